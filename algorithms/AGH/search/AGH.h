@@ -12,6 +12,10 @@
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include "binary_codes.h"
+#include "float_matrix.h"
+#include "batch_encoder.h"
 
 using namespace std;
 using std::string;
@@ -34,6 +38,11 @@ class AGH
 	vector<vector<float> > anchor;
 	vector<vector<float> > W;
 	vector<vector<float> > Thres;
+
+	// anchors and W for the batch encoder
+	FloatMatrix anchorT;
+	vector<double> anchorNorm;
+	FloatMatrix Wm;
     
 	void ReadAGHParams(string filename, int m_,int dim, int isTwo)
 	{
@@ -99,223 +108,92 @@ class AGH
 				Thres.push_back(tmp);
 			}
 		}
-	}
-	
-	void compactBits(vector<vector<float> > U,vector<vector<unsigned> >* B)
-	{
-		//U n*nbits
-		int n = U.size();
-		int nbits = U.at(0).size();
-		for(int i=0;i<n;i++)
-		{
-			vector<unsigned> B_;
-			unsigned tmp=0;
-			for(int j=0;j<=nbits;j++)
-			{
-				if(j==nbits)
-				{
-					B_.push_back(tmp);
-					break;
-				}
-				if(j%8==0 && j!=0)
-				{
-					B_.push_back(tmp);
-					tmp=0;
-				}
-				if(U.at(i)[j]>0)
-				{
-					unsigned pos=1<<(j%8);
-					tmp |= pos;
-				}
-			}
-			B->push_back(B_);
-		}
-	}
-	
-	struct L_Neighbor{
-		int pos;
-		float val;
-		L_Neighbor()
-		{
-			pos=0;
-			val=-1;
-		}
-	};
 
-	void UpdatePriorityList(L_Neighbor *BList, L_Neighbor tmp) {
-	// find the location to insert
-	int j;
-    int i = s;
-    while (i > 0) {
-        j = i - 1;
-        if (BList[j].val <= tmp.val && BList[j].val!=-1) break;
-        i = j;
-    }
-	if(i < s)
-	{
-    	j = s-1;
-    	while (j > i) {
-        	BList[j] = BList[j-1];
-        	--j;
-    	}
-    	BList[i] = tmp;
+		FloatMatrix A;
+		A.assign(anchor);
+		matrix_transpose(A, &anchorT);
+		squared_norms(A, &anchorNorm);
+		Wm.assign(W);
 	}
-	}
-	float get_distance(vector<float> point, vector<float> query)
+	
+	/**
+	 * Z[i] holds the normalized weights exp(-d/sigma^2) of the s anchors
+	 * nearest to X[i] and zero elsewhere. The distances of all queries to
+	 * all anchors are one matrix product.
+	 */
+	void anchorWeights(const FloatMatrix& X, FloatMatrix* Z)
 	{
-		int dim = query.size();
-		float dist=0.0;
-		for(int i=0; i<dim; i++)
-		{
-			dist += pow(point[i]-query[i],2);
-		}
-		return dist;
-	}
+		int nq = X.size();
+		int top = std::min(s, m);
+		FloatMatrix D;
+		squared_distances(X, anchorT, anchorNorm, &D);
 
-	void compressAGH_OneLayer(vector<vector<float> >* X, vector<vector<unsigned> >* B,int s_)
-	{
-		s = s_;
-		int nq = X->size();
-		int dim = X->at(0).size();
-		
-		vector<vector<L_Neighbor> > Y;
-		
-		vector<vector<float> > Z;
+		Z->resize(nq, m);
+		vector<int> pos(m);
+		vector<float> val(top);
 		for(int i=0; i<nq; i++)
 		{
-			vector<float> Z_(m,0);
-			Z.push_back(Z_);
-
-			vector<L_Neighbor> LNN(s);
+			const float* d = D.row(i);
 			for(int j=0; j<m; j++)
-			{
-				float dist = get_distance(X->at(i),anchor[j]);
-				L_Neighbor L_;
-				L_.pos=j;
-				L_.val=dist;
-				UpdatePriorityList(&LNN[0],L_);
-			}
+				pos[j] = j;
+			// ties go to the lower anchor, as in the insertion list
+			std::partial_sort(pos.begin(), pos.begin() + top, pos.end(),
+				[d](int a, int b) { return d[a] < d[b] || (d[a] == d[b] && a < b); });
+
 			float sum = 0.0;
-			for(int j=0;j<s;j++)
+			for(int j=0; j<top; j++)
 			{
-				L_Neighbor L_= LNN[j];
-				float val=exp((-1)* L_.val/pow(sigma,2));
-				L_.val=val;
-				LNN[j]=L_;
-				sum += val;
+				val[j] = exp((-1)* d[pos[j]]/pow(sigma,2));
+				sum += val[j];
 			}
 			sum = 1.0/sum;
-			for(int j=0; j<s; j++)
-			{
-				L_Neighbor L_=LNN[j];
-				float val= L_.val*sum;
-				L_.val=val;
-				LNN[j] = L_;
-			}
-
-			Y.push_back(LNN);		
+			float* z = Z->row(i);
+			for(int j=0; j<top; j++)
+				z[pos[j]] = val[j]*sum;
 		}
-		for(int i=0; i<nq; i++)
-		{
-			for(int j=0; j<s; j++)
-			{
-				int tep = Y[i][j].pos*nq+i;
-				Z[tep%nq][ceil(tep/nq)] = Y[i][j].val;
-			}
-		}
-		vector<vector<float> > U;
-		for(int i=0; i<nq; i++)
-		{
-			vector<float> U_;
-			for(int j=0; j<nbits; j++)
-			{
-				float tmp=0.0;
-				for(int t=0; t<m; t++)
-				{
-					tmp += Z[i][t]*W[t][j];
-				}
-				U_.push_back(tmp);
-			}
-			U.push_back(U_);
-		}
-		compactBits(U,B);
 	}
 
-	void compressAGH_TwoLayer(vector<vector<float> >* X, vector<vector<unsigned> >* B,int s_)
+	void compressAGH_OneLayer(const FloatMatrix& X, BinaryCodes* B,int s_)
 	{
 		s = s_;
-		int nq = X->size();
-		
-		vector<vector<L_Neighbor> > T;
-		
-		vector<vector<float> > Z;
-		for(int i=0; i<nq; i++)
-		{
-			vector<float> Z_(m,0);
-			Z.push_back(Z_);
+		FloatMatrix Z;
+		anchorWeights(X, &Z);
 
-			vector<L_Neighbor> LNN(s);
-			for(int j=0; j<m; j++)
-			{
-				float dist = get_distance(X->at(i),anchor[j]);
-				L_Neighbor L_;
-				L_.pos=j;
-				L_.val=dist;
-				UpdatePriorityList(&LNN[0],L_);
-			}
-			float sum = 0.0;
-			for(int j=0;j<s;j++)
-			{
-				L_Neighbor L_= LNN[j];
-				float val=exp((-1)* L_.val/pow(sigma,2));
-				L_.val=val;
-				LNN[j]=L_;
-				sum += val;
-			}
-			sum = 1.0/sum;
-			for(int j=0; j<s; j++)
-			{
-				L_Neighbor L_=LNN[j];
-				float val= L_.val*sum;
-				L_.val=val;
-				LNN[j] = L_;
-			}
+		// Z has s nonzeros per row, which matrix_multiply skips
+		FloatMatrix U;
+		matrix_multiply(Z, Wm, &U);
+		pack_signs(U, B);
+	}
 
-			T.push_back(LNN);		
-		}
+	void compressAGH_TwoLayer(const FloatMatrix& X, BinaryCodes* B,int s_)
+	{
+		s = s_;
+		int nq = X.size();
+		int half = nbits/2;
+		FloatMatrix Z;
+		anchorWeights(X, &Z);
+
+		FloatMatrix H;
+		matrix_multiply(Z, Wm, &H);
+
+		// the second layer thresholds the first one
+		FloatMatrix U;
+		U.resize(nq, nbits);
 		for(int i=0; i<nq; i++)
 		{
-			for(int j=0; j<s; j++)
+			const float* h = H.row(i);
+			float* u = U.row(i);
+			for(int j=0; j<half; j++)
 			{
-				int tep = T[i][j].pos*nq+i;
-				Z[tep%nq][ceil(tep/nq)] = T[i][j].val;
-			}
-		}
-		vector<vector<float> > Y;
-		for(int i=0; i<nq; i++)//nq
-		{
-			vector<float> U_;
-			U_.resize(nbits);
-			for(int j=0; j<nbits/2; j++)
-			{
-				float tmp=0.0;
-				for(int t=0; t<m; t++)
-				{
-					tmp += Z[i][t]*W[t][j];
-				}
-				U_[j]=tmp;
+				float tmp = h[j];
+				u[j] = tmp;
 				if(tmp > 0)
-				{
-					U_[nbits/2+j]=tmp-Thres[0][j];
-				}
+					u[half+j] = tmp-Thres[0][j];
 				else
-				{
-					U_[nbits/2+j]=-tmp+Thres[1][j];
-				};
+					u[half+j] = -tmp+Thres[1][j];
 			}
-			Y.push_back(U_);
 		}
-		compactBits(Y,B);
+		pack_signs(U, B);
 	}
 };
 
@@ -0,0 +1,274 @@
+/*
+ * binary_codes.h
+ *
+ *  Packed binary codes and the Hamming distance kernels.
+ */
+
+#ifndef BINARY_CODES_H_
+#define BINARY_CODES_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BINARY_CODES_X86_
+#endif
+
+using std::vector;
+
+/**
+ * Row-major matrix of binary codes stored in 64-bit words. Bit j of a code
+ * is bit j%64 of word j/64, which is the bit order of pack_signs and of the
+ * B1 files (8 bits per byte, byte b holding bits 8b..8b+7).
+ * Rows are stride words apart, where stride is the number of words rounded
+ * up to a power of two below 8 and to a multiple of 8 above. The matrix is
+ * 64-byte aligned, so each row is aligned to min(8*stride, 64) bytes. The
+ * padding bits are zero.
+ */
+class BinaryCodes
+{
+	public:
+	BinaryCodes() : base_(NULL), rows_(0), nbits_(0), words_(0), stride_(0) {}
+
+	BinaryCodes(int rows, int nbits) : base_(NULL)
+	{
+		resize(rows, nbits);
+	}
+
+	~BinaryCodes()
+	{
+		free(base_);
+	}
+
+	/**
+	 * Reserves rows codes of nbits bits, all zero.
+	 */
+	void resize(int rows, int nbits)
+	{
+		void* addr = NULL;
+		free(base_);
+		rows_ = rows;
+		nbits_ = nbits;
+		words_ = (nbits + 63) / 64;
+		stride_ = 1;
+		while (stride_ < words_ && stride_ < 8) stride_ *= 2;
+		if (words_ > 8) stride_ = (words_ + 7) / 8 * 8;
+		size_t bytes = sizeof(uint64_t) * stride_ * (size_t)(rows > 0 ? rows : 1);
+		if (posix_memalign(&addr, 64, bytes) != 0) addr = NULL;
+		base_ = (uint64_t*)addr;
+		if (base_ != NULL) memset(base_, 0, bytes);
+	}
+
+	uint64_t* row(int i) { return base_ + (size_t)i * stride_; }
+	const uint64_t* row(int i) const { return base_ + (size_t)i * stride_; }
+	int size() const { return rows_; }
+	int nbits() const { return nbits_; }
+	int words() const { return words_; }
+	int stride() const { return stride_; }
+
+	void setBit(int i, int j)
+	{
+		row(i)[j >> 6] |= uint64_t(1) << (j & 63);
+	}
+
+	/**
+	 * Sets row i from nbytes values holding 8 bits each.
+	 */
+	void setBytes(int i, const unsigned* bytes, int nbytes)
+	{
+		uint64_t* r = row(i);
+		for (int b = 0; b < nbytes; b++)
+		{
+			r[b >> 3] |= (uint64_t)(bytes[b] & 0xff) << ((b & 7) * 8);
+		}
+	}
+
+	private:
+	BinaryCodes(const BinaryCodes&);
+	BinaryCodes& operator=(const BinaryCodes&);
+
+	uint64_t* base_;
+	int rows_;
+	int nbits_;
+	int words_;
+	int stride_;
+};
+
+
+/**
+ * Hamming distance kernels. dist compares two codes of words words; scan
+ * writes the distances of a query to n rows that are stride words apart.
+ * The kernel is chosen once at run time from the instructions the cpu has,
+ * so the binaries need not be built with -march=native.
+ */
+typedef int (*HammingDistFunc)(const uint64_t* a, const uint64_t* b, int words);
+typedef void (*HammingScanFunc)(const uint64_t* q, const uint64_t* codes,
+	int stride, int words, int n, int* dist);
+
+struct HammingKernel
+{
+	HammingDistFunc dist;
+	HammingScanFunc scan;
+	const char* name;
+};
+
+inline int hamming_dist_generic(const uint64_t* a, const uint64_t* b, int words)
+{
+	int dist = 0;
+	for (int t = 0; t < words; t++)
+	{
+		uint64_t y = a[t] ^ b[t];
+		y = y - ((y >> 1) & 0x5555555555555555ULL);
+		y = (y & 0x3333333333333333ULL) + ((y >> 2) & 0x3333333333333333ULL);
+		y = (y + (y >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+		dist += (int)((y * 0x0101010101010101ULL) >> 56);
+	}
+	return dist;
+}
+
+inline void hamming_scan_generic(const uint64_t* q, const uint64_t* codes,
+	int stride, int words, int n, int* dist)
+{
+	for (int j = 0; j < n; j++)
+	{
+		dist[j] = hamming_dist_generic(q, codes + (size_t)j * stride, words);
+	}
+}
+
+#ifdef BINARY_CODES_X86_
+
+__attribute__((target("popcnt")))
+inline int hamming_dist_popcnt(const uint64_t* a, const uint64_t* b, int words)
+{
+	int dist = 0;
+	for (int t = 0; t < words; t++)
+	{
+		dist += (int)_mm_popcnt_u64(a[t] ^ b[t]);
+	}
+	return dist;
+}
+
+__attribute__((target("popcnt")))
+inline void hamming_scan_popcnt(const uint64_t* q, const uint64_t* codes,
+	int stride, int words, int n, int* dist)
+{
+	if (words == 1)
+	{
+		uint64_t q0 = q[0];
+		for (int j = 0; j < n; j++)
+		{
+			dist[j] = (int)_mm_popcnt_u64(codes[(size_t)j * stride] ^ q0);
+		}
+		return;
+	}
+	for (int j = 0; j < n; j++)
+	{
+		dist[j] = hamming_dist_popcnt(q, codes + (size_t)j * stride, words);
+	}
+}
+
+/**
+ * AVX-512 VPOPCNTDQ: one-word codes are compared 8 rows per instruction,
+ * long codes 8 words per instruction. Codes of 2 to 8 words use popcnt.
+ */
+__attribute__((target("avx512f,avx512vpopcntdq")))
+inline int hamming_dist_avx512(const uint64_t* a, const uint64_t* b, int words)
+{
+	__m512i sum = _mm512_setzero_si512();
+	int t = 0;
+	for (; t + 8 <= words; t += 8)
+	{
+		__m512i x = _mm512_xor_si512(_mm512_loadu_si512(a + t), _mm512_loadu_si512(b + t));
+		sum = _mm512_add_epi64(sum, _mm512_popcnt_epi64(x));
+	}
+	if (t < words)
+	{
+		__mmask8 mask = (__mmask8)((1u << (words - t)) - 1);
+		__m512i x = _mm512_xor_si512(_mm512_maskz_loadu_epi64(mask, a + t),
+			_mm512_maskz_loadu_epi64(mask, b + t));
+		sum = _mm512_add_epi64(sum, _mm512_popcnt_epi64(x));
+	}
+	return (int)_mm512_reduce_add_epi64(sum);
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+inline void hamming_scan_avx512(const uint64_t* q, const uint64_t* codes,
+	int stride, int words, int n, int* dist)
+{
+	int j = 0;
+	if (stride == 1)
+	{
+		__m512i q0 = _mm512_set1_epi64((long long)q[0]);
+		for (; j + 8 <= n; j += 8)
+		{
+			__m512i x = _mm512_xor_si512(_mm512_loadu_si512(codes + j), q0);
+			_mm256_storeu_si256((__m256i*)(dist + j),
+				_mm512_cvtepi64_epi32(_mm512_popcnt_epi64(x)));
+		}
+		for (; j < n; j++)
+		{
+			dist[j] = (int)_mm_popcnt_u64(codes[j] ^ q[0]);
+		}
+	}
+	else if (words <= 8)
+	{
+		hamming_scan_popcnt(q, codes, stride, words, n, dist);
+	}
+	else
+	{
+		for (; j < n; j++)
+		{
+			dist[j] = hamming_dist_avx512(q, codes + (size_t)j * stride, words);
+		}
+	}
+}
+
+#endif
+
+inline HammingKernel select_hamming_kernel()
+{
+	HammingKernel kernel;
+	kernel.dist = hamming_dist_generic;
+	kernel.scan = hamming_scan_generic;
+	kernel.name = "generic";
+#ifdef BINARY_CODES_X86_
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("popcnt"))
+	{
+		kernel.dist = hamming_dist_popcnt;
+		kernel.scan = hamming_scan_popcnt;
+		kernel.name = "popcnt";
+#if defined(__GNUC__) && (__GNUC__ >= 8 || defined(__clang__))
+		if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+		{
+			kernel.scan = hamming_scan_avx512;
+			kernel.name = "avx512vpopcntdq";
+		}
+#endif
+	}
+#endif
+	return kernel;
+}
+
+inline const HammingKernel& hamming_kernel()
+{
+	static const HammingKernel kernel = select_hamming_kernel();
+	return kernel;
+}
+
+inline int hamming_distance(const uint64_t* a, const uint64_t* b, int words)
+{
+	return hamming_kernel().dist(a, b, words);
+}
+
+/**
+ * Distances of query q to the rows begin..end-1 of codes, written to dist.
+ */
+inline void hamming_scan(const uint64_t* q, const BinaryCodes& codes, int begin, int end, int* dist)
+{
+	hamming_kernel().scan(q, codes.row(begin), codes.stride(), codes.words(), end - begin, dist);
+}
+
+#endif /* BINARY_CODES_H_ */
@@ -1,259 +0,0 @@
-
-unsigned char_bit_cnt [] = {
-0x0,
-0x1,
-0x1,
-0x2,
-0x1,
-0x2,
-0x2,
-0x3,
-0x1,
-0x2,
-0x2,
-0x3,
-0x2,
-0x3,
-0x3,
-0x4,
-0x1,
-0x2,
-0x2,
-0x3,
-0x2,
-0x3,
-0x3,
-0x4,
-0x2,
-0x3,
-0x3,
-0x4,
-0x3,
-0x4,
-0x4,
-0x5,
-0x1,
-0x2,
-0x2,
-0x3,
-0x2,
-0x3,
-0x3,
-0x4,
-0x2,
-0x3,
-0x3,
-0x4,
-0x3,
-0x4,
-0x4,
-0x5,
-0x2,
-0x3,
-0x3,
-0x4,
-0x3,
-0x4,
-0x4,
-0x5,
-0x3,
-0x4,
-0x4,
-0x5,
-0x4,
-0x5,
-0x5,
-0x6,
-0x1,
-0x2,
-0x2,
-0x3,
-0x2,
-0x3,
-0x3,
-0x4,
-0x2,
-0x3,
-0x3,
-0x4,
-0x3,
-0x4,
-0x4,
-0x5,
-0x2,
-0x3,
-0x3,
-0x4,
-0x3,
-0x4,
-0x4,
-0x5,
-0x3,
-0x4,
-0x4,
-0x5,
-0x4,
-0x5,
-0x5,
-0x6,
-0x2,
-0x3,
-0x3,
-0x4,
-0x3,
-0x4,
-0x4,
-0x5,
-0x3,
-0x4,
-0x4,
-0x5,
-0x4,
-0x5,
-0x5,
-0x6,
-0x3,
-0x4,
-0x4,
-0x5,
-0x4,
-0x5,
-0x5,
-0x6,
-0x4,
-0x5,
-0x5,
-0x6,
-0x5,
-0x6,
-0x6,
-0x7,
-0x1,
-0x2,
-0x2,
-0x3,
-0x2,
-0x3,
-0x3,
-0x4,
-0x2,
-0x3,
-0x3,
-0x4,
-0x3,
-0x4,
-0x4,
-0x5,
-0x2,
-0x3,
-0x3,
-0x4,
-0x3,
-0x4,
-0x4,
-0x5,
-0x3,
-0x4,
-0x4,
-0x5,
-0x4,
-0x5,
-0x5,
-0x6,
-0x2,
-0x3,
-0x3,
-0x4,
-0x3,
-0x4,
-0x4,
-0x5,
-0x3,
-0x4,
-0x4,
-0x5,
-0x4,
-0x5,
-0x5,
-0x6,
-0x3,
-0x4,
-0x4,
-0x5,
-0x4,
-0x5,
-0x5,
-0x6,
-0x4,
-0x5,
-0x5,
-0x6,
-0x5,
-0x6,
-0x6,
-0x7,
-0x2,
-0x3,
-0x3,
-0x4,
-0x3,
-0x4,
-0x4,
-0x5,
-0x3,
-0x4,
-0x4,
-0x5,
-0x4,
-0x5,
-0x5,
-0x6,
-0x3,
-0x4,
-0x4,
-0x5,
-0x4,
-0x5,
-0x5,
-0x6,
-0x4,
-0x5,
-0x5,
-0x6,
-0x5,
-0x6,
-0x6,
-0x7,
-0x3,
-0x4,
-0x4,
-0x5,
-0x4,
-0x5,
-0x5,
-0x6,
-0x4,
-0x5,
-0x5,
-0x6,
-0x5,
-0x6,
-0x6,
-0x7,
-0x4,
-0x5,
-0x5,
-0x6,
-0x5,
-0x6,
-0x6,
-0x7,
-0x5,
-0x6,
-0x6,
-0x7,
-0x6,
-0x7,
-0x7,
-0x8,
-0};
@@ -17,6 +17,7 @@
 #include <iostream>
 #include <fstream>
 #include <set>
+#include "float_matrix.h"
 
 using namespace std;
 using std::string;
@@ -88,7 +89,7 @@ float compute_number_closer(vector<vector<int> >* gnds, vector<vector<int> >* re
 	return avg/nq;
 }
 
-float compute_relative_distance_error(vector<vector<float> >* points, vector<vector<float> >* query, vector<vector<int> >* gnds, vector<vector<int> >* results)
+float compute_relative_distance_error(const FloatMatrix& points, const FloatMatrix& query, vector<vector<int> >* gnds, vector<vector<int> >* results)
 {
 	size_t nq = results->size();
 	size_t nn = results->at(0).size();
@@ -99,8 +100,8 @@ float compute_relative_distance_error(vector<vector<float> >* points, vector<vec
 
 		for (size_t j=0;j<nn;++j)
 		{
-			float min_distance= get_distance(points->at(gnds->at(i)[j]),query->at(i));
-			float test_distance = get_distance(points->at(results->at(i)[j]),query->at(i));
+			float min_distance= l2_distance(points.row(gnds->at(i)[j]),query.row(i),points.stride());
+			float test_distance = l2_distance(points.row(results->at(i)[j]),query.row(i),points.stride());
 			float d= (test_distance - min_distance )/min_distance;
 			if(d >4)
 				sum +=4;
@@ -229,7 +230,7 @@ float compute_number_closer(vector<vector<int> >* gnds, vector<vector<E_Neighbor
 	return avg/nq;
 }
 
-float compute_relative_distance_error(vector<vector<float> >* points, vector<vector<float> >* query, vector<vector<int> >* gnds, vector<vector<E_Neighbor> >* results)
+float compute_relative_distance_error(const FloatMatrix& points, const FloatMatrix& query, vector<vector<int> >* gnds, vector<vector<E_Neighbor> >* results)
 {
 	size_t nq = results->size();
 	size_t nn = results->at(0).size();
@@ -240,7 +241,7 @@ float compute_relative_distance_error(vector<vector<float> >* points, vector<vec
 
 		for (size_t j=0;j<nn;++j)
 		{
-			float min_distance= get_distance(points->at(gnds->at(i)[j]),query->at(i));
+			float min_distance= l2_distance(points.row(gnds->at(i)[j]),query.row(i),points.stride());
 			float test_distance=results->at(i)[j].dist;
 			float d= (test_distance - min_distance )/min_distance;
            
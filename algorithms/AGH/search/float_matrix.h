@@ -0,0 +1,176 @@
+/*
+ * float_matrix.h
+ *
+ *  Contiguous float vectors and the squared Euclidean distance kernels.
+ */
+
+#ifndef FLOAT_MATRIX_H_
+#define FLOAT_MATRIX_H_
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "../../../tools/dataset/mmap_dataset.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FLOAT_MATRIX_X86_
+#endif
+
+using std::vector;
+
+/**
+ * Row-major matrix of float vectors. Rows are padded with zeros to a
+ * multiple of 16 floats and the matrix is 64-byte aligned, so every row
+ * starts on a cache line and the distance kernels need no scalar tail when
+ * they run over stride() floats.
+ */
+class FloatMatrix
+{
+	public:
+	FloatMatrix() : base_(NULL), rows_(0), dim_(0), stride_(0) {}
+
+	~FloatMatrix()
+	{
+		release();
+	}
+
+	/**
+	 * Reserves rows vectors of dim floats, all zero.
+	 */
+	void resize(int rows, int dim)
+	{
+		void* addr = NULL;
+		release();
+		rows_ = rows;
+		dim_ = dim;
+		stride_ = (dim + 15) / 16 * 16;
+		size_t bytes = sizeof(float) * stride_ * (size_t)(rows > 0 ? rows : 1);
+		if (posix_memalign(&addr, 64, bytes) != 0) addr = NULL;
+		base_ = (float*)addr;
+		if (base_ != NULL) memset(base_, 0, bytes);
+	}
+
+	void assign(const vector<vector<float> >& X)
+	{
+		resize(X.size(), X.empty() ? 0 : X[0].size());
+		for (int i = 0; i < rows_; i++)
+		{
+			memcpy(row(i), &X[i][0], sizeof(float) * dim_);
+		}
+	}
+
+	/**
+	 * Takes over the float rows of a dataset file. They are copied to
+	 * aligned, padded rows (on huge pages if asked), and the file is closed.
+	 */
+	void assign(nns::Dataset& file, bool huge_pages = false)
+	{
+		release();
+		file.align(64, huge_pages);
+		file_.swap(file);
+		rows_ = file_.size();
+		dim_ = file_.dim();
+		stride_ = file_.stride() / sizeof(float);
+		base_ = rows_ > 0 ? file_.mutable_row<float>(0) : NULL;
+	}
+
+	float* row(int i) { return base_ + (size_t)i * stride_; }
+	const float* row(int i) const { return base_ + (size_t)i * stride_; }
+	int size() const { return rows_; }
+	int dim() const { return dim_; }
+	int stride() const { return stride_; }
+
+	private:
+	FloatMatrix(const FloatMatrix&);
+	FloatMatrix& operator=(const FloatMatrix&);
+
+	void release()
+	{
+		if (file_.stride() == 0) free(base_);
+		file_.close();
+		base_ = NULL;
+	}
+
+	nns::Dataset file_;  // holds the rows taken over by assign
+	float* base_;
+	int rows_;
+	int dim_;
+	int stride_;
+};
+
+
+/**
+ * Squared Euclidean distance of two vectors of n floats. As for the Hamming
+ * kernels, the kernel is chosen once at run time from the instructions the
+ * cpu has.
+ */
+typedef float (*L2DistFunc)(const float* a, const float* b, int n);
+
+inline float l2_dist_generic(const float* a, const float* b, int n)
+{
+	float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		float d0 = a[i] - b[i], d1 = a[i + 1] - b[i + 1];
+		float d2 = a[i + 2] - b[i + 2], d3 = a[i + 3] - b[i + 3];
+		s0 += d0 * d0;
+		s1 += d1 * d1;
+		s2 += d2 * d2;
+		s3 += d3 * d3;
+	}
+	for (; i < n; i++)
+	{
+		float d = a[i] - b[i];
+		s0 += d * d;
+	}
+	return (s0 + s1) + (s2 + s3);
+}
+
+#ifdef FLOAT_MATRIX_X86_
+
+__attribute__((target("avx2,fma")))
+inline float l2_dist_avx2(const float* a, const float* b, int n)
+{
+	__m256 sum0 = _mm256_setzero_ps();
+	__m256 sum1 = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+		__m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+		sum0 = _mm256_fmadd_ps(d0, d0, sum0);
+		sum1 = _mm256_fmadd_ps(d1, d1, sum1);
+	}
+	sum0 = _mm256_add_ps(sum0, sum1);
+	__m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum0), _mm256_extractf128_ps(sum0, 1));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	float dist = _mm_cvtss_f32(sum);
+	for (; i < n; i++)
+	{
+		float d = a[i] - b[i];
+		dist += d * d;
+	}
+	return dist;
+}
+
+#endif
+
+inline L2DistFunc select_l2_kernel()
+{
+#ifdef FLOAT_MATRIX_X86_
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return l2_dist_avx2;
+#endif
+	return l2_dist_generic;
+}
+
+inline float l2_distance(const float* a, const float* b, int n)
+{
+	static const L2DistFunc kernel = select_l2_kernel();
+	return kernel(a, b, n);
+}
+
+#endif /* FLOAT_MATRIX_H_ */
@@ -10,6 +10,7 @@
 
 #include "annoylib.h"
 #include "kissrandom.h"
+#include "../../tools/dataset/mmap_dataset.h"
 
 using namespace std;
 using std::set;
@@ -23,39 +24,22 @@ float diff_timeval(timeval t1, timeval t2) {
   return (float) (t1.tv_sec - t2.tv_sec) + (t1.tv_usec - t2.tv_usec) * 1e-6;
 }
 
-static const unsigned LSHKIT_HEADER = 3;
-
 typedef float T;
 typedef unsigned S;
 
+// maps an lshkit file of P elements, the rows are read in place
 template<typename P>
-char* load_data(const char* data_path, int& dim, int& N )
+void load_data(const char* data_path, nns::Dataset& ds, int& dim, int& N)
 {
-	// start to read data 
-    ifstream is(data_path, ios::binary);
-    unsigned header[LSHKIT_HEADER]; /* entry size, row, col */
-    is.read((char *)header, sizeof header);
-    
-    dim = header[2];
-    unsigned skip = LSHKIT_HEADER * sizeof(unsigned);   
-
-    is.seekg(0, std::ios::end);
-	size_t size = is.tellg();
-    size -= skip;
-    unsigned line = sizeof(P) * dim;
-    N =  size/line; 
-      
-    is.seekg(skip, std::ios::beg);
-    char* data = new char[N*sizeof(P)*dim];
-
-    for (unsigned i = 0; i < N; ++i) {
-        is.read( data + i*sizeof(P)*dim , sizeof(P) * dim);      
-    }    
-    is.close();
-    return data;
+    ds.open(data_path, nns::FORMAT_LSHKIT);
+    if (ds.elem_size() != sizeof(P)) {
+        throw runtime_error(string(data_path) + ": unexpected element size");
+    }
+    dim = ds.dim();
+    N = ds.size();
 }
 
-T get_recall(S * gt, vector<int32_t>* res, S k)
+T get_recall(const S * gt, vector<int32_t>* res, S k)
 {
 	float ratio=0;
 	std::set<S> gnd_row;
@@ -70,7 +54,7 @@ T get_recall(S * gt, vector<int32_t>* res, S k)
 }
 
 
-T get_mAP(S * gt, vector<int32_t>* res, S k)
+T get_mAP(const S * gt, vector<int32_t>* res, S k)
 {
 	std::set<S> gs_set;
 	int found_last=0;
@@ -137,11 +121,12 @@ int main_buildIndex(int argc, char *argv[]){
 	}
 
 	int dim, N;
-    char *data = load_data<T>(data_path, dim , N);
+    nns::Dataset data;
+    load_data<T>(data_path, data, dim , N);
 
 	AnnoyIndex<int32_t, float, Euclidean, Kiss64Random>* index = new AnnoyIndex<int32_t, float, Euclidean, Kiss64Random>(dim);
     for (unsigned i = 0; i < N; ++i) {  
-        index->add_item( i, (T*) (data +i*dim*sizeof(T)));
+        index->add_item( i, data.row<T>(i));
     }
 
   	timeval start;
@@ -160,7 +145,6 @@ int main_buildIndex(int argc, char *argv[]){
           << N    << " # N  " << N << endl
           << trees << " # nTree " << endl*/
 
-    delete []data;    
 	delete index;
 
 }
@@ -226,13 +210,13 @@ int main_search(int argc, char *argv[]){
 	}
 	
     int dim, nq;
-    char *query_data = load_data<T>(query_path, dim , nq);
-	char *gnd_data = load_data<S>(gnd_path, K , nq);
+    nns::Dataset query_data, gnd_data;
+    load_data<T>(query_path, query_data, dim , nq);
+	load_data<S>(gnd_path, gnd_data, K , nq);
 
 	AnnoyIndex<int32_t, float, Euclidean, Kiss64Random>* index = new AnnoyIndex<int32_t, float, Euclidean, Kiss64Random>(dim);
 	index->load(index_path);	
 
-	assert( query_data != NULL );
 	T recall=0;
 	int search_N=0;
 	T mAP =0;
@@ -245,13 +229,13 @@ int main_search(int argc, char *argv[]){
 		vector<int> result;
 		vector<T> distance;
         gettimeofday(&start, NULL);
-		index->get_nns_by_vector ((T*) (query_data +i*dim*sizeof(T)), K, nStop, &result, &distance); //,(S*)(gnd_data +i*K*sizeof(S))
+		index->get_nns_by_vector (query_data.row<T>(i), K, nStop, &result, &distance); //,gnd_data.row<S>(i)
 		gettimeofday(&end, NULL);
 	    search_time += diff_timeval(end, start);
 		search_N += result[K];
-		recall += get_recall((S*)(gnd_data +i*K*sizeof(S)),&result,K);
+		recall += get_recall(gnd_data.row<S>(i),&result,K);
 		
-		mAP += get_mAP((S*)(gnd_data +i*K*sizeof(S)),&result,K);
+		mAP += get_mAP(gnd_data.row<S>(i),&result,K);
 	}
 	//index->get_hits();
 	
@@ -262,8 +246,6 @@ int main_search(int argc, char *argv[]){
 	fprintf(ofp,"%.6f %.6f %.6f #N_%d %.6f \n",recall,0.0,search_time,search_N,mAP);	
 	fclose(ofp);
 
-	if ( query_data != NULL ) delete []query_data;
-
 	delete index;
 }
 
@@ -8,6 +8,7 @@
 #include <fstream>
 #include <stdexcept>
 #include <boost/assert.hpp>
+#include "../../../tools/dataset/mmap_dataset.h"
 
 #ifdef __GNUC__
 #ifdef __AVX__
@@ -108,36 +109,25 @@ namespace kgraph {
         void zero () {
             memset(data, 0, row * stride);
         }
-        void load (const std::string &path, unsigned dim, unsigned skip = 0, unsigned gap = 0) {
-            std::ifstream is(path.c_str(), std::ios::binary);
-            BOOST_VERIFY(is);
-            is.seekg(0, std::ios::end);
-            size_t size = is.tellg();
-            size -= skip;
-            unsigned line = sizeof(T) * dim + gap;
-            unsigned N =  size / line;
-            reset(N, dim);
+        /// Copies the rows of a mapped dataset file.
+        void load (nns::Dataset const &file) {
+            reset(file.size(), file.dim());
             zero();
-            is.seekg(skip, std::ios::beg);
-            for (unsigned i = 0; i < N; ++i) {
-                is.read(&data[stride * i], sizeof(T) * dim);
-                is.seekg(gap, std::ios::cur);
+            for (unsigned i = 0; i < row; ++i) {
+                memcpy(&data[stride * i], file.row_bytes(i), sizeof(T) * col);
             }
-            BOOST_VERIFY(is);
+        }
+        void load (const std::string &path, unsigned dim, unsigned skip = 0, unsigned gap = 0) {
+            nns::Dataset file;
+            file.open_raw(path, sizeof(T), dim, skip, gap);
+            load(file);
         }
 
         void load_lshkit (std::string const &path) {
-            static const unsigned LSHKIT_HEADER = 3;
-            std::ifstream is(path.c_str(), std::ios::binary);
-            unsigned header[LSHKIT_HEADER]; /* entry size, row, col */
-            is.read((char *)header, sizeof header);
-            BOOST_VERIFY(is);
-            BOOST_VERIFY(header[0] == sizeof(T));
-            is.close();
-            unsigned D = header[2];
-            unsigned skip = LSHKIT_HEADER * sizeof(unsigned);
-            unsigned gap = 0;
-            load(path, D, skip, gap);
+            nns::Dataset file;
+            file.open(path, nns::FORMAT_LSHKIT);
+            BOOST_VERIFY(file.elem_size() == sizeof(T));
+            load(file);
         }
 
         void save_lshkit (std::string const &path) {
@@ -31,8 +31,8 @@ using std::ifstream;
 using std::ios;
 using std::endl;
 
-vector<vector <float> > points;
-vector<vector <float > > query;
+FloatMatrix points;
+FloatMatrix queries;
 vector<vector <int> > gnds;
 vector<int> maxChecks;
 
@@ -41,6 +41,8 @@ int nq;
 int dim;
 int k;
 int radis;
+int num_threads = 1;
+int mih_tables;
 
 float diff_timeval(timeval t1, timeval t2) {
   return (float) (t1.tv_sec - t2.tv_sec) + (t1.tv_usec - t2.tv_usec) * 1e-6;
@@ -56,6 +58,8 @@ int main(int argc, char * argv[]) {
 	    {"m",                           required_argument, 0, 'm'},
 		{"k",                           required_argument, 0, 'k'},
 		{"r",                           required_argument, 0, 'r'},
+		{"mih",                         required_argument, 0, 'i'},
+		{"num-of-threads",              required_argument, 0, 'T'},
 		{"c",                           required_argument, 0, 'c'},
 	    {"dataset_binary_path",         required_argument, 0, 'b'},
 	    {"params_path",                 required_argument, 0, 'p'},
@@ -72,7 +76,7 @@ int main(int argc, char * argv[]) {
 	  char checks_path[20] ="";
 
 	  while (iarg != -1) {
-	    iarg = getopt_long(argc, argv, "s:q:g:n:m:k:r:c:b:p:h",
+	    iarg = getopt_long(argc, argv, "s:q:g:n:m:k:r:i:T:c:b:p:h",
 	                       longopts, &index);
 
 	    switch (iarg) {
@@ -111,6 +115,16 @@ int main(int argc, char * argv[]) {
 	    	  radis = atoi(optarg);
 	    	  }
 	    	  break;
+		  case 'i':
+	    	  if (optarg) {
+	    	  mih_tables = atoi(optarg);
+	    	  }
+	    	  break;
+		  case 'T':
+	    	  if (optarg) {
+	    	  num_threads = atoi(optarg);
+	    	  }
+	    	  break;
 		  case 'c':
 	    	  if (optarg) {
 			  strcpy(checks_path, optarg);
@@ -132,7 +146,7 @@ int main(int argc, char * argv[]) {
 	  ///*
 	  ReadPoints(dataset_filepath, &points, n, &dim);
 
-	  ReadPoints(query_filepath, &query,nq, &dim);
+	  ReadPoints(query_filepath, &queries,nq, &dim);
 
 	  ReadGroundtruth(groundtruth_filepath, &gnds, nq, k);
 
@@ -144,7 +158,7 @@ int main(int argc, char * argv[]) {
 	  int nbits = NSH_.nbits;
 
 
-	  vector<vector<unsigned> > B1;
+	  BinaryCodes B1;
 	  ReadB1(dataset_binary_path,&B1,n);
 
 
@@ -153,11 +167,16 @@ int main(int argc, char * argv[]) {
 	  if(radis!=-1)
 	  	HCI_.buildIndex();
 
+	  // multi-index hashing for range search; -i -1 scans all codes instead
+	  MultiIndexHashing MIH_;
+	  if(radis>=0 && mih_tables>=0)
+	  	MIH_.buildIndex(B1,mih_tables);
+
       timeval start;
 	  gettimeofday(&start, NULL);
 
-	  vector<vector<unsigned> > B2;
-	  NSH_.compressNSH(&query,&B2);
+	  BinaryCodes B2;
+	  NSH_.compressNSH(queries,&B2);
 
 	  timeval end;
 	  gettimeofday(&end, NULL);
@@ -175,18 +194,20 @@ int main(int argc, char * argv[]) {
 		     hammingDist(&B2,&B1,&indices,maxChecks[i]);
 		  else if(radis==-2)
 			 HCI_.knnSearch(B2,indices,dists,maxChecks[i],maxChecks[i]);
+		  else if(mih_tables>=0)
+		     MIH_.rangeSearch(B2,radis,&indices);
 		  else
 		     hammingDist_ByRange(&B2,&B1,&indices,radis);
 
 		  // get results after re-ranking
 		  vector<vector<int> > results;
-		  results = Search(&points, &query, &indices, k);
+		  results = Search(points, queries, indices, k, num_threads);
 
 		  gettimeofday(&end, NULL);
 		  double search_time = diff_timeval(end, start);
 
 		  float recall = compute_recall(&gnds, &results);
-		  float rde =  compute_relative_distance_error(&points, &query, &gnds, &results);
+		  float rde =  compute_relative_distance_error(points, queries, &gnds, &results);
 		  cout<<recall<<" "<<rde << " "<< search_time/nq << " #bit_"<< nbits<<" #radis_"<<radis<<" #maxChecks_"<<maxChecks[i]<<" "<< endl;
 		 	
 	  }
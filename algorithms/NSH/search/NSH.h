@@ -12,6 +12,9 @@
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include "binary_codes.h"
+#include "float_matrix.h"
+#include "batch_encoder.h"
 
 using namespace std;
 using std::string;
@@ -33,6 +36,11 @@ class NSH
 	vector<vector<float> > pivots;
 	vector<vector<float> > W;
 
+	// pivots and W for the batch encoder
+	FloatMatrix pivotT;
+	vector<double> pivotNorm;
+	FloatMatrix Wm;
+
 	void ReadNSHParams(string filename, int dim)
 	{
 		FILE* fp=fopen(filename.c_str(),"r");
@@ -66,6 +74,12 @@ class NSH
 			fscanf(fp,"\n");
 			W.push_back(tmp);
 		}
+
+		FloatMatrix P;
+		P.assign(pivots);
+		matrix_transpose(P, &pivotT);
+		squared_norms(P, &pivotNorm);
+		Wm.assign(W);
 	}
 
 	void compressNSH(vector<vector<float> >* X, vector<vector<float> >* U)
@@ -105,83 +119,28 @@ class NSH
 		}
 	}*/
 
-	void compactBits(vector<vector<float> > U,vector<vector<unsigned> >* B)
-	{
-			//U n*nbits
-		int n = U.size();
-		int nbits = U.at(0).size();
-		for(int i=0;i<n;i++)//n
-		{
-			vector<unsigned> B_;
-			unsigned tmp=0;
-			for(int j=0;j<=nbits;j++)
-			{
-				if(j==nbits)
-				{
-					B_.push_back(tmp);
-					break;
-				}
-				if(j%8==0 && j!=0)
-				{
-					B_.push_back(tmp);
-					tmp=0;
-				}
-				if(U.at(i)[j]>0)
-				{
-					unsigned pos=1<<(j%8);
-					tmp |= pos;
-				}
-			}
-			B->push_back(B_);
-		}
-	}
-	float get_distance(vector<float> point, vector<float> query)
-	{
-		int dim = query.size();
-		float dist=0.0;
-		for(int i=0; i<dim; i++)
-		{
-			dist += pow(point[i]-query[i],2);
-		}
-		return dist;
-	}
-
-	void compressNSH(vector<vector<float> >* X, vector<vector<unsigned> >* B)
+	void compressNSH(const FloatMatrix& X, BinaryCodes* B)
 	{
 		//X nq*dim
-		int n = X->size();
-		int dim = X->at(0).size();
-
-		vector<vector<float> > QK;
-		QK.resize(n);
+		int n = X.size();
 
+		// QK = [exp(-||x-p||^2/eps^2), 1], from one matrix product
+		FloatMatrix D;
+		squared_distances(X, pivotT, pivotNorm, &D);
+		FloatMatrix QK;
+		QK.resize(n, m+1);
 		for(int i=0; i<n; i++)
 		{
-			QK.at(i).resize(m+1);
-			for(int j=0;j< m; j++)
-			{
-				float dist = get_distance(X->at(i),pivots.at(j));
-				//cout<<"dist:"<<i<<" "<<j<<":"<<dist<<endl;
-				QK[i][j] = exp((-1)*dist/pow(eps,2));
-			}
-			QK[i][m]=1;
+			const float* d = D.row(i);
+			float* qk = QK.row(i);
+			for(int j=0; j<m; j++)
+				qk[j] = exp((-1)*d[j]/pow(eps,2));
+			qk[m] = 1;
 		}
-		vector<vector<float> > HH;
-		HH.resize(n);
-		for(int i=0; i<n; i++)
-		{
-			HH.at(i).resize(nbits);
-			for(int j = 0 ; j < nbits; j++)
-			{
-				float tmp = 0.0;
-				for(int t=0;t<m+1;t++)
-				{
-					tmp += QK[i][t] * W[t][j];
-				}
-				HH[i][j] = tmp;
-			}
-		}
-		compactBits(HH,B);
+
+		FloatMatrix HH;
+		matrix_multiply(QK, Wm, &HH);
+		pack_signs(HH, B);
 	}
 
 	void compressNSH(vector<vector<float> >* X, vector<vector<int> >* U)
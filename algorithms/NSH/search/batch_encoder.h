@@ -0,0 +1,165 @@
+/*
+ * batch_encoder.h
+ *
+ *  Matrix kernels for encoding a batch of queries at once: blocked matrix
+ *  products, squared distances to a set of centers, and packing of signs
+ *  into binary codes.
+ */
+
+#ifndef BATCH_ENCODER_H_
+#define BATCH_ENCODER_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include "float_matrix.h"
+#include "binary_codes.h"
+
+/**
+ * C = A * B for A of n x k and B of k x p. A row of C is accumulated from
+ * whole rows of B, so the inner loop runs over contiguous, zero-padded
+ * floats and is vectorized by the compiler; blocking over rows of A and B
+ * keeps the rows of B in cache while a block of A is processed.
+ */
+inline void matrix_multiply(const FloatMatrix& A, const FloatMatrix& B, FloatMatrix* C)
+{
+	const int ROWS = 32;
+	const int DEPTH = 128;
+	int n = A.size();
+	int k = A.dim();
+	int stride = B.stride();
+	C->resize(n, B.dim());
+	for (int i0 = 0; i0 < n; i0 += ROWS)
+	{
+		int i1 = std::min(n, i0 + ROWS);
+		for (int t0 = 0; t0 < k; t0 += DEPTH)
+		{
+			int t1 = std::min(k, t0 + DEPTH);
+			for (int i = i0; i < i1; i++)
+			{
+				const float* a = A.row(i);
+				float* __restrict c = C->row(i);
+				for (int t = t0; t < t1; t++)
+				{
+					float at = a[t];
+					if (at == 0) continue;
+					const float* __restrict b = B.row(t);
+					for (int j = 0; j < stride; j++)
+						c[j] += at * b[j];
+				}
+			}
+		}
+	}
+}
+
+inline void matrix_transpose(const FloatMatrix& A, FloatMatrix* T)
+{
+	T->resize(A.dim(), A.size());
+	for (int i = 0; i < A.size(); i++)
+	{
+		const float* a = A.row(i);
+		for (int j = 0; j < A.dim(); j++)
+			T->row(j)[i] = a[j];
+	}
+}
+
+/**
+ * D[i][j] = ||X_i||^2 + ||C_j||^2 - 2 X_i.C_j, the squared distances of the
+ * rows of X to the centers C, given the transpose CT of C and the squared
+ * norms of its rows. The norms and cross terms are accumulated in double:
+ * in float the cancellation loses the small distances of near centers,
+ * which are the ones anchors and kernels are selected by.
+ */
+inline void squared_distances(const FloatMatrix& X, const FloatMatrix& CT,
+	const vector<double>& cnorms, FloatMatrix* D)
+{
+	int m = CT.dim();
+	D->resize(X.size(), m);
+	vector<double> dot(m);
+	for (int i = 0; i < X.size(); i++)
+	{
+		const float* x = X.row(i);
+		double xnorm = 0;
+		std::fill(dot.begin(), dot.end(), 0.0);
+		for (int t = 0; t < X.dim(); t++)
+		{
+			double xt = x[t];
+			if (xt == 0) continue;
+			xnorm += xt * xt;
+			const float* c = CT.row(t);
+			for (int j = 0; j < m; j++)
+				dot[j] += xt * c[j];
+		}
+		float* d = D->row(i);
+		for (int j = 0; j < m; j++)
+			d[j] = (float)std::max(0.0, xnorm + cnorms[j] - 2 * dot[j]);
+	}
+}
+
+inline void squared_norms(const FloatMatrix& C, vector<double>* norms)
+{
+	norms->assign(C.size(), 0);
+	for (int j = 0; j < C.size(); j++)
+	{
+		const float* c = C.row(j);
+		double norm = 0;
+		for (int t = 0; t < C.dim(); t++)
+			norm += (double)c[t] * c[t];
+		(*norms)[j] = norm;
+	}
+}
+
+/**
+ * Sets bit j of code i when U[i][j] > 0.
+ * Eight signs are taken per compare and movemask where AVX is available;
+ * the zero padding of U leaves the bits past nbits clear.
+ */
+inline void pack_signs_generic(const FloatMatrix& U, BinaryCodes* B)
+{
+	for (int i = 0; i < U.size(); i++)
+	{
+		const float* u = U.row(i);
+		uint64_t* b = B->row(i);
+		for (int j = 0; j < U.dim(); j++)
+		{
+			if (u[j] > 0)
+				b[j >> 6] |= uint64_t(1) << (j & 63);
+		}
+	}
+}
+
+#ifdef FLOAT_MATRIX_X86_
+
+__attribute__((target("avx")))
+inline void pack_signs_avx(const FloatMatrix& U, BinaryCodes* B)
+{
+	__m256 zero = _mm256_setzero_ps();
+	for (int i = 0; i < U.size(); i++)
+	{
+		const float* u = U.row(i);
+		uint64_t* b = B->row(i);
+		for (int j = 0; j < U.dim(); j += 8)
+		{
+			uint64_t mask = (uint64_t)_mm256_movemask_ps(
+				_mm256_cmp_ps(_mm256_load_ps(u + j), zero, _CMP_GT_OQ));
+			b[j >> 6] |= mask << (j & 63);
+		}
+	}
+}
+
+#endif
+
+inline void pack_signs(const FloatMatrix& U, BinaryCodes* B)
+{
+	B->resize(U.size(), U.dim());
+#ifdef FLOAT_MATRIX_X86_
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx"))
+	{
+		pack_signs_avx(U, B);
+		return;
+	}
+#endif
+	pack_signs_generic(U, B);
+}
+
+#endif /* BATCH_ENCODER_H_ */
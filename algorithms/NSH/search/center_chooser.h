@@ -1,32 +1,20 @@
 #include "random.h"
 //#include "dist.h"
-#include "char_bit_cnt.h"
+#include "binary_codes.h"
 
 class CenterChooser
 {
-	vector<vector<unsigned>* > dataset_;
+	const BinaryCodes* dataset_;
 public:
 
-	void setDataset(vector<vector<unsigned> >& dataset)
+	void setDataset(const BinaryCodes& dataset)
     {
-		size_t size_ = dataset.size();
-
-		dataset_.resize(size_);
-		for (size_t i=0;i<size_;i++)
-			dataset_.at(i) = &dataset.at(i);
-
+		dataset_ = &dataset;
     }
 ///*
 	int get_distance(int p1, int p2)
 	{
-		int dist=0;
-		int cbits = dataset_.at(0)->size();
-		for(int t=0; t<cbits; t++)
-		{
-			unsigned y = dataset_.at(p1)->at(t) ^ dataset_.at(p2)->at(t);
-			dist += char_bit_cnt[y];
-		}
-		return dist;
+		return hamming_distance(dataset_->row(p1), dataset_->row(p2), dataset_->words());
 	} //*/
 
 	void chooseCenters(int k, int* indices, int indices_length, int* centers, int& centers_length)
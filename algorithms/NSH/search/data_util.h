@@ -15,6 +15,8 @@
 #include <cstdlib>
 #include <dirent.h>
 #include <stdexcept>
+#include "binary_codes.h"
+#include "float_matrix.h"
 //#include "Params.h"
 
 using namespace std;
@@ -45,77 +47,70 @@ void transpose(vector<vector<float> > X,vector<vector<float> >* Y)
 	cout<<"Y10"<<Y->at(1)[0]<<endl;
 }
 
+// maps an fvecs or ivecs file and checks that it has at least count vectors
+void MapVectors(const string& filename, nns::DataFormat format, int count, nns::Dataset* file) {
+  file->open(filename, format);
+  if((int)file->size() < count) {
+    throw std::logic_error("Bad file content: fewer vectors than requested");
+  }
+  file->truncate(count);
+  if(!file->check_rows()) {
+    throw std::logic_error("Bad file content: vectors of different dimensions");
+  }
+}
+
 void ReadPoints(const string& filename, vector<vector<float> >* points, int count, int *dim) {
-	//vector<vector<float> > X;
-	ifstream input;
-	input.open(filename.c_str(), ios::binary);
-	if(!input.good()) {
-		throw std::logic_error("Invalid filename");
-	}
-	//X.resize(count);
-	points->resize(count);
-	int dimension;
-	for(int pid = 0; pid < count; ++pid) {
-		input.read((char*)&dimension, sizeof(dimension));
-		if(dimension <= 0) {
-			throw std::logic_error("Bad file content: non-positive dimension");
-		}
-	//X.at(pid).resize(dimension);
-	points->at(pid).resize(dimension);
-    for(int d = 0; d < dimension; ++d) {
-    	float buffer;
-    	input.read((char*)&(buffer), sizeof(float));
-    	//X.at(pid)[d] = buffer;
-    	points->at(pid)[d] = buffer;
-    }
+  nns::Dataset file;
+  MapVectors(filename, nns::FORMAT_FVECS, count, &file);
+  points->resize(count);
+  for(int pid = 0; pid < count; ++pid) {
+    const float* row = file.row<float>(pid);
+    points->at(pid).assign(row, row + file.dim());
   }
-  *dim = dimension;
-  //points = &X;
-  //transpose(X,points);
+  *dim = file.dim();
+}
+
+// reads count vectors of an fvecs file straight into the rows of points
+void ReadPoints(const string& filename, FloatMatrix* points, int count, int *dim) {
+  nns::Dataset file;
+  MapVectors(filename, nns::FORMAT_FVECS, count, &file);
+  points->assign(file);
+  *dim = points->dim();
 }
 
 void ReadGroundtruth(const string& filename, vector<vector<int> >* gnds,int nq, int nn) {
-  ifstream input;
-	input.open(filename.c_str(), ios::binary);
-  if(!input.good()) {
-    throw std::logic_error("Invalid filename");
-  }
+  nns::Dataset file;
+  MapVectors(filename, nns::FORMAT_IVECS, nq, &file);
   gnds->resize(nq);
-  int k;
   for(int pid = 0; pid < nq; ++pid) {
-    input.read((char*)&k, sizeof(k));
-    if(k <= 0) {
-      throw std::logic_error("Bad file content: non-positive dimension");
-    }
-    gnds->at(pid).resize(k);
-    for(int d = 0; d < k; ++d) {
-      int buffer;
-      input.read((char*)&(buffer), sizeof(int));
-      gnds->at(pid)[d] = buffer;
-    }
+    const int* row = file.row<int>(pid);
+    gnds->at(pid).assign(row, row + file.dim());
   }
-  //*nn = k;
 }
 
-void ReadB1(const string& filename, vector<vector<unsigned> >* B1,int n) {//
+// each code is stored as an int count cbits followed by cbits ints of 8 bits
+void ReadB1(const string& filename, BinaryCodes* B1,int n) {//
   ifstream input;
 	input.open(filename.c_str(), ios::binary);
   if(!input.good()) {
     throw std::logic_error("Invalid filename");
   }
-  B1->resize(n);
   int cbits;
+  vector<unsigned> buffer;
   for(int pid = 0; pid < n; ++pid) {
     input.read((char*)&cbits, sizeof(cbits));
     if(cbits <= 0) {
       throw std::logic_error("Bad file content: non-positive dimension");
     }
-    B1->at(pid).resize(cbits);
-    for(int d = 0; d < cbits; ++d) {
-      int buffer;
-      input.read((char*)&(buffer), sizeof(int));
-      B1->at(pid)[d] = (unsigned)buffer;//(unsigned)
+    if(pid == 0) {
+      B1->resize(n, 8 * cbits);
+      buffer.resize(cbits);
+    }
+    else if(cbits != (int)buffer.size()) {
+      throw std::logic_error("Bad file content: codes of different lengths");
     }
+    input.read((char*)&buffer[0], sizeof(int) * cbits);
+    B1->setBytes(pid, &buffer[0], cbits);
   }
 }
 
@@ -87,7 +87,7 @@ float compute_number_closer(vector<vector<int> >* gnds, vector<vector<int> >* re
 	return avg/nq;
 }
 
-float compute_relative_distance_error(vector<vector<float> >* points, vector<vector<float> >* query, vector<vector<int> >* gnds, vector<vector<int> >* results)
+float compute_relative_distance_error(const FloatMatrix& points, const FloatMatrix& query, vector<vector<int> >* gnds, vector<vector<int> >* results)
 {
 	size_t nq = results->size();
 	size_t nn = results->at(0).size();
@@ -98,10 +98,10 @@ float compute_relative_distance_error(vector<vector<float> >* points, vector<vec
 
 		for (size_t j=0;j<nn;++j)
 		{
-			float min_distance= get_distance(points->at(gnds->at(i)[j]),query->at(i));
+			float min_distance= l2_distance(points.row(gnds->at(i)[j]),query.row(i),points.stride());
 			if(min_distance==0)
 				continue;
-			float test_distance = get_distance(points->at(results->at(i)[j]),query->at(i));
+			float test_distance = l2_distance(points.row(results->at(i)[j]),query.row(i),points.stride());
 			float d= (test_distance - min_distance )/min_distance;
 			if(d<0)
 				cout<<i<<" "<<j<<" "<<gnds->at(i)[j]<<" "<<results->at(i)[j]<<" "<<min_distance<<" "<<test_distance<<endl;
@@ -232,7 +232,7 @@ float compute_number_closer(vector<vector<int> >* gnds, vector<vector<E_Neighbor
 	return avg/nq;
 }
 
-float compute_relative_distance_error(vector<vector<float> >* points, vector<vector<float> >* query, vector<vector<int> >* gnds, vector<vector<E_Neighbor> >* results)
+float compute_relative_distance_error(const FloatMatrix& points, const FloatMatrix& query, vector<vector<int> >* gnds, vector<vector<E_Neighbor> >* results)
 {
 	size_t nq = results->size();
 	size_t nn = results->at(0).size();
@@ -243,7 +243,7 @@ float compute_relative_distance_error(vector<vector<float> >* points, vector<vec
 
 		for (size_t j=0;j<nn;++j)
 		{
-			float min_distance= get_distance(points->at(gnds->at(i)[j]),query->at(i));
+			float min_distance= l2_distance(points.row(gnds->at(i)[j]),query.row(i),points.stride());
 			float test_distance=results->at(i)[j].dist;
 			float d= (test_distance - min_distance )/min_distance;
            
@@ -16,6 +16,12 @@
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "binary_codes.h"
+#include "float_matrix.h"
+#include "mih_index.h"
 #include "hierarchical_clustering_index.h"
 
 using namespace std;
@@ -45,178 +51,145 @@ struct E_Neighbor{
 		id=0;
 		dist=-1;
 	}
-};
-
-float get_distance(vector<float> point, vector<float> query)
-{
-	int dim = query.size();
-	float dist=0.0;
-	for(int i=0; i<dim; i++)
+	E_Neighbor(int id_, float dist_) : id(id_), dist(dist_) {}
+	// max-heap order of the rerank: the farthest neighbor on top
+	bool operator<(const E_Neighbor& e) const
 	{
-		dist += pow(point[i]-query[i],2);
+		return dist < e.dist || (dist == e.dist && id < e.id);
 	}
-	return dist;
-}
-
-int get_distance(const vector<unsigned>* p1, const vector<unsigned>* p2)
-{
-	int dist=0;
-	int cbits = p1->size();
-	for(int t=0; t<cbits; t++)
-	{
-		unsigned y = p1->at(t) ^ p2->at(t);
-		dist += char_bit_cnt[y];
-	}
-	return dist;
-}
+};
 
-void hammingDist(vector<vector<unsigned> >* B2,vector<vector<unsigned> >* B1, vector<vector<int> >* Dist)
+void hammingDist(BinaryCodes* B2,BinaryCodes* B1, vector<vector<int> >* Dist)
 {
 	int n = B1->size();
 	int nq = B2->size();
-	//int cbits = B2->at(0).size();
 	for(int i=0; i<nq; i++)
 	{
-		vector<int> d_;
-		for(int j=0; j<n; j++)
-		{
-			int tmp = 0;
-			tmp = get_distance(&B1->at(j),&B2->at(i));
-			//for(int t=0; t<cbits; t++)
-			//{
-				//unsigned y = B1->at(j)[t] ^ B2->at(i)[t];
-				//tmp += char_bit_cnt[y];
-			//}
-			d_.push_back(tmp);
-		}
+		vector<int> d_(n);
+		hamming_scan(B2->row(i), *B1, 0, n, &d_[0]);
 		Dist->push_back(d_);
 	}
 }
 
-void UpdatePriorityList_Binary (B_Neighbor *BList, B_Neighbor tmp, int len) {
-	// find the location to insert
-	int j;
-    int i = len;
-    while (i > 0) {
-        j = i - 1;
-        if (BList[j].dist <= tmp.dist && BList[j].dist!=-1) break;
-        i = j;
-    }
-	if(i < len)
+/**
+ * Ids of the nn rows of dist (n distances in 0..nbits) with the smallest
+ * distances, ordered by distance and then by id. Distances are small
+ * integers, so the rows are selected by a counting sort in O(n + nbits).
+ */
+void hammingTopK(const int* dist, int n, int nbits, int nn, vector<int>* ids)
+{
+	vector<int> count(nbits + 2, 0);
+	for(int j=0; j<n; j++)
+		count[dist[j] + 1]++;
+
+	// the rows of distance d go to count[d]..count[d+1]-1 in id order
+	for(int d=1; d<=nbits+1; d++)
+		count[d] += count[d-1];
+	if(nn > n)
+		nn = n;
+	ids->assign(nn, 0);
+	for(int j=0; j<n; j++)
 	{
-    	j = len-1;
-    	while (j > i) {
-        	BList[j] = BList[j-1];
-        	--j;
-    	}
-    	BList[i] = tmp;
+		int d = dist[j];
+		if(count[d] < nn)
+			(*ids)[count[d]++] = j;
 	}
 }
 
-void hammingDist(vector<vector<unsigned> >* B2,vector<vector<unsigned> >* B1, vector<vector<int> >* Dist,int nn)
+void hammingDist(BinaryCodes* B2,BinaryCodes* B1, vector<vector<int> >* Dist,int nn)
 {
-	int len = nn;
 	int n = B1->size();
 	int nq = B2->size();
-	//int cbits = B2->at(0).size();
+	vector<int> dist(n);
 
 	for(int i=0; i<nq; i++)//nq
 	{
-		vector<B_Neighbor> BNN(len);
-		for(int j=0; j<n; j++)
-		{
-			int tmp = 0;
-			tmp = get_distance(&B1->at(j),&B2->at(i));
-			//for(int t=0; t<cbits; t++)
-			//{
-				//unsigned y = B1->at(j)[t] ^ B2->at(i)[t];
-				//tmp += char_bit_cnt[y];
-			//}
-
-			B_Neighbor b_;
-			b_.id=j;
-			b_.dist=tmp;
-
-			UpdatePriorityList_Binary ( &BNN[0], b_, len);
-		}
 		vector<int> d_;
-		for(int j=0;j<len;j++)
-		{
-			d_.push_back(BNN.at(j).id);
-		}
+		hamming_scan(B2->row(i), *B1, 0, n, &dist[0]);
+		hammingTopK(&dist[0], n, B1->nbits(), nn, &d_);
 		Dist->push_back(d_);
 	}
 }
 
-void hammingDist_ByRange(vector<vector<unsigned> >* B2,vector<vector<unsigned> >* B1, vector<vector<int> >* IDs,int radis)
+void hammingDist_ByRange(BinaryCodes* B2,BinaryCodes* B1, vector<vector<int> >* IDs,int radis)
 {
 	int n = B1->size();
 	int nq = B2->size();
-	//int cbits = B2->at(0).size();
+	vector<int> dist(n);
 
 	for(int i=0; i<nq; i++)//nq
 	{
 		vector<int> BNN;
+		hamming_scan(B2->row(i), *B1, 0, n, &dist[0]);
 		for(int j=0; j<n; j++)
 		{
-			int tmp = 0;
-			tmp = get_distance(&B1->at(j),&B2->at(i));
-			//for(int t=0; t<cbits; t++)
-			//{
-				//unsigned y = B1->at(j)[t] ^ B2->at(i)[t];
-				//tmp += char_bit_cnt[y];
-			//}
-			if(tmp<=radis)
+			if(dist[j]<=radis)
 				BNN.push_back(j);
 		}
 		IDs->push_back(BNN);
 	}
 }
 
-void UpdatePriorityList_Euclidean (E_Neighbor *BList, E_Neighbor tmp, int len) {
-	// find the location to insert
-	int j;
-    int i = len;
-    while (i > 0) {
-        j = i - 1;
-        if (BList[j].dist <= tmp.dist && BList[j].dist!=-1) break;
-        i = j;
-    }
-	if(i < len)
-	{
-    	j = len-1;
-    	while (j > i) {
-        	BList[j] = BList[j-1];
-        	--j;
-    	}
-    	BList[i] = tmp;
-	}
-}
-
-vector<vector<int> > Search(vector<vector<float> >* points, vector<vector<float> >* query, vector<vector<int> >* IDs, int K)
+/**
+ * Reranks the candidates ids of query q by Euclidean distance and writes the
+ * ids of the K nearest to result, nearest first. The K best are kept in a
+ * bounded max-heap; if there are fewer than K candidates the result is
+ * padded with id 0, as the insertion list used to be.
+ */
+void Rerank(const FloatMatrix& points, const float* q, const vector<int>& ids, int K,
+	vector<E_Neighbor>* heap, vector<int>* result)
 {
-	int nq=query->size();
-	vector<vector<int> > results;
-	for(int i=0; i<nq; i++)
+	int len = ids.size();
+	int stride = points.stride();
+	heap->clear();
+	for(int j=0; j<len; j++)
 	{
-		vector<int> result;
-		vector<E_Neighbor> ENN(K);
-		int len = IDs->at(i).size();
-		vector<int> ids_ = IDs->at(i);
-		for(int j=0; j<len; j++)
+		if(j+4 < len)
+			__builtin_prefetch(points.row(ids[j+4]));
+		E_Neighbor e_(ids[j], l2_distance(q, points.row(ids[j]), stride));
+		if((int)heap->size() < K)
 		{
-			float dist = get_distance(query->at(i),points->at(ids_.at(j)));
-			E_Neighbor e_;
-			e_.id=ids_.at(j);
-			e_.dist=dist;
-			UpdatePriorityList_Euclidean (&ENN[0], e_, K);
+			heap->push_back(e_);
+			push_heap(heap->begin(), heap->end());
 		}
-		for(int j=0;j<K;j++)
+		else if(e_ < heap->front())
 		{
-			result.push_back(ENN[j].id);
+			pop_heap(heap->begin(), heap->end());
+			heap->back() = e_;
+			push_heap(heap->begin(), heap->end());
 		}
-		results.push_back(result);
 	}
+	sort_heap(heap->begin(), heap->end());
+	result->assign(K, 0);
+	for(size_t j=0; j<heap->size(); j++)
+		(*result)[j] = (*heap)[j].id;
+}
+
+/**
+ * Reranks the candidates of every query; queries are shared among
+ * num_threads threads.
+ */
+vector<vector<int> > Search(const FloatMatrix& points, const FloatMatrix& query, const vector<vector<int> >& IDs, int K, int num_threads = 1)
+{
+	int nq=query.size();
+	vector<vector<int> > results(nq);
+	if(num_threads > nq)
+		num_threads = nq;
+	if(num_threads < 1)
+		num_threads = 1;
+
+	std::atomic<int> next(0);
+	vector<std::thread> workers;
+	for(int t=0; t<num_threads; t++)
+	{
+		workers.push_back(std::thread([&]() {
+			vector<E_Neighbor> heap;
+			for(int i=next++; i<nq; i=next++)
+				Rerank(points, query.row(i), IDs[i], K, &heap, &results[i]);
+		}));
+	}
+	for(int t=0; t<num_threads; t++)
+		workers[t].join();
 	return results;
 }
 
@@ -4,7 +4,7 @@
 #include <vector>
 #include <iostream>
 #include "center_chooser.h"
-//#include "char_bit_cnt.h"
+#include "binary_codes.h"
 #include "dynamic_bitset.h"
 #include "heap.h"
 #include "result_set.h"
@@ -29,30 +29,26 @@ class HierarchicalClusteringIndex
     int leaf_max_size_;
 
 	size_t size_;
- 	size_t veclen_;
+ 	int words_;
 	size_t size_at_build_;
 	size_t last_id_;
 
 	vector<size_t> ids_;
-	vector<vector<unsigned>* > points_;
+	const BinaryCodes* points_;
 	CenterChooser Centers_;
 	
 	//DynamicBitset removed_points_;
 
-	void setDataset(vector<vector<unsigned> >& dataset)
+	void setDataset(const BinaryCodes& dataset)
     {
     	size_ = dataset.size();
+    	words_ = dataset.words();
 
-		points_.resize(size_);
-		for (size_t i=0;i<size_;i++)
-		{
-			points_.at(i) = &dataset.at(i);
-		}
-		//cout<<"points00: "<<points_.at(0)->at(0)<<endl;
+		points_ = &dataset;
     }
 	public:
 
-	void set_params(vector<vector<unsigned> >& inputData, int b=32,int t=4,int leaf=100)
+	void set_params(const BinaryCodes& inputData, int b=32,int t=4,int leaf=100)
     {
         branching_ = b;
         trees_ = t;
@@ -91,7 +87,7 @@ class HierarchicalClusteringIndex
     	
     	size_t index;   /** Point index */
     	
-    	vector<unsigned>* point;  /** Point data */
+    	const uint64_t* point;  /** Point data */
     };
 
 
@@ -99,7 +95,7 @@ class HierarchicalClusteringIndex
 	struct Node
     {
         
-    	vector<unsigned>* pivot;  /** The cluster center  */
+    	const uint64_t* pivot;  /** The cluster center  */
 
     	size_t pivot_index;
         
@@ -134,27 +130,13 @@ class HierarchicalClusteringIndex
 ///*
 	int get_distance(int p1, int p2)
 	{
-		int dist=0;
-		int cbits = points_.at(0)->size();
-		for(int t=0; t<cbits; t++)
-		{
-			unsigned y = points_.at(p1)->at(t) ^ points_.at(p2)->at(t);
-			dist += char_bit_cnt[y];
-		}
-		return dist;
+		return hamming_distance(points_->row(p1), points_->row(p2), words_);
 	}
 
 	
-	int get_distance(const vector<unsigned>* p1, const vector<unsigned>* p2)
+	int get_distance(const uint64_t* p1, const uint64_t* p2)
 	{
-		int dist=0;
-		int cbits = p1->size();
-		for(int t=0; t<cbits; t++)
-		{
-			unsigned y = p1->at(t) ^ p2->at(t);
-			dist += char_bit_cnt[y];
-		}
-		return dist;
+		return hamming_distance(p1, p2, words_);
 	}
 //*/
 
@@ -180,7 +162,7 @@ class HierarchicalClusteringIndex
             node->points.resize(indices_length);
             for (int i=0;i<indices_length;++i) {
             	node->points[i].index = indices[i];
-            	node->points[i].point = points_.at(indices[i]);
+            	node->points[i].point = points_->row(indices[i]);
             }
             node->childs.clear();
 			//cout<<"indices:"<<indices_length<<"  "<< node->points.size()<<endl;
@@ -198,7 +180,7 @@ class HierarchicalClusteringIndex
             node->points.resize(indices_length);
             for (int i=0;i<indices_length;++i) {
             	node->points[i].index = indices[i];
-            	node->points[i].point = points_.at(indices[i]);
+            	node->points[i].point = points_->row(indices[i]);
             }
             node->childs.clear();
 			//cout<<" centers: "<<centers_length<<"  "<< node->points.size()<<endl;
@@ -222,7 +204,7 @@ class HierarchicalClusteringIndex
 
             node->childs[i] = new Node();
             node->childs[i]->pivot_index = centers[i];
-            node->childs[i]->pivot = points_.at(centers[i]);
+            node->childs[i]->pivot = points_->row(centers[i]);
             node->childs[i]->points.clear();
             computeClustering(node->childs[i],indices+start, end-start);
             start=end;
@@ -231,7 +213,7 @@ class HierarchicalClusteringIndex
 
 	typedef BranchStruct BranchSt;
 
-	void findNN(NodePtr node, ResultSet& result, const vector<unsigned>* vec, int& checks,const int maxChecks,
+	void findNN(NodePtr node, ResultSet& result, const uint64_t* vec, int& checks,const int maxChecks,
 	                Heap<BranchSt>* heap,  DynamicBitset& checked)
 	{
 	    if (node->childs.empty())
@@ -272,7 +254,7 @@ class HierarchicalClusteringIndex
 
 
 
-	void findNeighborsWithRemoved(ResultSet& result, const vector<unsigned>* vec, const int maxChecks)
+	void findNeighborsWithRemoved(ResultSet& result, const uint64_t* vec, const int maxChecks)
     {
         //int maxChecks = searchParams.checks;
 
@@ -297,7 +279,7 @@ class HierarchicalClusteringIndex
 
 
 
-	int knnSearch(const vector<vector<unsigned> >& queries, vector< vector<int> >& indices,	vector< vector<int> >& dists,size_t knn,const int maxChecks)
+	int knnSearch(const BinaryCodes& queries, vector< vector<int> >& indices,	vector< vector<int> >& dists,size_t knn,const int maxChecks)
     {
         if (indices.size() < queries.size() ) indices.resize(queries.size());
 		if (dists.size() < queries.size() )   dists.resize(queries.size());
@@ -308,7 +290,7 @@ class HierarchicalClusteringIndex
 		{
 				//resultSet.clear();
 				ResultSet resultSet(knn);
-				findNeighborsWithRemoved(resultSet, &queries.at(i), maxChecks);
+				findNeighborsWithRemoved(resultSet, queries.row(i), maxChecks);
 				size_t n = std::min(resultSet.size(), knn);
 				indices[i].resize(n);
 				dists[i].resize(n);
@@ -45,6 +45,8 @@ template <class T> T LInfNormSIMD(const T* pVect1, const T* pVect2, size_t qty);
 template <class T> T L1NormStandard(const T *p1, const T *p2, size_t qty);
 template <class T> T L1Norm(const T *p1, const T *p2, size_t qty) ;
 template <class T> T L1NormSIMD(const T* pVect1, const T* pVect2, size_t qty);
+// Distances between each of vectQty vectors (on the left) and the query
+template <class T> void L1NormSIMDBatch(const T* const* pVects, size_t vectQty, const T* pQuery, size_t qty, T* pDist);
 
 
 /*
@@ -54,6 +56,8 @@ template <class T> T L1NormSIMD(const T* pVect1, const T* pVect2, size_t qty);
 template <class T> T L2NormStandard(const T *p1, const T *p2, size_t qty);
 template <class T> T L2Norm(const T* pVect1, const T* pVect2, size_t qty);
 template <class T> T L2NormSIMD(const T* pVect1, const T* pVect2, size_t qty);
+// Distances between each of vectQty vectors (on the left) and the query
+template <class T> void L2NormSIMDBatch(const T* const* pVects, size_t vectQty, const T* pQuery, size_t qty, T* pDist);
 
 float L2SqrSIMD(const float* pVect1, const float* pVect2, size_t qty);
 
@@ -65,6 +69,8 @@ template <class T> T CosineSimilarity(const T *p1, const T *p2, size_t qty);
 // Scalar product divided by vector Euclidean norms
 template <class T> T NormScalarProduct(const T *p1, const T *p2, size_t qty);
 template <class T> T NormScalarProductSIMD(const T *p1, const T *p2, size_t qty);
+// Normalized scalar products of each of vectQty vectors and the query
+template <class T> void NormScalarProductSIMDBatch(const T* const* pVects, size_t vectQty, const T* pQuery, size_t qty, T* pRes);
 
 // Scalar product that is not normalized 
 template <class T> T ScalarProduct(const T *p1, const T *p2, size_t qty);
@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <string>
 #include <vector>
+#include <stdexcept>
 
 #include "params.h"
 
@@ -26,6 +27,7 @@ namespace similarity {
 
 using std::string;
 using std::vector;
+using std::runtime_error;
 
 template <typename dist_t>
 class RangeQuery;
@@ -43,6 +45,18 @@ class Index {
   virtual void Search(RangeQuery<dist_t>* query) = 0;
   virtual void Search(KNNQuery<dist_t>* query) = 0;
   virtual const string ToString() const = 0;
+  /*
+   * A method that can store its index implements SaveIndex()
+   * and LoadIndex(), so that an index built once can be
+   * searched with many sets of query-time parameters.
+   * LoadIndex() expects the same data set the index was built for.
+   */
+  virtual void SaveIndex(const string& location) {
+    throw runtime_error("SaveIndex is not supported by the method: " + ToString());
+  }
+  virtual void LoadIndex(const string& location) {
+    throw runtime_error("LoadIndex is not supported by the method: " + ToString());
+  }
   /*
    * If a method has query time parameters that
    * can be changed without rebuilding the index,
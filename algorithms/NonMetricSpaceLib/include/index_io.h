@@ -0,0 +1,160 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/) and others.
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#ifndef _INDEX_IO_H_
+#define _INDEX_IO_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "object.h"
+
+/*
+ * Build-time parameters shared by the methods that implement
+ * SaveIndex() and LoadIndex(): with loadIndex, the constructor
+ * reads the index from the file instead of building it, with saveIndex
+ * it writes the index it has built.
+ */
+#define PARAM_SAVE_INDEX      "saveIndex"
+#define PARAM_LOAD_INDEX      "loadIndex"
+
+namespace similarity {
+
+using std::string;
+using std::vector;
+using std::istream;
+using std::ostream;
+using std::stringstream;
+using std::runtime_error;
+using std::unordered_map;
+
+/*
+ * An index file is a header followed by a method-specific body.
+ * All numbers are stored in the native byte order. Objects are referred
+ * to by their positions in the data set, so the index can only be loaded
+ * for the data set it was built for: the header keeps the number of
+ * objects and a hash of their ids to check this.
+ */
+const uint32_t INDEX_FILE_MAGIC   = 0x4e4d5349; // "ISMN"
+const uint32_t INDEX_FILE_VERSION = 1;
+
+template <typename T>
+inline void WriteBinaryPOD(ostream& out, const T& v) {
+  if (!out.write(reinterpret_cast<const char*>(&v), sizeof(T))) {
+    throw runtime_error("Error writing an index file");
+  }
+}
+
+template <typename T>
+inline void ReadBinaryPOD(istream& in, T& v) {
+  if (!in.read(reinterpret_cast<char*>(&v), sizeof(T))) {
+    throw runtime_error("Error reading an index file: unexpected end of file");
+  }
+}
+
+/*
+ * A vector is stored as its 64-bit size followed by the elements.
+ */
+template <typename T>
+inline void WriteBinaryVector(ostream& out, const vector<T>& v) {
+  uint64_t qty = v.size();
+  WriteBinaryPOD(out, qty);
+  if (qty && !out.write(reinterpret_cast<const char*>(&v[0]), sizeof(T) * qty)) {
+    throw runtime_error("Error writing an index file");
+  }
+}
+
+template <typename T>
+inline void ReadBinaryVector(istream& in, vector<T>& v) {
+  uint64_t qty;
+  ReadBinaryPOD(in, qty);
+  v.resize(qty);
+  if (qty && !in.read(reinterpret_cast<char*>(&v[0]), sizeof(T) * qty)) {
+    throw runtime_error("Error reading an index file: unexpected end of file");
+  }
+}
+
+inline uint64_t HashObjectIds(const ObjectVector& data) {
+  uint64_t h = 14695981039346656037ULL; // FNV-1a
+  for (const Object* o: data) {
+    h = (h ^ static_cast<uint32_t>(o->id())) * 1099511628211ULL;
+  }
+  return h;
+}
+
+inline void WriteIndexHeader(ostream& out, const string& methName, const ObjectVector& data) {
+  WriteBinaryPOD(out, INDEX_FILE_MAGIC);
+  WriteBinaryPOD(out, INDEX_FILE_VERSION);
+  vector<char> name(methName.begin(), methName.end());
+  WriteBinaryVector(out, name);
+  uint64_t dataQty = data.size();
+  WriteBinaryPOD(out, dataQty);
+  WriteBinaryPOD(out, HashObjectIds(data));
+}
+
+inline void ReadIndexHeader(istream& in, const string& methName, const ObjectVector& data) {
+  uint32_t magic, version;
+  ReadBinaryPOD(in, magic);
+  if (magic != INDEX_FILE_MAGIC) {
+    throw runtime_error("Not an index file (wrong magic number)");
+  }
+  ReadBinaryPOD(in, version);
+  if (version != INDEX_FILE_VERSION) {
+    stringstream err;
+    err << "Unsupported index file version: " << version;
+    throw runtime_error(err.str());
+  }
+  vector<char> name;
+  ReadBinaryVector(in, name);
+  if (string(name.begin(), name.end()) != methName) {
+    throw runtime_error("The index file was created by the method '" +
+                        string(name.begin(), name.end()) + "' rather than '" + methName + "'");
+  }
+  uint64_t dataQty, hash;
+  ReadBinaryPOD(in, dataQty);
+  ReadBinaryPOD(in, hash);
+  if (dataQty != data.size() || hash != HashObjectIds(data)) {
+    stringstream err;
+    err << "The index file was created for a different data set: " << dataQty
+        << " objects were indexed, the data set has " << data.size() << " objects";
+    throw runtime_error(err.str());
+  }
+}
+
+/*
+ * Maps object ids to positions in the data set. This is needed by
+ * methods that keep copies of objects rather than pointers into the data
+ * set, so the ids have to be unique.
+ */
+inline void GetObjectPositions(const ObjectVector& data, unordered_map<IdType, IdType>& pos) {
+  pos.clear();
+  pos.reserve(data.size());
+  for (size_t i = 0; i < data.size(); ++i) {
+    if (!pos.insert(std::make_pair(data[i]->id(), static_cast<IdType>(i))).second) {
+      stringstream err;
+      err << "Cannot save the index, because the object id " << data[i]->id() << " is not unique";
+      throw runtime_error(err.str());
+    }
+  }
+}
+
+}  // namespace similarity
+
+#endif     // _INDEX_IO_H_
@@ -47,6 +47,7 @@ class KNNQuery : public Query<dist_t> {
   bool CheckAndAddToResult(const dist_t distance, const Object* object);
   bool CheckAndAddToResult(const Object* object);
   size_t CheckAndAddToResult(const ObjectVector& bucket);
+  size_t CheckAndAddToResult(const Object* const* pObjs, size_t qty);
 
   bool Equals(const KNNQuery<dist_t>* query) const;
   void Print() const;
@@ -17,6 +17,9 @@
 #ifndef _LSH_H_
 #define _LSH_H_
 
+#include <mutex>
+#include <vector>
+
 #include "index.h"
 #include "space.h"
 #include "lshkit.h"
@@ -140,12 +143,20 @@ class LSH : public Index<dist_t> {
 
  private:
   typedef lshkit::LshIndex<TailRepeatHash<lsh_t>, unsigned> LshIndexType;
+  typedef lshkit::FloatMatrix::Accessor AccessorType;
+
+  // Accessors are reused by searches, see LSHAccessorRef
+  AccessorType* acquireSearchContext() const;
+  void releaseSearchContext(AccessorType* context) const;
 
   const ObjectVector& data_;
   int p_;
   lshkit::FloatMatrix* matrix_;
   LshIndexType* index_;
 
+  mutable std::mutex                    searchContextGuard_;
+  mutable std::vector<AccessorType*>    searchContexts_;
+
   // disable copy and assign
   DISABLE_COPY_AND_ASSIGN(LSH);
 };
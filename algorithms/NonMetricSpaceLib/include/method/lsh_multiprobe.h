@@ -17,6 +17,9 @@
 #ifndef _LSH_MULTI_PROBE_H_
 #define _LSH_MULTI_PROBE_H_
 
+#include <mutex>
+#include <vector>
+
 #include "index.h"
 #include "space.h"
 #include "lshkit.h"
@@ -25,6 +28,9 @@
 
 namespace similarity {
 
+using std::mutex;
+using std::vector;
+
 // this class is a wrapper around lshkit and
 // but lshkit can handle only float!
 
@@ -60,6 +66,11 @@ class MultiProbeLSH : public Index<dist_t> {
 
  private:
   typedef lshkit::MultiProbeLshIndex<unsigned> LshIndexType;
+  typedef lshkit::FloatMatrix::Accessor AccessorType;
+
+  // Accessors are reused by searches, see LSHAccessorRef
+  AccessorType* acquireSearchContext() const;
+  void releaseSearchContext(AccessorType* context) const;
 
   const ObjectVector& data_;
   int dim_;
@@ -68,6 +79,9 @@ class MultiProbeLSH : public Index<dist_t> {
   unsigned T_;
   float R_;
 
+  mutable mutex                   searchContextGuard_;
+  mutable vector<AccessorType*>   searchContexts_;
+
   // disable copy and assign
   DISABLE_COPY_AND_ASSIGN(MultiProbeLSH);
 };
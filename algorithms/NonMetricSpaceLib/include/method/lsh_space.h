@@ -19,6 +19,7 @@
 
 #include <cmath>
 #include "knnquery.h"
+#include "lshkit/matrix.h"
 
 namespace similarity {
 
@@ -65,6 +66,25 @@ class LSHMultiProbeLpSpace {
   KNNQuery<dist_t>* query_;
 };
 
+/*
+ * The scanner keeps its accessor by value, while an accessor holds
+ * a mark per data point. Accessors are reused by searches, and the scanner
+ * gets only a reference to one of them.
+ */
+class LSHAccessorRef {
+ public:
+  typedef lshkit::FloatMatrix::Accessor AccessorType;
+  typedef AccessorType::Key             Key;
+  typedef AccessorType::Value           Value;
+
+  explicit LSHAccessorRef(AccessorType* accessor) : accessor_(accessor) {}
+
+  void reset() { accessor_->reset(); }
+  bool mark(unsigned key) { return accessor_->mark(key); }
+  const float* operator()(unsigned key) { return (*accessor_)(key); }
+ private:
+  AccessorType* accessor_;
+};
 
 }   // namespace similarity
 
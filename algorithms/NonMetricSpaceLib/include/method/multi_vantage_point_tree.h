@@ -19,6 +19,7 @@
 
 #include "index.h"
 #include "params.h"
+#include "pivot_dist_filter.h"
 
 #define METH_MVPTREE                "mvptree"
 
@@ -119,24 +120,39 @@ class MultiVantagePointTree : public Index<dist_t> {
     friend class MultiVantagePointTree;
   };
 
+  /*
+   * A leaf keeps the objects and, separately, their distances to the pivots:
+   * the path distances first, then the distances to the two pivots of the leaf.
+   * All entries of a leaf have the same path length.
+   */
   class LeafNode : public Node {
    public:
     LeafNode(const Object* pivot1, const Object* pivot2, Entries& entries, bool ChunkBucket)
       : Node(pivot1, pivot2, true),
-        entries_(entries), CacheOptimizedBucket_(NULL), bucket_(NULL) {
-      if (ChunkBucket && entries.size()) {
-        // TODO (@leo) Figure out whether and (why?) chunking does not improve performance
-        ObjectVector TmpData(entries.size());
+        pathLen_(0), CacheOptimizedBucket_(NULL), bucket_(NULL) {
+      ObjectVector TmpData(entries.size());
 
-        for (unsigned i = 0; i < entries.size(); ++i) {
-          TmpData[i] = entries[i].object;
+      for (unsigned i = 0; i < entries.size(); ++i) {
+        TmpData[i] = entries[i].object;
+      }
+
+      if (!entries.empty()) {
+        pathLen_ = entries[0].path.size();
+        vector<dist_t> dists;
+        for (const Entry& e: entries) {
+          CHECK(e.path.size() == pathLen_);
+          dists.insert(dists.end(), e.path.begin(), e.path.end());
+          dists.push_back(e.d1);
+          dists.push_back(e.d2);
         }
+        dists_.Init(entries.size(), pathLen_ + 2, dists);
+      }
 
+      if (ChunkBucket && entries.size()) {
+        // TODO (@leo) Figure out whether and (why?) chunking does not improve performance
         CreateCacheOptimizedBucket(TmpData, CacheOptimizedBucket_, bucket_);
-
-        for (unsigned i = 0; i < entries.size(); ++i) {
-          entries[i].object = (*bucket_)[i];
-        }
+      } else {
+        bucket_ = new ObjectVector(TmpData);
       }
     }
     ~LeafNode() {
@@ -144,16 +160,23 @@ class MultiVantagePointTree : public Index<dist_t> {
     }
 
    private:
-    Entries       entries_;
-    char*         CacheOptimizedBucket_; 
-    ObjectVector* bucket_;
+    size_t                  pathLen_;
+    PivotDistFilter<dist_t> dists_;
+    char*                   CacheOptimizedBucket_;
+    ObjectVector*           bucket_;
     friend class MultiVantagePointTree;
   };
 
   Node* BuildTree(const Space<dist_t>* space, Entries& entries);
 
+  /*
+   * The path keeps the distances from the query to the pivots on the path,
+   * it has two extra elements used by the leaves, bounds is a buffer for
+   * the filtering in leaves.
+   */
   template <typename QueryType>
-  void GenericSearch(Node* node, QueryType* query, Dists& path, size_t query_path_len, int& MaxLeavesToVisit);
+  void GenericSearch(Node* node, QueryType* query, Dists& path, size_t query_path_len,
+                     Dists& bounds, int& MaxLeavesToVisit);
 
   Node* root_;               // root node
 
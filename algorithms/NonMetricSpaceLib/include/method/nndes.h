@@ -34,6 +34,8 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 #include "index.h"
 #include "space.h"
+#include "space/space_lp.h"
+#include "method/small_world_rand.h"
 
 #include "nndes/nndes-common.h"
 #include "nndes/nndes.h"
@@ -51,7 +53,7 @@ class NNDescentMethod : public Index<dist_t> {
                   const Space<dist_t>* space, 
                   const ObjectVector& data, 
                   const AnyParams& AllParams);
-  ~NNDescentMethod(){};
+  ~NNDescentMethod();
 
   /* 
    * Just the name of the method, consider printing crucial parameter values
@@ -64,25 +66,45 @@ class NNDescentMethod : public Index<dist_t> {
 
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
+  void SaveIndex(const string& location);
+  void LoadIndex(const string& location);
+  /*
+   * The knn-graph can also be written and read in the file format of KGraph,
+   * which DPG reads as well, so that the same graph can be searched by
+   * these methods. Nodes are positions in the data set.
+   */
+  void ExportGraph(const string& location) const;
+  void ImportGraph(const string& location);
 
   virtual vector<string> GetQueryTimeParamNames() const;
 
+  /*
+   * Computes the distances for NN-descent. If the space is an Lp space,
+   * the vectors are copied to one array, where each row is padded with
+   * zeros to a multiple of 16 bytes, and the distances from a point to
+   * a list of points are computed by the batched SIMD kernels of the space.
+   * Otherwise, IndexTimeDistance is called for each pair, with the smaller
+   * id on the left, because NN-descent assumes the distance is symmetric.
+   */
   class SpaceOracle {
   public:
-    SpaceOracle(const Space<dist_t>* space, const ObjectVector& data) :
-                space_(space), data_(data) {}
-    inline dist_t operator()(IdType id1, IdType id2) const {
-      return space_->IndexTimeDistance(data_.at(id1), data_.at(id2));
-    }
+    SpaceOracle(const Space<dist_t>* space, const ObjectVector& data);
+    void operator()(IdType id, const IdType* pIds, size_t qty, float* pDist) const;
+    bool isVectorOracle() const { return lpDist_ != NULL; }
   private:
-    const Space<dist_t>*    space_;
-    const ObjectVector&     data_;
+    const Space<dist_t>*        space_;
+    const ObjectVector&         data_;
+    const SpaceLpDist<dist_t>*  lpDist_;
+    size_t                      stride_;
+    vector<dist_t>              vects_;
   };
  private:
+  void BuildGraph(bool PrintProgress);
   void SearchGreedy(KNNQuery<dist_t>* query);
   void SearchSmallWorld(KNNQuery<dist_t>* query);
 
-  typedef pair<dist_t, IdType>      EvaluatedNode;
+  SearchContextSW<dist_t>* acquireSearchContext() const;
+  void releaseSearchContext(SearchContextSW<dist_t>* context) const;
 
   virtual void SetQueryTimeParamsInternal(AnyParamManager& );
 
@@ -94,12 +116,22 @@ class NNDescentMethod : public Index<dist_t> {
   size_t                  iterationQty_; // iteration in the original Wei Dong's code nndes.cpp
   float                   rho_;
   float                   delta_;
+  size_t                  indexThreadQty_;
 
-  SpaceOracle                        nndesOracle_;
-  unique_ptr<NNDescent<SpaceOracle>> nndesObj_;
+  /*
+   * The knn-graph used for searching, in the CSR format: the neighbors of
+   * the node i are nnIds_[nnOffsets_[i]] ... nnIds_[nnOffsets_[i+1]-1]
+   * in the order of increasing distance. It is copied from NN-descent
+   * after it has finished, or loaded from a file.
+   */
+  vector<size_t>                     nnOffsets_;
+  vector<IdType>                     nnIds_;
 
   size_t                  initSearchAttempts_;
   bool                    greedy_;
+
+  mutable mutex                             searchContextGuard_;
+  mutable vector<SearchContextSW<dist_t>*>  searchContexts_;
   // disable copy and assign
   DISABLE_COPY_AND_ASSIGN(NNDescentMethod);
 };
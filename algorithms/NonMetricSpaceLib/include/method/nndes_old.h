@@ -74,6 +74,12 @@ class NNDescentMethodOld : public Index<dist_t> {
     inline dist_t operator()(IdType id1, IdType id2) const {
       return space_->IndexTimeDistance(data_.at(id1), data_.at(id2));
     }
+    // The distance is computed with the smaller id on the left, as NN-descent assumes symmetry
+    void operator()(IdType id, const IdType* pIds, size_t qty, float* pDist) const {
+      for (size_t i = 0; i < qty; ++i) {
+        pDist[i] = id < pIds[i] ? (*this)(id, pIds[i]) : (*this)(pIds[i], id);
+      }
+    }
   private:
     const Space<dist_t>*    space_;
     const ObjectVector&     data_;
@@ -22,6 +22,7 @@
 
 #include "index.h"
 #include "permutation_utils.h"
+#include "packed_posting_list.h"
 #include "ported_boost_progress.h"
 
 #define METH_PIVOT_NEIGHB_INVINDEX      "pivot_neighb_invindx"
@@ -48,7 +49,8 @@ using std::mutex;
  * In this implementation, we introduce several modifications:
  * 1) The inverted file is split into small parts. In doing so, we aim to
  *    achieve better caching properties of the counter array used in ScanCount.
- * 2) The index is not compressed (though it could be)
+ * 2) Posting lists are compressed using differential coding and SIMD bit packing
+ *    (see packed_posting_list.h).
  * 3) Instead of the adaptive union algorithm, we use a well-known ScanCount algorithm (by default). 
  *    The overall time spent on processing of the inverted file is 20-30% of the overall
  *    search time. Thus, the retrieval time cannot be substantially improved by
@@ -66,6 +68,22 @@ using std::mutex;
 
 typedef vector<int> PostingListInt;
 
+/*
+ * Per-query buffers of GenSearch(). They are kept in a pool and reused,
+ * so a query allocates nothing. The counters, one per object of a chunk,
+ * are zero between chunks: only the counters that were incremented
+ * are reset. One-byte counters are used if numPrefix < 256.
+ */
+struct SearchContextNAPP {
+  vector<uint8_t>   counter8_;
+  vector<uint16_t>  counter16_;
+  vector<uint32_t>  hist_;     // hist_[c] is the # of objects with counter >= c
+  vector<IdType>    touched_;  // objects with non-zero counters (map and merge)
+  vector<IdType>    cand_;
+  ObjectVector      candObjs_;
+  PostingListInt    postList_;
+};
+
 template <typename dist_t>
 class PivotNeighbInvertedIndex : public Index<dist_t> {
  public:
@@ -79,6 +97,8 @@ class PivotNeighbInvertedIndex : public Index<dist_t> {
   const std::string ToString() const;
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
+  void SaveIndex(const string& location);
+  void LoadIndex(const string& location);
   
   virtual vector<string> GetQueryTimeParamNames() const;
 
@@ -113,9 +133,18 @@ class PivotNeighbInvertedIndex : public Index<dist_t> {
     return static_cast<size_t>(db_scan_frac_ * data_.size());
   }
   
-  vector<shared_ptr<vector<PostingListInt>>> posting_lists_;
+  vector<shared_ptr<vector<PackedPostingList>>> posting_lists_;
+
+  mutable mutex                         searchContextGuard_;
+  mutable vector<SearchContextNAPP*>    searchContexts_;
+
+  SearchContextNAPP* acquireSearchContext() const;
+  void releaseSearchContext(SearchContextNAPP* context) const;
 
   template <typename QueryType> void GenSearch(QueryType* query, size_t K);
+  template <typename CounterType, typename QueryType>
+  void GenSearchChunks(QueryType* query, size_t db_scan, const Permutation& perm_q,
+                       vector<CounterType>& counter, SearchContextNAPP& context);
 
   // disable copy and assign
   DISABLE_COPY_AND_ASSIGN(PivotNeighbInvertedIndex);
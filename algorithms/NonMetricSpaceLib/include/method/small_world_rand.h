@@ -29,6 +29,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <algorithm>
 
 
 #define METH_SMALL_WORLD_RAND                 "small_world_rand"
@@ -96,7 +97,6 @@ public:
   const vector<MSWNode*>& getAllFriends() const {
     return friends;
   }
-
   mutex accessGuard_;
 
 private:
@@ -151,6 +151,49 @@ private:
   MSWNode* element;
 };
 
+//----------------------------------
+/*
+ * Per-query state of the search over the frozen graph. Contexts are
+ * kept in a pool and reused, so a query allocates nothing: the visited
+ * marks are reset by incrementing the epoch, the heaps keep their capacity.
+ */
+template <typename dist_t>
+class SearchContextSW {
+public:
+  SearchContextSW() : epoch_(0) {}
+
+  void start(size_t nodeQty, size_t NN) {
+    if (visited_.size() != nodeQty) {
+      visited_.assign(nodeQty, 0);
+      epoch_ = 0;
+    }
+    if (++epoch_ == 0) {
+      fill(visited_.begin(), visited_.end(), 0);
+      epoch_ = 1;
+    }
+    closestDist_.reserve(NN + 1);
+  }
+  // Returns true if the node wasn't visited before
+  bool visit(IdType id) {
+    if (visited_[id] == epoch_) return false;
+    visited_[id] = epoch_;
+    return true;
+  }
+
+  typedef std::pair<dist_t, IdType> EvaluatedNode;
+  struct CloserNode {
+    bool operator()(const EvaluatedNode& a, const EvaluatedNode& b) const {
+      return a.first > b.first;
+    }
+  };
+
+  vector<dist_t>          closestDist_; // max-heap of at most NN best distances
+  vector<EvaluatedNode>   candidates_;  // min-heap of nodes to expand
+private:
+  vector<unsigned>        visited_;
+  unsigned                epoch_;
+};
+
 //----------------------------------
 template <typename dist_t>
 class SmallWorldRand : public Index<dist_t> {
@@ -166,6 +209,8 @@ public:
   const std::string ToString() const;
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
+  void SaveIndex(const string& location);
+  void LoadIndex(const string& location);
   MSWNode* getRandomEntryPoint() const;
   MSWNode* getRandomEntryPointLocked() const;
   size_t getEntryQtyLocked() const;
@@ -187,6 +232,15 @@ public:
 private:
   virtual void SetQueryTimeParamsInternal(AnyParamManager& );
 
+  /*
+   * Converts the graph built by add() into the adjacency arrays and
+   * releases the nodes. After this, the graph can't be changed
+   * and is searched without any locking.
+   */
+  void freeze();
+  SearchContextSW<dist_t>* acquireSearchContext() const;
+  void releaseSearchContext(SearchContextSW<dist_t>* context) const;
+
   size_t                NN_;
   size_t                initIndexAttempts_;
   size_t                initSearchAttempts_;
@@ -196,6 +250,16 @@ private:
   mutable mutex   ElListGuard_;
   ElementList     ElList_;
 
+  /*
+   * The frozen graph: the friends of the i-th object of the data set
+   * are friendIds_[friendOffsets_[i]] ... friendIds_[friendOffsets_[i+1]-1].
+   */
+  vector<size_t>  friendOffsets_;
+  vector<IdType>  friendIds_;
+
+  mutable mutex                             searchContextGuard_;
+  mutable vector<SearchContextSW<dist_t>*>  searchContexts_;
+
 protected:
 
   DISABLE_COPY_AND_ASSIGN(SmallWorldRand);
@@ -19,10 +19,13 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <iostream>
+#include <unordered_map>
 
 #include "index.h"
 #include "params.h"
 #include "ported_boost_progress.h"
+#include "pivot_dist_filter.h"
 
 #define METH_VPTREE          "vptree"
 
@@ -31,6 +34,9 @@ namespace similarity {
 using std::string;
 using std::vector;
 using std::unique_ptr;
+using std::istream;
+using std::ostream;
+using std::unordered_map;
 
 // Vantage point tree
 
@@ -50,6 +56,8 @@ class VPTree : public Index<dist_t> {
 
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
+  void SaveIndex(const string& location);
+  void LoadIndex(const string& location);
 
   vector<string> GetQueryTimeParamNames() const { return oracle_.GetParams(); }
 
@@ -70,20 +78,41 @@ class VPTree : public Index<dist_t> {
     // We want trees to be balanced
     const size_t BalanceConst = 4; 
 
+    /*
+     * The path holds the pivots of the ancestors, the bucket keeps
+     * distances to the last MaxPathLength of them.
+     */
     VPNode(unsigned level,
            ProgressDisplay* progress_bar,
            const SearchOracle&  oracle,
            const Space<dist_t>* space, const ObjectVector& data,
            size_t BucketSize, bool ChunkBucket,
-           bool use_random_center, bool is_root);
+           bool use_random_center, bool is_root,
+           ObjectVector& path, size_t MaxPathLength);
+    // Reads the subtree written by Save()
+    VPNode(const SearchOracle& oracle, const Space<dist_t>* space,
+           istream& in, const ObjectVector& data, bool ChunkBucket,
+           ObjectVector& path, size_t MaxPathLength);
     ~VPNode();
 
+    // Writes the subtree in preorder, objects are stored as positions in the data set
+    void Save(ostream& out, const unordered_map<IdType, IdType>& objPos) const;
+
+    /*
+     * The path holds the distances from the query to the pivots of
+     * the ancestors, bounds is a buffer for the filtering in buckets.
+     */
     template <typename QueryType>
-    void GenericSearch(QueryType* query, int& MaxLeavesToVisit);
+    void GenericSearch(QueryType* query, int& MaxLeavesToVisit,
+                       vector<dist_t>& path, vector<dist_t>& bounds);
 
    private:
     void CreateBucket(bool ChunkBucket, const ObjectVector& data, 
-                      ProgressDisplay* progress_bar);
+                      ProgressDisplay* progress_bar,
+                      const Space<dist_t>* space,
+                      const ObjectVector& path, size_t MaxPathLength);
+    template <typename QueryType>
+    void SearchBucket(QueryType* query, const vector<dist_t>& path, vector<dist_t>& bounds);
     const SearchOracle& oracle_; // The search oracle must be accessed by reference,
                                  // so that VP-tree may be able to change its parameters
     const Object* pivot_;
@@ -97,15 +126,23 @@ class VPTree : public Index<dist_t> {
     VPNode*       right_child_;
     ObjectVector* bucket_;
     char*         CacheOptimizedBucket_;
+    // Distances from the bucket objects to the pivots on the path
+    PivotDistFilter<dist_t> pathDists_;
 
     friend class VPTree;
   };
 
+  template <typename QueryType>
+  void GenericSearch(QueryType* query);
+
+  const Space<dist_t>* space_;
   SearchOracle    oracle_;
+  const ObjectVector& data_;
   VPNode*         root_;
   size_t          BucketSize_;
   int             MaxLeavesToVisit_;
   bool            ChunkBucket_;
+  size_t          MaxPathLength_;
   // disable copy and assign
   DISABLE_COPY_AND_ASSIGN(VPTree);
 };
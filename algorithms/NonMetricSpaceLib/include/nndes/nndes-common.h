@@ -39,11 +39,10 @@ namespace similarity {
 
 #define SYMMETRIC 1
 
-#ifdef _OPENMP
-#if SYMMETRIC
+// The local join of NNDescent may run in several threads
+#if SYMMETRIC && (defined(USE_SPINLOCK) || defined(_OPENMP))
 #define NEED_LOCK 1
 #endif
-#endif
 
 #if NEED_LOCK
 #ifdef USE_SPINLOCK
@@ -51,6 +50,8 @@ namespace similarity {
          boost::detail::spinlock lock;
      public:
          void init () {
+             // the spinlock has no constructor, unlocking it sets the initial state
+             lock.unlock();
          }
          void set () {
              lock.lock();
@@ -12,6 +12,10 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #ifndef WDONG_NNDESCENT
 #define WDONG_NNDESCENT
 
+#include <thread>
+#include <atomic>
+#include <mutex>
+
 #include "nndes-common.h"
 #include "ported_boost_progress.h"
 
@@ -21,6 +25,10 @@ namespace similarity {
     using std::unique_ptr;
     using std::vector;
     using std::swap;
+    using std::thread;
+    using std::atomic;
+    using std::mutex;
+    using std::lock_guard;
 
 #ifndef NNDES_SHOW_PROGRESS
 #define NNDES_SHOW_PROGRESS 1
@@ -33,16 +41,22 @@ namespace similarity {
 
     // The main NN-Descent class.
     // Instead of the actual dataset, the class takes a distance oracle
-    // as input.  Given two data item ids, the oracle returns the distance
-    // between the two.
+    // as input.  Given the id of a data item and a list of ids,
+    // oracle(id, ids, qty, dists) computes the distances from the item
+    // to each item of the list.
+    // The local joins of an iteration are split among threadQty threads.
     template <typename ORACLE>
     class NNDescent {
     private:
+        // The number of points a thread takes for the local join at a time
+        static const int JOIN_CHUNK = 64;
+
         const ORACLE &oracle;
         int N;              // # points
         int K;              // K-NN to find
         int S;              // # of NNs to use for exploration
         GraphOption option;
+        size_t threadQty;
         vector<KNN> nn;     // K-NN approximation
 
         // We maintain old and newly added KNN/RNN items
@@ -67,17 +81,56 @@ namespace similarity {
             return p1 == p2;
         }
 
-        // Compare two points and update their KNN list of necessary.
-        // Return the number of comparisons done (0 or 1).
-        int update (int p1, int p2) {
-            if (mark(p1, p2)) return 0;
+        // Compare p1 to the points of the list and update their KNN lists
+        // if necessary. If greater is true, only points with larger ids
+        // are compared. The distances are computed in one oracle call.
+        // Return the number of comparisons done.
+        int update (int p1, const vector<int> &list, bool greater,
+                    vector<int> &ids, vector<float> &dists) {
+            ids.clear();
+            BOOST_FOREACH(int p2, list) {
+                if (mark(p1, p2) || (greater && p2 < p1)) continue;
+                ids.push_back(p2);
+            }
+            if (ids.empty()) return 0;
+            dists.resize(ids.size());
+            oracle(p1, &ids[0], ids.size(), &dists[0]);
             // KNN::update is synchronized by a lock
-            // keep an order is necessary to avoid deadlock.
-            if (p1 > p2) swap(p1, p2);
-            float dist =  oracle(p1, p2);
-            nn[p1].update(KNN::Element(p2, dist, true));
-            nn[p2].update(KNN::Element(p1, dist, true));
-            return 1;
+            for (size_t i = 0; i < ids.size(); ++i) {
+                nn[p1].update(KNN::Element(ids[i], dists[i], true));
+                nn[ids[i]].update(KNN::Element(p1, dists[i], true));
+            }
+            return ids.size();
+        }
+
+        // The local join of the point i
+        long long int join (int i, vector<int> &ids, vector<float> &dists) {
+            long long int cc = 0;
+            // The following loops are bloated to deal with all
+            // the experimental setups.  Otherwise they should
+            // be really simple.
+            if (option & (GRAPH_KNN | GRAPH_BOTH)) {
+                BOOST_FOREACH(int j, nn_new[i]) {
+                    cc += update(j, nn_new[i], true, ids, dists);
+                    cc += update(j, nn_old[i], false, ids, dists);
+                }
+            }
+            if (option & (GRAPH_RNN | GRAPH_BOTH)) {
+                BOOST_FOREACH(int j, rnn_new[i]) {
+                    cc += update(j, rnn_new[i], true, ids, dists);
+                    cc += update(j, rnn_old[i], false, ids, dists);
+                }
+            }
+            if (option & GRAPH_BOTH) {
+                BOOST_FOREACH(int j, nn_new[i]) {
+                    cc += update(j, rnn_old[i], false, ids, dists);
+                    cc += update(j, rnn_new[i], false, ids, dists);
+                }
+                BOOST_FOREACH(int j, nn_old[i]) {
+                    cc += update(j, rnn_new[i], false, ids, dists);
+                }
+            }
+            return cc;
         }
 
     public:
@@ -90,8 +143,9 @@ namespace similarity {
         }
 
         NNDescent (int N_, int K_, float S_, const ORACLE &oracle_,
-                GraphOption opt = GRAPH_BOTH)
-            : oracle(oracle_), N(N_), K(K_), S(K * S_), option(opt), nn(N_),
+                GraphOption opt = GRAPH_BOTH, size_t threadQty_ = 1)
+            : oracle(oracle_), N(N_), K(K_), S(K * S_), option(opt),
+              threadQty(threadQty_ ? threadQty_ : 1), nn(N_),
               nn_old(N_), nn_new(N_), rnn_old(N_), rnn_new(N_), cost(0)
         {
             for (int i = 0; i < N; ++i) {
@@ -122,59 +176,45 @@ namespace similarity {
                     PrintProgress? new ProgressDisplay(N, cerr): NULL);
 #endif
 
-            long long int cc = 0;
-            // local joins
-#pragma omp parallel for default(shared) reduction(+:cc)
-            for (int i = 0; i < N; ++i) {
-
-                // The following loops are bloated to deal with all
-                // the experimental setups.  Otherwise they should
-                // be really simple.
-                if (option & (GRAPH_KNN | GRAPH_BOTH)) {
-                    BOOST_FOREACH(int j, nn_new[i]) {
-                        BOOST_FOREACH(int k, nn_new[i]) {
-                            if (j >= k) continue;
-                            cc += update(j, k);
-                        }
-                        BOOST_FOREACH(int k, nn_old[i]) {
-                            cc += update(j, k);
-                        }
+            // local joins, the points are handed out to the threads in chunks
+            atomic<int> next(0);
+            vector<long long int> threadCost(threadQty, 0);
+            mutex progressGuard;
+            auto joinWorker = [&](size_t t) {
+                vector<int>   ids;
+                vector<float> dists;
+                long long int cc = 0;
+                for (;;) {
+                    int start = next.fetch_add(JOIN_CHUNK);
+                    if (start >= N) break;
+                    int end = start + JOIN_CHUNK;
+                    if (end > N) end = N;
+                    for (int i = start; i < end; ++i) {
+                        cc += join(i, ids, dists);
                     }
-                }
-                if (option & (GRAPH_RNN | GRAPH_BOTH)) {
-                    BOOST_FOREACH(int j, rnn_new[i]) {
-                        BOOST_FOREACH(int k, rnn_new[i]) {
-                            if (j >= k) continue;
-                            cc += update(j, k);
-                        }
-                        BOOST_FOREACH(int k, rnn_old[i]) {
-                            cc += update(j, k);
-                        }
+#if NNDES_SHOW_PROGRESS
+                    if (progress) {
+                        lock_guard<mutex> lock(progressGuard);
+                        (*progress) += end - start;
                     }
+#endif
                 }
-                if (option & GRAPH_BOTH) {
-                    BOOST_FOREACH(int j, nn_new[i]) {
-                        BOOST_FOREACH(int k, rnn_old[i]) {
-                            cc += update(j, k);
-                        }
-                        BOOST_FOREACH(int k, rnn_new[i]) {
-                            cc += update(j, k);
-                        }
-                    }
-                    BOOST_FOREACH(int j, nn_old[i]) {
-                        BOOST_FOREACH(int k, rnn_new[i]) {
-                            cc += update(j, k);
-                        }
-                    }
+                threadCost[t] = cc;
+            };
+            if (threadQty == 1) {
+                joinWorker(0);
+            } else {
+                vector<thread> threads;
+                for (size_t t = 0; t < threadQty; ++t) {
+                    threads.push_back(thread(joinWorker, t));
+                }
+                for (size_t t = 0; t < threadQty; ++t) {
+                    threads[t].join();
                 }
-
-#if NNDES_SHOW_PROGRESS
-#pragma omp critical 
-                if (progress) ++(*progress);
-#endif
             }
-
-            cost += cc;
+            BOOST_FOREACH(long long int cc, threadCost) {
+                cost += cc;
+            }
 
             int t = 0;
 //#pragma omp parallel for default(shared) reduction(+:t)
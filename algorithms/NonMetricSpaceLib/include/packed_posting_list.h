@@ -0,0 +1,167 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/) and others.
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#ifndef _PACKED_POSTING_LIST_H_
+#define _PACKED_POSTING_LIST_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include "simdutils.h"
+
+#ifdef PORTABLE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace similarity {
+
+using std::vector;
+
+/*
+ * A sorted list of non-negative integer ids compressed using differential
+ * coding and bit packing. This is a variant of SIMD-BP128 from:
+ *
+ *    Daniel Lemire and Leonid Boytsov,
+ *    Decoding billions of integers per second through vectorization,
+ *    Software: Practice and Experience, 2015.
+ *
+ * The list is split into blocks of 128 ids (the last block is padded by
+ * repeating the last id). Each id is replaced by its difference with the id
+ * four positions earlier, and all differences of a block are stored using
+ * the number of bits needed for the largest one. Ids 4k ... 4k+3 are kept in
+ * the four 32-bit lanes of a 128-bit word, so a block is decoded with a few
+ * SIMD shifts, masks, and additions per four ids.
+ */
+class PackedPostingList {
+ public:
+  enum { kBlockQty = 128 };
+
+  PackedPostingList() : qty_(0) {}
+
+  // The ids must be sorted
+  void Encode(const vector<int>& ids) {
+    qty_ = ids.size();
+    bits_.clear();
+    words_.clear();
+
+    uint32_t prev[4] = {0, 0, 0, 0};
+    uint32_t delta[kBlockQty];
+
+    for (size_t start = 0; start < ids.size(); start += kBlockQty) {
+      uint32_t maxDelta = 0;
+      for (size_t i = 0; i < kBlockQty; ++i) {
+        uint32_t id = static_cast<uint32_t>(ids[std::min(start + i, ids.size() - 1)]);
+        delta[i] = id - prev[i % 4];
+        prev[i % 4] = id;
+        maxDelta |= delta[i];
+      }
+      unsigned bits = 0;
+      while (bits < 32 && (maxDelta >> bits)) ++bits;
+
+      size_t base = words_.size();
+      words_.resize(base + 4 * bits, 0);
+      for (size_t i = 0; i < kBlockQty && bits; ++i) {
+        unsigned pos  = (i / 4) * bits;
+        unsigned word = pos / 32, off = pos % 32;
+        words_[base + 4 * word + i % 4] |= delta[i] << off;
+        if (off + bits > 32) {
+          words_[base + 4 * (word + 1) + i % 4] |= delta[i] >> (32 - off);
+        }
+      }
+      bits_.push_back(static_cast<uint8_t>(bits));
+    }
+  }
+
+  void Decode(vector<int>& ids) const {
+    ids.clear();
+    ids.reserve(qty_);
+    ForEach([&ids](uint32_t id) { ids.push_back(static_cast<int>(id)); });
+  }
+
+  // Calls f(id) for each id of the list in the increasing order
+  template <class Func>
+  void ForEach(Func f) const {
+    uint32_t PORTABLE_ALIGN16 buf[kBlockQty];
+    uint32_t PORTABLE_ALIGN16 prev[4] = {0, 0, 0, 0};
+    const uint32_t* in = words_.empty() ? NULL : &words_[0];
+
+    for (size_t b = 0; b < bits_.size(); ++b) {
+      UnpackBlock(in, bits_[b], prev, buf);
+      in += 4 * bits_[b];
+      size_t qty = std::min<size_t>(kBlockQty, qty_ - b * kBlockQty);
+      for (size_t i = 0; i < qty; ++i) f(buf[i]);
+      memcpy(prev, buf + kBlockQty - 4, sizeof prev);
+    }
+  }
+
+  size_t size() const { return qty_; }
+  size_t MemUsage() const {
+    return sizeof(*this) + bits_.capacity() + words_.capacity() * sizeof(uint32_t);
+  }
+
+ private:
+  /*
+   * Decodes a block packed with the given number of bits, prev are
+   * the last four ids of the previous block.
+   */
+  static void UnpackBlock(const uint32_t* in, unsigned bits,
+                          const uint32_t* prev, uint32_t* out) {
+#ifdef PORTABLE_SSE2
+    __m128i acc = _mm_load_si128(reinterpret_cast<const __m128i*>(prev));
+    if (!bits) {
+      for (size_t k = 0; k < kBlockQty / 4; ++k) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(out + 4 * k), acc);
+      }
+      return;
+    }
+    const __m128i mask = _mm_set1_epi32(bits == 32 ? 0xffffffffu : (1u << bits) - 1);
+    for (size_t k = 0; k < kBlockQty / 4; ++k) {
+      unsigned pos  = k * bits;
+      unsigned word = pos / 32, off = pos % 32;
+      __m128i v = _mm_srl_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * word)),
+                                _mm_cvtsi32_si128(off));
+      if (off + bits > 32) {
+        v = _mm_or_si128(v, _mm_sll_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * (word + 1))),
+                                          _mm_cvtsi32_si128(32 - off)));
+      }
+      acc = _mm_add_epi32(acc, _mm_and_si128(v, mask));
+      _mm_store_si128(reinterpret_cast<__m128i*>(out + 4 * k), acc);
+    }
+#else
+    const uint32_t mask = bits == 32 ? 0xffffffffu : (1u << bits) - 1;
+    for (size_t i = 0; i < kBlockQty; ++i) {
+      uint32_t delta = 0;
+      if (bits) {
+        unsigned pos  = (i / 4) * bits;
+        unsigned word = pos / 32, off = pos % 32;
+        delta = in[4 * word + i % 4] >> off;
+        if (off + bits > 32) delta |= in[4 * (word + 1) + i % 4] << (32 - off);
+        delta &= mask;
+      }
+      out[i] = (i < 4 ? prev[i] : out[i - 4]) + delta;
+    }
+#endif
+  }
+
+  size_t            qty_;
+  vector<uint8_t>   bits_;   // the number of bits for each block
+  vector<uint32_t>  words_;  // packed blocks, a block takes 4 * bits words
+};
+
+}  // namespace similarity
+
+#endif     // _PACKED_POSTING_LIST_H_
@@ -0,0 +1,138 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/) and others.
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#ifndef _PIVOT_DIST_FILTER_H_
+#define _PIVOT_DIST_FILTER_H_
+
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include "utils.h"
+#include "logging.h"
+#include "simdutils.h"
+
+#ifdef PORTABLE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace similarity {
+
+using std::vector;
+
+/*
+ * Distances between the objects of a tree leaf and the pivots on the path
+ * to the leaf. They are stored by columns, one column per pivot, so that
+ * the objects that can't be answers are filtered out before any distance
+ * to the query is computed. For float distances, four objects are
+ * checked at a time using SIMD.
+ */
+template <typename dist_t>
+class PivotDistFilter {
+ public:
+  PivotDistFilter() : objQty_(0), pivotQty_(0), stride_(0) {}
+
+  // dists[i * pivotQty + k] is the distance between the pivot k and the object i
+  void Init(size_t objQty, size_t pivotQty, const vector<dist_t>& dists) {
+    CHECK(dists.size() == objQty * pivotQty);
+    objQty_   = objQty;
+    pivotQty_ = pivotQty;
+    stride_   = (objQty + 3) / 4 * 4;
+    cols_.assign(pivotQty_ * stride_, 0);
+    for (size_t i = 0; i < objQty_; ++i) {
+      for (size_t k = 0; k < pivotQty_; ++k) {
+        cols_[k * stride_ + i] = dists[i * pivotQty_ + k];
+      }
+    }
+  }
+
+  size_t objQty() const { return objQty_; }
+  size_t pivotQty() const { return pivotQty_; }
+
+  /*
+   * Writes to pos the positions of objects i from [start, end) such that
+   * lo[k] <= d(k, i) <= hi[k] for the first pivotQty pivots, and returns
+   * their number. The start must be a multiple of four.
+   */
+  size_t Filter(size_t start, size_t end, size_t pivotQty,
+                const dist_t* lo, const dist_t* hi, uint32_t* pos) const {
+    size_t qty = 0;
+    for (size_t i = start; i < end; ++i) {
+      bool keep = true;
+      for (size_t k = 0; k < pivotQty && keep; ++k) {
+        dist_t d = cols_[k * stride_ + i];
+        keep = lo[k] <= d && d <= hi[k];
+      }
+      if (keep) pos[qty++] = i;
+    }
+    return qty;
+  }
+
+ private:
+  size_t          objQty_;
+  size_t          pivotQty_;
+  size_t          stride_;  // column length, padded to a multiple of four
+  vector<dist_t>  cols_;
+};
+
+#ifdef PORTABLE_SSE2
+template <>
+inline size_t PivotDistFilter<float>::Filter(size_t start, size_t end, size_t pivotQty,
+                                             const float* lo, const float* hi, uint32_t* pos) const {
+  size_t qty = 0;
+  for (size_t i = start; i < end; i += 4) {
+    __m128 keep = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (size_t k = 0; k < pivotQty; ++k) {
+      __m128 d = _mm_loadu_ps(&cols_[k * stride_ + i]);
+      keep = _mm_and_ps(keep, _mm_and_ps(_mm_cmple_ps(_mm_set1_ps(lo[k]), d),
+                                         _mm_cmple_ps(d, _mm_set1_ps(hi[k]))));
+    }
+    unsigned mask = _mm_movemask_ps(keep);
+    // Columns are padded, but the padding isn't a part of the leaf
+    if (i + 4 > end) mask &= (1u << (end - i)) - 1;
+    while (mask) {
+      unsigned b = __builtin_ctz(mask);
+      pos[qty++] = i + b;
+      mask &= mask - 1;
+    }
+  }
+  return qty;
+}
+#else
+#pragma message WARN("PivotDistFilter<float>: SSE2 is not available, defaulting to pure C++ implementation!")
+#endif
+
+/*
+ * Rounds a bound computed in double precision outwards, so that no
+ * distance inside the interval is left out, and clamps it to the range
+ * of distance values.
+ */
+template <typename dist_t>
+inline dist_t PivotDistBound(double x, bool lower) {
+  if (std::is_integral<dist_t>::value) x = lower ? std::ceil(x) : std::floor(x);
+  double maxDist = static_cast<double>(DistMax<dist_t>());
+  dist_t res = static_cast<dist_t>(std::max(-maxDist, std::min(maxDist, x)));
+  if (!std::is_integral<dist_t>::value) {
+    if (lower && res > x) res = std::nextafter(res, -DistMax<dist_t>());
+    if (!lower && res < x) res = std::nextafter(res, DistMax<dist_t>());
+  }
+  return res;
+}
+
+}  // namespace similarity
+
+#endif     // _PIVOT_DIST_FILTER_H_
@@ -21,6 +21,12 @@
 
 namespace similarity {
 
+/*
+ * Queries compute distances to buckets and lists of candidates
+ * in blocks of this size.
+ */
+const size_t DIST_BATCH_QTY = 64;
+
 template <typename dist_t>
 class Space;
 
@@ -39,6 +45,8 @@ class Query {
   // Distance can be asymmetric!
   virtual dist_t DistanceObjLeft(const Object* object) const;
   virtual dist_t DistanceObjRight(const Object* object) const;
+  // pDist[i] = DistanceObjLeft(pObjs[i]), computed in a single call to the space
+  virtual void DistanceObjLeftBatch(const Object* const* pObjs, size_t qty, dist_t* pDist) const;
 
   virtual void Reset() = 0;
   virtual dist_t Radius() const = 0;
@@ -18,6 +18,7 @@
 
 #include <string>
 #include <cmath>
+#include <limits>
 #include <vector>
 #include <sstream>
 
@@ -181,6 +182,17 @@ public:
 
     return (kVisitBoth);
   }
+  /*
+   * The same rule applied to the distance t between a pivot and an object:
+   * if Classify would prune the side of t, the object can't be an answer.
+   * This is the case unless
+   *    distQueryPivot - below <= t <= distQueryPivot + above.
+   */
+  inline void GetPivotDistMargins(dist_t MaxDist, double& below, double& above) const {
+    const double inf = std::numeric_limits<double>::infinity();
+    below = alpha_right_ > 0 && exp_right_ > 0 ? pow(double(MaxDist) / alpha_right_, 1.0 / exp_right_) : inf;
+    above = alpha_left_ > 0 && exp_left_ > 0 ? pow(double(MaxDist) / alpha_left_, 1.0 / exp_left_) : inf;
+  }
   string Dump() { 
     stringstream str;
 
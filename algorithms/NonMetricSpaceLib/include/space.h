@@ -132,6 +132,18 @@ class Space {
    * IndexTimeDistance access can be disable/enabled only by function friends 
    */
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const = 0;
+  /*
+   * Computes distances between qty objects and the query in one call:
+   * pDist[i] = HiddenDistance(pObjs[i], query). Spaces can redefine it
+   * to avoid a virtual call per distance and to compute several distances
+   * at a time using SIMD instructions.
+   */
+  virtual void HiddenDistanceBatch(const Object* const* pObjs, size_t qty,
+                                   const Object* query, dist_t* pDist) const {
+    for (size_t i = 0; i < qty; ++i) {
+      pDist[i] = HiddenDistance(pObjs[i], query);
+    }
+  }
   virtual Space<dist_t>* HiddenClone() const = 0;
  private:
   bool mutable bIndexPhase = true;
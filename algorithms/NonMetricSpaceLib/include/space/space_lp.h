@@ -67,6 +67,22 @@ public:
      */
     return LPGenericDistanceOptim(x, y, length, dist_t(pf_));
   }
+  // Distances between each of vectQty vectors and the query
+  void operator()(const dist_t* const* pVects, size_t vectQty,
+                  const dist_t* pQuery, size_t length, dist_t* pDist) const {
+    if (custom_) {
+      if (p_ == 1) {
+        L1NormSIMDBatch(pVects, vectQty, pQuery, length, pDist);
+        return;
+      } else if (p_ == 2) {
+        L2NormSIMDBatch(pVects, vectQty, pQuery, length, pDist);
+        return;
+      }
+    }
+    for (size_t i = 0; i < vectQty; ++i) {
+      pDist[i] = (*this)(pVects[i], pQuery, length);
+    }
+  }
   dist_t getP() const { return pf_; }
   bool getCustom() const { return custom_; }
 private:
@@ -82,12 +98,18 @@ class SpaceLp : public VectorSpaceSimpleStorage<dist_t> {
   virtual ~SpaceLp() {}
 
   virtual std::string ToString() const;
+  // Lets methods compute distances between vectors they keep themselves
+  const SpaceLpDist<dist_t>& GetDistObj() const { return distObj_; }
  protected:
   virtual Space<dist_t>* HiddenClone() const {
     // Can use the default copy constructor, b/c we have no pointer fields in SpaceLpDist<dist_t>
     return new SpaceLp<dist_t>(*this);
   }
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const;
+  virtual void HiddenDistanceBatch(const Object* const* pObjs, size_t qty,
+                                   const Object* query, dist_t* pDist) const {
+    this->DistanceBatchSimpleStorage(pObjs, qty, query, pDist, distObj_);
+  }
  private:
   SpaceLpDist<dist_t> distObj_;
 };
@@ -45,6 +45,8 @@ public:
 protected:
   virtual Space<dist_t>* HiddenClone() const { return new SpaceCosineSimilarity<dist_t>(); } // no parameters 
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const;
+  virtual void HiddenDistanceBatch(const Object* const* pObjs, size_t qty,
+                                   const Object* query, dist_t* pDist) const;
 };
 
 template <typename dist_t>
@@ -65,6 +67,8 @@ public:
 protected:
   virtual Space<dist_t>* HiddenClone() const { return new SpaceAngularDistance<dist_t>(); } // no parameters 
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const;
+  virtual void HiddenDistanceBatch(const Object* const* pObjs, size_t qty,
+                                   const Object* query, dist_t* pDist) const;
 };
 
 
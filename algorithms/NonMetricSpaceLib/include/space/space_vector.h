@@ -21,6 +21,9 @@
 #include <map>
 #include <stdexcept>
 #include <sstream>
+#include <memory>
+#include <vector>
+#include <algorithm>
 
 #include <string.h>
 #include "global.h"
@@ -28,6 +31,16 @@
 #include "utils.h"
 #include "space.h"
 
+/*
+ * Data files with these extensions are read as binary files:
+ * fvecs: each vector is an int dimensionality followed by the float elements,
+ * lshkit: a header of three unsigned ints (element size, # of vectors,
+ *         dimensionality) followed by all the float elements.
+ * Files with other extensions are read as text, one vector per line.
+ */
+#define DATA_FILE_EXT_FVECS      ".fvecs"
+#define DATA_FILE_EXT_LSHKIT     ".lshkit"
+
 namespace similarity {
 
 template <typename dist_t>
@@ -49,6 +62,16 @@ class VectorSpace : public Space<dist_t> {
   virtual Space<dist_t>* HiddenClone() const = 0;
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const = 0;
   void ReadVec(std::string line, LabelType& label, std::vector<dist_t>& v) const;
+  void ReadBinaryDataset(ObjectVector& dataset,
+                         const ExperimentConfig<dist_t>* config,
+                         const char* inputfile,
+                         const int MaxNumObjects) const;
+  /*
+   * True if an object keeps just the vector elements, i.e.,
+   * the space doesn't redefine CreateObjFromVect(). The binary
+   * reader then places all objects in a single contiguous arena.
+   */
+  virtual bool HasSimpleStorage() const { return false; }
   void CreateVectFromObjSimpleStorage(const char *pFuncName,
                                  const Object* obj, dist_t* pDstVect,
                                  size_t nElem) const {
@@ -62,6 +85,13 @@ class VectorSpace : public Space<dist_t> {
     }
     for (size_t i = 0; i < nElem; ++i) pDstVect[i]=pSrcVec[i];
   }
+ private:
+  /*
+   * Memory of the objects read by ReadBinaryDataset(). The objects
+   * only point to it, so it is released together with the space
+   * (and all its clones), rather than when the objects are deleted.
+   */
+  mutable std::vector<std::shared_ptr<char>> arenas_;
 };
 
 template <typename dist_t>
@@ -76,6 +106,32 @@ class VectorSpaceSimpleStorage : public VectorSpace<dist_t> {
     return VectorSpace<dist_t>::
                 CreateVectFromObjSimpleStorage(__func__, obj, pDstVect, nElem);
   }
+ protected:
+  virtual bool HasSimpleStorage() const { return true; }
+  /*
+   * A helper to implement HiddenDistanceBatch() using a one-to-many
+   * distance function batchFunc(pVects, vectQty, pQuery, elemQty, pDist).
+   */
+  template <class BatchFunc>
+  void DistanceBatchSimpleStorage(const Object* const* pObjs, size_t qty,
+                                  const Object* query, dist_t* pDist,
+                                  BatchFunc batchFunc) const {
+    const size_t kBlockQty = 64;
+    const dist_t* pVects[kBlockQty];
+    const dist_t* pQuery = reinterpret_cast<const dist_t*>(query->data());
+    const size_t length = query->datalength() / sizeof(dist_t);
+    CHECK(length > 0);
+
+    for (size_t start = 0; start < qty; start += kBlockQty) {
+      const size_t blockQty = std::min(kBlockQty, qty - start);
+      for (size_t i = 0; i < blockQty; ++i) {
+        const Object* obj = pObjs[start + i];
+        CHECK(obj->datalength() == query->datalength());
+        pVects[i] = reinterpret_cast<const dist_t*>(obj->data());
+      }
+      batchFunc(pVects, blockQty, pQuery, length, pDist + start);
+    }
+  }
 };
 
 }  // namespace similarity
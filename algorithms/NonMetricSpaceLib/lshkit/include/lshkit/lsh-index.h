@@ -25,9 +25,11 @@
 #ifndef __LSHKIT_FLAT__
 #define __LSHKIT_FLAT__
 
+#include <cassert>
 #include <stdexcept>
 #include <algorithm>
 #include <iostream>
+#include <boost/range/iterator_range.hpp>
 #include <lshkit/common.h>
 #include <lshkit/topk.h>
 #include <lshkit/archive.h>
@@ -39,6 +41,11 @@ namespace lshkit {
   * LSH functions.  Given a query point q, the points in the bins to which q is
   * hashed to are scanned for the nearest neighbors of q.
   *
+  * Each hash table keeps the keys of all its bins in one array, bin j
+  * being the range [offsets[j], offsets[j+1]) of this array.  Inserted keys
+  * are first kept aside and moved to the array by commit(), which has to be
+  * called after the last insertion and before the first query.
+  *
   * @param LSH The LSH class.
   * @param KEY The key type.
   */
@@ -53,10 +60,82 @@ public:
     typedef KEY Key;
 
 protected:
-    typedef std::vector<Key> Bin;
+    typedef boost::iterator_range<const Key *> Bin;
+
+    /// A hash table in the compressed sparse row format.
+    class Table
+    {
+        std::vector<unsigned> offsets_;
+        std::vector<Key> keys_;
+        std::vector<std::pair<unsigned, Key> > pending_;
+    public:
+        void resize (unsigned range)
+        {
+            offsets_.assign(range + 1, 0);
+            keys_.clear();
+            pending_.clear();
+        }
+
+        unsigned size () const
+        {
+            return offsets_.empty() ? 0 : offsets_.size() - 1;
+        }
+
+        void insert (unsigned idx, Key key)
+        {
+            pending_.push_back(std::make_pair(idx, key));
+        }
+
+        /// Moves the pending keys to the bins, keeping the order of insertion.
+        void commit ()
+        {
+            if (pending_.empty()) return;
+            unsigned range = size();
+            std::vector<unsigned> offsets(range + 1, 0);
+            for (unsigned j = 0; j < range; ++j) {
+                offsets[j + 1] = offsets_[j + 1] - offsets_[j];
+            }
+            for (size_t i = 0; i < pending_.size(); ++i) {
+                ++offsets[pending_[i].first + 1];
+            }
+            for (unsigned j = 0; j < range; ++j) {
+                offsets[j + 1] += offsets[j];
+            }
+            std::vector<Key> keys(offsets[range]);
+            std::vector<unsigned> next(offsets.begin(), offsets.end() - 1);
+            for (unsigned j = 0; j < range; ++j) {
+                for (unsigned k = offsets_[j]; k < offsets_[j + 1]; ++k) {
+                    keys[next[j]++] = keys_[k];
+                }
+            }
+            for (size_t i = 0; i < pending_.size(); ++i) {
+                keys[next[pending_[i].first]++] = pending_[i].second;
+            }
+            offsets_.swap(offsets);
+            keys_.swap(keys);
+            std::vector<std::pair<unsigned, Key> >().swap(pending_);
+        }
+
+        /// Keys of bin idx, the table must be committed.
+        Bin operator [] (unsigned idx) const
+        {
+            assert(pending_.empty());
+            const Key *keys = keys_.data();
+            return Bin(keys + offsets_[idx], keys + offsets_[idx + 1]);
+        }
+
+        void load (std::istream &ar, unsigned idx, unsigned ll)
+        {
+            std::vector<Key> bin(ll);
+            ar.read((char *)&bin[0], ll * sizeof(Key));
+            for (unsigned k = 0; k < ll; ++k) {
+                insert(idx, bin[k]);
+            }
+        }
+    };
 
     std::vector<LSH> lshs_;
-    std::vector<std::vector<Bin> > tables_;
+    std::vector<Table> tables_;
 
 public:
     /// Constructor.
@@ -99,38 +178,40 @@ public:
             lshs_[i].serialize(ar, 0);
             unsigned l;
             ar & l;
-            std::vector<Bin> &table = tables_[i];
+            Table &table = tables_[i];
             table.resize(l);
             for (;;) {
                 unsigned idx, ll;
                 ar & idx;
                 ar & ll;
                 if (ll == 0) break;
-                table[idx].resize(ll);
-                ar.read((char *)&table[idx][0], ll * sizeof(Key));
+                table.load(ar, idx, ll);
             }
+            table.commit();
         }
     }
 
     /// Save the LSH index to a stream.
     void save (std::ostream &ar)
     {
+        commit();
         unsigned L;
         L = lshs_.size();
         ar & L;
         for (unsigned i = 0; i < L; ++i) {
             lshs_[i].serialize(ar, 0);
-            std::vector<Bin> &table = tables_[i];
+            Table &table = tables_[i];
             unsigned l = table.size();
             ar & l;
             unsigned idx, ll;
             for (unsigned j = 0; j < l; ++j) {
-                if (table[j].empty()) continue;
+                Bin bin = table[j];
+                if (bin.empty()) continue;
                 idx = j;
-                ll = table[j].size();
+                ll = bin.size();
                 ar & idx;
                 ar & ll;
-                ar.write((char *)&table[j][0], ll * sizeof(Key));
+                ar.write((const char *)bin.begin(), ll * sizeof(Key));
             }
             idx = ll = 0;
             ar & idx;
@@ -159,7 +240,18 @@ public:
               std::cerr << "data lshs_ index = " << index << std::endl;
             #endif
 
-            tables_[i][index].push_back(key);
+            tables_[i].insert(index, key);
+        }
+    }
+
+    /// Move the inserted items to the hash tables.
+    /**
+      * Should be called after insertions and before queries.
+      */
+    void commit ()
+    {
+        for (unsigned i = 0; i < tables_.size(); ++i) {
+            tables_[i].commit();
         }
     }
 
@@ -20,6 +20,8 @@
 */
 
 #include <fstream>
+#include <vector>
+#include <algorithm>
 #include <boost/dynamic_bitset.hpp>
 
 /**
@@ -132,24 +134,32 @@ public:
     Matrix (const std::string &path): dims(NULL) { load(path); }
 
     /// An accessor class to be used with LSH index.
+    /**
+      * A key is marked by storing the number of the current query, so
+      * reset() doesn't need to clear the marks.
+      */
     class Accessor
     {
         const Matrix &matrix_;
-        boost::dynamic_bitset<> flags_;
+        std::vector<unsigned> marks_;
+        unsigned epoch_;
     public:
         typedef unsigned Key;
         typedef const float *Value;
 
         Accessor(const Matrix &matrix)
-            : matrix_(matrix), flags_(matrix.getSize()) {}
+            : matrix_(matrix), marks_(matrix.getSize(), 0), epoch_(1) {}
 
         void reset () {
-            flags_.reset();
+            if (++epoch_ == 0) {
+                std::fill(marks_.begin(), marks_.end(), 0);
+                epoch_ = 1;
+            }
         }
 
         bool mark (unsigned key) {
-            if (flags_[key]) return false;
-            flags_.set(key);
+            if (marks_[key] == epoch_) return false;
+            marks_[key] = epoch_;
             return true;
         }
 
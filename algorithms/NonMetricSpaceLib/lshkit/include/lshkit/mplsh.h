@@ -172,18 +172,42 @@ typedef std::vector<Probe> ProbeSequence;
 /// Generate a template probe sequence.
 void GenProbeSequenceTemplate (ProbeSequence &seq, unsigned M, unsigned T);
 
+/// Probe sequence template as flat arrays of perturbations.
+/**
+  * Probe i perturbs the components perturbs[j], begins[i] <= j < begins[i+1].
+  * A perturbation is 2 * l + d, where l is the rank of the component score
+  * and d is 1 if the component is increased, and 0 if it is decreased.
+  */
+struct ProbePerturbations
+{
+    std::vector<unsigned> begins;
+    std::vector<unsigned> perturbs;
+
+    unsigned size () const { return begins.empty() ? 0 : begins.size() - 1; }
+};
+
+/// Generate the perturbations of a template probe sequence.
+void GenProbePerturbations (const ProbeSequence &seq, unsigned M, ProbePerturbations &perturbations);
+
 /// Probe sequence template.
 class ProbeSequenceTemplates: public std::vector<ProbeSequence>
 {
+    std::vector<ProbePerturbations> perturbations_;
 public:
     ProbeSequenceTemplates(unsigned max_M, unsigned max_T)
-        : std::vector<ProbeSequence>(max_M + 1)
+        : std::vector<ProbeSequence>(max_M + 1), perturbations_(max_M + 1)
     {
         for (unsigned i = 1; i <= max_M; ++i)
         {
             GenProbeSequenceTemplate(at(i), i, max_T);
+            GenProbePerturbations(at(i), i, perturbations_[i]);
         }
     }
+
+    const ProbePerturbations &perturbations (unsigned M) const
+    {
+        return perturbations_[M];
+    }
 };
 
 extern ProbeSequenceTemplates __probeSequenceTemplates;
@@ -254,6 +278,9 @@ public:
     }
 
     void genProbeSequence (Domain obj, std::vector<unsigned> &seq, unsigned T) const;
+
+    /// Writes at most T probes to seq, returns their number.
+    unsigned genProbeSequence (Domain obj, unsigned *seq, unsigned T) const;
 };
 
 
@@ -326,11 +353,11 @@ public:
     {
 		int c=0;
 		int io=0;
-        std::vector<unsigned> seq;
+        unsigned seq[Probe::MAX_T];
         for (unsigned i = 0; i < Super::lshs_.size(); ++i) {
-            Super::lshs_[i].genProbeSequence(obj, seq, T);
-            for (unsigned j = 0; j < seq.size(); ++j) {
-                typename Super::Bin &bin = Super::tables_[i][seq[j]];
+            unsigned qty = Super::lshs_[i].genProbeSequence(obj, seq, T);
+            for (unsigned j = 0; j < qty; ++j) {
+                typename Super::Bin bin = Super::tables_[i][seq[j]];
 				float tmp=0.0;
                 BOOST_FOREACH(Key key, bin) {
                     scanner(key);
@@ -359,15 +386,17 @@ public:
         if (K == 0) throw std::logic_error("CANNOT ACCEPT R-NN QUERY");
         if (scanner.topk().size() < K) throw std::logic_error("ERROR");
         unsigned L = Super::lshs_.size();
-        std::vector<std::vector<unsigned> > seqs(L);
+        // Probe j of table i is seqs[i * Probe::MAX_T + j]
+        std::vector<unsigned> seqs(L * Probe::MAX_T);
+        unsigned qty = 0;
         for (unsigned i = 0; i < L; ++i) {
-            Super::lshs_[i].genProbeSequence(obj, seqs[i], Probe::MAX_T);
+            qty = Super::lshs_[i].genProbeSequence(obj, &seqs[i * Probe::MAX_T], Probe::MAX_T);
         }
 
         for (unsigned j = 0; j < Probe::MAX_T; ++j) {
-            if (j >= seqs[0].size()) break;
+            if (j >= qty) break;
             for (unsigned i = 0; i < L; ++i) {
-                BOOST_FOREACH(Key key, Super::tables_[i][seqs[i][j]]) {
+                BOOST_FOREACH(Key key, Super::tables_[i][seqs[i * Probe::MAX_T + j]]) {
                     scanner(key);
                 }
             }
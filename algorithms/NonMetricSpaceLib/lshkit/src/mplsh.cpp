@@ -86,14 +86,46 @@ namespace lshkit
         }
     }
 
+    void GenProbePerturbations (const ProbeSequence &seq, unsigned M,
+            ProbePerturbations &perturbations)
+    {
+        perturbations.begins.clear();
+        perturbations.perturbs.clear();
+        perturbations.begins.push_back(0);
+        for (ProbeSequence::const_iterator it = seq.begin();
+                it != seq.end(); ++it)
+        {
+            for (unsigned l = 0; l < M; ++l)
+            {
+                if (it->mask & leftshift(l))
+                {
+                    perturbations.perturbs.push_back(2 * l + ((it->shift & leftshift(l)) ? 1 : 0));
+                }
+            }
+            perturbations.begins.push_back(perturbations.perturbs.size());
+        }
+    }
+
     void MultiProbeLsh::genProbeSequence (Domain obj, std::vector<unsigned>
             &seq, unsigned T) const
     {
-        ProbeSequence scores;
-        std::vector<unsigned> base;
-        scores.resize(2 * lsh_.size());
-        base.resize(lsh_.size());
-        for (unsigned i = 0; i < lsh_.size(); ++i)
+        seq.resize(Probe::MAX_T);
+        seq.resize(genProbeSequence(obj, &seq[0], T));
+    }
+
+    /*
+     * The hash of a probe differs from the hash of the query by the sum of
+     * a_[l] * (+1 or -1) over the perturbed components l, so these changes
+     * are computed once and each probe only adds up its own.
+     */
+    unsigned MultiProbeLsh::genProbeSequence (Domain obj, unsigned *seq,
+            unsigned T) const
+    {
+        unsigned M = lsh_.size();
+        assert(M <= Probe::MAX_M);
+        Probe scores[2 * Probe::MAX_M];
+        unsigned base[Probe::MAX_M];
+        for (unsigned i = 0; i < M; ++i)
         {
             float delta;
             base[i] = Super::lsh_[i](obj, &delta);
@@ -104,35 +136,30 @@ namespace lshkit
             scores[2*i+1].reserve = unsigned(-1);
             scores[2*i+1].score = 1.0 - delta;
         }
-        std::sort(scores.begin(), scores.end());
+        std::sort(scores, scores + 2 * M);
 
-        ProbeSequence &tmpl = __probeSequenceTemplates[lsh_.size()];
+        unsigned hash = 0;
+        unsigned change[2 * Probe::MAX_M];
+        for (unsigned i = 0; i < M; ++i)
+        {
+            unsigned a = a_[scores[i].mask];
+            hash += base[scores[i].mask] * a;
+            change[2*i] = unsigned(-1) * scores[i].reserve * a;
+            change[2*i+1] = scores[i].reserve * a;
+        }
 
-        seq.clear();
-        for (ProbeSequence::const_iterator it = tmpl.begin();
-                it != tmpl.end(); ++it)
+        const ProbePerturbations &tmpl = __probeSequenceTemplates.perturbations(M);
+        unsigned qty = std::min(T, tmpl.size());
+        for (unsigned j = 0; j < qty; ++j)
         {
-            if (seq.size() == T) break;
-            const Probe &probe = *it;
-            unsigned hash = 0;
-            for (unsigned i = 0; i < lsh_.size(); ++i)
+            unsigned h = hash;
+            for (unsigned k = tmpl.begins[j]; k < tmpl.begins[j + 1]; ++k)
             {
-                unsigned h = base[scores[i].mask];
-                if (probe.mask & leftshift(i))
-                {
-                    if (probe.shift & leftshift(i))
-                    {
-                        h += scores[i].reserve;
-                    }
-                    else
-                    {
-                        h += unsigned(-1) * scores[i].reserve;
-                    }
-                }
-                hash += h * a_[scores[i].mask];
+                h += change[tmpl.perturbs[k]];
             }
-            seq.push_back(hash % H_);
+            seq[j] = h % H_;
         }
+        return qty;
     }
 }
 
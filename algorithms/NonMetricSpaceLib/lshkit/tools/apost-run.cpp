@@ -186,6 +186,7 @@ int main (int argc, char *argv[])
                 ++progress;
             }
         }
+        index.commit();
         cout << boost::format("CONSTRUCTION TIME: %1%s.") % timer.elapsed() << endl;
 
         Benchmark<> bench;
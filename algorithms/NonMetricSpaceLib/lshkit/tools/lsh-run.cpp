@@ -174,6 +174,7 @@ int main (int argc, char *argv[])
                 ++progress;
             }
         }
+        index.commit();
         cout << boost::format("CONSTRUCTION TIME: %1%s.") % timer.elapsed() << endl;
 
         if (use_index) {
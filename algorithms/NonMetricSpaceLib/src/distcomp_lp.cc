@@ -522,6 +522,143 @@ double L2NormSIMD(const double* pVect1, const double* pVect2, size_t qty) {
 template float  L2NormSIMD<float>(const float* pVect1, const float* pVect2, size_t qty);
 template double L2NormSIMD<double>(const double* pVect1, const double* pVect2, size_t qty);
 
+/*
+ * One-to-many versions of L1NormSIMD and L2NormSIMD: a distance is computed
+ * for each of vectQty vectors against the same query. Four vectors are
+ * processed at a time, so every query element is loaded once per four
+ * distances.
+ */
+
+template <class T>
+void L1NormSIMDBatch(const T* const* pVects, size_t vectQty, const T* pQuery, size_t qty, T* pDist) {
+    for (size_t k = 0; k < vectQty; ++k) {
+        pDist[k] = L1NormSIMD(pVects[k], pQuery, qty);
+    }
+}
+
+// The elements are added up in the same order as in L1NormSIMD
+template <>
+void L1NormSIMDBatch(const float* const* pVects, size_t vectQty, const float* pQuery, size_t qty, float* pDist) {
+#ifndef PORTABLE_SSE2
+#pragma message WARN("L1NormSIMDBatch<float>: SSE2 is not available, defaulting to pure C++ implementation!")
+    for (size_t k = 0; k < vectQty; ++k) {
+        pDist[k] = L1NormStandard(pVects[k], pQuery, qty);
+    }
+#else
+    const size_t qty4 = qty/4*4;
+
+    __m128 mask_sign = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffffu));
+
+    size_t k = 0;
+    for (; k + 4 <= vectQty; k += 4) {
+        const float* p0 = pVects[k];
+        const float* p1 = pVects[k + 1];
+        const float* p2 = pVects[k + 2];
+        const float* p3 = pVects[k + 3];
+
+        __m128  sum0 = _mm_setzero_ps(), sum1 = sum0, sum2 = sum0, sum3 = sum0;
+
+        for (size_t i = 0; i < qty4; i += 4) {
+            __m128 q = _mm_loadu_ps(pQuery + i);
+            sum0 = _mm_add_ps(sum0, _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(p0 + i), q), mask_sign));
+            sum1 = _mm_add_ps(sum1, _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(p1 + i), q), mask_sign));
+            sum2 = _mm_add_ps(sum2, _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(p2 + i), q), mask_sign));
+            sum3 = _mm_add_ps(sum3, _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(p3 + i), q), mask_sign));
+        }
+
+        const float* pv[4] = {p0, p1, p2, p3};
+        float PORTABLE_ALIGN16 TmpRes[4][4];
+
+        _mm_store_ps(TmpRes[0], sum0);
+        _mm_store_ps(TmpRes[1], sum1);
+        _mm_store_ps(TmpRes[2], sum2);
+        _mm_store_ps(TmpRes[3], sum3);
+
+        for (size_t j = 0; j < 4; ++j) {
+            double res = TmpRes[j][0] + TmpRes[j][1] + TmpRes[j][2] + TmpRes[j][3];
+            for (size_t i = qty4; i < qty; ++i) {
+                res += fabs(pv[j][i] - pQuery[i]);
+            }
+            pDist[k + j] = res;
+        }
+    }
+    for (; k < vectQty; ++k) {
+        pDist[k] = L1NormSIMD(pVects[k], pQuery, qty);
+    }
+#endif
+}
+
+template void L1NormSIMDBatch<double>(const double* const* pVects, size_t vectQty, const double* pQuery, size_t qty, double* pDist);
+
+template <class T>
+void L2NormSIMDBatch(const T* const* pVects, size_t vectQty, const T* pQuery, size_t qty, T* pDist) {
+    for (size_t k = 0; k < vectQty; ++k) {
+        pDist[k] = L2NormSIMD(pVects[k], pQuery, qty);
+    }
+}
+
+/*
+ * Unlike L2SqrSIMD, which adds up the squared differences one element
+ * at a time, this function uses SIMD instructions. Hence, the distances
+ * can be slightly different from the ones computed by L2NormSIMD.
+ */
+template <>
+void L2NormSIMDBatch(const float* const* pVects, size_t vectQty, const float* pQuery, size_t qty, float* pDist) {
+#ifndef PORTABLE_SSE2
+#pragma message WARN("L2NormSIMDBatch<float>: SSE2 is not available, defaulting to pure C++ implementation!")
+    for (size_t k = 0; k < vectQty; ++k) {
+        pDist[k] = L2NormSIMD(pVects[k], pQuery, qty);
+    }
+#else
+    const size_t qty4 = qty/4*4;
+
+    size_t k = 0;
+    for (; k + 4 <= vectQty; k += 4) {
+        const float* p0 = pVects[k];
+        const float* p1 = pVects[k + 1];
+        const float* p2 = pVects[k + 2];
+        const float* p3 = pVects[k + 3];
+
+        __m128  diff0, diff1, diff2, diff3;
+        __m128  sum0 = _mm_setzero_ps(), sum1 = sum0, sum2 = sum0, sum3 = sum0;
+
+        for (size_t i = 0; i < qty4; i += 4) {
+            __m128 q = _mm_loadu_ps(pQuery + i);
+            diff0 = _mm_sub_ps(_mm_loadu_ps(p0 + i), q);
+            diff1 = _mm_sub_ps(_mm_loadu_ps(p1 + i), q);
+            diff2 = _mm_sub_ps(_mm_loadu_ps(p2 + i), q);
+            diff3 = _mm_sub_ps(_mm_loadu_ps(p3 + i), q);
+            sum0  = _mm_add_ps(sum0, _mm_mul_ps(diff0, diff0));
+            sum1  = _mm_add_ps(sum1, _mm_mul_ps(diff1, diff1));
+            sum2  = _mm_add_ps(sum2, _mm_mul_ps(diff2, diff2));
+            sum3  = _mm_add_ps(sum3, _mm_mul_ps(diff3, diff3));
+        }
+
+        const float* pv[4] = {p0, p1, p2, p3};
+        float PORTABLE_ALIGN16 TmpRes[4][4];
+
+        _mm_store_ps(TmpRes[0], sum0);
+        _mm_store_ps(TmpRes[1], sum1);
+        _mm_store_ps(TmpRes[2], sum2);
+        _mm_store_ps(TmpRes[3], sum3);
+
+        for (size_t j = 0; j < 4; ++j) {
+            float res = TmpRes[j][0] + TmpRes[j][1] + TmpRes[j][2] + TmpRes[j][3];
+            for (size_t i = qty4; i < qty; ++i) {
+                float diff = pv[j][i] - pQuery[i];
+                res += diff * diff;
+            }
+            pDist[k + j] = sqrt(res);
+        }
+    }
+    for (; k < vectQty; ++k) {
+        pDist[k] = L2NormSIMD(pVects[k], pQuery, qty);
+    }
+#endif
+}
+
+template void L2NormSIMDBatch<double>(const double* const* pVects, size_t vectQty, const double* pQuery, size_t qty, double* pDist);
+
 /*
  * Slower versions of LP-distance
  */
@@ -245,6 +245,97 @@ double NormScalarProductSIMD(const double* pVect1, const double* pVect2, size_t
 template float   NormScalarProductSIMD<float>(const float* pVect1, const float* pVect2, size_t qty);
 template double  NormScalarProductSIMD<double>(const double* pVect1, const double* pVect2, size_t qty);
 
+/*
+ * One-to-many version of NormScalarProductSIMD: the scalar product is
+ * computed for each of vectQty vectors against the same query. The norm
+ * of the query is computed only once and four vectors are processed at a time.
+ * The elements are added up in the same order as in the one-to-one function,
+ * hence, the results are the same.
+ */
+
+template <class T>
+void NormScalarProductSIMDBatch(const T* const* pVects, size_t vectQty, const T* pQuery, size_t qty, T* pRes) {
+    for (size_t k = 0; k < vectQty; ++k) {
+        pRes[k] = NormScalarProductSIMD(pVects[k], pQuery, qty);
+    }
+}
+
+template <>
+void NormScalarProductSIMDBatch(const float* const* pVects, size_t vectQty, const float* pQuery, size_t qty, float* pRes) {
+#ifndef PORTABLE_SSE2
+#pragma message WARN("NormScalarProductSIMDBatch<float>: SSE2 is not available, defaulting to pure C++ implementation!")
+    for (size_t k = 0; k < vectQty; ++k) {
+        pRes[k] = NormScalarProduct(pVects[k], pQuery, qty);
+    }
+#else
+    const size_t qty4 = qty/4*4;
+    const float eps = numeric_limits<float>::min() * 2;
+
+    __m128  q;
+    __m128  sum_square2 = _mm_set1_ps(0);
+
+    for (size_t i = 0; i < qty4; i += 4) {
+        q = _mm_loadu_ps(pQuery + i);
+        sum_square2 = _mm_add_ps(sum_square2, _mm_mul_ps(q, q));
+    }
+
+    float PORTABLE_ALIGN16 TmpResSquare2[4];
+
+    _mm_store_ps(TmpResSquare2, sum_square2);
+    float norm2 = TmpResSquare2[0] + TmpResSquare2[1] + TmpResSquare2[2] + TmpResSquare2[3];
+
+    for (size_t i = qty4; i < qty; ++i) {
+        norm2 += pQuery[i] * pQuery[i];
+    }
+
+    size_t k = 0;
+    for (; k + 4 <= vectQty; k += 4) {
+        const float* pv[4] = {pVects[k], pVects[k + 1], pVects[k + 2], pVects[k + 3]};
+
+        __m128  v[4];
+        __m128  sum_prod[4], sum_square1[4];
+        for (size_t j = 0; j < 4; ++j) {
+            sum_prod[j] = sum_square1[j] = _mm_set1_ps(0);
+        }
+
+        for (size_t i = 0; i < qty4; i += 4) {
+            q = _mm_loadu_ps(pQuery + i);
+            for (size_t j = 0; j < 4; ++j) {
+                v[j] = _mm_loadu_ps(pv[j] + i);
+                sum_prod[j]    = _mm_add_ps(sum_prod[j], _mm_mul_ps(v[j], q));
+                sum_square1[j] = _mm_add_ps(sum_square1[j], _mm_mul_ps(v[j], v[j]));
+            }
+        }
+
+        for (size_t j = 0; j < 4; ++j) {
+            float PORTABLE_ALIGN16 TmpResProd[4];
+            float PORTABLE_ALIGN16 TmpResSquare1[4];
+
+            _mm_store_ps(TmpResProd, sum_prod[j]);
+            float sum = TmpResProd[0] + TmpResProd[1] + TmpResProd[2] + TmpResProd[3];
+            _mm_store_ps(TmpResSquare1, sum_square1[j]);
+            float norm1 = TmpResSquare1[0] + TmpResSquare1[1] + TmpResSquare1[2] + TmpResSquare1[3];
+
+            for (size_t i = qty4; i < qty; ++i) {
+                sum += pv[j][i] * pQuery[i];
+                norm1 += pv[j][i] * pv[j][i];
+            }
+
+            if (norm1 < eps) {
+              pRes[k + j] = norm2 < eps ? 1 : 0;
+            } else {
+              pRes[k + j] = max(float(-1), min(float(1), sum / sqrt(norm1) / sqrt(norm2)));
+            }
+        }
+    }
+    for (; k < vectQty; ++k) {
+        pRes[k] = NormScalarProductSIMD(pVects[k], pQuery, qty);
+    }
+#endif
+}
+
+template void NormScalarProductSIMDBatch<double>(const double* const* pVects, size_t vectQty, const double* pQuery, size_t qty, double* pRes);
+
 /*
  * Scalar products that are not normalized.
  */
@@ -89,10 +89,20 @@ bool KNNQuery<dist_t>::CheckAndAddToResult(const Object* object) {
 
 template <typename dist_t>
 size_t KNNQuery<dist_t>::CheckAndAddToResult(const ObjectVector& bucket) {
+  return bucket.empty() ? 0 : CheckAndAddToResult(&bucket[0], bucket.size());
+}
+
+template <typename dist_t>
+size_t KNNQuery<dist_t>::CheckAndAddToResult(const Object* const* pObjs, size_t qty) {
   size_t res = 0;
-  for (size_t i = 0; i < bucket.size(); ++i) {
-    if (CheckAndAddToResult(bucket[i])) {
-      ++res;
+  dist_t dist[DIST_BATCH_QTY];
+  for (size_t start = 0; start < qty; start += DIST_BATCH_QTY) {
+    const size_t blockQty = std::min(DIST_BATCH_QTY, qty - start);
+    this->DistanceObjLeftBatch(pObjs + start, blockQty, dist);
+    for (size_t i = 0; i < blockQty; ++i) {
+      if (CheckAndAddToResult(dist[i], pObjs[start + i])) {
+        ++res;
+      }
     }
   }
   return res;
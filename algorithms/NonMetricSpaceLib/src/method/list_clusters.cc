@@ -345,9 +345,7 @@ const ObjectVector& ListClusters<dist_t>::Cluster::GetBucket() {
 template <typename dist_t>
 template <typename QueryType>
 void ListClusters<dist_t>::Cluster::Search(QueryType* query) const {
-  for (const auto& object : (*bucket_)) {
-    query->CheckAndAddToResult(object);
-  }
+  query->CheckAndAddToResult(*bucket_);
 }
 
 template class ListClusters<double>;
@@ -15,6 +15,7 @@
  */
 
 #include <limits>
+#include <memory>
 
 #include "space.h"
 #include "method/lsh_space.h"
@@ -64,14 +65,32 @@ LSH<dist_t, lsh_t, paramcreator_t>::LSH(const Space<dist_t>* space,
   for (int i = 0; i < matrix_->getSize(); ++i) {
     index_->insert(i, (*matrix_)[i]);
   }
+  index_->commit();
 }
 
 template <typename dist_t, typename lsh_t, typename paramcreator_t>
 LSH<dist_t, lsh_t, paramcreator_t>::~LSH() {
+  for (AccessorType* context: searchContexts_) delete context;
   delete matrix_;
   delete index_;
 }
 
+template <typename dist_t, typename lsh_t, typename paramcreator_t>
+typename LSH<dist_t, lsh_t, paramcreator_t>::AccessorType*
+LSH<dist_t, lsh_t, paramcreator_t>::acquireSearchContext() const {
+  std::unique_lock<std::mutex> lock(searchContextGuard_);
+  if (searchContexts_.empty()) return new AccessorType(*matrix_);
+  AccessorType* context = searchContexts_.back();
+  searchContexts_.pop_back();
+  return context;
+}
+
+template <typename dist_t, typename lsh_t, typename paramcreator_t>
+void LSH<dist_t, lsh_t, paramcreator_t>::releaseSearchContext(AccessorType* context) const {
+  std::unique_lock<std::mutex> lock(searchContextGuard_);
+  searchContexts_.push_back(context);
+}
+
 template <typename dist_t, typename lsh_t, typename paramcreator_t>
 const std::string LSH<dist_t, lsh_t, paramcreator_t>::ToString() const {
   return "lsh";
@@ -90,13 +109,14 @@ void LSH<dist_t, lsh_t, paramcreator_t>::Search(KNNQuery<dist_t>* query) {
 
   const float* q = reinterpret_cast<const float*>(query->QueryObject()->data());
 
-  lshkit::FloatMatrix::Accessor accessor(*matrix_);
+  std::unique_ptr<AccessorType> context(acquireSearchContext());
   LSHLpSpace<dist_t> lp(dim, p_, query);
-  lshkit::TopkScanner<lshkit::FloatMatrix::Accessor, LSHLpSpace<dist_t>>
-      query_scanner(accessor, lp, query->GetK());
+  lshkit::TopkScanner<LSHAccessorRef, LSHLpSpace<dist_t>>
+      query_scanner(LSHAccessorRef(context.get()), lp, query->GetK());
   query_scanner.reset(q);
 
   index_->query(q, query_scanner);
+  releaseSearchContext(context.release());
 
   const lshkit::Topk<uint32_t>& knn = query_scanner.topk();
   for (size_t i = 0; i < knn.size(); ++i) {
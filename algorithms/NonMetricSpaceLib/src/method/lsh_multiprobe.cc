@@ -92,16 +92,33 @@ MultiProbeLSH<dist_t>::MultiProbeLSH(const Space<dist_t>* space,
   for (int i = 0; i < matrix_->getSize(); ++i) {
     index_->insert(i, (*matrix_)[i]);
   }
+  index_->commit();
 	ofstream os("mplsh.index", std::ios::binary);
 	index_->save(os);
 }
 
 template <typename dist_t>
 MultiProbeLSH<dist_t>::~MultiProbeLSH() {
+  for (AccessorType* context: searchContexts_) delete context;
   delete matrix_;
   delete index_;
 }
 
+template <typename dist_t>
+typename MultiProbeLSH<dist_t>::AccessorType* MultiProbeLSH<dist_t>::acquireSearchContext() const {
+  unique_lock<mutex> lock(searchContextGuard_);
+  if (searchContexts_.empty()) return new AccessorType(*matrix_);
+  AccessorType* context = searchContexts_.back();
+  searchContexts_.pop_back();
+  return context;
+}
+
+template <typename dist_t>
+void MultiProbeLSH<dist_t>::releaseSearchContext(AccessorType* context) const {
+  unique_lock<mutex> lock(searchContextGuard_);
+  searchContexts_.push_back(context);
+}
+
 template <typename dist_t>
 const std::string MultiProbeLSH<dist_t>::ToString() const {
   return "multiprobe lsh";
@@ -120,12 +137,13 @@ void MultiProbeLSH<dist_t>::Search(KNNQuery<dist_t>* query) {
 
   const float* q = reinterpret_cast<const float*>(query->QueryObject()->data());
 
-  lshkit::FloatMatrix::Accessor accessor(*matrix_);
+  unique_ptr<AccessorType> context(acquireSearchContext());
   LSHMultiProbeLpSpace<dist_t> lp(dim_, query);
-  lshkit::TopkScanner<lshkit::FloatMatrix::Accessor, LSHMultiProbeLpSpace<dist_t>>
-      query_scanner(accessor, lp, query->GetK());
+  lshkit::TopkScanner<LSHAccessorRef, LSHMultiProbeLpSpace<dist_t>>
+      query_scanner(LSHAccessorRef(context.get()), lp, query->GetK());
   query_scanner.reset(q);
   int checks = index_->query(q, T_, query_scanner);
+  releaseSearchContext(context.release());
   //cout<<checks<<endl;
   const lshkit::Topk<uint32_t>& knn = query_scanner.topk();
   for (size_t i = 0; i < knn.size(); ++i) {
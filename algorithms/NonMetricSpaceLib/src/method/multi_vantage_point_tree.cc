@@ -145,15 +145,15 @@ MultiVantagePointTree<dist_t>::BuildTree(
 template <typename dist_t>
 void MultiVantagePointTree<dist_t>::Search(RangeQuery<dist_t>* query) {
   int mx = MaxLeavesToVisit_;
-  Dists path(MaxPathLength_);
-  GenericSearch(root_, query, path, 0, mx);
+  Dists path(MaxPathLength_ + 2), bounds(2 * (MaxPathLength_ + 2));
+  GenericSearch(root_, query, path, 0, bounds, mx);
 }
 
 template <typename dist_t>
 void MultiVantagePointTree<dist_t>::Search(KNNQuery<dist_t>* query) {
   int mx = MaxLeavesToVisit_;
-  Dists path(MaxPathLength_);
-  GenericSearch(root_, query, path, 0, mx);
+  Dists path(MaxPathLength_ + 2), bounds(2 * (MaxPathLength_ + 2));
+  GenericSearch(root_, query, path, 0, bounds, mx);
 }
 
 // Range search algorithm
@@ -164,6 +164,7 @@ void MultiVantagePointTree<dist_t>::GenericSearch(
     QueryType* query,
     Dists& path,
     size_t query_path_len,
+    Dists& bounds,
     int& MaxLeavesToVisit) {
   if (node == NULL) {
     return;
@@ -181,25 +182,36 @@ void MultiVantagePointTree<dist_t>::GenericSearch(
   if (node->isleaf()) {
     --MaxLeavesToVisit;
     const LeafNode* leaf_node = reinterpret_cast<const LeafNode*>(node);
-    const Entries& entries = leaf_node->entries_;
-    for (size_t i = 0; i < entries.size(); ++i) {
-      if (dp1 - query->Radius() <= entries[i].d1 &&
-          dp1 + query->Radius() >= entries[i].d1 &&
-          dp2 - query->Radius() <= entries[i].d2 &&
-          dp2 + query->Radius() >= entries[i].d2) {
-        size_t path_len = std::min(query_path_len, entries[i].path.size());
-        bool ok = true;
-        for (size_t k = 0; k < path_len; ++k) {
-          if (path[k] - query->Radius() > entries[i].path[k] ||
-              path[k] + query->Radius() < entries[i].path[k]) {
-            ok = false;
-            break;
-          }
-        }
-        if (ok) {
-          query->CheckAndAddToResult(entries[i].object);
-        }
+    const ObjectVector& bucket = *leaf_node->bucket_;
+    const size_t pivotQty = leaf_node->dists_.pivotQty();
+    if (bucket.empty()) return;
+    CHECK(query_path_len == leaf_node->pathLen_);
+    // The query distances are arranged as the columns of the leaf
+    path[query_path_len] = dp1;
+    path[query_path_len + 1] = dp2;
+
+    dist_t*       lo = &bounds[0];
+    dist_t*       hi = &bounds[pivotQty];
+    uint32_t      pos[DIST_BATCH_QTY];
+    const Object* pObjs[DIST_BATCH_QTY];
+
+    /*
+     * Objects are filtered using their distances to the pivots, the rest are
+     * compared with the query in one batch. The bounds are recomputed for
+     * each block of objects, because the query radius may decrease.
+     */
+    for (size_t start = 0; start < bucket.size(); start += DIST_BATCH_QTY) {
+      const double radius = query->Radius();
+      for (size_t k = 0; k < pivotQty; ++k) {
+        lo[k] = PivotDistBound<dist_t>(path[k] - radius, true);
+        hi[k] = PivotDistBound<dist_t>(path[k] + radius, false);
+      }
+      size_t qty = leaf_node->dists_.Filter(start, std::min(bucket.size(), start + DIST_BATCH_QTY),
+                                            pivotQty, lo, hi, pos);
+      for (size_t i = 0; i < qty; ++i) {
+        pObjs[i] = bucket[pos[i]];
       }
+      query->CheckAndAddToResult(pObjs, qty);
     }
   } else {
     const InternalNode* internal_node =
@@ -219,10 +231,10 @@ void MultiVantagePointTree<dist_t>::GenericSearch(
         bool FirstRight2 = dp2 > internal_node->m21_;
         for (int order2 = 0; order2 < 2; ++order2) {
           if (order2 == int(FirstRight2) && dp2 - query->Radius() <= internal_node->m21_) {   // left-left
-            GenericSearch(internal_node->child1_, query, path, query_path_len, MaxLeavesToVisit);
+            GenericSearch(internal_node->child1_, query, path, query_path_len, bounds, MaxLeavesToVisit);
           }
 		  if (order2 != int(FirstRight2) && dp2 + query->Radius() >= internal_node->m21_) {   // left-right
-            GenericSearch(internal_node->child2_, query, path, query_path_len, MaxLeavesToVisit);
+            GenericSearch(internal_node->child2_, query, path, query_path_len, bounds, MaxLeavesToVisit);
           }
         }
       }
@@ -230,10 +242,10 @@ void MultiVantagePointTree<dist_t>::GenericSearch(
         bool FirstRight2 = dp2 > internal_node->m22_;
         for (int order2 = 0; order2 < 2; ++order2) {
           if (order2 == int(FirstRight2) && dp2 - query->Radius() <= internal_node->m22_) {   // right-left
-            GenericSearch(internal_node->child3_, query, path, query_path_len, MaxLeavesToVisit);
+            GenericSearch(internal_node->child3_, query, path, query_path_len, bounds, MaxLeavesToVisit);
           }
 		  if (order2 != int(FirstRight2) && dp2 + query->Radius() >= internal_node->m22_) {   // right-right
-            GenericSearch(internal_node->child4_, query, path, query_path_len, MaxLeavesToVisit);
+            GenericSearch(internal_node->child4_, query, path, query_path_len, bounds, MaxLeavesToVisit);
           }
         }
       }
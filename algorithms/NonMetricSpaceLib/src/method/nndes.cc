@@ -48,6 +48,8 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <map>
 #include <unordered_set>
 #include <queue>
+#include <fstream>
+#include <thread>
 
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
@@ -57,11 +59,107 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include "rangequery.h"
 #include "knnquery.h"
 #include "method/nndes.h"
-
-#define USE_BITSET_FOR_SEARCHING 1
+#include "index_io.h"
 
 namespace similarity {
 
+/*
+ * The knn-graph file of KGraph: the magic string, the major and the minor
+ * version, the number of nodes, and, for each node, the number of
+ * neighbors used in search (M), the number of neighbors stored (K),
+ * and the ids of K neighbors. All numbers are 32-bit unsigned integers.
+ */
+static const char     KGRAPH_MAGIC[]        = "KNNGRAPH";
+static const size_t   KGRAPH_MAGIC_SIZE     = 8;
+static const uint32_t KGRAPH_VERSION_MAJOR  = 2;
+static const uint32_t KGRAPH_VERSION_MINOR  = 0;
+
+// Only the float and double Lp spaces are instantiated
+template <typename dist_t>
+const SpaceLpDist<dist_t>* GetLpDist(const Space<dist_t>* space) {
+  return NULL;
+}
+
+template <>
+const SpaceLpDist<float>* GetLpDist(const Space<float>* space) {
+  const SpaceLp<float>* lp = dynamic_cast<const SpaceLp<float>*>(space);
+  return lp ? &lp->GetDistObj() : NULL;
+}
+
+template <>
+const SpaceLpDist<double>* GetLpDist(const Space<double>* space) {
+  const SpaceLp<double>* lp = dynamic_cast<const SpaceLp<double>*>(space);
+  return lp ? &lp->GetDistObj() : NULL;
+}
+
+// Instantiating SpaceLpDist<int> would need integer distance kernels
+template <typename dist_t>
+void LpDistBatch(const SpaceLpDist<dist_t>& lpDist, const dist_t* const* pVects, size_t qty,
+                 const dist_t* pQuery, size_t length, dist_t* pDist) {
+  throw runtime_error("Lp distances are only computed for float and double vectors");
+}
+
+template <>
+void LpDistBatch(const SpaceLpDist<float>& lpDist, const float* const* pVects, size_t qty,
+                 const float* pQuery, size_t length, float* pDist) {
+  lpDist(pVects, qty, pQuery, length, pDist);
+}
+
+template <>
+void LpDistBatch(const SpaceLpDist<double>& lpDist, const double* const* pVects, size_t qty,
+                 const double* pQuery, size_t length, double* pDist) {
+  lpDist(pVects, qty, pQuery, length, pDist);
+}
+
+template <typename dist_t>
+NNDescentMethod<dist_t>::SpaceOracle::SpaceOracle(const Space<dist_t>* space,
+                                                  const ObjectVector& data) :
+      space_(space), data_(data), lpDist_(GetLpDist(space)), stride_(0) {
+  if (!lpDist_ || data_.empty()) {
+    lpDist_ = NULL;
+    return;
+  }
+  size_t dim = data_[0]->datalength() / sizeof(dist_t);
+  for (const Object* o: data_) {
+    if (o->datalength() != dim * sizeof(dist_t)) {
+      lpDist_ = NULL;
+      return;
+    }
+  }
+  const size_t padQty = 16 / sizeof(dist_t);
+  stride_ = (dim + padQty - 1) / padQty * padQty;
+  vects_.assign(data_.size() * stride_, 0);
+  for (size_t i = 0; i < data_.size(); ++i) {
+    memcpy(&vects_[i * stride_], data_[i]->data(), dim * sizeof(dist_t));
+  }
+}
+
+template <typename dist_t>
+void NNDescentMethod<dist_t>::SpaceOracle::operator()(IdType id, const IdType* pIds,
+                                                      size_t qty, float* pDist) const {
+  if (!lpDist_) {
+    for (size_t i = 0; i < qty; ++i) {
+      IdType id1 = min(id, pIds[i]), id2 = max(id, pIds[i]);
+      pDist[i] = space_->IndexTimeDistance(data_[id1], data_[id2]);
+    }
+    return;
+  }
+  const dist_t* pVects[DIST_BATCH_QTY];
+  dist_t        dist[DIST_BATCH_QTY];
+  const dist_t* pQuery = &vects_[id * stride_];
+
+  for (size_t start = 0; start < qty; start += DIST_BATCH_QTY) {
+    size_t batchQty = min(qty - start, DIST_BATCH_QTY);
+    for (size_t i = 0; i < batchQty; ++i) {
+      pVects[i] = &vects_[pIds[start + i] * stride_];
+    }
+    LpDistBatch(*lpDist_, pVects, batchQty, pQuery, stride_, dist);
+    for (size_t i = 0; i < batchQty; ++i) {
+      pDist[start + i] = dist[i];
+    }
+  }
+}
+
 template <typename dist_t>
 NNDescentMethod<dist_t>::NNDescentMethod(
     bool  PrintProgress,
@@ -75,7 +173,7 @@ NNDescentMethod<dist_t>::NNDescentMethod(
       iterationQty_(100), // default value from Wei Dong's code
       rho_(1.0), // default value from Wei Dong's code
       delta_(0.001), // default value from Wei Dong's code
-      nndesOracle_(space, data),
+      indexThreadQty_(thread::hardware_concurrency()),
       initSearchAttempts_(10),
       greedy_(false)
 {
@@ -88,6 +186,13 @@ NNDescentMethod<dist_t>::NNDescentMethod(
   pmgr.GetParamOptional("rho", rho_); // Fast rho is 0.5
   pmgr.GetParamOptional("delta", delta_);
   pmgr.GetParamOptional("greedy", greedy_);
+  pmgr.GetParamOptional("indexThreadQty", indexThreadQty_);
+
+  string saveLocation, loadLocation, exportLocation, importLocation;
+  pmgr.GetParamOptional(PARAM_SAVE_INDEX, saveLocation);
+  pmgr.GetParamOptional(PARAM_LOAD_INDEX, loadLocation);
+  pmgr.GetParamOptional("exportGraph", exportLocation);
+  pmgr.GetParamOptional("importGraph", importLocation);
 
   SetQueryTimeParamsInternal(pmgr);
 
@@ -96,6 +201,7 @@ NNDescentMethod<dist_t>::NNDescentMethod(
   LOG(LIB_INFO) <<  "iterationQty = " << iterationQty_;
   LOG(LIB_INFO) <<  "rho          = " << rho_;
   LOG(LIB_INFO) <<  "delta        = " << delta_;
+  LOG(LIB_INFO) <<  "indexThreadQty = " << indexThreadQty_;
 
   LOG(LIB_INFO) <<  "(initial) initSearchAttempts= " << initSearchAttempts_;
   LOG(LIB_INFO) <<  "(initial) greedy       = " << greedy_;
@@ -103,18 +209,44 @@ NNDescentMethod<dist_t>::NNDescentMethod(
 
   LOG(LIB_INFO) <<  "(initial) searchNN = " << searchNN_;
 
-  LOG(LIB_INFO) << "Starting NN-Descent...";
+  if (!loadLocation.empty()) {
+    LoadIndex(loadLocation);
+  } else {
+    if (!importLocation.empty()) {
+      ImportGraph(importLocation);
+    } else {
+      BuildGraph(PrintProgress);
+    }
+    if (!saveLocation.empty()) SaveIndex(saveLocation);
+  }
+
+  if (!exportLocation.empty()) ExportGraph(exportLocation);
+}
+
+template <typename dist_t>
+NNDescentMethod<dist_t>::~NNDescentMethod() {
+  for (SearchContextSW<dist_t>* context: searchContexts_) delete context;
+}
+
+template <typename dist_t>
+void NNDescentMethod<dist_t>::BuildGraph(bool PrintProgress) {
+  SpaceOracle oracle(space_, data_);
 
-  nndesObj_.reset(new NNDescent<SpaceOracle>(data_.size(), // N
-                                             NN_, //K 
-                                             rho_, //S, 
-                                             nndesOracle_, GRAPH_BOTH));
+  LOG(LIB_INFO) << "Starting NN-Descent" << (oracle.isVectorOracle() ? " over the vector array" : "")
+                << " in " << max<size_t>(indexThreadQty_, 1) << " threads...";
+
+  unique_ptr<NNDescent<SpaceOracle>> nndesObj(
+                          new NNDescent<SpaceOracle>(data_.size(), // N
+                                                     NN_, //K 
+                                                     rho_, //S, 
+                                                     oracle, GRAPH_BOTH,
+                                                     indexThreadQty_));
 
     float total = float(data_.size()) * (data_.size() - 1) / 2;
     cout.precision(5);
     cout.setf(ios::fixed);
     for (int it = 0; it < iterationQty_; ++it) {
-        int t = nndesObj_->iterate(PrintProgress);
+        int t = nndesObj->iterate(PrintProgress);
         float rate = float(t) / (NN_ * data_.size());
 
 // TODO @leo computation of recall needs to be re-written, can't use original Wei Dong's code
@@ -130,12 +262,148 @@ NNDescentMethod<dist_t>::NNDescentMethod(
         }
         cout << setw(2) << it << " update:" << rate << " recall:" << recall << " cost:" << float(nndes.getCost())/total  << endl;
 */
-        LOG(LIB_INFO) << setw(2) << it << " update:" << rate << " cost:" << float(nndesObj_->getCost())/total;
+        LOG(LIB_INFO) << setw(2) << it << " update:" << rate << " cost:" << float(nndesObj->getCost())/total;
         if (rate < delta_) break;
     }
 
 
   LOG(LIB_INFO) << "NN-Descent finished!";
+
+  const vector<KNN> &nn = nndesObj->getNN();
+  nnOffsets_.assign(1, 0);
+  nnIds_.clear();
+  for (const KNN& knn: nn) {
+    for (const KNNEntry& e: knn) {
+      if (e.key != KNNEntry::BAD) nnIds_.push_back(e.key);
+    }
+    nnOffsets_.push_back(nnIds_.size());
+  }
+}
+
+template <typename dist_t>
+void NNDescentMethod<dist_t>::ExportGraph(const string& location) const {
+  ofstream out(location.c_str(), ios::binary | ios::trunc);
+  if (!out) throw runtime_error("Cannot open the graph file for writing: " + location);
+
+  out.write(KGRAPH_MAGIC, KGRAPH_MAGIC_SIZE);
+  WriteBinaryPOD(out, KGRAPH_VERSION_MAJOR);
+  WriteBinaryPOD(out, KGRAPH_VERSION_MINOR);
+  WriteBinaryPOD(out, static_cast<uint32_t>(data_.size()));
+  for (size_t i = 0; i < data_.size(); ++i) {
+    uint32_t K = nnOffsets_[i + 1] - nnOffsets_[i];
+    WriteBinaryPOD(out, K); // M
+    WriteBinaryPOD(out, K);
+    for (size_t k = nnOffsets_[i]; k < nnOffsets_[i + 1]; ++k) {
+      WriteBinaryPOD(out, static_cast<uint32_t>(nnIds_[k]));
+    }
+  }
+  out.close();
+  if (!out) throw runtime_error("Error writing the graph file: " + location);
+
+  LOG(LIB_INFO) << "The knn-graph (" << nnIds_.size() << " edges) is exported to " << location;
+}
+
+template <typename dist_t>
+void NNDescentMethod<dist_t>::ImportGraph(const string& location) {
+  ifstream in(location.c_str(), ios::binary);
+  if (!in) throw runtime_error("Cannot open the graph file for reading: " + location);
+
+  char      magic[KGRAPH_MAGIC_SIZE];
+  uint32_t  major, minor, N;
+  if (!in.read(magic, KGRAPH_MAGIC_SIZE) || memcmp(magic, KGRAPH_MAGIC, KGRAPH_MAGIC_SIZE)) {
+    throw runtime_error("Not a KGraph knn-graph file: " + location);
+  }
+  ReadBinaryPOD(in, major);
+  ReadBinaryPOD(in, minor);
+  if (major != KGRAPH_VERSION_MAJOR) {
+    stringstream err;
+    err << "Unsupported version of the knn-graph file: " << major << "." << minor;
+    throw runtime_error(err.str());
+  }
+  ReadBinaryPOD(in, N);
+  if (N != data_.size()) {
+    stringstream err;
+    err << "The knn-graph has " << N << " nodes, the data set has " << data_.size() << " objects";
+    throw runtime_error(err.str());
+  }
+
+  vector<uint32_t>  ids;
+  size_t            maxK = 0;
+  nnOffsets_.assign(1, 0);
+  nnIds_.clear();
+  for (size_t i = 0; i < N; ++i) {
+    uint32_t M, K;
+    ReadBinaryPOD(in, M);
+    ReadBinaryPOD(in, K);
+    ids.resize(K);
+    if (K && !in.read(reinterpret_cast<char*>(&ids[0]), K * sizeof(uint32_t))) {
+      throw runtime_error("The knn-graph file is corrupt: " + location);
+    }
+    // Only the first M neighbors are used in search
+    M = min(M, K);
+    for (size_t k = 0; k < M; ++k) {
+      if (ids[k] >= N) throw runtime_error("The knn-graph file is corrupt: " + location);
+      nnIds_.push_back(ids[k]);
+    }
+    nnOffsets_.push_back(nnIds_.size());
+    maxK = max<size_t>(maxK, M);
+  }
+  NN_ = maxK;
+
+  LOG(LIB_INFO) << "The knn-graph (" << nnIds_.size() << " edges) is imported from " << location;
+  LOG(LIB_INFO) << "NN (the largest number of neighbors) = " << NN_;
+}
+
+template <typename dist_t>
+void NNDescentMethod<dist_t>::SaveIndex(const string& location) {
+  ofstream out(location.c_str(), ios::binary | ios::trunc);
+  if (!out) throw runtime_error("Cannot open the index file for writing: " + location);
+
+  vector<uint64_t> offsets(nnOffsets_.begin(), nnOffsets_.end());
+
+  WriteIndexHeader(out, METH_NNDES, data_);
+  WriteBinaryPOD(out, static_cast<uint64_t>(NN_));
+  WriteBinaryVector(out, offsets);
+  WriteBinaryVector(out, nnIds_);
+  out.close();
+
+  LOG(LIB_INFO) << "The knn-graph (" << nnIds_.size() << " edges) is saved to " << location;
+}
+
+template <typename dist_t>
+void NNDescentMethod<dist_t>::LoadIndex(const string& location) {
+  ifstream in(location.c_str(), ios::binary);
+  if (!in) throw runtime_error("Cannot open the index file for reading: " + location);
+
+  ReadIndexHeader(in, METH_NNDES, data_);
+
+  uint64_t          NN;
+  vector<uint64_t>  offsets;
+  vector<IdType>    ids;
+  ReadBinaryPOD(in, NN);
+  ReadBinaryVector(in, offsets);
+  ReadBinaryVector(in, ids);
+
+  if (offsets.size() != data_.size() + 1 || offsets.front() != 0 || offsets.back() != ids.size()) {
+    throw runtime_error("The index file is corrupt: " + location);
+  }
+  for (size_t i = 0; i < data_.size(); ++i) {
+    if (offsets[i] > offsets[i + 1]) {
+      throw runtime_error("The index file is corrupt: " + location);
+    }
+  }
+  for (IdType id: ids) {
+    if (id < 0 || static_cast<size_t>(id) >= data_.size()) {
+      throw runtime_error("The index file is corrupt: " + location);
+    }
+  }
+
+  nnOffsets_.assign(offsets.begin(), offsets.end());
+  nnIds_.swap(ids);
+  NN_ = NN;
+
+  LOG(LIB_INFO) << "The knn-graph (" << nnIds_.size() << " edges) is loaded from " << location;
+  LOG(LIB_INFO) << "NN (as in the index file) = " << NN_;
 }
 
 template <typename dist_t>
@@ -148,15 +416,37 @@ void NNDescentMethod<dist_t>::Search(KNNQuery<dist_t>* query) {
   greedy_ ? SearchGreedy(query) : SearchSmallWorld(query);
 }
 
+template <typename dist_t>
+SearchContextSW<dist_t>* NNDescentMethod<dist_t>::acquireSearchContext() const {
+  unique_lock<mutex> lock(searchContextGuard_);
+  if (searchContexts_.empty()) return new SearchContextSW<dist_t>();
+  SearchContextSW<dist_t>* context = searchContexts_.back();
+  searchContexts_.pop_back();
+  return context;
+}
+
+template <typename dist_t>
+void NNDescentMethod<dist_t>::releaseSearchContext(SearchContextSW<dist_t>* context) const {
+  unique_lock<mutex> lock(searchContextGuard_);
+  searchContexts_.push_back(context);
+}
+
+/*
+ * The visited marks and the heaps come from a reusable search context,
+ * so a query allocates nothing.
+ */
 template <typename dist_t>
 void NNDescentMethod<dist_t>::SearchSmallWorld(KNNQuery<dist_t>* query) {
-  const vector<KNN> &nn = nndesObj_->getNN();
+  typedef typename SearchContextSW<dist_t>::EvaluatedNode EvaluatedNode;
+  typename SearchContextSW<dist_t>::CloserNode            closer;
+
+  if (data_.empty()) return;
 
-#if USE_BITSET_FOR_SEARCHING
-  vector<bool>                      visitedBitset(data_.size());
-#else
-  unordered_set <IdType>            visitedNodes;
-#endif
+  unique_ptr<SearchContextSW<dist_t>> context(acquireSearchContext());
+  context->start(data_.size(), searchNN_);
+
+  vector<dist_t>&         closestDist = context->closestDist_; //The set of all elements which distance was calculated
+  vector<EvaluatedNode>&  candidates = context->candidates_; //the set of elements which we can use to evaluate
 
   for (size_t i=0; i < initSearchAttempts_; i++) {
   /**
@@ -164,71 +454,59 @@ void NNDescentMethod<dist_t>::SearchSmallWorld(KNNQuery<dist_t>* query) {
    */
     IdType randPoint = RandomInt() % data_.size();
 
-    priority_queue <dist_t>             closestDistQueue; //The set of all elements which distance was calculated
-    priority_queue <EvaluatedNode>      candidateSet; //the set of elements which we can use to evaluate
+    closestDist.clear();
+    candidates.clear();
 
     const Object* currObj = data_[randPoint];
     dist_t         d = query->DistanceObjLeft(currObj);
     query->CheckAndAddToResult(d, currObj);
     
-    EvaluatedNode  ev(-d, randPoint);
-
-    candidateSet.push(ev);
-    closestDistQueue.push(d);
-#if USE_BITSET_FOR_SEARCHING
-    visitedBitset[randPoint] = true;
-#else
-    visitedNodes.insert(randPoint);
-#endif
+    candidates.push_back(EvaluatedNode(d, randPoint));
+    closestDist.push_back(d);
+    context->visit(randPoint);
 
-    while(!candidateSet.empty()){
-      const EvaluatedNode& currEv = candidateSet.top();
-      dist_t lowerBound = closestDistQueue.top();
+    while(!candidates.empty()){
+      const EvaluatedNode& currEv = candidates.front();
+      dist_t lowerBound = closestDist.front();
 
       // Did we reach a local minimum?
-      if ((-currEv.first) > lowerBound) {
+      if (currEv.first > lowerBound) {
         break;
       }
 
       IdType currEvId = currEv.second;
 
       // Can't access curEv anymore! The reference would become invalid
-      candidateSet.pop();
+      pop_heap(candidates.begin(), candidates.end(), closer);
+      candidates.pop_back();
 
       //calculate distance to each neighbor
-      for (const KNNEntry& e: nn[currEvId]) {
-        IdType currNew = e.key;
-        if (currNew == KNNEntry::BAD) continue;
-
-#if USE_BITSET_FOR_SEARCHING
-        if (!visitedBitset[currNew]) {
-          visitedBitset[currNew] = true;
-#else
-        if (visitedNodes.find(currNew) == visitedNodes.end()){
-            visitedNodes.insert(currNew);
-#endif
-
-            currObj = data_[currNew];
-            d = query->DistanceObjLeft(currObj);
-            query->CheckAndAddToResult(d, currObj);
-            EvaluatedNode  evE1(-d, currNew);
-
-            closestDistQueue.push(d);
-            if (closestDistQueue.size() > searchNN_) { 
-              closestDistQueue.pop(); 
-            }
-            candidateSet.push(evE1);
+      for (size_t k = nnOffsets_[currEvId]; k < nnOffsets_[currEvId + 1]; ++k) {
+        IdType currNew = nnIds_[k];
+
+        if (context->visit(currNew)) {
+          currObj = data_[currNew];
+          d = query->DistanceObjLeft(currObj);
+          query->CheckAndAddToResult(d, currObj);
+
+          closestDist.push_back(d);
+          push_heap(closestDist.begin(), closestDist.end());
+          if (closestDist.size() > searchNN_) { 
+            pop_heap(closestDist.begin(), closestDist.end());
+            closestDist.pop_back();
           }
+          candidates.push_back(EvaluatedNode(d, currNew));
+          push_heap(candidates.begin(), candidates.end(), closer);
+        }
       }
     }
   }
+  releaseSearchContext(context.release());
 }
 
 
 template <typename dist_t>
 void NNDescentMethod<dist_t>::SearchGreedy(KNNQuery<dist_t>* query) {
-  const vector<KNN> &nn = nndesObj_->getNN();
-
   for (size_t i=0; i < initSearchAttempts_; i++) {
     IdType curr = RandomInt() % data_.size();
 
@@ -241,15 +519,13 @@ void NNDescentMethod<dist_t>::SearchGreedy(KNNQuery<dist_t>* query) {
     do {
       currOld = curr;
       // Iterate over neighbors
-      for (const KNNEntry&e: nn[currOld]) {
-        IdType currNew = e.key;
-        if (currNew != KNNEntry::BAD) {
-          dist_t currDistNew = query->DistanceObjLeft(data_[currNew]);
-          query->CheckAndAddToResult(currDistNew, data_[currNew]);
-          if (currDistNew < currDist) {
-            curr = currNew;
-            currDist = currDistNew;
-          }
+      for (size_t k = nnOffsets_[currOld]; k < nnOffsets_[currOld + 1]; ++k) {
+        IdType currNew = nnIds_[k];
+        dist_t currDistNew = query->DistanceObjLeft(data_[currNew]);
+        query->CheckAndAddToResult(currDistNew, data_[currNew]);
+        if (currDistNew < currDist) {
+          curr = currNew;
+          currDist = currDistNew;
         }
       }
     } while (currOld != curr);
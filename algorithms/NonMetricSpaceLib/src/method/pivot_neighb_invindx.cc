@@ -16,16 +16,23 @@
 
 #include <algorithm>
 #include <sstream>
+#include <fstream>
 #include <thread>
 #include <memory>
+#include <limits>
 #include <unordered_map>
 
 #include "space.h"
 #include "rangequery.h"
 #include "knnquery.h"
-#include "incremental_quick_select.h"
 #include "method/pivot_neighb_invindx.h"
 #include "utils.h"
+#include "index_io.h"
+#include "simdutils.h"
+
+#ifdef PORTABLE_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace similarity {
 
@@ -143,12 +150,21 @@ PivotNeighbInvertedIndex<dist_t>::PivotNeighbInvertedIndex(
 
   pmgr.GetParamOptional("indexThreadQty", index_thread_qty_);
 
+  string saveLocation, loadLocation;
+  pmgr.GetParamOptional(PARAM_SAVE_INDEX, saveLocation);
+  pmgr.GetParamOptional(PARAM_LOAD_INDEX, loadLocation);
+
   if (num_prefix_ > num_pivot_) {
     LOG(LIB_FATAL) << METH_PIVOT_NEIGHB_INVINDEX << " requires that numPrefix "
                << "should be less than or equal to numPivot";
   }
 
   CHECK(num_prefix_ <= num_pivot_);
+
+  if (num_prefix_ > numeric_limits<uint16_t>::max()) {
+    LOG(LIB_FATAL) << METH_PIVOT_NEIGHB_INVINDEX << " requires that numPrefix "
+               << "should be less than or equal to " << numeric_limits<uint16_t>::max();
+  }
   
   size_t indexQty = (data_.size() + chunk_index_size_ - 1) / chunk_index_size_;
 
@@ -156,6 +172,11 @@ PivotNeighbInvertedIndex<dist_t>::PivotNeighbInvertedIndex(
 
   pmgr.CheckUnused();
 
+  if (!loadLocation.empty()) {
+    LoadIndex(loadLocation);
+    return;
+  }
+
   LOG(LIB_INFO) << "# of entries in an index chunk  = " << chunk_index_size_;
   LOG(LIB_INFO) << "# of index chunks             = " << indexQty;
   LOG(LIB_INFO) << "# of indexing thread          = " << index_thread_qty_;
@@ -175,7 +196,7 @@ PivotNeighbInvertedIndex<dist_t>::PivotNeighbInvertedIndex(
    * it is thread-safe to index each chunk separately.
    */
   for (size_t chunkId = 0; chunkId < indexQty; ++chunkId) {
-    posting_lists_[chunkId] = shared_ptr<vector<PostingListInt>>(new vector<PostingListInt>());
+    posting_lists_[chunkId] = shared_ptr<vector<PackedPostingList>>(new vector<PackedPostingList>());
   }
 
   // Don't need more thread than you have chunks
@@ -222,6 +243,147 @@ PivotNeighbInvertedIndex<dist_t>::PivotNeighbInvertedIndex(
       (*progress_bar) += (progress_bar->expected_count() - progress_bar->count());
     }
   }
+
+  size_t postQty = 0, memUsage = 0;
+  for (const auto& chunk: posting_lists_) {
+    for (const PackedPostingList& lst: *chunk) {
+      postQty  += lst.size();
+      memUsage += lst.MemUsage();
+    }
+  }
+  LOG(LIB_INFO) << "Posting lists use " << memUsage / (1024.0 * 1024) << " MB"
+                << " (" << postQty * sizeof(int) / (1024.0 * 1024) << " MB uncompressed)";
+
+  if (!saveLocation.empty()) SaveIndex(saveLocation);
+}
+
+template <typename dist_t>
+SearchContextNAPP* PivotNeighbInvertedIndex<dist_t>::acquireSearchContext() const {
+  unique_lock<mutex> lock(searchContextGuard_);
+  if (searchContexts_.empty()) return new SearchContextNAPP();
+  SearchContextNAPP* context = searchContexts_.back();
+  searchContexts_.pop_back();
+  return context;
+}
+
+template <typename dist_t>
+void PivotNeighbInvertedIndex<dist_t>::releaseSearchContext(SearchContextNAPP* context) const {
+  unique_lock<mutex> lock(searchContextGuard_);
+  searchContexts_.push_back(context);
+}
+
+/*
+ * Pivots are stored as positions in the data set. The posting lists
+ * of each chunk are stored in the CSR format: the list of the pivot p
+ * is ids[offsets[p]] ... ids[offsets[p+1]-1].
+ */
+template <typename dist_t>
+void PivotNeighbInvertedIndex<dist_t>::SaveIndex(const string& location) {
+  ofstream out(location.c_str(), ios::binary | ios::trunc);
+  if (!out) throw runtime_error("Cannot open the index file for writing: " + location);
+
+  std::unordered_map<const Object*, IdType> objPos;
+  for (size_t i = 0; i < data_.size(); ++i) {
+    objPos[data_[i]] = static_cast<IdType>(i);
+  }
+  vector<IdType> pivotPos;
+  for (const Object* p: pivot_) {
+    CHECK(objPos.count(p));
+    pivotPos.push_back(objPos[p]);
+  }
+
+  WriteIndexHeader(out, METH_PIVOT_NEIGHB_INVINDEX, data_);
+  WriteBinaryPOD(out, static_cast<uint64_t>(chunk_index_size_));
+  WriteBinaryPOD(out, static_cast<uint64_t>(num_prefix_));
+  WriteBinaryVector(out, pivotPos);
+  WriteBinaryPOD(out, static_cast<uint64_t>(posting_lists_.size()));
+
+  vector<uint64_t>  offsets;
+  vector<int>       ids;
+  PostingListInt    lst;
+  for (const auto& chunk: posting_lists_) {
+    offsets.assign(1, 0);
+    ids.clear();
+    for (const PackedPostingList& packed: *chunk) {
+      packed.Decode(lst);
+      ids.insert(ids.end(), lst.begin(), lst.end());
+      offsets.push_back(ids.size());
+    }
+    WriteBinaryVector(out, offsets);
+    WriteBinaryVector(out, ids);
+  }
+  out.close();
+
+  LOG(LIB_INFO) << "The index is saved to " << location;
+}
+
+template <typename dist_t>
+void PivotNeighbInvertedIndex<dist_t>::LoadIndex(const string& location) {
+  ifstream in(location.c_str(), ios::binary);
+  if (!in) throw runtime_error("Cannot open the index file for reading: " + location);
+
+  ReadIndexHeader(in, METH_PIVOT_NEIGHB_INVINDEX, data_);
+
+  uint64_t        chunkIndexSize, numPrefix, indexQty;
+  vector<IdType>  pivotPos;
+  ReadBinaryPOD(in, chunkIndexSize);
+  ReadBinaryPOD(in, numPrefix);
+  ReadBinaryVector(in, pivotPos);
+  ReadBinaryPOD(in, indexQty);
+
+  if (!chunkIndexSize || numPrefix > pivotPos.size() ||
+      indexQty != (data_.size() + chunkIndexSize - 1) / chunkIndexSize) {
+    throw runtime_error("The index file is corrupt: " + location);
+  }
+
+  chunk_index_size_ = chunkIndexSize;
+  num_prefix_       = numPrefix;
+  num_pivot_        = pivotPos.size();
+
+  pivot_.clear();
+  for (IdType p: pivotPos) {
+    if (p < 0 || static_cast<size_t>(p) >= data_.size()) {
+      throw runtime_error("The index file is corrupt: " + location);
+    }
+    pivot_.push_back(data_[p]);
+  }
+
+  vector<uint64_t>  offsets;
+  vector<int>       ids;
+  PostingListInt    lst;
+  posting_lists_.resize(indexQty);
+  for (size_t chunkId = 0; chunkId < indexQty; ++chunkId) {
+    size_t chunkQty = min(data_.size(), (chunkId + 1) * chunk_index_size_) - chunkId * chunk_index_size_;
+
+    ReadBinaryVector(in, offsets);
+    ReadBinaryVector(in, ids);
+    if (offsets.size() != num_pivot_ + 1 || offsets.back() != ids.size()) {
+      throw runtime_error("The index file is corrupt: " + location);
+    }
+    posting_lists_[chunkId] = shared_ptr<vector<PackedPostingList>>(new vector<PackedPostingList>(num_pivot_));
+    auto & chunkPostLists = *posting_lists_[chunkId];
+    for (size_t p = 0; p < num_pivot_; ++p) {
+      if (offsets[p] > offsets[p + 1]) {
+        throw runtime_error("The index file is corrupt: " + location);
+      }
+      lst.assign(ids.begin() + offsets[p], ids.begin() + offsets[p + 1]);
+      for (size_t i = 0; i < lst.size(); ++i) {
+        if (lst[i] < 0 || static_cast<size_t>(lst[i]) >= chunkQty || (i && lst[i] <= lst[i - 1])) {
+          throw runtime_error("The index file is corrupt: " + location);
+        }
+      }
+      chunkPostLists[p].Encode(lst);
+    }
+  }
+
+  LOG(LIB_INFO) << "The index is loaded from " << location;
+  LOG(LIB_INFO) << "# of entries in an index chunk  = " << chunk_index_size_;
+  LOG(LIB_INFO) << "# of index chunks             = " << indexQty;
+  LOG(LIB_INFO) << "# pivots                      = " << num_pivot_;
+  LOG(LIB_INFO) << "# pivots to index (numPrefix) = " << num_prefix_;
+  LOG(LIB_INFO) << "# pivots to search (minTimes) = " << min_times_;
+  LOG(LIB_INFO) << "# dbScanFrac              = " << db_scan_frac_;
+  LOG(LIB_INFO) << "# knnAmp                  = " << knn_amp_;
 }
 
 template <typename dist_t>
@@ -231,8 +393,7 @@ PivotNeighbInvertedIndex<dist_t>::IndexChunk(size_t chunkId, ProgressDisplay* pr
   size_t maxId = min(data_.size(), minId + chunk_index_size_);
 
 
-  auto & chunkPostLists = *posting_lists_[chunkId];
-  chunkPostLists.resize(num_pivot_);
+  vector<PostingListInt> chunkPostLists(num_pivot_);
 
   for (size_t id = 0; id < maxId - minId; ++id) {
     Permutation perm;
@@ -247,9 +408,12 @@ PivotNeighbInvertedIndex<dist_t>::IndexChunk(size_t chunkId, ProgressDisplay* pr
     }
   }
 
-  // Sorting is essential for merging algos
-  for (auto & p:chunkPostLists) {
-    sort(p.begin(), p.end());
+  // Sorting is essential for merging algos and for the compression
+  auto & packedPostLists = *posting_lists_[chunkId];
+  packedPostLists.resize(num_pivot_);
+  for (size_t p = 0; p < num_pivot_; ++p) {
+    sort(chunkPostLists[p].begin(), chunkPostLists[p].end());
+    packedPostLists[p].Encode(chunkPostLists[p]);
   }
 }
     
@@ -319,6 +483,7 @@ PivotNeighbInvertedIndex<dist_t>::GetQueryTimeParamNames() const {
 
 template <typename dist_t>
 PivotNeighbInvertedIndex<dist_t>::~PivotNeighbInvertedIndex() {
+  for (SearchContextNAPP* context: searchContexts_) delete context;
 }
 
 template <typename dist_t>
@@ -328,6 +493,59 @@ const string PivotNeighbInvertedIndex<dist_t>::ToString() const {
   return str.str();
 }
 
+/*
+ * Appends the positions of the counters that are >= minQty to res.
+ * Most counters are small, so the SIMD versions compare sixteen
+ * counters at a time and rarely find anything.
+ */
+template <typename CounterType>
+void thresholdScan(const CounterType* counter, size_t qty, CounterType minQty, vector<IdType>& res) {
+  for (size_t i = 0; i < qty; ++i) {
+    if (counter[i] >= minQty) res.push_back(i);
+  }
+}
+
+#ifdef PORTABLE_SSE2
+inline void appendMaskPositions(unsigned mask, size_t start, vector<IdType>& res) {
+  while (mask) {
+    res.push_back(start + __builtin_ctz(mask));
+    mask &= mask - 1;
+  }
+}
+
+// counter >= minQty iff the saturated difference minQty - counter is zero
+template <>
+void thresholdScan(const uint8_t* counter, size_t qty, uint8_t minQty, vector<IdType>& res) {
+  const __m128i thresh = _mm_set1_epi8(static_cast<char>(minQty));
+  const __m128i zero   = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= qty; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counter + i));
+    appendMaskPositions(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(thresh, v), zero)), i, res);
+  }
+  for (; i < qty; ++i) {
+    if (counter[i] >= minQty) res.push_back(i);
+  }
+}
+
+template <>
+void thresholdScan(const uint16_t* counter, size_t qty, uint16_t minQty, vector<IdType>& res) {
+  const __m128i thresh = _mm_set1_epi16(static_cast<short>(minQty));
+  const __m128i zero   = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= qty; i += 16) {
+    __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counter + i));
+    __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counter + i + 8));
+    __m128i r  = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_subs_epu16(thresh, v1), zero),
+                                 _mm_cmpeq_epi16(_mm_subs_epu16(thresh, v2), zero));
+    appendMaskPositions(_mm_movemask_epi8(r), i, res);
+  }
+  for (; i < qty; ++i) {
+    if (counter[i] >= minQty) res.push_back(i);
+  }
+}
+#endif
+
 template <typename dist_t>
 template <typename QueryType>
 void PivotNeighbInvertedIndex<dist_t>::GenSearch(QueryType* query, size_t K) {
@@ -343,11 +561,49 @@ void PivotNeighbInvertedIndex<dist_t>::GenSearch(QueryType* query, size_t K) {
 
   size_t db_scan = computeDbScan(K);
 
+  if (use_sort_ && !db_scan) {
+    stringstream err;
+    err << "One should specify a proper value for either dbScanFrac or knnAmp" <<
+           " currently, dbScanFrac=" << db_scan_frac_ << " knnAmp=" << knn_amp_;
+    throw runtime_error(err.str());
+  }
+
   Permutation perm_q;
   GetPermutationPPIndex(pivot_, query, &perm_q);
 
-  vector<unsigned>          counter(chunk_index_size_);
+  unique_ptr<SearchContextNAPP> context(acquireSearchContext());
+
+  if (num_prefix_ <= numeric_limits<uint8_t>::max()) {
+    GenSearchChunks(query, db_scan, perm_q, context->counter8_, *context);
+  } else {
+    GenSearchChunks(query, db_scan, perm_q, context->counter16_, *context);
+  }
+
+  releaseSearchContext(context.release());
+}
 
+/*
+ * An object is a candidate if it appears in at least min_times_ posting
+ * lists of the query pivots. With useSort, only the db_scan candidates
+ * (per chunk) that appear in the largest number of lists are checked. Instead of
+ * sorting, the counters are compared with a threshold found using hist_: objects
+ * with counters >= fullQty are all checked, the remaining slots are given to
+ * objects with counters == fullQty - 1 (in the order of ids).
+ */
+template <typename dist_t>
+template <typename CounterType, typename QueryType>
+void PivotNeighbInvertedIndex<dist_t>::GenSearchChunks(QueryType* query, size_t db_scan,
+                                                       const Permutation& perm_q,
+                                                       vector<CounterType>& counter,
+                                                       SearchContextNAPP& context) {
+  const size_t counterQty = min(chunk_index_size_, data_.size());
+  if (counter.size() != counterQty) counter.assign(counterQty, 0);
+
+  CounterType*      pCounter = counter.empty() ? NULL : &counter[0];
+  vector<uint32_t>& hist     = context.hist_;
+  vector<IdType>&   touched  = context.touched_;
+  vector<IdType>&   cand     = context.cand_;
+  ObjectVector&     candObjs = context.candObjs_;
 
   for (size_t chunkId = 0; chunkId < posting_lists_.size(); ++chunkId) {
     const auto & chunkPostLists = *posting_lists_[chunkId];
@@ -357,130 +613,90 @@ void PivotNeighbInvertedIndex<dist_t>::GenSearch(QueryType* query, size_t K) {
 
     const auto data_start = &data_[0] + minId;
 
-    if (use_sort_) {
-      if (!db_scan) {
-        stringstream err;
-        err << "One should specify a proper value for either dbScanFrac or knnAmp" <<
-               " currently, dbScanFrac=" << db_scan_frac_ << " knnAmp=" << knn_amp_;
-        throw runtime_error(err.str());
-      }
-      vector<pair<int, size_t>> candidates;
-
-      if (inv_proc_alg_ == kMap) {
-        std::unordered_map<uint32_t, uint32_t> map_counter;
-        for (size_t i = 0; i < num_prefix_; ++i) {
-          for (auto& p : chunkPostLists[perm_q[i]]) {
-            map_counter[p]++;
-          }
+    hist.assign(num_prefix_ + 2, 0);
+    touched.clear();
+
+    /*
+     * The histogram is needed only to select the best candidates. Updating
+     * it is not free: the same few elements are incremented over and over.
+     */
+    if (inv_proc_alg_ == kScan) {//this way
+      for (size_t i = 0; i < num_prefix_; ++i) {
+        if (use_sort_) {
+          chunkPostLists[perm_q[i]].ForEach([&](uint32_t id) { ++hist[++pCounter[id]]; });
+        } else {
+          chunkPostLists[perm_q[i]].ForEach([&](uint32_t id) { ++pCounter[id]; });
         }
+      }
+      hist[0] = chunkQty;
+    } else if (inv_proc_alg_ == kMap) {
+      for (size_t i = 0; i < num_prefix_; ++i) {
+        chunkPostLists[perm_q[i]].ForEach([&](uint32_t id) {
+          if (!pCounter[id]) touched.push_back(id);
+          if (use_sort_) ++hist[pCounter[id] + 1];
+          ++pCounter[id];
+        });
+      }
+      hist[0] = touched.size();
+    } else if (inv_proc_alg_ == kMerge) {
+      VectIdCount   tmpRes[2];
+      unsigned      prevRes = 0;
+
+      for (size_t i = 0; i < num_prefix_; ++i) {
+        chunkPostLists[perm_q[i]].Decode(context.postList_);
+        postListUnion(tmpRes[prevRes], context.postList_, tmpRes[1-prevRes]);
+        prevRes = 1 - prevRes;
+      }
 
-        candidates.reserve(db_scan);
-
-        for (auto& it : map_counter) {
-          if (it.second >= min_times_) {
-            candidates.push_back(std::make_pair(-static_cast<int>(it.second), it.first));
-          }
-        }
-      } else if (inv_proc_alg_ == kScan) {//this way
-        candidates.resize(chunkQty);
+      for (const auto& it: tmpRes[1-prevRes]) {
+        touched.push_back(it.id);
+        pCounter[it.id] = it.qty;
+        for (size_t c = 1; c <= it.qty; ++c) ++hist[c];
+      }
+      hist[0] = touched.size();
+    } else {
+      LOG(LIB_FATAL) << "Bug, unknown inv_proc_alg_: " << inv_proc_alg_;
+    }
 
-        for (size_t i = 0; i < candidates.size(); ++i) {
-          candidates[i].second = i;
-        }
-        for (size_t i = 0; i < num_prefix_; ++i) {
-          for (auto& p : chunkPostLists[perm_q[i]]) {
-            candidates[p].first--;
-          }
-        }
-      } else if (inv_proc_alg_ == kMerge) {
-        VectIdCount   tmpRes[2];
-        unsigned      prevRes = 0;
+    const size_t minQty = min(min_times_, num_prefix_ + 1);
+    size_t       fullQty = minQty;
+    size_t       tieQty = 0;
 
-        for (size_t i = 0; i < num_prefix_; ++i) {
-          postListUnion(tmpRes[prevRes], chunkPostLists[perm_q[i]], tmpRes[1-prevRes]);
-          prevRes = 1 - prevRes;
-        }
+    if (use_sort_) {
+      // hist[num_prefix_ + 1] is zero
+      while (hist[fullQty] > db_scan) ++fullQty;
+      if (fullQty > minQty) tieQty = db_scan - hist[fullQty];
+    }
 
-        candidates.reserve(db_scan);
+    const size_t lowQty = tieQty ? fullQty - 1 : fullQty;
 
-        for (const auto& it: tmpRes[1-prevRes]) {
-          if (it.qty >= min_times_) {
-            candidates.push_back(std::make_pair(-static_cast<int>(it.qty), it.id));
-          }
-        }
+    candObjs.clear();
+    if (lowQty <= num_prefix_) {
+      cand.clear();
+      if (inv_proc_alg_ == kScan) {
+        thresholdScan(pCounter, chunkQty, static_cast<CounterType>(lowQty), cand);
       } else {
-        LOG(LIB_FATAL) << "Bug, unknown inv_proc_alg_: " << inv_proc_alg_;
-      }
-
-      IncrementalQuickSelect<IntInt> quick_select(candidates);
-      size_t scan_qty = min(db_scan, candidates.size());
-      for (size_t i = 0; i < scan_qty; ++i) {
-        auto z = quick_select.GetNext();
-        if (static_cast<size_t>(-z.first) >= min_times_) {
-          const size_t idx = z.second;
-          quick_select.Next();
-          if (!skip_checking_) 
-		  {
-			  query->CheckAndAddToResult(data_start[idx]);
-		  }
-        } else {
-          break;
+        for (IdType id: touched) {
+          if (pCounter[id] >= lowQty) cand.push_back(id);
         }
       }
-    } else {
-      if (inv_proc_alg_ == kMap) {
-        std::unordered_map<uint32_t, uint32_t> map_counter;
-        for (size_t i = 0; i < num_prefix_; ++i) {
-          for (auto& p : chunkPostLists[perm_q[i]]) {
-            map_counter[p]++;
-          }
-        }
-        for (auto& it : map_counter) {
-          if (it.second >= min_times_) {
-            const size_t idx = it.first;
-            if (!skip_checking_) 
-			{
-				query->CheckAndAddToResult(data_start[idx]);
-			}
-          }
-        }
-      } else if (inv_proc_alg_ == kScan) {
-        if (chunkId) {
-          memset(&counter[0], 0, sizeof(counter[0])*counter.size());
-        }
-        for (size_t i = 0; i < num_prefix_; ++i) {
-          for (auto& p : chunkPostLists[perm_q[i]]) {
-            counter[p]++;
-          }
-        }
-        for (size_t i = 0; i < chunkQty; ++i) {
-          if (counter[i] >= min_times_) {
-            if (!skip_checking_)
-			{
-				query->CheckAndAddToResult(data_start[i]);
-			}
-          }
-        }
-      } else if (inv_proc_alg_ == kMerge) {
-        VectIdCount   tmpRes[2];
-        unsigned      prevRes = 0;
-        for (size_t i = 0; i < num_prefix_; ++i) {
-          postListUnion(tmpRes[prevRes], chunkPostLists[perm_q[i]], tmpRes[1-prevRes]);
-          prevRes = 1 - prevRes;
+      for (IdType id: cand) {
+        if (pCounter[id] >= fullQty) {
+          candObjs.push_back(data_start[id]);
+        } else if (tieQty) {
+          --tieQty;
+          candObjs.push_back(data_start[id]);
         }
-
-        for (const auto& it: tmpRes[1-prevRes]) {
-          if (it.qty >= min_times_) {
-            if (!skip_checking_)
-			{
-				 query->CheckAndAddToResult(data_start[it.id]);
-			}
-          }
-        }
-      } else {
-        LOG(LIB_FATAL) << "Bug, unknown inv_proc_alg_: " << inv_proc_alg_;
       }
     }
+
+    if (inv_proc_alg_ == kScan) {
+      memset(pCounter, 0, sizeof(CounterType) * chunkQty);
+    } else {
+      for (IdType id: touched) pCounter[id] = 0;
+    }
+
+    if (!skip_checking_) query->CheckAndAddToResult(candObjs);
   }
 }
 
@@ -47,17 +47,13 @@ SeqSearch<dist_t>::~SeqSearch() {
 template <typename dist_t>
 void SeqSearch<dist_t>::Search(RangeQuery<dist_t>* query) {
   const ObjectVector& data = pData_ != NULL ? *pData_ : origData_;
-  for (size_t i = 0; i < data.size(); ++i) {
-    query->CheckAndAddToResult(data[i]);
-  }
+  query->CheckAndAddToResult(data);
 }
 
 template <typename dist_t>
 void SeqSearch<dist_t>::Search(KNNQuery<dist_t>* query) {
   const ObjectVector& data = pData_ != NULL ? *pData_ : origData_;
-  for (size_t i = 0; i < data.size(); ++i) {
-    query->CheckAndAddToResult(data[i]);
-  }
+  query->CheckAndAddToResult(data);
 }
 
 template class SeqSearch<float>;
@@ -22,11 +22,13 @@
 #include "rangequery.h"
 #include "ported_boost_progress.h"
 #include "method/small_world_rand.h"
+#include "index_io.h"
 
 #include <vector>
 #include <set>
 #include <map>
 #include <sstream>
+#include <fstream>
 #include <typeinfo>
 
 #ifdef _OPENMP
@@ -119,12 +121,25 @@ SmallWorldRand<dist_t>::SmallWorldRand(bool PrintProgress,
   pmgr.GetParamOptional("initSearchAttempts", initSearchAttempts_);
   pmgr.GetParamOptional("indexThreadQty",     indexThreadQty_);
 
+  string saveLocation, loadLocation;
+  pmgr.GetParamOptional(PARAM_SAVE_INDEX, saveLocation);
+  pmgr.GetParamOptional(PARAM_LOAD_INDEX, loadLocation);
+
   LOG(LIB_INFO) << "NN                  = " << NN_;
   LOG(LIB_INFO) << "initIndexAttempts   = " << initIndexAttempts_;
   LOG(LIB_INFO) << "initSearchAttempts  = " << initSearchAttempts_;
   LOG(LIB_INFO) << "indexThreadQty      = " << indexThreadQty_;
 
-  if (data.empty()) return;
+  if (!loadLocation.empty()) {
+    LoadIndex(loadLocation);
+    return;
+  }
+
+  if (data.empty()) {
+    freeze();
+    if (!saveLocation.empty()) SaveIndex(saveLocation);
+    return;
+  }
 
   // 2) One entry should be added before all the threads are started, or else add() will not work properly
   addCriticalSection(new MSWNode(data[0], 0 /* id == 0 */));
@@ -165,6 +180,92 @@ SmallWorldRand<dist_t>::SmallWorldRand(bool PrintProgress,
     }
     LOG(LIB_INFO) << indexThreadQty_ << " indexing threads have finished";
   }
+
+  freeze();
+
+  if (!saveLocation.empty()) SaveIndex(saveLocation);
+}
+
+template <typename dist_t>
+void SmallWorldRand<dist_t>::freeze() {
+  vector<MSWNode*> nodes(data_.size());
+  for (MSWNode* node: ElList_) {
+    CHECK(node->getId() < nodes.size());
+    nodes[node->getId()] = node;
+  }
+
+  friendOffsets_.assign(1, 0);
+  friendIds_.clear();
+  for (MSWNode* node: nodes) {
+    CHECK(node != NULL);
+    for (MSWNode* friendNode: node->getAllFriends()) {
+      friendIds_.push_back(static_cast<IdType>(friendNode->getId()));
+    }
+    friendOffsets_.push_back(friendIds_.size());
+  }
+
+  for (MSWNode* node: ElList_) delete node;
+  ElList_.clear();
+}
+
+/*
+ * The graph is stored in the CSR format: node i is the i-th object
+ * of the data set and its friends are friendIds[friendOffsets[i]]
+ * ... friendIds[friendOffsets[i+1]-1].
+ */
+template <typename dist_t>
+void SmallWorldRand<dist_t>::SaveIndex(const string& location) {
+  ofstream out(location.c_str(), ios::binary | ios::trunc);
+  if (!out) throw runtime_error("Cannot open the index file for writing: " + location);
+
+  vector<uint64_t> friendOffsets(friendOffsets_.begin(), friendOffsets_.end());
+
+  WriteIndexHeader(out, METH_SMALL_WORLD_RAND, data_);
+  WriteBinaryPOD(out, static_cast<uint64_t>(NN_));
+  WriteBinaryVector(out, friendOffsets);
+  WriteBinaryVector(out, friendIds_);
+  out.close();
+
+  LOG(LIB_INFO) << "The graph (" << friendIds_.size() << " edges) is saved to " << location;
+}
+
+template <typename dist_t>
+void SmallWorldRand<dist_t>::LoadIndex(const string& location) {
+  ifstream in(location.c_str(), ios::binary);
+  if (!in) throw runtime_error("Cannot open the index file for reading: " + location);
+
+  ReadIndexHeader(in, METH_SMALL_WORLD_RAND, data_);
+
+  uint64_t          NN;
+  vector<uint64_t>  friendOffsets;
+  vector<IdType>    friendIds;
+  ReadBinaryPOD(in, NN);
+  ReadBinaryVector(in, friendOffsets);
+  ReadBinaryVector(in, friendIds);
+
+  if (friendOffsets.size() != data_.size() + 1 || friendOffsets.back() != friendIds.size()) {
+    throw runtime_error("The index file is corrupt: " + location);
+  }
+
+  for (size_t id = 0; id < data_.size(); ++id) {
+    if (friendOffsets[id] > friendOffsets[id + 1]) {
+      throw runtime_error("The index file is corrupt: " + location);
+    }
+  }
+  for (IdType friendId: friendIds) {
+    if (friendId < 0 || static_cast<size_t>(friendId) >= data_.size()) {
+      throw runtime_error("The index file is corrupt: " + location);
+    }
+  }
+
+  for (MSWNode* node: ElList_) delete node;
+  ElList_.clear();
+  friendOffsets_.assign(friendOffsets.begin(), friendOffsets.end());
+  friendIds_.swap(friendIds);
+
+  NN_ = NN;
+  LOG(LIB_INFO) << "The graph (" << friendIds_.size() << " edges) is loaded from " << location;
+  LOG(LIB_INFO) << "NN (as in the index file) = " << NN_;
 }
 
 template <typename dist_t>
@@ -188,6 +289,23 @@ const std::string SmallWorldRand<dist_t>::ToString() const {
 
 template <typename dist_t>
 SmallWorldRand<dist_t>::~SmallWorldRand() {
+  for (MSWNode* node: ElList_) delete node;
+  for (SearchContextSW<dist_t>* context: searchContexts_) delete context;
+}
+
+template <typename dist_t>
+SearchContextSW<dist_t>* SmallWorldRand<dist_t>::acquireSearchContext() const {
+  unique_lock<mutex> lock(searchContextGuard_);
+  if (searchContexts_.empty()) return new SearchContextSW<dist_t>();
+  SearchContextSW<dist_t>* context = searchContexts_.back();
+  searchContexts_.pop_back();
+  return context;
+}
+
+template <typename dist_t>
+void SmallWorldRand<dist_t>::releaseSearchContext(SearchContextSW<dist_t>* context) const {
+  unique_lock<mutex> lock(searchContextGuard_);
+  searchContexts_.push_back(context);
 }
 
 template <typename dist_t>
@@ -342,6 +460,9 @@ SmallWorldRand<dist_t>::kSearchElementsWithAttempts(const Space<dist_t>* space,
 
 template <typename dist_t>
 void SmallWorldRand<dist_t>::add(const Space<dist_t>* space, MSWNode *newElement){
+  if (!friendOffsets_.empty()) {
+    throw runtime_error("Cannot add a node, because the graph is frozen");
+  }
   newElement->removeAllFriends(); 
 
   bool isEmpty = false;
@@ -389,87 +510,80 @@ void SmallWorldRand<dist_t>::Search(RangeQuery<dist_t>* query) {
 template <typename dist_t>
 void SmallWorldRand<dist_t>::Search(KNNQuery<dist_t>* query) {
 /*
- * The trick of using large dense bitsets instead of unordered_set was 
- * borrowed from Wei Dong's kgraph: https://github.com/aaalgo/kgraph
- *
- * This trick works really well even in a multi-threaded mode. Indeed, the amount
- * of allocated memory is small. For example, if one has 8M entries, the size of
- * the bitmap is merely 1 MB. Furthermore, setting 1MB of entries to zero via memset would take only
- * a fraction of millisecond.
+ * The search runs over the frozen graph: friends are read from
+ * the adjacency arrays without locking, the visited marks and
+ * the heaps come from a reusable search context.
  */
+  typedef typename SearchContextSW<dist_t>::EvaluatedNode EvaluatedNode;
+  typename SearchContextSW<dist_t>::CloserNode            closer;
+
 	int checks=0;
-  vector<bool>                        visitedBitset(ElList_.size());
+  if (friendOffsets_.size() <= 1) return;
+  size_t nodeQty = friendOffsets_.size() - 1;
+
+  unique_ptr<SearchContextSW<dist_t>> context(acquireSearchContext());
+  context->start(nodeQty, NN_);
+
+  vector<dist_t>&         closestDist = context->closestDist_; //The set of all elements which distance was calculated
+  vector<EvaluatedNode>&  candidates = context->candidates_; //the set of elements which we can use to evaluate
 
   for (size_t i=0; i < initSearchAttempts_; i++) {
   /**
    * Search of most k-closest elements to the query.
    */
-    MSWNode* provider = getRandomEntryPoint();
+    IdType provider = RandomInt() % nodeQty;
 
-    priority_queue <dist_t>                          closestDistQueue; //The set of all elements which distance was calculated
-    priority_queue <EvaluatedMSWNodeReverse<dist_t>> candidateQueue; //the set of elements which we can use to evaluate
+    closestDist.clear();
+    candidates.clear();
 
-    const Object* currObj = provider->getData();
+    const Object* currObj = data_[provider];
     dist_t d = query->DistanceObjLeft(currObj);
 	checks++;
     query->CheckAndAddToResult(d, currObj); // This should be done before the object goes to the queue: otherwise it will not be compared to the query at all!
 
-    EvaluatedMSWNodeReverse<dist_t> ev(d, provider);
-    candidateQueue.push(ev);
-    closestDistQueue.emplace(d);
+    candidates.push_back(EvaluatedNode(d, provider));
+    closestDist.push_back(d);
+    context->visit(provider);
 
-    size_t nodeId = provider->getId();
-    // data_.size() is guaranteed to be equal to ElList_.size()
-    if (nodeId >= data_.size()) {
-      stringstream err;
-      err << "Bug: nodeId > data_size()";
-      LOG(LIB_INFO) << err.str();
-      throw runtime_error(err.str());
-    }
-    visitedBitset[nodeId] = true; 
-
-    while(!candidateQueue.empty()){
-
-      auto iter = candidateQueue.top(); // This one was already compared to the query
-      const EvaluatedMSWNodeReverse<dist_t>& currEv = iter;
+    while(!candidates.empty()){
+      const EvaluatedNode& currEv = candidates.front(); // This one was already compared to the query
  
-      dist_t lowerBound = closestDistQueue.top();
+      dist_t lowerBound = closestDist.front();
 
       // Did we reach a local minimum?
-      if (currEv.getDistance() > lowerBound) {
+      if (currEv.first > lowerBound) {
         break;
       }
 
-      const vector<MSWNode*>& neighbor = (currEv.getMSWNode())->getAllFriends();
+      IdType currId = currEv.second;
 
       // Can't access curEv anymore! The reference would become invalid
-      candidateQueue.pop();
+      pop_heap(candidates.begin(), candidates.end(), closer);
+      candidates.pop_back();
 
       //calculate distance to each neighbor
-      for (auto iter = neighbor.begin(); iter != neighbor.end(); ++iter){
-        nodeId = (*iter)->getId();
-        // data_.size() is guaranteed to be equal to ElList_.size()
-        if (nodeId >= data_.size()) {
-          stringstream err;
-          err << "Bug: nodeId > data_size()";
-          LOG(LIB_INFO) << err.str();
-          throw runtime_error(err.str());
-        }
-        if (!visitedBitset[nodeId]) {
-          currObj = (*iter)->getData();
+      // data() rather than &friendIds_[0]: a graph may have no edges at all
+      const IdType* friendEnd = friendIds_.data() + friendOffsets_[currId + 1];
+      for (const IdType* iter = friendIds_.data() + friendOffsets_[currId]; iter != friendEnd; ++iter){
+        IdType friendId = *iter;
+        if (context->visit(friendId)) {
+          currObj = data_[friendId];
           d = query->DistanceObjLeft(currObj);
            checks++;
-          visitedBitset[nodeId] = true;
-          closestDistQueue.emplace(d);
-          if (closestDistQueue.size() > NN_) { 
-            closestDistQueue.pop(); 
+          closestDist.push_back(d);
+          push_heap(closestDist.begin(), closestDist.end());
+          if (closestDist.size() > NN_) { 
+            pop_heap(closestDist.begin(), closestDist.end());
+            closestDist.pop_back();
           }
-          candidateQueue.emplace(d, *iter);
+          candidates.push_back(EvaluatedNode(d, friendId));
+          push_heap(candidates.begin(), candidates.end(), closer);
           query->CheckAndAddToResult(d, currObj);
         }
       }
     }
   }
+  releaseSearchContext(context.release());
 	std::cout<<checks<<std::endl;
 }
 
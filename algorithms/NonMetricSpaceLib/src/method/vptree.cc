@@ -27,6 +27,7 @@
 #include "method/vptree.h"
 #include "method/vptree_utils.h"
 #include "methodfactory.h"
+#include "index_io.h"
 
 namespace similarity {
 
@@ -44,18 +45,33 @@ VPTree<dist_t, SearchOracle>::VPTree(
                        const ObjectVector& data,
                        const AnyParams& MethParams,
                        bool use_random_center) : 
+                              space_(space),
                               oracle_(space, data, PrintProgress),
+                              data_(data),
+                              root_(NULL),
                               BucketSize_(50),
                               MaxLeavesToVisit_(FAKE_MAX_LEAVES_TO_VISIT),
-                              ChunkBucket_(true)
+                              ChunkBucket_(true),
+                              MaxPathLength_(0)
                        {
   AnyParamManager pmgr(MethParams);
 
   pmgr.GetParamOptional("bucketSize", BucketSize_);
   pmgr.GetParamOptional("chunkBucket", ChunkBucket_);
+  /*
+   * With maxPathLen > 0, buckets keep the distances from their objects
+   * to the pivots of this many closest ancestors, and the objects
+   * the oracle would prune are filtered out using these distances.
+   */
+  pmgr.GetParamOptional("maxPathLen", MaxPathLength_);
+
+  string saveLocation, loadLocation;
+  pmgr.GetParamOptional(PARAM_SAVE_INDEX, saveLocation);
+  pmgr.GetParamOptional(PARAM_LOAD_INDEX, loadLocation);
 
   LOG(LIB_INFO) << "bucketSize  = " << BucketSize_;
   LOG(LIB_INFO) << "chunkBucket = " << ChunkBucket_;
+  LOG(LIB_INFO) << "maxPathLen  = " << MaxPathLength_;
 
   // Call this function *ONLY AFTER* the bucket size is obtained!
   VPTree<dist_t,SearchOracle>::SetQueryTimeParamsInternal(pmgr);
@@ -64,20 +80,70 @@ VPTree<dist_t, SearchOracle>::VPTree(
 
   oracle_.LogParams();
 
+  if (!loadLocation.empty()) {
+    LoadIndex(loadLocation);
+    return;
+  }
+
   unique_ptr<ProgressDisplay>   progress_bar(PrintProgress ? 
                                               new ProgressDisplay(data.size(), cerr):
                                               NULL);
 
+  ObjectVector path;
   root_ = new VPNode(0,
                      progress_bar.get(), 
                      oracle_, space,
                      const_cast<ObjectVector&>(data),
                      BucketSize_, ChunkBucket_,
-                     use_random_center, true);
+                     use_random_center, true,
+                     path, MaxPathLength_);
 
   if (progress_bar) { // make it 100%
     (*progress_bar) += (progress_bar->expected_count() - progress_bar->count());
   }
+
+  if (!saveLocation.empty()) SaveIndex(saveLocation);
+}
+
+template <typename dist_t, typename SearchOracle>
+void VPTree<dist_t, SearchOracle>::SaveIndex(const string& location) {
+  ofstream out(location.c_str(), ios::binary | ios::trunc);
+  if (!out) throw runtime_error("Cannot open the index file for writing: " + location);
+
+  /* 
+   * Buckets may keep copies of the objects (see chunkBucket),
+   * so the objects are mapped to positions by their ids.
+   */
+  unordered_map<IdType, IdType> objPos;
+  GetObjectPositions(data_, objPos);
+
+  WriteIndexHeader(out, METH_VPTREE, data_);
+  WriteBinaryPOD(out, static_cast<uint64_t>(BucketSize_));
+  root_->Save(out, objPos);
+  out.close();
+
+  LOG(LIB_INFO) << "The tree is saved to " << location;
+}
+
+template <typename dist_t, typename SearchOracle>
+void VPTree<dist_t, SearchOracle>::LoadIndex(const string& location) {
+  ifstream in(location.c_str(), ios::binary);
+  if (!in) throw runtime_error("Cannot open the index file for reading: " + location);
+
+  ReadIndexHeader(in, METH_VPTREE, data_);
+
+  uint64_t bucketSize;
+  ReadBinaryPOD(in, bucketSize);
+
+  delete root_;
+  root_ = NULL;
+  // The distances to the pivots on the path aren't saved, they are computed again
+  ObjectVector path;
+  root_ = new VPNode(oracle_, space_, in, data_, ChunkBucket_, path, MaxPathLength_);
+  BucketSize_ = bucketSize;
+
+  LOG(LIB_INFO) << "The tree is loaded from " << location;
+  LOG(LIB_INFO) << "bucketSize (as in the index file) = " << BucketSize_;
 }
 
 template <typename dist_t,typename SearchOracle>
@@ -91,21 +157,46 @@ const std::string VPTree<dist_t, SearchOracle>::ToString() const {
 }
 
 template <typename dist_t, typename SearchOracle>
-void VPTree<dist_t, SearchOracle>::Search(RangeQuery<dist_t>* query) {
+template <typename QueryType>
+void VPTree<dist_t, SearchOracle>::GenericSearch(QueryType* query) {
   int mx = MaxLeavesToVisit_;
-  root_->GenericSearch(query, mx);
+  vector<dist_t> path, bounds;
+  if (MaxPathLength_) {
+    path.reserve(64);
+    bounds.resize(2 * MaxPathLength_);
+  }
+  root_->GenericSearch(query, mx, path, bounds);
+}
+
+template <typename dist_t, typename SearchOracle>
+void VPTree<dist_t, SearchOracle>::Search(RangeQuery<dist_t>* query) {
+  GenericSearch(query);
 }
 
 template <typename dist_t, typename SearchOracle>
 void VPTree<dist_t, SearchOracle>::Search(KNNQuery<dist_t>* query) {
-  int mx = MaxLeavesToVisit_;
-  root_->GenericSearch(query, mx);
+  GenericSearch(query);
 }
 
 template <typename dist_t, typename SearchOracle>
 void VPTree<dist_t, SearchOracle>::VPNode::CreateBucket(bool ChunkBucket, 
                                                         const ObjectVector& data, 
-                                                        ProgressDisplay* progress_bar) {
+                                                        ProgressDisplay* progress_bar,
+                                                        const Space<dist_t>* space,
+                                                        const ObjectVector& path,
+                                                        size_t MaxPathLength) {
+    size_t pivotQty = min(path.size(), MaxPathLength);
+    if (pivotQty) {
+      vector<dist_t> dists;
+      dists.reserve(data.size() * pivotQty);
+      for (const Object* o: data) {
+        // The pivot is always on the left side, as in the tree nodes
+        for (size_t k = path.size() - pivotQty; k < path.size(); ++k) {
+          dists.push_back(space->IndexTimeDistance(path[k], o));
+        }
+      }
+      pathDists_.Init(data.size(), pivotQty, dists);
+    }
     if (ChunkBucket) {
       CreateCacheOptimizedBucket(data, CacheOptimizedBucket_, bucket_);
     } else {
@@ -121,7 +212,8 @@ VPTree<dist_t, SearchOracle>::VPNode::VPNode(
                                const SearchOracle& oracle,
                                const Space<dist_t>* space, const ObjectVector& data,
                                size_t BucketSize, bool ChunkBucket,
-                               bool use_random_center, bool is_root)
+                               bool use_random_center, bool is_root,
+                               ObjectVector& path, size_t MaxPathLength)
     : oracle_(oracle),
       pivot_(NULL), mediandist_(0),
       left_child_(NULL), right_child_(NULL),
@@ -130,7 +222,7 @@ VPTree<dist_t, SearchOracle>::VPNode::VPNode(
   CHECK(!data.empty());
 
   if (!data.empty() && data.size() <= BucketSize) {
-    CreateBucket(ChunkBucket, data, progress_bar);
+    CreateBucket(ChunkBucket, data, progress_bar, space, path, MaxPathLength);
     return;
   }
 
@@ -178,20 +270,88 @@ VPTree<dist_t, SearchOracle>::VPNode::VPNode(
     size_t LeastSize = dp.size() / BalanceConst;
 
     if (left.size() < LeastSize || right.size() < LeastSize) {
-        CreateBucket(ChunkBucket, data, progress_bar);
+        CreateBucket(ChunkBucket, data, progress_bar, space, path, MaxPathLength);
         return;
     }
 
+    path.push_back(pivot_);
     if (!left.empty()) {
-      left_child_ = new VPNode(level + 1, progress_bar, oracle_, space, left, BucketSize, ChunkBucket, use_random_center, false);
+      left_child_ = new VPNode(level + 1, progress_bar, oracle_, space, left, BucketSize, ChunkBucket, use_random_center, false,
+                               path, MaxPathLength);
     }
 
     if (!right.empty()) {
-      right_child_ = new VPNode(level + 1, progress_bar, oracle_, space, right, BucketSize, ChunkBucket, use_random_center, false);
+      right_child_ = new VPNode(level + 1, progress_bar, oracle_, space, right, BucketSize, ChunkBucket, use_random_center, false,
+                                path, MaxPathLength);
     }
+    path.pop_back();
   }
 }
 
+template <typename dist_t, typename SearchOracle>
+void VPTree<dist_t, SearchOracle>::VPNode::Save(ostream& out, 
+                                                const unordered_map<IdType, IdType>& objPos) const {
+  uint8_t isBucket = bucket_ != NULL;
+  WriteBinaryPOD(out, isBucket);
+  if (bucket_) {
+    vector<IdType> bucketPos;
+    for (const Object* o: *bucket_) {
+      bucketPos.push_back(objPos.at(o->id()));
+    }
+    WriteBinaryVector(out, bucketPos);
+    return;
+  }
+  uint8_t children = (left_child_ ? 1 : 0) | (right_child_ ? 2 : 0);
+  WriteBinaryPOD(out, objPos.at(pivot_->id()));
+  WriteBinaryPOD(out, mediandist_);
+  WriteBinaryPOD(out, children);
+  if (left_child_)  left_child_->Save(out, objPos);
+  if (right_child_) right_child_->Save(out, objPos);
+}
+
+template <typename dist_t, typename SearchOracle>
+VPTree<dist_t, SearchOracle>::VPNode::VPNode(const SearchOracle& oracle, const Space<dist_t>* space,
+                                             istream& in, const ObjectVector& data, bool ChunkBucket,
+                                             ObjectVector& path, size_t MaxPathLength)
+    : oracle_(oracle),
+      pivot_(NULL), mediandist_(0),
+      left_child_(NULL), right_child_(NULL),
+      bucket_(NULL), CacheOptimizedBucket_(NULL) 
+{
+  uint8_t isBucket;
+  ReadBinaryPOD(in, isBucket);
+  if (isBucket) {
+    vector<IdType> bucketPos;
+    ReadBinaryVector(in, bucketPos);
+    ObjectVector bucket;
+    for (IdType p: bucketPos) {
+      if (p < 0 || static_cast<size_t>(p) >= data.size()) {
+        throw runtime_error("The index file is corrupt: invalid object position");
+      }
+      bucket.push_back(data[p]);
+    }
+    CreateBucket(ChunkBucket, bucket, NULL, space, path, MaxPathLength);
+    return;
+  }
+  IdType  pivotPos;
+  uint8_t children;
+  ReadBinaryPOD(in, pivotPos);
+  ReadBinaryPOD(in, mediandist_);
+  ReadBinaryPOD(in, children);
+  if (pivotPos < 0 || static_cast<size_t>(pivotPos) >= data.size()) {
+    throw runtime_error("The index file is corrupt: invalid object position");
+  }
+  pivot_ = data[pivotPos];
+  // If reading a child fails, the destructor isn't called: the children are released here
+  unique_ptr<VPNode> left, right;
+  path.push_back(pivot_);
+  if (children & 1) left.reset(new VPNode(oracle_, space, in, data, ChunkBucket, path, MaxPathLength));
+  if (children & 2) right.reset(new VPNode(oracle_, space, in, data, ChunkBucket, path, MaxPathLength));
+  path.pop_back();
+  left_child_  = left.release();
+  right_child_ = right.release();
+}
+
 template <typename dist_t, typename SearchOracle>
 VPTree<dist_t, SearchOracle>::VPNode::~VPNode() {
   delete left_child_;
@@ -199,30 +359,67 @@ VPTree<dist_t, SearchOracle>::VPNode::~VPNode() {
   ClearBucket(CacheOptimizedBucket_, bucket_);
 }
 
+template <typename dist_t, typename SearchOracle>
+template <typename QueryType>
+void VPTree<dist_t, SearchOracle>::VPNode::SearchBucket(QueryType* query,
+                                                        const vector<dist_t>& path,
+                                                        vector<dist_t>& bounds) {
+  size_t pivotQty = pathDists_.pivotQty();
+  if (!pivotQty) {
+    query->CheckAndAddToResult(*bucket_);
+    return;
+  }
+  CHECK(path.size() >= pivotQty && bounds.size() >= 2 * pivotQty);
+  const dist_t*   queryDists = &path[path.size() - pivotQty];
+  dist_t*         lo = &bounds[0];
+  dist_t*         hi = &bounds[pivotQty];
+  uint32_t        pos[DIST_BATCH_QTY];
+  const Object*   pObjs[DIST_BATCH_QTY];
+
+  /*
+   * The bounds are recomputed for each block of objects,
+   * because the query radius may decrease.
+   */
+  for (size_t start = 0; start < bucket_->size(); start += DIST_BATCH_QTY) {
+    double below, above;
+    oracle_.GetPivotDistMargins(query->Radius(), below, above);
+    for (size_t k = 0; k < pivotQty; ++k) {
+      lo[k] = PivotDistBound<dist_t>(double(queryDists[k]) - below, true);
+      hi[k] = PivotDistBound<dist_t>(double(queryDists[k]) + above, false);
+    }
+    size_t qty = pathDists_.Filter(start, min(bucket_->size(), start + DIST_BATCH_QTY),
+                                   pivotQty, lo, hi, pos);
+    for (size_t i = 0; i < qty; ++i) {
+      pObjs[i] = (*bucket_)[pos[i]];
+    }
+    query->CheckAndAddToResult(pObjs, qty);
+  }
+}
+
 template <typename dist_t, typename SearchOracle>
 template <typename QueryType>
 void VPTree<dist_t, SearchOracle>::VPNode::GenericSearch(QueryType* query,
-                                                         int& MaxLeavesToVisit) {
+                                                         int& MaxLeavesToVisit,
+                                                         vector<dist_t>& path,
+                                                         vector<dist_t>& bounds) {
   if (MaxLeavesToVisit <= 0) return; // early termination
   if (bucket_) {
     --MaxLeavesToVisit;
 	//cerr<<"query radius:"<< query->Radius()<<" "<< bucket_->size()<<endl;
-    for (unsigned i = 0; i < bucket_->size(); ++i) {
-      const Object* Obj = (*bucket_)[i];
-      dist_t distQC = query->DistanceObjLeft(Obj);
-      query->CheckAndAddToResult(distQC, Obj);
-    }
+    SearchBucket(query, path, bounds);
     return;
   }
 	
   // Distance can be asymmetric, the pivot is always the left argument (see the function that creates the node)!
   dist_t distQC = query->DistanceObjLeft(pivot_);
   query->CheckAndAddToResult(distQC, pivot_);
+  // The path is needed only if buckets keep distances to pivots
+  if (!bounds.empty()) path.push_back(distQC);
 
   if (distQC < mediandist_) {      // the query is inside
     // then first check inside
     if (left_child_ != NULL && oracle_.Classify(distQC, query->Radius(), mediandist_) != kVisitRight)
-       left_child_->GenericSearch(query, MaxLeavesToVisit);
+       left_child_->GenericSearch(query, MaxLeavesToVisit, path, bounds);
 
     /* 
      * After potentially visiting the left child, we need to reclassify the node,
@@ -232,11 +429,11 @@ void VPTree<dist_t, SearchOracle>::VPNode::GenericSearch(QueryType* query,
 
     // after that outside
     if (right_child_ != NULL && oracle_.Classify(distQC, query->Radius(), mediandist_) != kVisitLeft)
-       right_child_->GenericSearch(query, MaxLeavesToVisit);
+       right_child_->GenericSearch(query, MaxLeavesToVisit, path, bounds);
   } else {                         // the query is outside
     // then first check outside
     if (right_child_ != NULL && oracle_.Classify(distQC, query->Radius(), mediandist_) != kVisitLeft)
-       right_child_->GenericSearch(query, MaxLeavesToVisit);
+       right_child_->GenericSearch(query, MaxLeavesToVisit, path, bounds);
 
     /* 
      * After potentially visiting the left child, we need to reclassify the node,
@@ -245,8 +442,9 @@ void VPTree<dist_t, SearchOracle>::VPNode::GenericSearch(QueryType* query,
 
     // after that inside
     if (left_child_ != NULL && oracle_.Classify(distQC, query->Radius(), mediandist_) != kVisitRight)
-      left_child_->GenericSearch(query, MaxLeavesToVisit);
+      left_child_->GenericSearch(query, MaxLeavesToVisit, path, bounds);
   }
+  if (!bounds.empty()) path.pop_back();
 }
 
 template class VPTree<float, PolynomialPruner<float> >;
@@ -68,6 +68,12 @@ dist_t Query<dist_t>::DistanceObjRight(const Object* object) const {
   return Distance(query_object_, object);
 }
 
+template <typename dist_t>
+void Query<dist_t>::DistanceObjLeftBatch(const Object* const* pObjs, size_t qty, dist_t* pDist) const {
+  distance_computations_ += qty;
+  space_->HiddenDistanceBatch(pObjs, qty, query_object_, pDist);
+}
+
 template class Query<float>;
 template class Query<double>;
 template class Query<int>;
@@ -18,6 +18,7 @@
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <algorithm>
 
 #include "space/space_scalar.h"
 #include "logging.h"
@@ -39,6 +40,17 @@ dist_t SpaceCosineSimilarity<dist_t>::HiddenDistance(const Object* obj1, const O
   return val;
 }
 
+template <typename dist_t>
+void SpaceCosineSimilarity<dist_t>::HiddenDistanceBatch(const Object* const* pObjs, size_t qty,
+                                                         const Object* query, dist_t* pDist) const {
+  this->DistanceBatchSimpleStorage(pObjs, qty, query, pDist,
+                                   NormScalarProductSIMDBatch<dist_t>);
+  for (size_t i = 0; i < qty; ++i) {
+    pDist[i] = std::max(dist_t(0), 1 - pDist[i]);
+    if (std::isnan(pDist[i])) LOG(LIB_FATAL) << "Bug: NAN dist!!!!";
+  }
+}
+
 template class SpaceCosineSimilarity<float>;
 template class SpaceCosineSimilarity<double>;
 
@@ -56,6 +68,17 @@ dist_t SpaceAngularDistance<dist_t>::HiddenDistance(const Object* obj1, const Ob
   return val;
 }
 
+template <typename dist_t>
+void SpaceAngularDistance<dist_t>::HiddenDistanceBatch(const Object* const* pObjs, size_t qty,
+                                                        const Object* query, dist_t* pDist) const {
+  this->DistanceBatchSimpleStorage(pObjs, qty, query, pDist,
+                                   NormScalarProductSIMDBatch<dist_t>);
+  for (size_t i = 0; i < qty; ++i) {
+    pDist[i] = std::acos(pDist[i]);
+    if (std::isnan(pDist[i])) LOG(LIB_FATAL) << "Bug: NAN dist!!!!";
+  }
+}
+
 template class SpaceAngularDistance<float>;
 template class SpaceAngularDistance<double>;
 
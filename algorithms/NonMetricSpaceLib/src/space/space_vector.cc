@@ -15,6 +15,7 @@
  */
 
 #include <cmath>
+#include <algorithm>
 #include <fstream>
 #include <string>
 #include <sstream>
@@ -24,6 +25,7 @@
 #include "distcomp.h"
 #include "experimentconf.h"
 #include "space/space_vector.h"
+#include "../../../../tools/dataset/mmap_dataset.h"
 
 namespace similarity {
 
@@ -80,6 +82,111 @@ void VectorSpace<dist_t>::WriteDataset(const ObjectVector& dataset,
 }
 
 
+template <typename dist_t>
+inline void CopyFloatVect(const float* src, size_t qty, dist_t* dst) {
+  for (size_t i = 0; i < qty; ++i) dst[i] = src[i];
+}
+
+template <>
+inline void CopyFloatVect<float>(const float* src, size_t qty, float* dst) {
+  memcpy(dst, src, qty * sizeof(float));
+}
+
+inline bool HasExtension(const std::string& fileName, const std::string& ext) {
+  return fileName.size() >= ext.size() &&
+         fileName.compare(fileName.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+/*
+ * The file is mapped into memory (see tools/dataset/mmap_dataset.h) and the
+ * rows are copied to the objects in place, so reading proceeds at the disk
+ * speed. If the space keeps only the vector elements in an object, all
+ * objects are placed into one arena: no memory is allocated per object
+ * besides the small Object itself.
+ */
+template <typename dist_t>
+void VectorSpace<dist_t>::ReadBinaryDataset(
+    ObjectVector& dataset,
+    const ExperimentConfig<dist_t>* config,
+    const char* FileName,
+    const int MaxNumObjects) const {
+  const bool fvecs = HasExtension(FileName, DATA_FILE_EXT_FVECS);
+
+  dataset.clear();
+
+  nns::Dataset file;
+  try {
+    file.open(FileName, fvecs ? nns::FORMAT_FVECS : nns::FORMAT_LSHKIT);
+  } catch (const std::exception &e) {
+    LOG(LIB_FATAL) << "Failed to read the file: " << e.what();
+  }
+  if (file.elem_size() != sizeof(float)) {
+    LOG(LIB_FATAL) << "Only float elements are supported, but the element size is "
+                   << file.elem_size() << " in the lshkit file: " << FileName;
+  }
+
+  uint64_t rowQty = file.size();
+  const uint64_t dim = file.dim();
+
+  if (MaxNumObjects && rowQty > static_cast<uint64_t>(MaxNumObjects)) rowQty = MaxNumObjects;
+
+  // Only the rows that are read are checked
+  file.truncate(rowQty);
+  if (!file.check_rows()) {
+    LOG(LIB_FATAL) << "The # of vector elements doesn't match the # of elements "
+                   << "in the first vector (" << file.dim() << ") file: " << FileName;
+  }
+
+  size_t actualDim = dim;
+  if (config && config->GetDimension()) {
+    if (static_cast<uint64_t>(config->GetDimension()) > dim) {
+      LOG(LIB_FATAL) << "The # of vector elements (" << dim << ")" <<
+                  " is smaller than the requested # of dimensions. " <<
+                  "File: " << FileName;
+    } else {
+      actualDim = config->GetDimension();
+    }
+  }
+
+  file.advise(MADV_SEQUENTIAL);
+
+  // Objects in the arena start at 16-byte boundaries
+  const size_t objSize   = (ID_SIZE + LABEL_SIZE + DATALENGTH_SIZE + 
+                            actualDim * sizeof(dist_t) + 15) / 16 * 16;
+
+  char* arena = NULL;
+  if (HasSimpleStorage() && rowQty) {
+    arena = new char[objSize * rowQty];
+    arenas_.push_back(std::shared_ptr<char>(arena, std::default_delete<char[]>()));
+  }
+
+  dataset.reserve(rowQty);
+
+  std::vector<dist_t>   temp(actualDim);
+
+  for (uint64_t i = 0; i < rowQty; ++i) {
+    const IdType id = static_cast<IdType>(i);
+    const float* row = file.row<float>(i);
+
+    if (arena) {
+      const LabelType label = EMPTY_LABEL;
+      const size_t    datalength = actualDim * sizeof(dist_t);
+      char* buf = arena + static_cast<size_t>(id) * objSize;
+      memcpy(buf, &id, ID_SIZE);
+      memcpy(buf + ID_SIZE, &label, LABEL_SIZE);
+      memcpy(buf + ID_SIZE + LABEL_SIZE, &datalength, DATALENGTH_SIZE);
+      CopyFloatVect(row, actualDim, reinterpret_cast<dist_t*>(buf + ID_SIZE + LABEL_SIZE + DATALENGTH_SIZE));
+      dataset.push_back(new Object(buf));
+    } else {
+      CopyFloatVect(row, actualDim, &temp[0]);
+      dataset.push_back(CreateObjFromVect(id, EMPTY_LABEL, temp));
+    }
+  }
+  LOG(LIB_INFO) << "Read " << dataset.size() << " vectors from the " 
+                << (fvecs ? "fvecs" : "lshkit") << " file: " << FileName;
+  LOG(LIB_INFO) << "Actual dimensionality: " << actualDim;
+}
+
 template <typename dist_t>
 void VectorSpace<dist_t>::ReadDataset(
     ObjectVector& dataset,
@@ -87,6 +194,11 @@ void VectorSpace<dist_t>::ReadDataset(
     const char* FileName,
     const int MaxNumObjects) const {
 
+  if (HasExtension(FileName, DATA_FILE_EXT_FVECS) || HasExtension(FileName, DATA_FILE_EXT_LSHKIT)) {
+    ReadBinaryDataset(dataset, config, FileName, MaxNumObjects);
+    return;
+  }
+
   dataset.clear();
   dataset.reserve(MaxNumObjects);
 
@@ -323,6 +323,64 @@ bool TestL2Agree(size_t N, size_t dim, size_t Rep) {
     return true;
 }
 
+/*
+ * The one-to-many functions should produce the same values
+ * as the respective one-to-one functions.
+ */
+template <class T>
+bool TestBatchAgree(size_t N, size_t dim, size_t Rep) {
+    vector<vector<T>> vects(N, vector<T>(dim));
+    vector<const T*> pVects(N);
+    vector<T> query(dim), res(N);
+
+    for (size_t i = 0; i < Rep; ++i) {
+        for (size_t j = 0; j < N; ++j) {
+            GenRandVect(&vects[j][0], dim, -T(RANGE), T(RANGE));
+            pVects[j] = &vects[j][0];
+        }
+        GenRandVect(&query[0], dim, -T(RANGE), T(RANGE));
+
+        /* 
+         * Let's also check the "tails": the number of vectors 
+         * can be smaller than N and not a multiple of 4.
+         */
+        size_t qty = N - i % 4;
+
+        bool bug = false;
+
+        L1NormSIMDBatch(&pVects[0], qty, &query[0], dim, &res[0]);
+        for (size_t j = 0; j < qty; ++j) {
+            T val = L1NormSIMD(pVects[j], &query[0], dim);
+            if (fabs(val - res[j])/max(max(val,res[j]),T(1e-18)) > 1e-6) {
+                cerr << "Bug L1 batch !!! Dim = " << dim << " val = " << val << " batch val = " << res[j] << endl;
+                bug = true;
+            }
+        }
+
+        L2NormSIMDBatch(&pVects[0], qty, &query[0], dim, &res[0]);
+        for (size_t j = 0; j < qty; ++j) {
+            T val = L2NormSIMD(pVects[j], &query[0], dim);
+            if (fabs(val - res[j])/max(max(val,res[j]),T(1e-18)) > 1e-6) {
+                cerr << "Bug L2 batch !!! Dim = " << dim << " val = " << val << " batch val = " << res[j] << endl;
+                bug = true;
+            }
+        }
+
+        NormScalarProductSIMDBatch(&pVects[0], qty, &query[0], dim, &res[0]);
+        for (size_t j = 0; j < qty; ++j) {
+            T val = NormScalarProductSIMD(pVects[j], &query[0], dim);
+            if (fabs(val - res[j]) > 1e-6) {
+                cerr << "Bug NormScalarProduct batch !!! Dim = " << dim << " val = " << val << " batch val = " << res[j] << endl;
+                bug = true;
+            }
+        }
+
+        if (bug) return false;
+    }
+
+    return true;
+}
+
 template <class T>
 bool TestItakuraSaitoAgree(size_t N, size_t dim, size_t Rep) {
     vector<T> vect1(dim), vect2(dim);
@@ -897,6 +955,11 @@ TEST(TestAgree) {
         nTest++;
         nFail += !TestL2Agree<double>(1024, dim, 10);
 
+        nTest++;
+        nFail += !TestBatchAgree<float>(37, dim, 10);
+        nTest++;
+        nFail += !TestBatchAgree<double>(37, dim, 10);
+
         nTest++;
         nFail += !TestKLAgree<float>(1024, dim, 10);
         nTest++;
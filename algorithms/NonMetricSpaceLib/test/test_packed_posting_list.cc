@@ -0,0 +1,64 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/) and others.
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "packed_posting_list.h"
+#include "utils.h"
+#include "bunit.h"
+
+using namespace std;
+
+namespace similarity {
+
+bool checkRoundTrip(const vector<int>& ids) {
+  PackedPostingList packed;
+  packed.Encode(ids);
+
+  vector<int> decoded;
+  packed.Decode(decoded);
+
+  return packed.size() == ids.size() && decoded == ids;
+}
+
+vector<int> genSortedIds(size_t qty, int maxId) {
+  vector<int> ids;
+  for (size_t i = 0; i < qty; ++i) {
+    ids.push_back(RandomInt() % maxId);
+  }
+  sort(ids.begin(), ids.end());
+  ids.erase(unique(ids.begin(), ids.end()), ids.end());
+  return ids;
+}
+
+TEST(PackedPostingListSmall) {
+  EXPECT_TRUE(checkRoundTrip(vector<int>()));
+  EXPECT_TRUE(checkRoundTrip(vector<int>({0})));
+  EXPECT_TRUE(checkRoundTrip(vector<int>({0, 1, 2, 3, 4})));
+  EXPECT_TRUE(checkRoundTrip(vector<int>({7, 100000, numeric_limits<int>::max()})));
+}
+
+// Lists that end in the middle of a block and lists with both small and large gaps
+TEST(PackedPostingListRandom) {
+  for (size_t qty: {127, 128, 129, 1000, 5000}) {
+    for (int maxId: {200, 65536, numeric_limits<int>::max()}) {
+      EXPECT_TRUE(checkRoundTrip(genSortedIds(qty, maxId)));
+    }
+  }
+}
+
+}  // namespace similarity
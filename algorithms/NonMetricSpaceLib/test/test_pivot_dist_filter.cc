@@ -0,0 +1,87 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/) and others.
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#include <vector>
+#include <algorithm>
+
+#include "pivot_dist_filter.h"
+#include "utils.h"
+#include "bunit.h"
+
+using namespace std;
+
+namespace similarity {
+
+/*
+ * The filter should keep exactly the objects whose distances are within
+ * the bounds for all pivots, including the ones on the bounds.
+ */
+template <typename dist_t>
+bool checkFilter(size_t objQty, size_t pivotQty, size_t usedPivotQty) {
+  vector<dist_t> dists(objQty * pivotQty);
+  for (dist_t& d: dists) d = static_cast<dist_t>(RandomInt() % 20);
+
+  PivotDistFilter<dist_t> filter;
+  filter.Init(objQty, pivotQty, dists);
+
+  vector<dist_t> lo(pivotQty), hi(pivotQty);
+  for (size_t k = 0; k < pivotQty; ++k) {
+    lo[k] = static_cast<dist_t>(RandomInt() % 10);
+    hi[k] = lo[k] + static_cast<dist_t>(RandomInt() % 15);
+  }
+
+  const size_t kBlockQty = 64;
+  vector<uint32_t> pos(kBlockQty);
+  for (size_t start = 0; start < objQty; start += kBlockQty) {
+    size_t end = min(objQty, start + kBlockQty);
+    vector<uint32_t> expPos;
+    for (size_t i = start; i < end; ++i) {
+      bool keep = true;
+      for (size_t k = 0; k < usedPivotQty; ++k) {
+        dist_t d = dists[i * pivotQty + k];
+        keep = keep && lo[k] <= d && d <= hi[k];
+      }
+      if (keep) expPos.push_back(i);
+    }
+    size_t qty = filter.Filter(start, end, usedPivotQty, &lo[0], &hi[0], &pos[0]);
+    if (vector<uint32_t>(pos.begin(), pos.begin() + qty) != expPos) return false;
+  }
+  return true;
+}
+
+TEST(PivotDistFilterFloat) {
+  for (size_t objQty: {1, 3, 4, 5, 63, 64, 65, 200}) {
+    EXPECT_TRUE(checkFilter<float>(objQty, 1, 1));
+    EXPECT_TRUE(checkFilter<float>(objQty, 6, 6));
+    EXPECT_TRUE(checkFilter<float>(objQty, 6, 3));
+  }
+}
+
+TEST(PivotDistFilterInt) {
+  for (size_t objQty: {1, 5, 64, 200}) {
+    EXPECT_TRUE(checkFilter<int>(objQty, 6, 6));
+    EXPECT_TRUE(checkFilter<int>(objQty, 6, 3));
+  }
+}
+
+TEST(PivotDistBound) {
+  EXPECT_EQ(3, PivotDistBound<int>(2.5, true));
+  EXPECT_EQ(2, PivotDistBound<int>(2.5, false));
+  EXPECT_EQ(DistMax<int>(), PivotDistBound<int>(1e20, false));
+  EXPECT_TRUE(PivotDistBound<float>(0.1, true) <= 0.1);
+  EXPECT_TRUE(PivotDistBound<float>(0.1, false) >= 0.1);
+}
+
+}  // namespace similarity
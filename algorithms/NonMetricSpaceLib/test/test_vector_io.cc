@@ -0,0 +1,140 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/) and others.
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <string>
+#include <fstream>
+
+#include "object.h"
+#include "space/space_lp.h"
+#include "space/space_bregman.h"
+#include "bunit.h"
+
+using namespace std;
+
+namespace similarity {
+
+const size_t kVectQty = 1000;
+const size_t kVectDim = 17;
+
+vector<vector<float>> genVectors() {
+  vector<vector<float>> res(kVectQty, vector<float>(kVectDim));
+  for (size_t i = 0; i < kVectQty; ++i) {
+    for (size_t k = 0; k < kVectDim; ++k) {
+      res[i][k] = 0.25f * ((i * 31 + k * 7) % 97) + 0.5f;
+    }
+  }
+  return res;
+}
+
+void writeText(const string& fileName, const vector<vector<float>>& vects) {
+  ofstream out(fileName.c_str());
+  for (const auto& v: vects) {
+    for (size_t k = 0; k < v.size(); ++k) out << v[k] << (k + 1 == v.size() ? "\n" : " ");
+  }
+}
+
+void writeFvecs(const string& fileName, const vector<vector<float>>& vects) {
+  ofstream out(fileName.c_str(), ios::binary);
+  for (const auto& v: vects) {
+    int d = v.size();
+    out.write(reinterpret_cast<const char*>(&d), sizeof d);
+    out.write(reinterpret_cast<const char*>(&v[0]), sizeof(float) * d);
+  }
+}
+
+void writeLshkit(const string& fileName, const vector<vector<float>>& vects) {
+  ofstream out(fileName.c_str(), ios::binary);
+  unsigned header[3] = {sizeof(float), static_cast<unsigned>(vects.size()),
+                        static_cast<unsigned>(vects[0].size())};
+  out.write(reinterpret_cast<const char*>(header), sizeof header);
+  for (const auto& v: vects) {
+    out.write(reinterpret_cast<const char*>(&v[0]), sizeof(float) * v.size());
+  }
+}
+
+/*
+ * The binary readers should produce the same objects as the text reader.
+ */
+template <typename dist_t>
+void testReadBinary(const VectorSpace<dist_t>& space, int maxNumObjects) {
+  vector<vector<float>> vects = genVectors();
+
+  writeText("tmpfile.txt", vects);
+  writeFvecs("tmpfile.fvecs", vects);
+  writeLshkit("tmpfile.lshkit", vects);
+
+  ObjectVector textData, fvecsData, lshkitData;
+
+  space.ReadDataset(textData, NULL, "tmpfile.txt", maxNumObjects);
+  space.ReadDataset(fvecsData, NULL, "tmpfile.fvecs", maxNumObjects);
+  space.ReadDataset(lshkitData, NULL, "tmpfile.lshkit", maxNumObjects);
+
+  size_t expQty = maxNumObjects ? min<size_t>(maxNumObjects, kVectQty) : kVectQty;
+  EXPECT_EQ(expQty, textData.size());
+  EXPECT_EQ(expQty, fvecsData.size());
+  EXPECT_EQ(expQty, lshkitData.size());
+
+  for (size_t i = 0; i < textData.size() && i < fvecsData.size() && i < lshkitData.size(); ++i) {
+    EXPECT_EQ(textData[i]->id(), fvecsData[i]->id());
+    EXPECT_EQ(textData[i]->id(), lshkitData[i]->id());
+    EXPECT_EQ(textData[i]->label(), fvecsData[i]->label());
+    EXPECT_EQ(textData[i]->datalength(), fvecsData[i]->datalength());
+    EXPECT_EQ(textData[i]->datalength(), lshkitData[i]->datalength());
+    EXPECT_TRUE(!memcmp(textData[i]->data(), fvecsData[i]->data(), textData[i]->datalength()));
+    EXPECT_TRUE(!memcmp(textData[i]->data(), lshkitData[i]->data(), textData[i]->datalength()));
+  }
+
+  for (const Object* o: textData) delete o;
+  for (const Object* o: fvecsData) delete o;
+  for (const Object* o: lshkitData) delete o;
+
+  remove("tmpfile.txt");
+  remove("tmpfile.fvecs");
+  remove("tmpfile.lshkit");
+}
+
+TEST(ReadBinaryFloat) {
+  SpaceLp<float> space(2);
+  testReadBinary(space, 0);
+  testReadBinary(space, 100);
+}
+
+TEST(ReadBinaryDouble) {
+  SpaceLp<double> space(2);
+  testReadBinary(space, 0);
+  testReadBinary(space, 100);
+}
+
+// KL-divergence objects keep precomputed logarithms, so they aren't placed in the arena
+TEST(ReadBinaryKLDiv) {
+  KLDivFast<float> space;
+  testReadBinary(space, 0);
+}
+
+TEST(ReadEmptyFvecs) {
+  SpaceLp<float> space(2);
+  ofstream("tmpfile.fvecs", ios::binary).close();
+  ObjectVector data;
+  space.ReadDataset(data, NULL, "tmpfile.fvecs", 0);
+  EXPECT_EQ(size_t(0), data.size());
+  remove("tmpfile.fvecs");
+}
+
+}  // namespace similarity
+
@@ -18,6 +18,7 @@
 #include "mkl_cblas.h"
 
 #include "multitable.hpp"
+#include "../../tools/dataset/mmap_dataset.h"
 
 using std::bitset;
 using std::cout;
@@ -170,6 +171,8 @@ inline U Round(T number) {
  * Function reads point written in .fvecs or .bvecs format.
  * Input points have coordinates of type T.
  * Result points have coordinates of type U
+ * The file is mapped by mmap (see nns::Dataset), so the points
+ * are converted straight from the page cache.
  * @param filename .fvecs or .bvecs file name
  * @param points_count how many points to read
  * @param points result list of read points
@@ -178,23 +181,26 @@ template<class T, class U>
 void ReadPoints(const string& filename,
                 vector<vector<U> >* points,
                 int count) {
-  ifstream input;
-	input.open(filename.c_str(), ios::binary);
-  if(!input.good()) {
-    throw std::logic_error("Invalid filename");
+  nns::Dataset input;
+  // .ivecs files have the layout of .fvecs files
+  input.open(filename, sizeof(T) == 1 ? nns::FORMAT_BVECS : nns::FORMAT_FVECS);
+  if(input.elem_size() != sizeof(T)) {
+    throw std::logic_error("Coordinate type does not match the file format");
+  }
+  if((int)input.size() < count) {
+    throw std::logic_error("Bad file content: fewer points than requested");
+  }
+  input.truncate(count);
+  if(!input.check_rows()) {
+    throw std::logic_error("Bad file content: vectors of different dimensions");
   }
+  const Dimensions dimension = input.dim();
   points->resize(count);
-  int dimension;
   for(PointId pid = 0; pid < count; ++pid) {
-    input.read((char*)&dimension, sizeof(dimension));
-    if(dimension <= 0) {
-      throw std::logic_error("Bad file content: non-positive dimension");
-    }
+    const T* row = input.row<T>(pid);
     points->at(pid).resize(dimension);
     for(Dimensions d = 0; d < dimension; ++d) {
-      T buffer;
-      input.read((char*)&(buffer), sizeof(T));
-      points->at(pid)[d] = Round<T, U>(buffer);
+      points->at(pid)[d] = Round<T, U>(row[d]);
     }
   }
 }
@@ -17,7 +17,8 @@ int indexing(						// build hash tables for the dataset
 	int   B,							// page size
 	float ratio, int N,						// approximation ratio
 	char* data_set,						// address of data set
-	char* output_folder,char* index_folder);				// folder to store info of qalsh
+	char* output_folder,char* index_folder,				// folder to store info of qalsh
+	int   num_threads);						// num of threads for bulkloading
 
 // -----------------------------------------------------------------------------
 int lshknn(							// k-nn via qalsh (data in disk)
@@ -25,7 +26,10 @@ int lshknn(							// k-nn via qalsh (data in disk)
 	int   d, int N,						// dimensionality
 	char* query_set,					// path of query set
 	char* truth_set,					// groundtrue file
-	char* output_folder,char* result_folder,float ratio,int B);				// output folder
+	char* output_folder,char* result_folder,float ratio,int B,				// output folder
+	int   cache_type,						// type of page source
+	int   cache_pages,						// num of pages for PAGE_LRU
+	int   num_threads);						// num of threads for knn_batch
 
 // -----------------------------------------------------------------------------
 int linear_scan(					// brute-force linear scan (data in disk)
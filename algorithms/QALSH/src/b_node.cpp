@@ -131,6 +131,24 @@ int BNode::get_level()				// get <level_>
 	return level_;
 }
 
+// -----------------------------------------------------------------------------
+BTree* BNode::get_btree()			// get <btree_>
+{
+	return btree_;
+}
+
+// -----------------------------------------------------------------------------
+int BNode::get_left_sibling_addr()	// get addr of left sibling node
+{
+	return left_sibling_;
+}
+
+// -----------------------------------------------------------------------------
+int BNode::get_right_sibling_addr()	// get addr of right sibling node
+{
+	return right_sibling_;
+}
+
 // -----------------------------------------------------------------------------
 //	<level>: SIZECHAR
 //	<num_entries> <left_sibling> and <right_sibling>: SIZEINT
@@ -401,6 +419,28 @@ BIndexNode* BIndexNode::get_right_sibling()
 	return node;
 }
 
+// -----------------------------------------------------------------------------
+//  Reuse a node restored before to load another block of the same b-tree
+//  (or a b-tree with the same block length). <key_> and <son_> are kept, so
+//  no memory is allocated.
+// -----------------------------------------------------------------------------
+void BIndexNode::reload(			// reuse this node for another block
+	BTree* btree,						// b-tree of this node
+	int block,							// address of file of this node
+	char* blk)							// buffer of one block
+{
+	if (key_ == NULL) {				// first time: allocate arrays
+		init_restore(btree, block);
+		return;
+	}
+	btree_ = btree;
+	block_ = block;
+	dirty_ = false;
+
+	btree_->file_->read_block(blk, block);
+	read_from_buffer(blk);
+}
+
 // -----------------------------------------------------------------------------
 int BIndexNode::get_son(			// get son indexed by <index>
 	int index)							// input index
@@ -697,6 +737,28 @@ BLeafNode* BLeafNode::get_right_sibling()
 	return node;
 }
 
+// -----------------------------------------------------------------------------
+//  Reuse a node restored before to load another block of the same b-tree
+//  (or a b-tree with the same block length). <key_> and <id_> are kept, so
+//  no memory is allocated.
+// -----------------------------------------------------------------------------
+void BLeafNode::reload(				// reuse this node for another block
+	BTree* btree,						// b-tree of this node
+	int block,							// address of file of this node
+	char* blk)							// buffer of one block
+{
+	if (key_ == NULL) {				// first time: allocate arrays
+		init_restore(btree, block);
+		return;
+	}
+	btree_ = btree;
+	block_ = block;
+	dirty_ = false;
+
+	btree_->file_->read_block(blk, block);
+	read_from_buffer(blk);
+}
+
 // -----------------------------------------------------------------------------
 int BLeafNode::get_key_size(		// get key size of this node
 	int _block_length)					// block length
@@ -51,6 +51,12 @@ public:
 
 	int get_level();				// get <level_>
 
+	BTree* get_btree();				// get <btree_>
+
+	int get_left_sibling_addr();	// get addr of left sibling node
+
+	int get_right_sibling_addr();	// get addr of right sibling node
+
 	// -------------------------------------------------------------------------
 	int  get_header_size();			// get header size in b-node
 
@@ -120,6 +126,12 @@ public:
 									// get right sibling node
 	virtual BIndexNode* get_right_sibling();
 
+	// -------------------------------------------------------------------------
+	void reload(					// reuse this node for another block
+		BTree* btree,					// b-tree of this node
+		int block,						// address of file of this node
+		char* blk);						// buffer of one block
+
 	// -------------------------------------------------------------------------
 	int get_son(					// get <son_> indexed by <index>
 		int index);						// index
@@ -174,6 +186,12 @@ public:
 									// get right sibling node
 	virtual BLeafNode* get_right_sibling();
 
+	// -------------------------------------------------------------------------
+	void reload(					// reuse this node for another block
+		BTree* btree,					// b-tree of this node
+		int block,						// address of file of this node
+		char* blk);						// buffer of one block
+
 	// -------------------------------------------------------------------------
 	int get_key_size(				// get key size of this node
 		int block_length);				// block length
@@ -48,6 +48,7 @@ void BTree::init(					// init a new tree
 	}
 									// init <file>, b-tree store here
 	file_ = new BlockFile(fname, b_length);
+	file_->begin_buffered_write();	// written to disk when <file_> is closed
 
 	// -------------------------------------------------------------------------
 	//  Init the first node: to store <blocklength> (page size of a node),
@@ -31,6 +31,9 @@ BlockFile::BlockFile(				// constructor
 	block_length_ = b_length;
 
 	num_blocks_ = 0;				// num of blocks, init to 0
+	source_ = NULL;					// read blocks from <fp_> by default
+	wbuf_ = NULL;					// write blocks to <fp_> by default
+	wbuf_cap_ = 0;
 	// -------------------------------------------------------------------------
 	//  Init <fp> and open <file_name_>. If <file_name_> exists, then fp != 0,
 	//  and we excute if-clause program. Otherwise, we excute else-clause 
@@ -105,6 +108,12 @@ BlockFile::BlockFile(				// constructor
 // -----------------------------------------------------------------------------
 BlockFile::~BlockFile()				// destructor
 {
+	if (wbuf_) {					// write back the buffered blocks
+		flush_buffered_write();
+	}
+	if (source_) {					// release <source_>
+		delete source_; source_ = NULL;
+	}
 	if (file_name_) {				// release space of <file_name_>
 		delete[] file_name_; file_name_ = NULL;
 	}
@@ -210,16 +219,24 @@ bool BlockFile::read_block(			// read a <block> from <index>
 	int index)							// pos of the block
 {
 	index++;						// extrnl block to intrnl block
-									// move to the position
-	if (index <= num_blocks_ && index > 0) {
-		seek_block(index);
-	}
-	else {
+	if (index > num_blocks_ || index <= 0) {
 		printf("BlockFile::read_block request the block %d "
 			"which is illegal.", index - 1);
 		error("\n", true);
 	}
 
+	if (source_) {					// read the block from page source
+		source_->copy_page(index - 1, 0, block_length_, block);
+		return true;
+	}
+	if (wbuf_) {					// read the block from write buffer
+		memcpy(block, wbuf_ + (long) (index - 1) * block_length_,
+			block_length_);
+		return true;
+	}
+
+	std::lock_guard<std::mutex> guard(io_lock_);
+	seek_block(index);				// move to the position
 	get_bytes(block, block_length_);// read the block
 	if (index + 1 > num_blocks_) {	// <fp_> reaches the end of file
 		fseek(fp_, 0, SEEK_SET);
@@ -250,6 +267,11 @@ bool BlockFile::write_block(		// write a <block> into <index>
 			"which is illegal.", index - 1);
 		error("\n", true);
 	}
+	if (wbuf_) {					// write the block to write buffer
+		memcpy(wbuf_ + (long) (index - 1) * block_length_, block,
+			block_length_);
+		return true;
+	}
 	
 	put_bytes(block, block_length_);// write this block
 	if (index + 1 > num_blocks_) {	// update <act_block_>
@@ -269,6 +291,21 @@ bool BlockFile::write_block(		// write a <block> into <index>
 int BlockFile::append_block(		// append new block at the end of file
 	Block block)						// the new block
 {
+	if (wbuf_) {					// append the block to write buffer
+		if (num_blocks_ == wbuf_cap_) {
+			long cap = wbuf_cap_ * 2;
+			char* buf = new char[cap * block_length_];
+			memcpy(buf, wbuf_, wbuf_cap_ * block_length_);
+			delete[] wbuf_; wbuf_ = buf;
+
+			g_memory += (cap - wbuf_cap_) * block_length_;
+			wbuf_cap_ = cap;
+		}
+		memcpy(wbuf_ + (long) num_blocks_ * block_length_, block,
+			block_length_);
+		return num_blocks_++;
+	}
+
 	fseek(fp_, 0, SEEK_END);		// <fp_> point to the end of file
 	put_bytes(block, block_length_);// write a <block>
 	num_blocks_++;					// add 1 to <num_blocks_>
@@ -301,6 +338,8 @@ bool BlockFile::delete_last_blocks(	// delete last <num> blocks
 	}
 
 	num_blocks_ -= num;				// update <number>
+	if (wbuf_) return true;			// header is written by flush
+
 	fseek(fp_, SIZEINT, SEEK_SET);
 	fwrite_number(num_blocks_);
 
@@ -309,3 +348,66 @@ bool BlockFile::delete_last_blocks(	// delete last <num> blocks
 	return true;
 }
 
+// -----------------------------------------------------------------------------
+//  Read data blocks through a page source (lru buffer pool, mmap or memory)
+//  instead of fseek/fread. It is only used for the b-trees which have been
+//  built, since the page source does not see the blocks written later.
+// -----------------------------------------------------------------------------
+void BlockFile::init_page_source(	// read blocks through a page source
+	int type,							// type of page source
+	int capacity)						// num of pages for PAGE_LRU
+{
+	if (source_) {					// release old <source_>
+		delete source_; source_ = NULL;
+	}
+	if (type == PAGE_DIRECT) return;
+
+	BlockFileStore* store = new BlockFileStore(file_name_, block_length_);
+	source_ = create_page_source(type, store, num_blocks_, capacity);
+}
+
+// -----------------------------------------------------------------------------
+//  Keep the data blocks of a new file in memory. Building a b-tree appends a
+//  block, rewrites it when the node is released and reads it back when its
+//  parent is built, so every block costs several seeks on <fp_>. With the
+//  write buffer the whole file is written by flush_buffered_write() in one
+//  sequential pass instead.
+// -----------------------------------------------------------------------------
+void BlockFile::begin_buffered_write()// keep data blocks in memory
+{
+	if (wbuf_ || source_) return;
+
+	wbuf_cap_ = num_blocks_ > 64 ? num_blocks_ : 64;
+	wbuf_ = new char[wbuf_cap_ * block_length_];
+	g_memory += wbuf_cap_ * block_length_;
+
+	for (int i = 0; i < num_blocks_; i++) {
+		seek_block(i + 1);			// load the existing blocks
+		get_bytes(wbuf_ + (long) i * block_length_, block_length_);
+		act_block_ = i + 2;
+	}
+}
+
+// -----------------------------------------------------------------------------
+void BlockFile::flush_buffered_write()// write data blocks to disk
+{
+	if (wbuf_ == NULL) return;
+
+	const long CHUNK = 64L * 1024 * 1024;
+	long total = (long) num_blocks_ * block_length_;
+
+	fseeko(fp_, (off_t) block_length_, SEEK_SET);
+	for (long pos = 0; pos < total; pos += CHUNK) {
+		long len = total - pos < CHUNK ? total - pos : CHUNK;
+		put_bytes(wbuf_ + pos, (int) len);
+	}
+	fseek(fp_, SIZEINT, SEEK_SET);	// update <num_blocks_>
+	fwrite_number(num_blocks_);
+
+	fseek(fp_, 0, SEEK_SET);
+	act_block_ = 0;
+
+	g_memory -= wbuf_cap_ * block_length_;
+	delete[] wbuf_; wbuf_ = NULL;
+	wbuf_cap_ = 0;
+}
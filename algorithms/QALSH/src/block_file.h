@@ -14,6 +14,11 @@ public:
 	int block_length_;				// length of a block
 	int act_block_;					// block num of fp position
 	int num_blocks_;				// total num of blocks
+	PageSource* source_;			// page source for reading blocks
+	std::mutex io_lock_;			// lock of <fp_> for reading blocks
+
+	char* wbuf_;					// data blocks kept in memory when building
+	long  wbuf_cap_;				// capacity of <wbuf_> (in blocks)
 
 	// -------------------------------------------------------------------------
 	BlockFile(						// constructor
@@ -70,6 +75,16 @@ public:
 
 	bool delete_last_blocks(		// delete last <num> blocks
 		int num);						// num of blocks to be deleted
+
+	// -------------------------------------------------------------------------
+	void init_page_source(			// read blocks through a page source
+		int type,						// type of page source
+		int capacity);					// num of pages for PAGE_LRU
+
+	// -------------------------------------------------------------------------
+	void begin_buffered_write();	// keep data blocks in memory until flush
+
+	void flush_buffered_write();	// write data blocks to disk sequentially
 };
 
 
@@ -31,6 +31,9 @@
 #include <ctime>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include <time.h>
 
 // -----------------------------------------------------------------------------
@@ -41,6 +44,8 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 
 // -----------------------------------------------------------------------------
 //  For Windows directory
@@ -52,6 +57,7 @@
 #include "def.h"
 #include "util.h"
 #include "random.h"
+#include "page_cache.h"
 #include "block_file.h"
 #include "b_node.h"
 #include "b_tree.h"
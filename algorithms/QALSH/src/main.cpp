@@ -13,16 +13,20 @@ void usage() 						// display the usage of qalsh
 		"    -ds   (string)    file path of the dataset\n"
 		"    -qs   (string)    file path of the query set\n"
 		"    -ts   (string)    file path of the ground truth set\n"
-		"    -of   (string)    output folder to store info of qalsh\n\n");
+		"    -of   (string)    output folder to store info of qalsh\n"
+		"    -pc   (integer)   page cache: 0 - none, 1 - lru, 2 - mmap, "
+		"3 - memory\n"
+		"    -cp   (integer)   num of pages of lru buffer pool\n"
+		"    -t    (integer)   num of threads for indexing and k-nn search\n\n");
 
 	printf("\n"
 		"The options of algorithms (-alg) are:\n"
 		"    0 - Ground-Truth\n"
 		"        Parameters: -alg 0 -n -qn -d -p -ds -qs -ts\n\n"
 		"    1 - Indexing\n"
-		"        Parameters: -alg 1 -n -d -B -p -c -ds -of\n\n"
+		"        Parameters: -alg 1 -n -d -B -p -c -ds -of [-t]\n\n"
 		"    2 - QALSH\n"
-		"        Parameters: -alg 2 -qn -d -p -qs -ts -of\n\n"
+		"        Parameters: -alg 2 -qn -d -p -qs -ts -of [-pc -cp -t]\n\n"
 		"    3 - Linear Scan\n"
 		"        Parameters: -alg 3 -n -qn -d -B -p -qs -ts -of\n\n");
 
@@ -43,6 +47,9 @@ int main(int nargs, char **args)
 	int B   = -1;					// page size
 	int N   =100 ;
 	float ratio = -1.0f;			// approximation ratio
+	int cache_type  = PAGE_DIRECT;	// type of page source
+	int cache_pages = 1024;			// num of pages of lru buffer pool
+	int num_threads = 1;			// num of threads (indexing and k-nn)
 
 	char  data_set[200];			// address of data set
 	char  query_set[200];			// address of query set
@@ -112,6 +119,30 @@ int main(int nargs, char **args)
 				break;
 			}
 		}
+		else if (strcmp(args[cnt], "-pc") == 0) {
+			cache_type = atoi(args[++cnt]);
+			printf("page cache = %d\n", cache_type);
+			if (cache_type < PAGE_DIRECT || cache_type > PAGE_MEMORY) {
+				failed = true;
+				break;
+			}
+		}
+		else if (strcmp(args[cnt], "-cp") == 0) {
+			cache_pages = atoi(args[++cnt]);
+			printf("cache pages = %d\n", cache_pages);
+			if (cache_pages <= 0) {
+				failed = true;
+				break;
+			}
+		}
+		else if (strcmp(args[cnt], "-t") == 0) {
+			num_threads = atoi(args[++cnt]);
+			printf("threads = %d\n", num_threads);
+			if (num_threads <= 0) {
+				failed = true;
+				break;
+			}
+		}
 		else if (strcmp(args[cnt], "-ds") == 0) {
 			strncpy(data_set, args[++cnt], sizeof(data_set));
 			printf("dataset = %s\n", data_set);
@@ -157,10 +188,12 @@ int main(int nargs, char **args)
 		ground_truth(n, qn, d, data_set, query_set, truth_set);
 		break;
 	case 1:
-		indexing(n, d, B, ratio, N, data_set, output_folder, index_folder);
+		indexing(n, d, B, ratio, N, data_set, output_folder, index_folder,
+			num_threads);
 		break;
 	case 2:
-		lshknn(qn, d, N,query_set, truth_set, output_folder,result_folder, ratio, B);
+		lshknn(qn, d, N,query_set, truth_set, output_folder,result_folder, ratio, B,
+			cache_type, cache_pages, num_threads);
 		break;
 	case 3:
 		linear_scan(n, qn, d, B, query_set, truth_set, output_folder);
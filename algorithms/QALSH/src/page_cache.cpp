@@ -0,0 +1,517 @@
+#include "headers.h"
+
+
+// -----------------------------------------------------------------------------
+//  PageStore: where the pages are stored on disk
+// -----------------------------------------------------------------------------
+PageStore::PageStore(				// constructor
+	int page_size)						// page size
+{
+	page_size_ = page_size;
+}
+
+// -----------------------------------------------------------------------------
+PageStore::~PageStore()				// destructor
+{
+}
+
+
+// -----------------------------------------------------------------------------
+//  BlockFileStore: pages are the data blocks of one block file
+// -----------------------------------------------------------------------------
+BlockFileStore::BlockFileStore(		// constructor
+	char* fname,						// file name of block file
+	int page_size)						// page size (block length)
+	: PageStore(page_size)
+{
+	base_   = NULL;
+	length_ = 0;
+
+	fp_ = fopen(fname, "rb");		// use its own file pointer, so that the
+	if (!fp_) {						// pos of <fp_> of BlockFile is not moved
+		printf("BlockFileStore could not open %s.\n", fname);
+		error("", true);
+	}
+}
+
+// -----------------------------------------------------------------------------
+BlockFileStore::~BlockFileStore()	// destructor
+{
+	if (base_ != NULL) {
+		munmap(base_, length_); base_ = NULL;
+	}
+	if (fp_) fclose(fp_);
+}
+
+// -----------------------------------------------------------------------------
+int BlockFileStore::read_page(		// read a page from disk
+	int page_id,						// page id
+	char* buf)							// buffer of one page (return)
+{
+									// skip the header block
+	off_t pos = (off_t) (page_id + 1) * page_size_;
+	if (fseeko(fp_, pos, SEEK_SET) != 0) return 1;
+	if (fread(buf, page_size_, 1, fp_) != 1) return 1;
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+const char* BlockFileStore::map_page(// map a page into memory by mmap
+	int page_id)						// page id
+{
+	if (base_ == NULL) {			// map the whole file at the first time
+		struct stat st;
+		if (fstat(fileno(fp_), &st) != 0) return NULL;
+
+		length_ = (long) st.st_size;
+		void* addr = mmap(NULL, length_, PROT_READ, MAP_SHARED,
+			fileno(fp_), 0);
+		if (addr == MAP_FAILED) return NULL;
+		base_ = (char*) addr;
+	}
+
+	long pos = (long) (page_id + 1) * page_size_;
+	if (pos + page_size_ > length_) return NULL;
+
+	return base_ + pos;
+}
+
+
+// -----------------------------------------------------------------------------
+//  DataPageStore: pages are the data files "<data_path>/<page_id>.data"
+// -----------------------------------------------------------------------------
+DataPageStore::DataPageStore(		// constructor
+	char* data_path,					// path of data files
+	int page_size,						// page size
+	int num_pages)						// number of data files
+	: PageStore(page_size)
+{
+	strcpy(data_path_, data_path);
+	num_pages_ = num_pages;
+
+	maps_ = new char*[num_pages_];
+	for (int i = 0; i < num_pages_; i++) {
+		maps_[i] = NULL;
+	}
+}
+
+// -----------------------------------------------------------------------------
+DataPageStore::~DataPageStore()		// destructor
+{
+	if (maps_ != NULL) {
+		for (int i = 0; i < num_pages_; i++) {
+			if (maps_[i] != NULL) munmap(maps_[i], page_size_);
+		}
+		delete[] maps_; maps_ = NULL;
+	}
+}
+
+// -----------------------------------------------------------------------------
+int DataPageStore::read_page(		// read a page from disk
+	int page_id,						// page id
+	char* buf)							// buffer of one page (return)
+{
+	get_data_filename(page_id, data_path_, fname_);
+	return read_buffer_from_page(page_size_, fname_, buf);
+}
+
+// -----------------------------------------------------------------------------
+const char* DataPageStore::map_page(// map a page into memory by mmap
+	int page_id)						// page id
+{
+	if (maps_[page_id] != NULL) return maps_[page_id];
+
+	get_data_filename(page_id, data_path_, fname_);
+	int fd = open(fname_, O_RDONLY);
+	if (fd < 0) {
+		printf("DataPageStore::map_page could not open %s.\n", fname_);
+		return NULL;
+	}
+
+	void* addr = mmap(NULL, page_size_, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);						// the mapping is kept after close
+	if (addr == MAP_FAILED) return NULL;
+
+	maps_[page_id] = (char*) addr;
+	return maps_[page_id];
+}
+
+// -----------------------------------------------------------------------------
+void DataPageStore::unmap_page(		// release a page mapped by map_page()
+	int page_id)						// page id
+{
+	if (maps_[page_id] != NULL) {
+		munmap(maps_[page_id], page_size_); maps_[page_id] = NULL;
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+//  PageSource: page layer between the b-trees (or data pages) and the disk
+// -----------------------------------------------------------------------------
+PageSource::PageSource(				// constructor
+	PageStore* store,					// page store
+	int num_pages)						// number of pages
+{
+	store_ = store;
+	num_pages_ = num_pages;
+	hits_ = misses_ = 0;
+}
+
+// -----------------------------------------------------------------------------
+PageSource::~PageSource()			// destructor
+{
+	if (store_ != NULL) {
+		delete store_; store_ = NULL;
+	}
+}
+
+// -----------------------------------------------------------------------------
+void PageSource::copy_page(			// copy part of a page (thread safe)
+	int page_id,						// page id
+	int offset,							// offset in the page
+	int length,							// num of bytes to copy
+	char* buf)							// buffer (return)
+{
+	memcpy(buf, get_page(page_id) + offset, length);
+}
+
+
+// -----------------------------------------------------------------------------
+//  LRUPageSource: buffer pool of <capacity_> pages with lru replacement
+// -----------------------------------------------------------------------------
+LRUPageSource::LRUPageSource(		// constructor
+	PageStore* store,					// page store
+	int num_pages,						// number of pages
+	int capacity)						// num of pages in buffer pool
+	: PageSource(store, num_pages)
+{
+	if (capacity < 1) capacity = 1;	// at least one frame
+	if (capacity > num_pages && num_pages > 0) capacity = num_pages;
+
+	capacity_ = capacity;
+	used_ = 0;
+	head_ = tail_ = -1;
+
+	int page_size = store_->get_page_size();
+	pool_ = new char[(long) capacity_ * page_size];
+	frame_page_ = new int[capacity_];
+	prev_ = new int[capacity_];
+	next_ = new int[capacity_];
+	for (int i = 0; i < capacity_; i++) {
+		frame_page_[i] = -1;
+		prev_[i] = next_[i] = -1;
+	}
+
+	page_frame_ = new int[num_pages_];
+	for (int i = 0; i < num_pages_; i++) {
+		page_frame_[i] = -1;
+	}
+	g_memory += (long) capacity_ * (page_size + SIZEINT * 3);
+	g_memory += (long) SIZEINT * num_pages_;
+}
+
+// -----------------------------------------------------------------------------
+LRUPageSource::~LRUPageSource()		// destructor
+{
+	g_memory -= (long) capacity_ * (store_->get_page_size() + SIZEINT * 3);
+	g_memory -= (long) SIZEINT * num_pages_;
+
+	delete[] pool_; pool_ = NULL;
+	delete[] frame_page_; frame_page_ = NULL;
+	delete[] page_frame_; page_frame_ = NULL;
+	delete[] prev_; prev_ = NULL;
+	delete[] next_; next_ = NULL;
+}
+
+// -----------------------------------------------------------------------------
+void LRUPageSource::unlink_frame(	// remove a frame from lru list
+	int frame)							// frame id
+{
+	if (prev_[frame] != -1) next_[prev_[frame]] = next_[frame];
+	else head_ = next_[frame];
+
+	if (next_[frame] != -1) prev_[next_[frame]] = prev_[frame];
+	else tail_ = prev_[frame];
+
+	prev_[frame] = next_[frame] = -1;
+}
+
+// -----------------------------------------------------------------------------
+void LRUPageSource::push_front(		// insert a frame as most recently used
+	int frame)							// frame id
+{
+	prev_[frame] = -1;
+	next_[frame] = head_;
+	if (head_ != -1) prev_[head_] = frame;
+	head_ = frame;
+	if (tail_ == -1) tail_ = frame;
+}
+
+// -----------------------------------------------------------------------------
+const char* LRUPageSource::get_page(// get a page (valid until next call)
+	int page_id)						// page id
+{
+	int page_size = store_->get_page_size();
+	int frame = page_frame_[page_id];
+
+	if (frame != -1) {				// page hit
+		hits_++;
+		if (frame != head_) {
+			unlink_frame(frame);
+			push_front(frame);
+		}
+		return pool_ + (long) frame * page_size;
+	}
+
+	misses_++;						// page miss
+	if (used_ < capacity_) {		// use a free frame
+		frame = used_++;
+	}
+	else {							// evict the least recently used frame
+		frame = tail_;
+		unlink_frame(frame);
+		page_frame_[frame_page_[frame]] = -1;
+	}
+
+	char* buf = pool_ + (long) frame * page_size;
+	if (store_->read_page(page_id, buf)) {
+		printf("LRUPageSource::get_page could not read page %d.\n", page_id);
+		error("", true);
+	}
+	frame_page_[frame] = page_id;
+	page_frame_[page_id] = frame;
+	push_front(frame);
+
+	return buf;
+}
+
+// -----------------------------------------------------------------------------
+//  The page returned by get_page() may be evicted by another thread, so the
+//  copy is done while holding <lock_>.
+// -----------------------------------------------------------------------------
+void LRUPageSource::copy_page(		// copy part of a page (thread safe)
+	int page_id,						// page id
+	int offset,							// offset in the page
+	int length,							// num of bytes to copy
+	char* buf)							// buffer (return)
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	memcpy(buf, get_page(page_id) + offset, length);
+}
+
+
+// -----------------------------------------------------------------------------
+//  MmapPageSource: pages are mapped by mmap and left to the os page cache
+// -----------------------------------------------------------------------------
+MmapPageSource::MmapPageSource(		// constructor
+	PageStore* store,					// page store
+	int num_pages)						// number of pages
+	: PageSource(store, num_pages)
+{
+	pages_ = new std::atomic<const char*>[num_pages_];
+	for (int i = 0; i < num_pages_; i++) {
+		pages_[i] = NULL;
+	}
+
+	max_maps_ = store_->get_max_maps();
+	if (max_maps_ >= num_pages_) max_maps_ = 0;
+	used_ = 0;
+	head_ = tail_ = -1;
+	prev_ = next_ = NULL;
+	if (max_maps_ > 0) {
+		prev_ = new int[num_pages_];
+		next_ = new int[num_pages_];
+		for (int i = 0; i < num_pages_; i++) {
+			prev_[i] = next_[i] = -1;
+		}
+		g_memory += (long) SIZEINT * 2 * num_pages_;
+	}
+}
+
+// -----------------------------------------------------------------------------
+MmapPageSource::~MmapPageSource()	// destructor
+{
+	delete[] pages_; pages_ = NULL;	// mappings are released by <store_>
+	if (max_maps_ > 0) {
+		g_memory -= (long) SIZEINT * 2 * num_pages_;
+		delete[] prev_; prev_ = NULL;
+		delete[] next_; next_ = NULL;
+	}
+}
+
+// -----------------------------------------------------------------------------
+//  A miss means the page is mapped for the first time. Whether the os has
+//  to fetch it from disk is not visible here.
+// -----------------------------------------------------------------------------
+const char* MmapPageSource::get_page(// get a page
+	int page_id)						// page id
+{
+	if (max_maps_ > 0) return get_lru_page(page_id);
+
+	const char* page = pages_[page_id];
+	if (page != NULL) {
+		hits_++;
+		return page;
+	}
+
+	std::lock_guard<std::mutex> guard(lock_);
+	page = pages_[page_id];			// mapped by another thread
+	if (page != NULL) {
+		hits_++;
+		return page;
+	}
+
+	misses_++;
+	page = store_->map_page(page_id);
+	if (page == NULL) {
+		printf("MmapPageSource::get_page could not map page %d.\n", page_id);
+		error("", true);
+	}
+	pages_[page_id] = page;
+	return page;
+}
+
+// -----------------------------------------------------------------------------
+//  A mapped page may be unmapped by another thread once mappings are limited,
+//  so the copy is done while holding <lock_>.
+// -----------------------------------------------------------------------------
+void MmapPageSource::copy_page(		// copy part of a page (thread safe)
+	int page_id,						// page id
+	int offset,							// offset in the page
+	int length,							// num of bytes to copy
+	char* buf)							// buffer (return)
+{
+	if (max_maps_ == 0) {
+		PageSource::copy_page(page_id, offset, length, buf);
+		return;
+	}
+	std::lock_guard<std::mutex> guard(lock_);
+	memcpy(buf, get_lru_page(page_id) + offset, length);
+}
+
+// -----------------------------------------------------------------------------
+void MmapPageSource::unlink_page(	// remove a page from lru list
+	int page_id)						// page id
+{
+	if (prev_[page_id] != -1) next_[prev_[page_id]] = next_[page_id];
+	else head_ = next_[page_id];
+
+	if (next_[page_id] != -1) prev_[next_[page_id]] = prev_[page_id];
+	else tail_ = prev_[page_id];
+
+	prev_[page_id] = next_[page_id] = -1;
+}
+
+// -----------------------------------------------------------------------------
+void MmapPageSource::push_front(	// insert a page as most recently used
+	int page_id)						// page id
+{
+	prev_[page_id] = -1;
+	next_[page_id] = head_;
+	if (head_ != -1) prev_[head_] = page_id;
+	head_ = page_id;
+	if (tail_ == -1) tail_ = page_id;
+}
+
+// -----------------------------------------------------------------------------
+//  Called with <lock_> held (or by a single thread). When <max_maps_> pages
+//  are mapped, the least recently used one is unmapped first.
+// -----------------------------------------------------------------------------
+const char* MmapPageSource::get_lru_page(// get a page when mappings are limited
+	int page_id)						// page id
+{
+	const char* page = pages_[page_id];
+	if (page != NULL) {
+		hits_++;
+		if (page_id != head_) {
+			unlink_page(page_id);
+			push_front(page_id);
+		}
+		return page;
+	}
+
+	misses_++;
+	if (used_ < max_maps_) {
+		used_++;
+	}
+	else {							// unmap the least recently used page
+		int victim = tail_;
+		unlink_page(victim);
+		store_->unmap_page(victim);
+		pages_[victim] = NULL;
+	}
+
+	page = store_->map_page(page_id);
+	if (page == NULL) {
+		printf("MmapPageSource::get_page could not map page %d.\n", page_id);
+		error("", true);
+	}
+	pages_[page_id] = page;
+	push_front(page_id);
+	return page;
+}
+
+
+// -----------------------------------------------------------------------------
+//  MemoryPageSource: all pages are loaded into memory in the constructor
+// -----------------------------------------------------------------------------
+MemoryPageSource::MemoryPageSource(	// constructor
+	PageStore* store,					// page store
+	int num_pages)						// number of pages
+	: PageSource(store, num_pages)
+{
+	int page_size = store_->get_page_size();
+	pages_ = new char[(long) num_pages_ * page_size];
+	g_memory += (long) num_pages_ * page_size;
+
+	for (int i = 0; i < num_pages_; i++) {
+		if (store_->read_page(i, pages_ + (long) i * page_size)) {
+			printf("MemoryPageSource could not read page %d.\n", i);
+			error("", true);
+		}
+	}
+	misses_ = num_pages_;			// every page is read once
+}
+
+// -----------------------------------------------------------------------------
+MemoryPageSource::~MemoryPageSource()// destructor
+{
+	g_memory -= (long) num_pages_ * store_->get_page_size();
+	delete[] pages_; pages_ = NULL;
+}
+
+// -----------------------------------------------------------------------------
+const char* MemoryPageSource::get_page(// get a page
+	int page_id)						// page id
+{
+	hits_++;
+	return pages_ + (long) page_id * store_->get_page_size();
+}
+
+
+// -----------------------------------------------------------------------------
+PageSource* create_page_source(		// create a page source by its type
+	int type,							// type of page source
+	PageStore* store,					// page store
+	int num_pages,						// number of pages
+	int capacity)						// num of pages for PAGE_LRU
+{
+	PageSource* source = NULL;
+	switch (type) {
+	case PAGE_LRU:
+		source = new LRUPageSource(store, num_pages, capacity);
+		break;
+	case PAGE_MMAP:
+		source = new MmapPageSource(store, num_pages);
+		break;
+	case PAGE_MEMORY:
+		source = new MemoryPageSource(store, num_pages);
+		break;
+	default:						// PAGE_DIRECT: no page source
+		delete store; store = NULL;
+		break;
+	}
+	return source;
+}
@@ -0,0 +1,251 @@
+#ifndef __PAGE_CACHE_H
+#define __PAGE_CACHE_H
+
+
+// -----------------------------------------------------------------------------
+//  Types of page sources. PAGE_DIRECT keeps the original behaviour, i.e.,
+//  every page is read by fseek/fread (b-tree) or fopen/fread (data pages).
+// -----------------------------------------------------------------------------
+const int PAGE_DIRECT = 0;			// no cache, read from disk every time
+const int PAGE_LRU    = 1;			// lru buffer pool of fixed size
+const int PAGE_MMAP   = 2;			// pages are mapped by mmap
+const int PAGE_MEMORY = 3;			// all pages are loaded into memory
+
+// -----------------------------------------------------------------------------
+//  Every data file is mapped on its own, so the number of mappings alive at
+//  the same time is bounded (far below the default vm.max_map_count 65530).
+// -----------------------------------------------------------------------------
+const int MAX_DATA_MAPS = 16384;
+
+// -----------------------------------------------------------------------------
+//  PageStore: where the pages are stored on disk
+// -----------------------------------------------------------------------------
+class PageStore {
+public:
+	PageStore(						// constructor
+		int page_size);					// page size
+	virtual ~PageStore();			// destructor
+
+	// -------------------------------------------------------------------------
+	virtual int read_page(			// read a page from disk
+		int page_id,					// page id
+		char* buf) = 0;					// buffer of one page (return)
+
+	virtual const char* map_page(	// map a page into memory by mmap
+		int page_id) = 0;				// page id
+
+	virtual void unmap_page(		// release a page mapped by map_page()
+		int page_id)					// page id
+	{}
+
+	virtual int get_max_maps()		// max num of pages mapped at the same
+	{ return 0; }					// time (0: no limit)
+
+	int get_page_size()				// get page size
+	{ return page_size_; }
+
+protected:
+	int page_size_;					// page size
+};
+
+// -----------------------------------------------------------------------------
+//  BlockFileStore: pages are the data blocks of one block file. The first
+//  block (header block) of the file is skipped.
+// -----------------------------------------------------------------------------
+class BlockFileStore : public PageStore {
+public:
+	BlockFileStore(					// constructor
+		char* fname,					// file name of block file
+		int page_size);					// page size (block length)
+	virtual ~BlockFileStore();		// destructor
+
+	// -------------------------------------------------------------------------
+	virtual int read_page(			// read a page from disk
+		int page_id,					// page id
+		char* buf);						// buffer of one page (return)
+
+	virtual const char* map_page(	// map a page into memory by mmap
+		int page_id);					// page id
+
+protected:
+	FILE* fp_;						// file pointer
+	char* base_;					// mmap address of the whole file
+	long  length_;					// length of the file
+};
+
+// -----------------------------------------------------------------------------
+//  DataPageStore: pages are the data files "<data_path>/<page_id>.data"
+//  produced by write_data_new_form().
+// -----------------------------------------------------------------------------
+class DataPageStore : public PageStore {
+public:
+	DataPageStore(					// constructor
+		char* data_path,				// path of data files
+		int page_size,					// page size
+		int num_pages);					// number of data files
+	virtual ~DataPageStore();		// destructor
+
+	// -------------------------------------------------------------------------
+	virtual int read_page(			// read a page from disk
+		int page_id,					// page id
+		char* buf);						// buffer of one page (return)
+
+	virtual const char* map_page(	// map a page into memory by mmap
+		int page_id);					// page id
+
+	virtual void unmap_page(		// release a page mapped by map_page()
+		int page_id);					// page id
+
+	virtual int get_max_maps()		// max num of pages mapped at the same
+	{ return MAX_DATA_MAPS; }		// time
+
+protected:
+	char  data_path_[200];			// path of data files
+	char  fname_[200];				// file name buffer
+	int   num_pages_;				// number of data files
+	char** maps_;					// mmap address of each data file
+};
+
+// -----------------------------------------------------------------------------
+//  PageSource: page layer between the b-trees (or data pages) and the disk.
+//  It counts page hits and misses, where a miss means the page has to be
+//  fetched from <store_>. copy_page() can be called by several threads.
+// -----------------------------------------------------------------------------
+class PageSource {
+public:
+	PageSource(						// constructor
+		PageStore* store,				// page store (owned by page source)
+		int num_pages);					// number of pages
+	virtual ~PageSource();			// destructor
+
+	// -------------------------------------------------------------------------
+	virtual const char* get_page(	// get a page (valid until next call)
+		int page_id) = 0;				// page id
+
+	virtual void copy_page(			// copy part of a page (thread safe)
+		int page_id,					// page id
+		int offset,						// offset in the page
+		int length,						// num of bytes to copy
+		char* buf);						// buffer (return)
+
+	int get_page_size()				// get page size
+	{ return store_->get_page_size(); }
+
+	// -------------------------------------------------------------------------
+	std::atomic<long> hits_;		// num of page hits
+	std::atomic<long> misses_;		// num of page misses
+
+protected:
+	PageStore* store_;				// page store
+	int num_pages_;					// number of pages
+};
+
+// -----------------------------------------------------------------------------
+//  LRUPageSource: buffer pool of <capacity_> pages with lru replacement
+// -----------------------------------------------------------------------------
+class LRUPageSource : public PageSource {
+public:
+	LRUPageSource(					// constructor
+		PageStore* store,				// page store
+		int num_pages,					// number of pages
+		int capacity);					// num of pages in buffer pool
+	virtual ~LRUPageSource();		// destructor
+
+	virtual const char* get_page(	// get a page (valid until next call)
+		int page_id);					// page id
+
+	virtual void copy_page(			// copy part of a page (thread safe)
+		int page_id,					// page id
+		int offset,						// offset in the page
+		int length,						// num of bytes to copy
+		char* buf);						// buffer (return)
+
+protected:
+	std::mutex lock_;				// lock of buffer pool
+	int   capacity_;				// num of frames in buffer pool
+	int   used_;					// num of frames in use
+	char* pool_;					// buffer pool
+	int*  frame_page_;				// page id of each frame
+	int*  page_frame_;				// frame of each page (-1 if not cached)
+	int*  prev_;					// lru list: previous frame
+	int*  next_;					// lru list: next frame
+	int   head_;					// most recently used frame
+	int   tail_;					// least recently used frame
+
+	// -------------------------------------------------------------------------
+	void unlink_frame(				// remove a frame from lru list
+		int frame);						// frame id
+
+	void push_front(				// insert a frame as most recently used
+		int frame);						// frame id
+};
+
+// -----------------------------------------------------------------------------
+//  MmapPageSource: pages are mapped by mmap and left to the os page cache.
+//  If the store limits the number of mappings (see get_max_maps()), the
+//  least recently used page is unmapped when the limit is reached.
+// -----------------------------------------------------------------------------
+class MmapPageSource : public PageSource {
+public:
+	MmapPageSource(					// constructor
+		PageStore* store,				// page store
+		int num_pages);					// number of pages
+	virtual ~MmapPageSource();		// destructor
+
+	virtual const char* get_page(	// get a page (valid until next call
+		int page_id);					// if mappings are limited)
+
+	virtual void copy_page(			// copy part of a page (thread safe)
+		int page_id,					// page id
+		int offset,						// offset in the page
+		int length,						// num of bytes to copy
+		char* buf);						// buffer (return)
+
+protected:
+	std::mutex lock_;				// lock for mapping a new page
+									// mapped address of each page
+	std::atomic<const char*>* pages_;
+	int   max_maps_;				// max num of mapped pages (0: no limit)
+	int   used_;					// num of mapped pages
+	int*  prev_;					// lru list: previous page
+	int*  next_;					// lru list: next page
+	int   head_;					// most recently used page
+	int   tail_;					// least recently used page
+
+	// -------------------------------------------------------------------------
+	const char* get_lru_page(		// get a page when mappings are limited
+		int page_id);					// page id
+
+	void unlink_page(				// remove a page from lru list
+		int page_id);					// page id
+
+	void push_front(				// insert a page as most recently used
+		int page_id);					// page id
+};
+
+// -----------------------------------------------------------------------------
+//  MemoryPageSource: all pages are loaded into memory in the constructor
+// -----------------------------------------------------------------------------
+class MemoryPageSource : public PageSource {
+public:
+	MemoryPageSource(				// constructor
+		PageStore* store,				// page store
+		int num_pages);					// number of pages
+	virtual ~MemoryPageSource();	// destructor
+
+	virtual const char* get_page(	// get a page
+		int page_id);					// page id
+
+protected:
+	char* pages_;					// all pages
+};
+
+// -----------------------------------------------------------------------------
+PageSource* create_page_source(		// create a page source by its type
+	int type,							// type of page source
+	PageStore* store,					// page store
+	int num_pages,						// number of pages
+	int capacity);						// num of pages for PAGE_LRU
+
+
+#endif
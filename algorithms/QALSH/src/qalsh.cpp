@@ -16,6 +16,11 @@ QALSH::QALSH()						// constructor
 
 	a_array_ = NULL;
 	trees_ = NULL;
+	ctx_ = NULL;
+
+	cache_type_ = PAGE_DIRECT;
+	cache_pages_ = 0;
+	data_source_ = NULL;
 }
 
 // -----------------------------------------------------------------------------
@@ -32,6 +37,13 @@ QALSH::~QALSH()						// destructor
 		}
 		delete[] trees_; trees_ = NULL;
 	}
+
+	if (ctx_) {
+		delete ctx_; ctx_ = NULL;
+	}
+	if (data_source_) {
+		delete data_source_; data_source_ = NULL;
+	}
 }
 
 // -----------------------------------------------------------------------------
@@ -138,12 +150,16 @@ void QALSH::gen_hash_func()			// generate hash function <a_array>
 
 // -----------------------------------------------------------------------------
 int QALSH::bulkload(				// build m b-trees by bulkloading
-	float** data)						// data set
+	float** data,						// data set
+	int num_threads)					// number of threads
 {
+	if (num_threads < 1) num_threads = 1;
+	if (num_threads > m_) num_threads = m_;
+
 	// -------------------------------------------------------------------------
 	//  Check whether the default maximum memory is enough
 	// -------------------------------------------------------------------------
-	g_memory += sizeof(HashValue) * n_pts_;
+	g_memory += (long) sizeof(HashValue) * n_pts_ * num_threads;
 	if (check_mem()) {
 		printf("*** memory = %.2f MB\n\n", g_memory / (1024.0f * 1024.0f));
 		return 1;
@@ -202,41 +218,61 @@ int QALSH::bulkload(				// build m b-trees by bulkloading
 	if (write_para_file(fname)) return 1;
 
 	// -------------------------------------------------------------------------
-	//  Write the hash tables (indexed by b+ tree) to the disk
+	//  Write the hash tables (indexed by b+ tree) to the disk. The tables are
+	//  built in groups of <num_threads>: the hash values of a group are
+	//  computed in one pass over the data set, then each table of the group
+	//  is sorted and bulkloaded by its own thread.
 	// -------------------------------------------------------------------------
 									// dataset sorted by hash value
-	HashValue* hashtable = new HashValue[n_pts_];
-	for (int i = 0; i < m_; i++) {
-		printf("    Tree %3d (out of %d)\n", i + 1, m_);
+	HashValue** hashtables = new HashValue*[num_threads];
+	for (int t = 0; t < num_threads; t++) {
+		hashtables[t] = new HashValue[n_pts_];
+	}
+
+	int ret = 0;
+	for (int i = 0; i < m_ && ret == 0; i += num_threads) {
+		int num = MIN(num_threads, m_ - i);
+		printf("    Tree %3d - %3d (out of %d)\n", i + 1, i + num, m_);
 
 		printf("        Computing Hash Values...\n");
-		for (int j = 0; j < n_pts_; j++) {
-			hashtable[j].id_ = j;
-			hashtable[j].proj_ = calc_hash_value(i, data[j]);
+		calc_hash_values(i, num, data, hashtables, num_threads);
+
+		printf("        Sorting and Bulkloading...\n");
+		std::atomic<int> failed(0);
+		std::vector<std::thread> workers;
+		for (int t = 0; t < num; t++) {
+			workers.push_back(std::thread([&, t]() {
+				HashValue* hashtable = hashtables[t];
+				qsort(hashtable, n_pts_, sizeof(HashValue), HashValueQsortComp);
+
+				char tree_fname[200];
+				get_tree_filename(i + t, tree_fname);
+
+				BTree *bt = new BTree();
+				bt->init(tree_fname, B_);
+				if (bt->bulkload(hashtable, n_pts_)) {
+					failed = 1;
+				}
+				delete bt; bt = NULL;
+			}));
 		}
-
-		printf("        Sorting...\n");
-		qsort(hashtable, n_pts_, sizeof(HashValue), HashValueQsortComp);
-
-		printf("        Bulkloading...\n");
-		get_tree_filename(i, fname);
-
-		BTree *bt = new BTree();
-		bt->init(fname, B_);
-		if (bt->bulkload(hashtable, n_pts_)) {
-			return 1;
+		for (int t = 0; t < num; t++) {
+			workers[t].join();
 		}
-		delete bt; bt = NULL;
+		ret = failed;
 	}
 
 	// -------------------------------------------------------------------------
 	//  Release space
 	// -------------------------------------------------------------------------
-	if (hashtable != NULL) {
-		delete[] hashtable; hashtable = NULL;
-		g_memory -= sizeof(HashValue) * n_pts_;
+	if (hashtables != NULL) {
+		for (int t = 0; t < num_threads; t++) {
+			delete[] hashtables[t]; hashtables[t] = NULL;
+		}
+		delete[] hashtables; hashtables = NULL;
+		g_memory -= (long) sizeof(HashValue) * n_pts_ * num_threads;
 	}
-	return 0;						// success to return
+	return ret;						// 0: success, 1: fail
 }
 
 // -----------------------------------------------------------------------------
@@ -299,6 +335,62 @@ float QALSH::calc_hash_value(		// calc hash value
 	return ret;
 }
 
+// -----------------------------------------------------------------------------
+//  Calc the hash values of tables <first> to <first + num - 1> for all data
+//  points, i.e., the product of the data set (n x d) and the hash functions
+//  of these tables (d x num). The hash functions are transposed, so that
+//  the inner loop runs over the tables and is vectorized by the compiler.
+//  The products are added in the same order as calc_hash_value(), thus the
+//  hash values are the same. The data points are split among the threads.
+// -----------------------------------------------------------------------------
+void QALSH::calc_hash_values(		// calc hash values of several tables
+	int first,							// first hash table id
+	int num,							// number of hash tables
+	float** data,						// data set
+	HashValue** tables,					// hash tables (return)
+	int num_threads)					// number of threads
+{
+	float* a_trans = new float[dim_ * num];
+	for (int t = 0; t < num; t++) {
+		for (int i = 0; i < dim_; i++) {
+			a_trans[i * num + t] = a_array_[(first + t) * dim_ + i];
+		}
+	}
+
+	if (num_threads > n_pts_) num_threads = n_pts_;
+	int step = (n_pts_ + num_threads - 1) / num_threads;
+
+	std::vector<std::thread> workers;
+	for (int t = 0; t < num_threads; t++) {
+		int start = t * step;
+		int end = MIN(start + step, n_pts_);
+		workers.push_back(std::thread([=]() {
+			float* sum = new float[num];
+			for (int j = start; j < end; j++) {
+				for (int k = 0; k < num; k++) sum[k] = 0.0f;
+
+				const float* point = data[j];
+				for (int i = 0; i < dim_; i++) {
+					const float* a = a_trans + i * num;
+					float x = point[i];
+					for (int k = 0; k < num; k++) {
+						sum[k] += a[k] * x;
+					}
+				}
+				for (int k = 0; k < num; k++) {
+					tables[k][j].id_ = j;
+					tables[k][j].proj_ = sum[k];
+				}
+			}
+			delete[] sum; sum = NULL;
+		}));
+	}
+	for (int t = 0; t < num_threads; t++) {
+		workers[t].join();
+	}
+	delete[] a_trans; a_trans = NULL;
+}
+
 // -----------------------------------------------------------------------------
 void QALSH::get_tree_filename(		// get file name of b-tree
 	int tree_id,						// tree id, from 0 to m-1
@@ -328,16 +420,62 @@ int QALSH::restore(					// load existing b-trees.
 		return 1;					// fail to return
 	}
 
+	// -------------------------------------------------------------------------
+	//  The buffer pool of PAGE_LRU is shared evenly by the <m_> b-trees and
+	//  the data pages.
+	// -------------------------------------------------------------------------
+	int capacity = cache_pages_ / (m_ + 1);
+
 	trees_ = new BTree*[m_];		// allocate <trees>
 	for (int i = 0; i < m_; i++) {
 		get_tree_filename(i, fname);// get filename of tree
 
 		trees_[i] = new BTree();	// init <trees>
 		trees_[i]->init_restore(fname);
+		trees_[i]->file_->init_page_source(cache_type_, capacity);
+	}
+
+	if (cache_type_ != PAGE_DIRECT) {
+		char data_path[200];		// init <data_source_>
+		strcpy(data_path, output_folder);
+		strcat(data_path, "data/");
+
+		int num = B_ / (dim_ * SIZEFLOAT);
+		int num_pages = (n_pts_ + num - 1) / num;
+		DataPageStore* store = new DataPageStore(data_path, B_, num_pages);
+		data_source_ = create_page_source(cache_type_, store, num_pages,
+			cache_pages_ - capacity * m_);
 	}
 	return 0;						// success to return
 }
 
+// -----------------------------------------------------------------------------
+void QALSH::set_page_cache(			// set page source used by restore()
+	int type,							// type of page source
+	int num_pages)						// num of pages for PAGE_LRU
+{
+	cache_type_ = type;
+	cache_pages_ = num_pages;
+}
+
+// -----------------------------------------------------------------------------
+void QALSH::display_page_stats()	// display page hits and misses
+{
+	if (cache_type_ == PAGE_DIRECT) return;
+
+	long hits = 0;
+	long misses = 0;
+	for (int i = 0; i < m_; i++) {
+		PageSource* source = trees_[i]->file_->source_;
+		hits += source->hits_;
+		misses += source->misses_;
+	}
+	printf("Page cache (type = %d, pages = %d):\n", cache_type_, cache_pages_);
+	printf("    b-tree pages: hits = %ld, misses = %ld\n", hits, misses);
+	printf("    data pages:   hits = %ld, misses = %ld\n\n",
+		data_source_->hits_.load(), data_source_->misses_.load());
+}
+
 // -----------------------------------------------------------------------------
 int QALSH::read_para_file(			// read "para" file
 	char* fname)						// file name of "para" file
@@ -383,76 +521,168 @@ int QALSH::read_para_file(			// read "para" file
 }
 
 // -----------------------------------------------------------------------------
-int QALSH::knn(						// k-nn search
-	float* query,						// query point
-	int top_k,							// top-k value
-	ResultItem* rslt,					// k-nn results
-	char* output_folder)				// output folder
+//  QALSHContext: search state of qalsh for one thread
+// -----------------------------------------------------------------------------
+QALSHContext::QALSHContext(			// constructor
+	int n,								// number of data points
+	int d,								// dimension of space
+	int m,								// number of hash tables
+	int B)								// page size
 {
-	// -------------------------------------------------------------------------
-	//  Space allocation and initialization
-	// -------------------------------------------------------------------------
-									// init k-nn results
-	for (int i = 0; i < top_k; i++) {
-		rslt[i].id_   = -1;
-		rslt[i].dist_ = MAXREAL;
-	}
-									// objects frequency
-	int* frequency  = new int[n_pts_];
+	n_pts_ = n;
+	m_ = m;
+
+	epoch_ = 0;						// stamp 0 is never used by a query
+	stamp_ = new unsigned int[n_pts_];
+	frequency_ = new int[n_pts_];
 	for (int i = 0; i < n_pts_; i++) {
-		frequency[i]  = 0;
+		stamp_[i] = 0;
+		frequency_[i] = 0;
 	}
-									// whether an object is checked
-	bool* is_checked = new bool[n_pts_];
-	for (int i = 0; i < n_pts_; i++) {
-		is_checked[i] = false;
+
+	data_ = new float[d];
+	flag_ = new bool[m_];
+	q_val_ = new float[m_];
+	lptr_ = new PageBuffer[m_];
+	rptr_ = new PageBuffer[m_];
+	for (int i = 0; i < m_; i++) {
+		lptr_[i].leaf_node_ = NULL;
+		rptr_[i].leaf_node_ = NULL;
 	}
+	list_.reserve(2 * m_);
 
-	float* data = new float[dim_];	// one object data
-	for (int i = 0; i < dim_; i++) {
-		data[i] = 0.0f;
+	blk_ = new char[B];
+	index_node_ = new BIndexNode();
+	page_io_ = dist_io_ = 0;
+
+	g_memory += (long) (sizeof(unsigned int) + SIZEINT) * n_pts_;
+	g_memory += SIZEFLOAT * d + (SIZEFLOAT + SIZEBOOL) * m_ + SIZECHAR * B;
+}
+
+// -----------------------------------------------------------------------------
+QALSHContext::~QALSHContext()		// destructor
+{
+	for (size_t i = 0; i < free_leaves_.size(); i++) {
+		delete free_leaves_[i]; free_leaves_[i] = NULL;
 	}
-	g_memory += ((SIZEBOOL + SIZEINT) * n_pts_ + SIZEFLOAT * dim_);
+	delete index_node_; index_node_ = NULL;
+
+	delete[] stamp_; stamp_ = NULL;
+	delete[] frequency_; frequency_ = NULL;
+	delete[] data_; data_ = NULL;
+	delete[] flag_; flag_ = NULL;
+	delete[] q_val_; q_val_ = NULL;
+	delete[] lptr_; lptr_ = NULL;
+	delete[] rptr_; rptr_ = NULL;
+	delete[] blk_; blk_ = NULL;
+}
 
-	bool* flag = new bool[m_];		// whether a hash table is finished
-	for (int i = 0; i < m_; i++) {
-		flag[i] = true;
+// -----------------------------------------------------------------------------
+void QALSHContext::begin_query()	// reset state for a new query
+{
+	epoch_++;
+	if (epoch_ == 0) {				// wrap around: clear all stamps once
+		for (int i = 0; i < n_pts_; i++) {
+			stamp_[i] = 0;
+		}
+		epoch_ = 1;
 	}
 
-	float* q_val = new float[m_];	// hash value of query
 	for (int i = 0; i < m_; i++) {
-		q_val[i] = -1.0f;
+		flag_[i] = true;
+		q_val_[i] = -1.0f;
+
+		lptr_[i].leaf_node_ = NULL;
+		lptr_[i].index_pos_ = -1;
+		lptr_[i].leaf_pos_  = -1;
+		lptr_[i].size_      = -1;
+
+		rptr_[i].leaf_node_ = NULL;
+		rptr_[i].index_pos_ = -1;
+		rptr_[i].leaf_pos_  = -1;
+		rptr_[i].size_      = -1;
 	}
-	g_memory += (SIZEFLOAT + SIZEBOOL) * m_;
-									// left and right page buffer
-	PageBuffer* lptr = new PageBuffer[m_];
-	PageBuffer* rptr = new PageBuffer[m_];
-	g_memory += (SIZECHAR * B_ * m_ * 2 + SIZEINT * m_ * 6);
+	page_io_ = 0;
+	dist_io_ = 0;
+}
+
+// -----------------------------------------------------------------------------
+BLeafNode* QALSHContext::get_leaf(	// get a leaf node from the free list
+	BTree* btree,						// b-tree of the node
+	int block)							// address of the node
+{
+	BLeafNode* node = NULL;
+	if (free_leaves_.empty()) {
+		node = new BLeafNode();
+	}
+	else {
+		node = free_leaves_.back();
+		free_leaves_.pop_back();
+	}
+	node->reload(btree, block, blk_);
+	return node;
+}
+
+// -----------------------------------------------------------------------------
+void QALSHContext::put_leaf(		// put a leaf node back to the free list
+	BLeafNode* node)					// leaf node
+{
+	free_leaves_.push_back(node);
+}
 
-	for (int i = 0; i < m_; i++) {
-		lptr[i].leaf_node_ = NULL;
-		lptr[i].index_pos_ = -1;
-		lptr[i].leaf_pos_  = -1;
-		lptr[i].size_      = -1;
 
-		rptr[i].leaf_node_ = NULL;
-		rptr[i].index_pos_ = -1;
-		rptr[i].leaf_pos_  = -1;
-		rptr[i].size_      = -1;
+// -----------------------------------------------------------------------------
+QALSHContext* QALSH::create_context()// create a search context
+{
+	return new QALSHContext(n_pts_, dim_, m_, B_);
+}
+
+// -----------------------------------------------------------------------------
+int QALSH::knn(						// k-nn search
+	float* query,						// query point
+	int top_k,							// top-k value
+	ResultItem* rslt,					// k-nn results
+	char* output_folder)				// output folder
+{
+	if (ctx_ == NULL) {				// reused by the following queries
+		ctx_ = create_context();
 	}
+	return knn(query, top_k, rslt, output_folder, ctx_);
+}
+
+// -----------------------------------------------------------------------------
+int QALSH::knn(						// k-nn search with a search context
+	float* query,						// query point
+	int top_k,							// top-k value
+	ResultItem* rslt,					// k-nn results
+	char* output_folder,				// output folder
+	QALSHContext* ctx)					// search context of this thread
+{
+	// -------------------------------------------------------------------------
+	//  Initialization (no space allocation)
+	// -------------------------------------------------------------------------
+									// init k-nn results
+	for (int i = 0; i < top_k; i++) {
+		rslt[i].id_   = -1;
+		rslt[i].dist_ = MAXREAL;
+	}
+	ctx->begin_query();
+
+	float* data = ctx->data_;		// one object data
+	bool* flag = ctx->flag_;		// whether a hash table is finished
+	PageBuffer* lptr = ctx->lptr_;	// left and right page buffer
+	PageBuffer* rptr = ctx->rptr_;
 
 	// -------------------------------------------------------------------------
 	//  Compute hash value <q_dist> of query and init the page buffers 
 	//  <lptr> and <rptr>.
 	// -------------------------------------------------------------------------
-	page_io_ = 0;					// num of page i/os
-	dist_io_ = 0;					// num of dist cmpt
-	init_buffer(lptr, rptr, q_val, query);
+	init_buffer(ctx, query);
 
 	// -------------------------------------------------------------------------
 	//  Determine the basic <radius> and <bucket_width> 
 	// -------------------------------------------------------------------------
-	float radius = find_radius(lptr, rptr, q_val);
+	float radius = find_radius(ctx);
 	float bucket_width = (w_ * radius / 2.0f);
 
 	// -------------------------------------------------------------------------
@@ -461,7 +691,7 @@ int QALSH::knn(						// k-nn search
 	bool again      = true;			// stop flag
 	int  candidates = 99 + top_k;	// threshold of candidates
 	int  flag_num   = 0;			// used for bucket bound
-	int  scanned_id = 0;			// num of scanned id
+	int  scanned_id = 0;			// num of scanned id
 	int checked=0;
 
 	int id    = -1;					// current object id
@@ -472,9 +702,7 @@ int QALSH::knn(						// k-nn search
 	float left_dist = -1.0f;		// left dist with query
 	float right_dist = -1.0f;		// right dist with query
 	float knn_dist = MAXREAL;		// kth nn dist
-									// result entry for update
-	ResultItem* item = new ResultItem();
-	g_memory += (long) sizeof(ResultItem);
+	ResultItem item;				// result entry for update
 
 	while (again) {
 		// ---------------------------------------------------------------------
@@ -497,12 +725,12 @@ int QALSH::knn(						// k-nn search
 				// -------------------------------------------------------------
 				left_dist = -1.0f;
 				if (lptr[i].size_ != -1) {
-					left_dist = calc_proj_dist(&lptr[i], q_val[i]);
+					left_dist = calc_proj_dist(&lptr[i], ctx->q_val_[i]);
 				}
 
 				right_dist = -1.0f;
 				if (rptr[i].size_ != -1) {
-					right_dist = calc_proj_dist(&rptr[i], q_val[i]);
+					right_dist = calc_proj_dist(&rptr[i], ctx->q_val_[i]);
 				}
 
 				// -------------------------------------------------------------
@@ -521,29 +749,32 @@ int QALSH::knn(						// k-nn search
 					start = end - count;
 					for (int j = end; j > start; j--) {
 						id = lptr[i].leaf_node_->get_entry_id(j);
-						frequency[id]++;
 						scanned_id++;
 
-						if (frequency[id] > l_ && !is_checked[id]) {
-							is_checked[id] = true;
-							read_data(id, dim_, B_, data, output_folder);
+						if (ctx->add_collision(id) > l_) {
+							ctx->set_checked(id);
+							if (data_source_) {
+								read_data(id, dim_, B_, data, data_source_);
+							} else {
+								read_data(id, dim_, B_, data, output_folder);
+							}
 
-							item->dist_ = calc_l2_dist(data, query, dim_);
-							item->id_ = id;
-							knn_dist = update_result(rslt, item, top_k);
+							item.dist_ = calc_l2_dist(data, query, dim_);
+							item.id_ = id;
+							knn_dist = update_result(rslt, &item, top_k);
 							checked++;
 							// -------------------------------------------------
 							//  Terminating condition 2
 							// -------------------------------------------------
-							dist_io_++;
-							if (dist_io_ >= candidates) {
+							ctx->dist_io_++;
+							if (ctx->dist_io_ >= candidates) {
 								again = false;
 								flag_num += m_;
 								break;
 							}
 						}
 					}
-					update_left_buffer(&lptr[i], &rptr[i]);
+					update_left_buffer(ctx, &lptr[i], &rptr[i]);
 				}
 				else if (right_dist >= 0 && right_dist < bucket_width && 
 					((left_dist >= 0 && left_dist > right_dist) || 
@@ -554,28 +785,31 @@ int QALSH::knn(						// k-nn search
 					end = start + count;
 					for (int j = start; j < end; j++) {
 						id = rptr[i].leaf_node_->get_entry_id(j);
-						frequency[id]++;
 						scanned_id++;
-						if (frequency[id] > l_ && !is_checked[id]) {
-							is_checked[id] = true;
-							read_data(id, dim_, B_, data, output_folder);
+						if (ctx->add_collision(id) > l_) {
+							ctx->set_checked(id);
+							if (data_source_) {
+								read_data(id, dim_, B_, data, data_source_);
+							} else {
+								read_data(id, dim_, B_, data, output_folder);
+							}
 
-							item->dist_ = calc_l2_dist(data, query, dim_);
-							item->id_ = id;
-							knn_dist = update_result(rslt, item, top_k);
+							item.dist_ = calc_l2_dist(data, query, dim_);
+							item.id_ = id;
+							knn_dist = update_result(rslt, &item, top_k);
    							checked++;
 							// -------------------------------------------------
 							//  Terminating condition 2
 							// -------------------------------------------------
-							dist_io_++;
-							if (dist_io_ >= candidates) {
+							ctx->dist_io_++;
+							if (ctx->dist_io_ >= candidates) {
 								again = false;
 								flag_num += m_;
 								break;
 							}
 						}
 					}
-					update_right_buffer(&lptr[i], &rptr[i]);
+					update_right_buffer(ctx, &lptr[i], &rptr[i]);
 				}
 				else {
 					flag[i] = false;
@@ -588,7 +822,7 @@ int QALSH::knn(						// k-nn search
 		// ---------------------------------------------------------------------
 		//  Terminating condition 1
 		// ---------------------------------------------------------------------
-		if (knn_dist < appr_ratio_ * radius && dist_io_ >= top_k) {
+		if (knn_dist < appr_ratio_ * radius && ctx->dist_io_ >= top_k) {
 			again = false;
 			break;
 		}
@@ -596,55 +830,78 @@ int QALSH::knn(						// k-nn search
 		// ---------------------------------------------------------------------
 		//  Step 3: auto-update <radius>
 		// ---------------------------------------------------------------------
-		radius = update_radius(lptr, rptr, q_val, radius);
+		radius = update_radius(ctx, radius);
 		bucket_width = radius * w_ / 2.0f;
 	}
 
 	// -------------------------------------------------------------------------
-	//  Release space
+	//  Give the leaf nodes back to the context
 	// -------------------------------------------------------------------------
-	if (data != NULL || frequency != NULL || is_checked != NULL) {
-		delete[] data; data = NULL;
-		delete[] frequency;  frequency  = NULL;
-		delete[] is_checked; is_checked = NULL;
-		g_memory -= ((SIZEBOOL + SIZEINT) * n_pts_ + SIZEFLOAT * dim_);
-	}
-	if (q_val != NULL || flag != NULL || item != NULL) {
-		delete[] q_val; q_val = NULL;
-		delete[] flag; flag = NULL;
-		delete   item; item = NULL;
-		g_memory -= (SIZEFLOAT + SIZEBOOL) * m_;
-		g_memory -= (long) sizeof(ResultItem);
-	}
-
 	for (int i = 0; i < m_; i++) {
 		// ---------------------------------------------------------------------
 		//  CANNOT remove the condition
 		//              <lptrs[i].leaf_node != rptrs[i].leaf_node>
 		//  Because <lptrs[i].leaf_node> and <rptrs[i].leaf_node> may point 
-		//  to the same address, then we would delete it twice and receive 
-		//  the runtime error or segmentation fault.
+		//  to the same address, then we would release it twice.
 		// ---------------------------------------------------------------------
 		if (lptr[i].leaf_node_ && lptr[i].leaf_node_ != rptr[i].leaf_node_) {
-			delete lptr[i].leaf_node_; lptr[i].leaf_node_ = NULL;
+			ctx->put_leaf(lptr[i].leaf_node_); lptr[i].leaf_node_ = NULL;
 		}
 		if (rptr[i].leaf_node_) {
-			delete rptr[i].leaf_node_; rptr[i].leaf_node_ = NULL;
+			ctx->put_leaf(rptr[i].leaf_node_); rptr[i].leaf_node_ = NULL;
 		}
 	}
-	delete[] lptr; lptr = NULL;
-	delete[] rptr; rptr = NULL;
-	g_memory -= (SIZECHAR * B_ * m_ * 2 + SIZEINT * m_ * 6);
-	return (page_io_ + dist_io_);
+	return (ctx->page_io_ + ctx->dist_io_);
+}
+
+// -----------------------------------------------------------------------------
+//  K-nn search of a batch of queries by <num_threads> threads. Each thread
+//  has its own search context and takes the next query from a shared
+//  counter. Return the total num of i/os of all queries.
+// -----------------------------------------------------------------------------
+int QALSH::knn_batch(				// k-nn search of a batch of queries
+	int qn,								// number of queries
+	float** query,						// query points
+	int top_k,							// top-k value
+	ResultItem* rslt,					// k-nn results (qn * top_k)
+	char* output_folder,				// folder of info of qalsh
+	int num_threads)					// number of threads
+{
+	if (num_threads < 1) num_threads = 1;
+	if (num_threads > qn) num_threads = qn;
+
+	std::atomic<int> next(0);		// next query to search
+	std::atomic<long> all_io(0);	// total num of i/os
+
+	std::vector<std::thread> workers;
+	for (int t = 0; t < num_threads; t++) {
+		workers.push_back(std::thread([&]() {
+			QALSHContext* ctx = create_context();
+			long io = 0;
+			int i = -1;
+			while ((i = next++) < qn) {
+				io += knn(query[i], top_k, &rslt[(long) i * top_k],
+					output_folder, ctx);
+			}
+			all_io += io;
+			delete ctx; ctx = NULL;
+		}));
+	}
+	for (int t = 0; t < num_threads; t++) {
+		workers[t].join();
+	}
+	return (int) all_io.load();
 }
 
 // -----------------------------------------------------------------------------
 void QALSH::init_buffer(			// init page buffer (loc pos of b-treee)
-	PageBuffer* lptr,					// left buffer page (return)
-	PageBuffer* rptr,					// right buffer page (return)
-	float* q_dist,						// hash value of query (return)
+	QALSHContext* ctx,					// search context (return)
 	float* query)						// query point
 {
+	PageBuffer* lptr = ctx->lptr_;	// left buffer page (return)
+	PageBuffer* rptr = ctx->rptr_;	// right buffer page (return)
+	float* q_dist = ctx->q_val_;	// hash value of query (return)
+
 	int  block   = -1;				// tmp vars for index node
 	int  follow  = -1;
 	bool lescape = false;
@@ -653,15 +910,14 @@ void QALSH::init_buffer(			// init page buffer (loc pos of b-treee)
 	int increment = -1;
 	int num_entries = -1;
 
-	BIndexNode* index_node = NULL;
+	BIndexNode* index_node = ctx->index_node_;
 
 	for (int i = 0; i < m_; i++) {	// calc hash value of query
 		q_dist[i] = calc_hash_value(i, query);
 		block = trees_[i]->root_;
 
-		index_node = new BIndexNode();
-		index_node->init_restore(trees_[i], block);
-		page_io_++;
+		index_node->reload(trees_[i], block, ctx->blk_);
+		ctx->page_io_++;
 
 		// ---------------------------------------------------------------------
 		//  Find the leaf node whose value is closest and larger than the key
@@ -686,11 +942,8 @@ void QALSH::init_buffer(			// init page buffer (loc pos of b-treee)
 				}
 			}
 			block = index_node->get_son(follow);
-			delete index_node; index_node = NULL;
-
-			index_node = new BIndexNode();
-			index_node->init_restore(trees_[i], block);
-			page_io_++;				// access a new node (a new page)
+			index_node->reload(trees_[i], block, ctx->blk_);
+			ctx->page_io_++;		// access a new node (a new page)
 		}
 
 		// ---------------------------------------------------------------------
@@ -708,8 +961,7 @@ void QALSH::init_buffer(			// init page buffer (loc pos of b-treee)
 
 		if (lescape) {				// only init right buffer
 			block = index_node->get_son(0);
-			rptr[i].leaf_node_ = new BLeafNode();
-			rptr[i].leaf_node_->init_restore(trees_[i], block);
+			rptr[i].leaf_node_ = ctx->get_leaf(trees_[i], block);
 			rptr[i].index_pos_ = 0;
 			rptr[i].leaf_pos_ = 0;
 
@@ -720,12 +972,11 @@ void QALSH::init_buffer(			// init page buffer (loc pos of b-treee)
 			} else {
 				rptr[i].size_ = increment;
 			}
-			page_io_++;
+			ctx->page_io_++;
 		}
 		else {						// init left buffer
 			block = index_node->get_son(follow);
-			lptr[i].leaf_node_ = new BLeafNode();
-			lptr[i].leaf_node_->init_restore(trees_[i], block);
+			lptr[i].leaf_node_ = ctx->get_leaf(trees_[i], block);
 
 			pos = lptr[i].leaf_node_->find_position_by_key(q_dist[i]);
 			if (pos < 0) pos = 0;
@@ -741,7 +992,7 @@ void QALSH::init_buffer(			// init page buffer (loc pos of b-treee)
 				lptr[i].leaf_pos_ = pos * increment + increment - 1;
 				lptr[i].size_ = increment;
 			}
-			page_io_++;
+			ctx->page_io_++;
 									// init right buffer
 			if (pos < lptr[i].leaf_node_->get_num_keys() - 1) {
 				rptr[i].leaf_node_ = lptr[i].leaf_node_;
@@ -757,8 +1008,9 @@ void QALSH::init_buffer(			// init page buffer (loc pos of b-treee)
 				}
 			}
 			else {
-				rptr[i].leaf_node_ = lptr[i].leaf_node_->get_right_sibling();
-				if (rptr[i].leaf_node_) {
+				block = lptr[i].leaf_node_->get_right_sibling_addr();
+				if (block != -1) {
+					rptr[i].leaf_node_ = ctx->get_leaf(trees_[i], block);
 					rptr[i].index_pos_ = 0;
 					rptr[i].leaf_pos_ = 0;
 
@@ -769,24 +1021,18 @@ void QALSH::init_buffer(			// init page buffer (loc pos of b-treee)
 					} else {
 						rptr[i].size_ = increment;
 					}
-					page_io_++;
+					ctx->page_io_++;
 				}
 			}
 		}
-
-		if (index_node != NULL) {
-			delete index_node; index_node = NULL;
-		}
 	}
 }
 
 // -----------------------------------------------------------------------------
 float QALSH::find_radius(			// find proper radius
-	PageBuffer* lptr,					// left page buffer
-	PageBuffer* rptr,					// right page buffer
-	float* q_dist)						// hash value of query
+	QALSHContext* ctx)					// search context
 {
-	float radius = update_radius(lptr, rptr, q_dist, 1.0f/appr_ratio_);
+	float radius = update_radius(ctx, 1.0f/appr_ratio_);
 	if (radius < 1.0f) radius = 1.0f;
 
 	return radius;
@@ -794,13 +1040,16 @@ float QALSH::find_radius(			// find proper radius
 
 // -----------------------------------------------------------------------------
 float QALSH::update_radius(			// update radius
-	PageBuffer* lptr,					// left page buffer
-	PageBuffer* rptr,					// right page buffer
-	float* q_dist,						// hash value of query
+	QALSHContext* ctx,					// search context
 	float  old_radius)					// old radius
 {
+	PageBuffer* lptr = ctx->lptr_;	// left page buffer
+	PageBuffer* rptr = ctx->rptr_;	// right page buffer
+	float* q_dist = ctx->q_val_;	// hash value of query
+
 	float dist = 0.0f;				// tmp vars
-	vector<float> list;
+	std::vector<float>& list = ctx->list_;
+	list.clear();
 
 	for (int i = 0; i < m_; i++) {	// find an array of proj dist
 		if (lptr[i].size_ != -1) {
@@ -862,10 +1111,10 @@ float QALSH::update_result(			// update knn results
 
 // -----------------------------------------------------------------------------
 void QALSH::update_left_buffer(		// update left buffer
+	QALSHContext* ctx,					// search context
 	PageBuffer* lptr,					// left buffer
 	const PageBuffer* rptr)				// right buffer
 {
-	BLeafNode* leaf_node = NULL;
 	BLeafNode* old_leaf_node = NULL;
 
 	if (lptr->index_pos_ > 0) {
@@ -878,10 +1127,10 @@ void QALSH::update_left_buffer(		// update left buffer
 	}
 	else {
 		old_leaf_node = lptr->leaf_node_;
-		leaf_node = lptr->leaf_node_->get_left_sibling();
+		int block = lptr->leaf_node_->get_left_sibling_addr();
 
-		if (leaf_node) {
-			lptr->leaf_node_ = leaf_node;
+		if (block != -1) {
+			lptr->leaf_node_ = ctx->get_leaf(old_leaf_node->get_btree(), block);
 			lptr->index_pos_ = lptr->leaf_node_->get_num_keys() - 1;
 
 			int pos = lptr->index_pos_;
@@ -889,7 +1138,7 @@ void QALSH::update_left_buffer(		// update left buffer
 			int num_entries = lptr->leaf_node_->get_num_entries();
 			lptr->leaf_pos_ = num_entries - 1;
 			lptr->size_ = num_entries - pos * increment;
-			page_io_++;
+			ctx->page_io_++;
 		}
 		else {
 			lptr->leaf_node_ = NULL;
@@ -899,17 +1148,17 @@ void QALSH::update_left_buffer(		// update left buffer
 		}
 
 		if (rptr->leaf_node_ != old_leaf_node) {
-			delete old_leaf_node; old_leaf_node = NULL;
+			ctx->put_leaf(old_leaf_node); old_leaf_node = NULL;
 		}
 	}
 }
 
 // -----------------------------------------------------------------------------
 void QALSH::update_right_buffer(	// update right buffer
+	QALSHContext* ctx,					// search context
 	const PageBuffer* lptr,				// left buffer
 	PageBuffer* rptr)					// right buffer
 {
-	BLeafNode* leaf_node = NULL;
 	BLeafNode* old_leaf_node = NULL;
 
 	if (rptr->index_pos_ < rptr->leaf_node_->get_num_keys() - 1) {
@@ -928,10 +1177,10 @@ void QALSH::update_right_buffer(	// update right buffer
 	}
 	else {
 		old_leaf_node = rptr->leaf_node_;
-		leaf_node = rptr->leaf_node_->get_right_sibling();
+		int block = rptr->leaf_node_->get_right_sibling_addr();
 
-		if (leaf_node) {
-			rptr->leaf_node_ = leaf_node;
+		if (block != -1) {
+			rptr->leaf_node_ = ctx->get_leaf(old_leaf_node->get_btree(), block);
 			rptr->index_pos_ = 0;
 			rptr->leaf_pos_ = 0;
 
@@ -942,7 +1191,7 @@ void QALSH::update_right_buffer(	// update right buffer
 			} else {
 				rptr->size_ = increment;
 			}
-			page_io_++;
+			ctx->page_io_++;
 		}
 		else {
 			rptr->leaf_node_ = NULL;
@@ -952,11 +1201,10 @@ void QALSH::update_right_buffer(	// update right buffer
 		}
 
 		if (lptr->leaf_node_ != old_leaf_node) {
-			delete old_leaf_node; old_leaf_node = NULL;
+			ctx->put_leaf(old_leaf_node); old_leaf_node = NULL;
 		}
 	}
 }
-
 // -----------------------------------------------------------------------------
 float QALSH::calc_proj_dist(		// calc proj dist
 	const PageBuffer* ptr,				// page buffer
@@ -35,6 +35,69 @@ struct HashValue {
 	float proj_;					// projection of the object
 };
 
+// -----------------------------------------------------------------------------
+//  QALSHContext: search state of qalsh for one thread. It is allocated once
+//  and reused by all the queries of this thread. The collision counters are
+//  stamped by the query id <epoch_>, so they are reset in O(1) instead of
+//  O(n) for each query.
+// -----------------------------------------------------------------------------
+class QALSHContext {
+public:
+	QALSHContext(					// constructor
+		int n,							// number of data points
+		int d,							// dimension of space
+		int m,							// number of hash tables
+		int B);							// page size
+	~QALSHContext();				// destructor
+
+	// -------------------------------------------------------------------------
+	void begin_query();				// reset state for a new query
+
+	int add_collision(				// add a collision of an object
+		int id)							// object id
+	{
+		if (stamp_[id] != epoch_) {	// first collision of this query
+			stamp_[id] = epoch_;
+			frequency_[id] = 0;
+		}
+		return ++frequency_[id];
+	}
+
+	void set_checked(				// object is checked, never count again
+		int id)							// object id
+	{ frequency_[id] = MININT; }
+
+	// -------------------------------------------------------------------------
+	BLeafNode* get_leaf(			// get a leaf node from the free list
+		BTree* btree,					// b-tree of the node
+		int block);						// address of the node
+
+	void put_leaf(					// put a leaf node back to the free list
+		BLeafNode* node);				// leaf node
+
+	// -------------------------------------------------------------------------
+	int n_pts_;						// number of data points
+	int m_;							// number of hash tables
+
+	unsigned int epoch_;			// stamp of current query
+	unsigned int* stamp_;			// stamp of each object
+	int* frequency_;				// collision count of each object
+
+	float* data_;					// one object data
+	bool* flag_;					// whether a hash table is finished
+	float* q_val_;					// hash value of query
+	PageBuffer* lptr_;				// left page buffer
+	PageBuffer* rptr_;				// right page buffer
+	std::vector<float> list_;		// proj dist for updating radius
+
+	char* blk_;						// buffer of one block
+	BIndexNode* index_node_;		// index node for locating leaf nodes
+	std::vector<BLeafNode*> free_leaves_;// leaf nodes which can be reused
+
+	int page_io_;					// io for scanning pages by qalsh
+	int dist_io_;					// io for calculating L2 distance
+};
+
 // -----------------------------------------------------------------------------
 //  QALSH: structure of qalsh indexed by b+ tree. QALSH is used to solve
 //  the problem of Approximate Nearest Neighbor (ANN) search.
@@ -53,12 +116,19 @@ public:
 		char* output_folder);			// folder of info of qalsh
 
 	// -------------------------------------------------------------------------
+	void set_page_cache(			// set page source used by restore()
+		int type,						// type of page source
+		int num_pages);					// num of pages for PAGE_LRU
+
 	int restore(					// restore params of qalsh
 		char* output_folder);			// folder of info of qalsh
 
+	void display_page_stats();		// display page hits and misses
+
 	// -------------------------------------------------------------------------
 	int bulkload(					// build b+ trees by bulkloading
-		float** data);					// data set
+		float** data,					// data set
+		int num_threads);				// number of threads
 
 	// -------------------------------------------------------------------------
 	int knn(						// k-nn search
@@ -67,6 +137,23 @@ public:
 		ResultItem* rslt,				// k-nn results
 		char* output_folder);			// folder of info of qalsh
 
+	int knn(						// k-nn search with a search context
+		float* query,					// one query point
+		int top_k,						// top-k value
+		ResultItem* rslt,				// k-nn results
+		char* output_folder,			// folder of info of qalsh
+		QALSHContext* ctx);				// search context of this thread
+
+	int knn_batch(					// k-nn search of a batch of queries
+		int qn,							// number of queries
+		float** query,					// query points
+		int top_k,						// top-k value
+		ResultItem* rslt,				// k-nn results (qn * top_k)
+		char* output_folder,			// folder of info of qalsh
+		int num_threads);				// number of threads
+
+	QALSHContext* create_context();	// create a search context
+
 private:
 	// -------------------------------------------------------------------------
 	int   n_pts_;					// number of points
@@ -90,9 +177,12 @@ private:
 	float* a_array_;				// hash functions
 	char index_path_[200];			// folder path of index
 
-	int dist_io_;					// io for calculating L2 distance
-	int page_io_;					// io for scanning pages by qalsh
 	BTree** trees_;					// b-trees
+	QALSHContext* ctx_;				// search context used by knn()
+
+	int cache_type_;				// type of page source
+	int cache_pages_;				// num of pages for PAGE_LRU
+	PageSource* data_source_;		// page source of data pages
 
 	// -------------------------------------------------------------------------
 	void calc_params();				// calc parama of qalsh
@@ -109,6 +199,13 @@ private:
 		int table_id,					// hash table id
 		float* point);					// one point
 
+	void calc_hash_values(			// calc hash values of several tables
+		int first,						// first hash table id
+		int num,						// number of hash tables
+		float** data,					// data set
+		HashValue** tables,				// hash tables (return)
+		int num_threads);				// number of threads
+
 	int write_para_file(			// write file of para
 		char* fname);					// file name of para
 
@@ -121,22 +218,16 @@ private:
 
 	// -------------------------------------------------------------------------
 	void init_buffer(				// init page buffer (loc pos of b-treee)
-		PageBuffer* lptr,				// left buffer page (return)
-		PageBuffer* rptr,				// right buffer page (return)
-		float* q_dist,					// hash value of query (return)
+		QALSHContext* ctx,				// search context (return)
 		float* query);					// query point
 
 	// -------------------------------------------------------------------------
 	float find_radius(				// find proper radius
-		PageBuffer* lptr,				// left page buffer
-		PageBuffer* rptr,				// right page buffer
-		float* q_dist);					// hash value of query
+		QALSHContext* ctx);				// search context
 
 	// -------------------------------------------------------------------------
 	float update_radius(			// update radius
-		PageBuffer* lptr,				// left page buffer
-		PageBuffer* rptr,				// right page buffer
-		float* q_dist,					// hash value of query
+		QALSHContext* ctx,				// search context
 		float  old_radius);				// old radius
 
 	// -------------------------------------------------------------------------
@@ -147,10 +238,12 @@ private:
 
 	// -------------------------------------------------------------------------
 	void update_left_buffer(		// update left buffer
+		QALSHContext* ctx,				// search context
 		PageBuffer* lptr,				// left buffer
 		const PageBuffer* rptr);		// right buffer
 
 	void update_right_buffer(		// update right buffer
+		QALSHContext* ctx,				// search context
 		const PageBuffer* lptr,			// left buffer
 		PageBuffer* rptr);				// right buffer
 
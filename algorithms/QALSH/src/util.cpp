@@ -4,7 +4,7 @@
 // -----------------------------------------------------------------------------
 //  Global variables
 // -----------------------------------------------------------------------------
-long g_memory = 0;
+std::atomic<long> g_memory(0);
 
 
 // -----------------------------------------------------------------------------
@@ -317,6 +317,23 @@ int read_data(						// read data from page
 	return 0;
 }
 
+// -----------------------------------------------------------------------------
+//  Read data in new format through a page source. Different from the above
+//  function, no file name or page buffer is allocated for each call.
+// -----------------------------------------------------------------------------
+int read_data(						// read data from page source
+	int id,								// index of data
+	int d,								// dimensionality
+	int B,								// page size
+	float* data,						// real data (return)
+	PageSource* source)					// page source of data pages
+{
+	int num = B / (d * SIZEFLOAT);	// number of data in one data file
+	source->copy_page(id / num, (id % num) * d * SIZEFLOAT, d * SIZEFLOAT,
+		(char*) data);
+	return 0;
+}
+
 // -----------------------------------------------------------------------------
 int read_buffer_from_page(			// read buffer from page
 	int B,								// page size
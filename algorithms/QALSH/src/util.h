@@ -1,11 +1,12 @@
 #ifndef __UTIL_H
 #define __UTIL_H
 
+class PageSource;
 
 // -----------------------------------------------------------------------------
 //  Global variables
 // -----------------------------------------------------------------------------
-extern long g_memory;
+extern std::atomic<long> g_memory;		// updated by knn_batch threads
 
 // -----------------------------------------------------------------------------
 //  Uitlity functions
@@ -74,6 +75,14 @@ int read_data(						// read data from page
 	float* data,						// real data (return)
 	char* output_path);					// output path
 
+// -----------------------------------------------------------------------------
+int read_data(						// read data from page source
+	int id,								// index of data
+	int d,								// dimensionality
+	int B,								// page size
+	float* data,						// real data (return)
+	PageSource* source);				// page source of data pages
+
 // -----------------------------------------------------------------------------
 int read_buffer_from_page(			// read data from page
 	int B,								// page size
@@ -0,0 +1,224 @@
+/**
+ * DistMatrix.cpp: Contiguous row-major storage and distance kernel
+ *                   for dense vector data.
+ */
+
+#include "DistMatrix.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "../../tools/dataset/mmap_dataset.h"
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+////////////////////////////////////////////////////////////////////////
+//                            DistMatrix                              //
+////////////////////////////////////////////////////////////////////////
+
+
+  //////////////////////////////////////////////////////////////////////
+  //                         Public Methods                           //
+  //////////////////////////////////////////////////////////////////////
+
+
+  /**
+   * Constructor reserving an aligned matrix of zeros.
+   * Each row is padded to a multiple of 16 floats (64 bytes), so
+   *   every row starts on a cache line.
+   */
+
+  DistMatrix:: DistMatrix (int rows, int dim)
+  //
+  {
+    void* addr = NULL;
+    long align = DISTMATRIX_ALIGN_ / sizeof (float);
+
+    this->rows = rows;
+    this->dim = dim;
+    this->stride = ((dim + align - 1) / align) * align;
+    this->owned = true;
+    this->file = NULL;
+
+    if (posix_memalign (&addr, DISTMATRIX_ALIGN_,
+          sizeof (float) * stride * (rows > 0 ? rows : 1)) != 0)
+    {
+      addr = NULL;
+    }
+    base = (float*) addr;
+    if (base != NULL)
+    {
+      memset (base, 0, sizeof (float) * stride * rows);
+    }
+  }
+
+
+  //////////////////////////////////////////////////////////////////////
+
+
+  /**
+   * Constructor copying a list of vector objects into an aligned matrix.
+   */
+
+  DistMatrix:: DistMatrix (DistData** items, int rows)
+  //
+    : DistMatrix (rows, rows > 0 ? items[0]->length : 0)
+  {
+    int i;
+
+    for (i=0; i<rows; i++)
+    {
+      memcpy (getRow (i), items[i]->value, sizeof (float) * items[i]->length);
+    }
+  }
+
+
+  //////////////////////////////////////////////////////////////////////
+
+
+  /**
+   * Constructor building a view of rows stored elsewhere. Row i starts
+   *   at base + i * stride. The storage is not released by the matrix.
+   */
+
+  DistMatrix:: DistMatrix (float* base, int rows, int dim, long stride)
+  //
+  {
+    this->base = base;
+    this->rows = rows;
+    this->dim = dim;
+    this->stride = stride;
+    this->owned = false;
+    this->file = NULL;
+  }
+
+
+  //////////////////////////////////////////////////////////////////////
+
+
+  DistMatrix:: ~DistMatrix ()
+  //
+  {
+    if (file != NULL)
+    {
+      delete file;
+    }
+    else if (owned && (base != NULL))
+    {
+      free (base);
+    }
+    base = NULL;
+  }
+
+
+  //////////////////////////////////////////////////////////////////////
+
+
+  /**
+   * Maps the first <rows> vectors of an fvecs file (per vector: int d,
+   *   then d floats) by mmap, see nns::Dataset. No data is copied; the
+   *   returned matrix is a view with stride d + 1, so its rows are not
+   *   aligned.
+   * Returns NULL if the file cannot be mapped or is too short.
+   */
+
+  DistMatrix* DistMatrix:: mapFvecs (const char* fileName, int rows)
+  //
+  {
+    nns::Dataset* file = new nns::Dataset ();
+    DistMatrix* matrix;
+
+    try
+    {
+      file->open (fileName, nns::FORMAT_FVECS);
+    }
+    catch (const std::runtime_error&)
+    {
+      delete file;
+      return NULL;
+    }
+    if ((rows < 0) || (file->size () < (size_t) rows))
+    {
+      delete file;
+      return NULL;
+    }
+
+    matrix = new DistMatrix ((float*) file->row<float> (0), rows, file->dim (),
+                             file->stride () / sizeof (float));
+    matrix->file = file;
+    return matrix;
+  }
+
+
+  //////////////////////////////////////////////////////////////////////
+
+
+  /**
+   * Returns the squared Euclidean distance of two rows of length dim.
+   * The rows need not be aligned. Four partial sums are kept in
+   *   SIMD registers, so the rounding differs slightly from the double
+   *   precision loop of DistData::distanceTo.
+   */
+
+  float distMatrixL2 (const float* a, const float* b, int dim)
+  //
+  {
+    int loc = 0;
+    float squareSum = 0.0F;
+    float diff = 0.0F;
+
+#if defined(__AVX__)
+    __m256 sum0 = _mm256_setzero_ps ();
+    __m256 sum1 = _mm256_setzero_ps ();
+
+    for (; loc+16<=dim; loc+=16)
+    {
+      __m256 d0 = _mm256_sub_ps (_mm256_loadu_ps (a + loc),
+                                 _mm256_loadu_ps (b + loc));
+      __m256 d1 = _mm256_sub_ps (_mm256_loadu_ps (a + loc + 8),
+                                 _mm256_loadu_ps (b + loc + 8));
+      sum0 = _mm256_add_ps (sum0, _mm256_mul_ps (d0, d0));
+      sum1 = _mm256_add_ps (sum1, _mm256_mul_ps (d1, d1));
+    }
+    sum0 = _mm256_add_ps (sum0, sum1);
+
+    __m128 sum = _mm_add_ps (_mm256_castps256_ps128 (sum0),
+                             _mm256_extractf128_ps (sum0, 1));
+    for (; loc+4<=dim; loc+=4)
+    {
+      __m128 d0 = _mm_sub_ps (_mm_loadu_ps (a + loc), _mm_loadu_ps (b + loc));
+      sum = _mm_add_ps (sum, _mm_mul_ps (d0, d0));
+    }
+#elif defined(__SSE2__)
+    __m128 sum = _mm_setzero_ps ();
+    __m128 sum1 = _mm_setzero_ps ();
+
+    for (; loc+8<=dim; loc+=8)
+    {
+      __m128 d0 = _mm_sub_ps (_mm_loadu_ps (a + loc), _mm_loadu_ps (b + loc));
+      __m128 d1 = _mm_sub_ps (_mm_loadu_ps (a + loc + 4),
+                              _mm_loadu_ps (b + loc + 4));
+      sum = _mm_add_ps (sum, _mm_mul_ps (d0, d0));
+      sum1 = _mm_add_ps (sum1, _mm_mul_ps (d1, d1));
+    }
+    sum = _mm_add_ps (sum, sum1);
+    for (; loc+4<=dim; loc+=4)
+    {
+      __m128 d0 = _mm_sub_ps (_mm_loadu_ps (a + loc), _mm_loadu_ps (b + loc));
+      sum = _mm_add_ps (sum, _mm_mul_ps (d0, d0));
+    }
+#endif
+
+#if defined(__SSE2__)
+    float part[4];
+    _mm_storeu_ps (part, sum);
+    squareSum = (part[0] + part[1]) + (part[2] + part[3]);
+#endif
+
+    for (; loc<dim; loc++)
+    {
+      diff = a[loc] - b[loc];
+      squareSum += diff * diff;
+    }
+
+    return squareSum;
+  }
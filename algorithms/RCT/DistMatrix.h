@@ -0,0 +1,43 @@
+#ifndef __DISTMATRIX_H
+#define	__DISTMATRIX_H
+
+#include <stddef.h>
+
+#include "DistData.h"
+
+#ifndef DISTMATRIX_ALIGN_
+#define DISTMATRIX_ALIGN_ (64)
+#endif
+
+namespace nns { class Dataset; }
+
+/**
+ * Row-major matrix of dense vectors. A matrix either owns its rows, which
+ *   are then 64-byte aligned and padded to a multiple of 16 floats, or is a
+ *   view of rows stored elsewhere (e.g. an fvecs file mapped by mmap).
+ */
+class DistMatrix {
+
+private:
+	float* base;
+	int rows;
+	int dim;
+	long stride;
+	bool owned;
+	nns::Dataset* file;
+public:
+	DistMatrix (int rows, int dim);
+	DistMatrix (DistData** items, int rows);
+	DistMatrix (float* base, int rows, int dim, long stride);
+	~DistMatrix ();
+	static DistMatrix* mapFvecs (const char* fileName, int rows);
+	float* getRow (int i) const { return base + (long) i * stride; }
+	int getRows () const { return rows; }
+	int getDim () const { return dim; }
+	long getStride () const { return stride; }
+};
+
+//! Squared Euclidean distance of two rows, as DistData::distanceTo.
+float distMatrixL2 (const float* a, const float* b, int dim);
+
+#endif	/* __DISTMATRIX_H */
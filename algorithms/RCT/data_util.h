@@ -10,6 +10,8 @@
 #include <dirent.h>
 #include <stdexcept>
 #include "DistData.h"
+#include "DistMatrix.h"
+#include "../../tools/dataset/mmap_dataset.h"
 //#include "VecData.h"
 
 #ifndef _DATA_UTIL_H
@@ -25,48 +27,48 @@ using std::endl;
 
 
 
-void ReadPoints(const string& filename,DistData** points, int count, int *dim) {
-  ifstream input;
-	input.open(filename.c_str(), ios::binary);
-  if(!input.good()) {
-    throw std::logic_error("Invalid filename");
+// maps the first count vectors of an fvecs or ivecs file
+void MapVectors(const string& filename, nns::DataFormat format, int count, nns::Dataset* file) {
+  file->open(filename, format);
+  if((int)file->size() < count) {
+    throw std::logic_error("Bad file content: fewer vectors than requested");
+  }
+  file->truncate(count);
+  if(!file->check_rows()) {
+    throw std::logic_error("Bad file content: vectors of different dimensions");
   }
-  int dimension;
+}
+
+void ReadPoints(const string& filename,DistData** points, int count, int *dim) {
+  nns::Dataset file;
+  MapVectors(filename, nns::FORMAT_FVECS, count, &file);
+  int dimension = file.dim();
   for(int pid = 0; pid < count; ++pid) {
-    input.read((char*)&dimension, sizeof(dimension));
-    if(dimension <= 0) {
-      throw std::logic_error("Bad file content: non-positive dimension");
-    }
 	float* point=(float*)malloc(sizeof(float)*dimension);//new float[dimension];
-    for(int d = 0; d < dimension; ++d) {
-      float buffer;
-      input.read((char*)&(buffer), sizeof(float));
-      point[d] = buffer;
-    }
+	memcpy(point, file.row<float>(pid), sizeof(float)*dimension);
     DistData* a=new DistData(point,dimension);
 	points[pid]= a;
   }
   *dim = dimension;
 }
 
-void ReadGroundtruth(const string& filename,int** gnds, int count) {
-  ifstream input;
-	input.open(filename.c_str(), ios::binary);
-  if(!input.good()) {
-    throw std::logic_error("Invalid filename");
+// Maps the first count vectors of an fvecs file without copying them.
+DistMatrix* MapPoints(const string& filename, int count, int *dim) {
+  DistMatrix* points = DistMatrix::mapFvecs(filename.c_str(), count);
+  if(points == NULL) {
+    throw std::logic_error("Invalid filename or bad file content");
   }
-  int nn;
+  *dim = points->getDim();
+  return points;
+}
+
+void ReadGroundtruth(const string& filename,int** gnds, int count) {
+  nns::Dataset file;
+  MapVectors(filename, nns::FORMAT_IVECS, count, &file);
+  int nn = file.dim();
   for(int pid = 0; pid < count; ++pid) {
-    input.read((char*)&nn, sizeof(nn));
-    if(nn <= 0) {
-      throw std::logic_error("Bad file content: non-positive dimension");
-    }
 	int* gnd=(int*)malloc(sizeof(int)*nn);//new float[dimension];
-    for(int d = 0; d < nn; ++d) {
-      int buffer;
-      input.read((char*)&(buffer), sizeof(int));
-      gnd[d] = buffer;	  
-    }    
+	memcpy(gnd, file.row<int>(pid), sizeof(int)*nn);
 	gnds[pid]= gnd;
   }
 }
@@ -170,6 +172,32 @@ float compute_relative_distance_error(int** gnds,DistData** points,DistData** qu
 	return count/ nq;
 }
 
+float compute_relative_distance_error(int** gnds,DistMatrix* points,DistMatrix* query, float** distances,int nq,int nn,int dim,int* nums)
+{
+	float count = 0;
+	for (size_t i=0; i<nq; ++i) 
+	{
+		float sum=0.0;
+		if(nums[i]!=0)
+		{
+			for (size_t j=0;j<nums[i];++j)
+			{
+				float min_distance= distMatrixL2(points->getRow(gnds[i][j]), query->getRow(i), dim);
+				float test_distance=distances[i][j];
+				float d= (test_distance - min_distance )/min_distance;
+				if(d >4)
+					sum +=4;
+				else
+					sum +=d;
+			}
+			sum = sum /nums[i];
+			count += sum ;
+		}
+
+	}
+	return count/ nq;
+}
+
 float compute_mean_average_precision (int** gnds,  int** indices,int nq,int nn,int* nums)
 {
 	float sum = 0;
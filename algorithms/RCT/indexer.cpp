@@ -44,6 +44,7 @@ int main(int argc, char * argv[]) {
 	    {"maxParents",                  required_argument, 0, 'p'},
 	    {"scaleFactor",                 required_argument, 0, 'f'},
 		{"sampleRate",                  required_argument, 0, 'r'},
+		{"num_threads",                 required_argument, 0, 't'},
 	  };
 	  int index;
 	  int iarg = 0;
@@ -53,12 +54,13 @@ int main(int argc, char * argv[]) {
 	  int maxParents; //max parent size
 	  float scaleFactor; 
 	  int r; //for show
+	  int num_threads = 1; //build threads
 
 	  char dataset_filepath[100] = "";
       char indices_filepath[100] = "";
       char output_filepath[100] = "";
 	  while (iarg != -1) {
-	    iarg = getopt_long(argc, argv, "s:i:o:n:p:f:r:h",
+	    iarg = getopt_long(argc, argv, "s:i:o:n:p:f:r:t:h",
 	                       longopts, &index);
 
 	    switch (iarg) {
@@ -97,11 +99,15 @@ int main(int argc, char * argv[]) {
 	    	  r = atof(optarg);
 	    	  }
 	    	  break;
+		  case 't':
+	    	  if (optarg) {
+	    	  num_threads = atoi(optarg);
+	    	  }
+	    	  break;
 	      }
 	  }
 	  //read data points
-	  DistData** points = new DistData*[n];
-	  ReadPoints(dataset_filepath,points, n, &dim);
+	  DistMatrix* points = MapPoints(dataset_filepath, n, &dim);
 
 	  //build rct
 	  timeval start;
@@ -111,6 +117,7 @@ int main(int argc, char * argv[]) {
 	  rct->setVerbosity(2);
 	  const float sampleRate_ = pow(n, 1.0 / r);
 	  rct->setSampleRate(sampleRate_);
+	  rct->setNumThreads(num_threads);
 	  rct->build(points, n, scaleFactor, maxParents);
 
       timeval end;
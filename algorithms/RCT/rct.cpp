@@ -1,5 +1,42 @@
 #include "rct.h"
 
+/*!
+ * Header of the binary RCT file written by <code>saveToFile</code>. It is
+ * followed by these arrays, each starting at a multiple of 8 bytes:
+ *
+ * -# <code>int levelSetSizes[levels + 1]</code>
+ * -# <code>int internToExtern[size]</code>
+ * -# <code>long long childOffsets[numNodes + 1]</code>
+ * -# <code>int childIndices[numEdges]</code>
+ *
+ * The nodes are numbered level by level, starting with level <em>0</em>.
+ * The children of node <em>k</em> are <code>childIndices[childOffsets[k]]
+ * </code> to <code>childIndices[childOffsets[k + 1] - 1]</code>.
+ */
+struct RCTBinaryHeader {
+    char magic[8];
+    int version;
+    int size;
+    int levels;
+    int numNodes;
+    int maxParents;
+    int maxDegree;
+    float avgDegree;
+    float coverageParameter;
+    float buildScaleFactor;
+    int reserved;
+    unsigned long long seed;
+    long long numEdges;
+};
+
+/*!
+ * Returns the number of bytes needed to pad <em>length</em> bytes to a
+ * multiple of 8 bytes.
+ */
+static long long rctPadding(long long length) {
+    return (8 - (length % 8)) % 8;
+}
+
 /*!
  * Sets the sample rate.
  *
@@ -11,11 +48,28 @@ void RCT::setSampleRate(const float& sampleRate) {
     (*this).sampleRate = sampleRate;
 }
 
+/*!
+ * Sets the number of threads used for construction. The constructed RCT
+ * does not depend on the number of threads.
+ *
+ * @note Must be called before construction.
+ *
+ * @param numThreads The desired number of threads.
+ */
+void RCT::setNumThreads(const int& numThreads) {
+    if (numThreads <= 1) {
+        (*this).numThreads = 1;
+    } else {
+        (*this).numThreads = numThreads;
+    }
+}
+
 /*!
  * Constructor using seed for random number generator initialization.
  */
 RCT::RCT(const unsigned long& seed) {
     data = NULL;
+    items = NULL;
     size = 0;
     maxParents = 1;
     maxDegree = 0;
@@ -28,20 +82,12 @@ RCT::RCT(const unsigned long& seed) {
     parentLSizeLList = NULL;
     childIndexLLList = NULL;
     childLSizeLList = NULL;
-    query = NULL;
-    distFromQueryList = NULL;
-    storedDistIndexList = NULL;
-    numStoredDists = 0;
-    numDistComps = 0UL;
-    levelQuotaList = NULL;
+    context = NULL;
     coverageParameter = 1.0f;
-    queryResultIndexList = NULL;
-    queryResultDistList = NULL;
-    visitedNodeIndexList = NULL;
-    tempResultIndexList = NULL;
-    tempResultDistList = NULL;
-    queryResultSize = 0;
-    queryResultSampleSize = 0;
+    checks = 0;
+    numThreads = 1;
+    mapAddr = NULL;
+    mapLength = 0;
     verbosity = 0;
 		coverageParameter = 1.0f;
 		sampleRate = 2.0f;
@@ -59,6 +105,10 @@ RCT::~RCT() {
     int lvl;
     int tempLength = 0;
     data = NULL;
+    if (items != NULL) {
+        delete items;
+        items = NULL;
+    }
     if (internToExternMapping != NULL) {
         delete [] internToExternMapping;
         internToExternMapping = NULL;
@@ -102,11 +152,13 @@ RCT::~RCT() {
             if (childIndexLLList[lvl] != NULL) {
                 tempLength = levelSetSizeList[lvl];
 
+                // Child lists loaded from a binary file point into
+                //   the mapped file.
                 for (i = 0; i < tempLength; i++) {
-                    if (childIndexLLList[lvl][i] != NULL) {
+                    if ((childIndexLLList[lvl][i] != NULL) && (mapAddr == NULL)) {
                         delete [] childIndexLLList[lvl][i];
-                        childIndexLLList[lvl][i] = NULL;
                     }
+                    childIndexLLList[lvl][i] = NULL;
                 }
 
                 delete [] childIndexLLList[lvl];
@@ -135,46 +187,14 @@ RCT::~RCT() {
         levelSetSizeList = NULL;
     }
 
-    query = NULL;
-
-    if (distFromQueryList != NULL) {
-        delete [] distFromQueryList;
-        distFromQueryList = NULL;
-    }
-
-    if (storedDistIndexList != NULL) {
-        delete [] storedDistIndexList;
-        storedDistIndexList = NULL;
-    }
-
-    if (levelQuotaList != NULL) {
-        delete [] levelQuotaList;
-        levelQuotaList = NULL;
-    }
-
-    if (queryResultIndexList != NULL) {
-        delete [] queryResultIndexList;
-        queryResultIndexList = NULL;
+    if (context != NULL) {
+        delete context;
+        context = NULL;
     }
 
-    if (queryResultDistList != NULL) {
-        delete [] queryResultDistList;
-        queryResultDistList = NULL;
-    }
-
-    if (tempResultIndexList != NULL) {
-        delete [] tempResultIndexList;
-        tempResultIndexList = NULL;
-    }
-
-    if (tempResultDistList != NULL) {
-        delete [] tempResultDistList;
-        tempResultDistList = NULL;
-    }
-
-    if (visitedNodeIndexList != NULL) {
-        delete [] visitedNodeIndexList;
-        visitedNodeIndexList = NULL;
+    if (mapAddr != NULL) {
+        munmap(mapAddr, mapLength);
+        mapAddr = NULL;
     }
 }
 
@@ -194,12 +214,37 @@ RCT::~RCT() {
  * @return The number of items in the constructed RCT.
  */
 int RCT::build(DistData** inputData, const int& numItems, const float& scaleFactor, const int& numParents) {
+    data = inputData;
+    return buildFrom(inputData, NULL, numItems, scaleFactor, numParents);
+}
+
+/*!
+ * Constructs the RCT from a matrix of data items, where row <em>i</em> holds
+ * the item with external index <em>i</em>. The rows are copied into internal
+ * order, so the matrix (e.g. a view of a file mapped by
+ * <code>DistMatrix::mapFvecs</code>) may be released after construction.
+ *
+ * @param inputData A matrix of data items to build the RCT on.
+ * @param numItems The number of item in the data array that should be used.
+ * @param scaleFactor The scale factor used during construction.
+ * @param nunParents The maximum number of parents allowed per node.
+ * @return The number of items in the constructed RCT.
+ */
+int RCT::build(DistMatrix* inputData, const int& numItems, const float& scaleFactor, const int& numParents) {
+    data = NULL;
+    return buildFrom(NULL, inputData, numItems, scaleFactor, numParents);
+}
+
+/*!
+ * Constructs the RCT from either a list or a matrix of data items.
+ */
+int RCT::buildFrom(DistData** inputData, DistMatrix* inputMatrix, const int& numItems, const float& scaleFactor, const int& numParents) {
     int i = 0;
     int loc = 0;
     int temp = 0;
 
     // If the data set is empty, then abort.
-    if ((numItems <= 0) || (inputData == NULL)) {
+    if ((numItems <= 0) || ((inputData == NULL) && (inputMatrix == NULL))) {
         if (verbosity > 0) {
             if (numItems == 1) {
                 cerr << "ERROR (from build): data set has only 1 item." << endl;
@@ -213,8 +258,6 @@ int RCT::build(DistData** inputData, const int& numItems, const float& scaleFact
         cout << "Building RCT from data array..." << endl;
     }
 
-    data = inputData;
-
     // Set up level sizes.
     setupLevels(numItems, numParents);
 
@@ -233,9 +276,10 @@ int RCT::build(DistData** inputData, const int& numItems, const float& scaleFact
         internToExternMapping[loc] = internToExternMapping[i];
         internToExternMapping[i] = temp;
     }
+    setupItems(inputData, inputMatrix);
 
     // Build the RCT structure.
-    numDistComps = 0UL;
+    context->numDistComps = 0UL;
     buildScaleFactor = scaleFactor;
     doBuild();
 
@@ -250,18 +294,85 @@ int RCT::build(DistData** inputData, const int& numItems, const float& scaleFact
  * Loads a previously-computed RCT from the specified file. The original data
  * set must also be provided (as well as the number of items in the data set).
  *
- * @note The extension ".rctf" is automatically appended to the file name.
+ * @note The file "<fileName>.rctb" written by <code>saveToFile</code> is
+ *       read if it exists. Otherwise, the text file "<fileName>.rctf"
+ *       written by <code>saveToTextFile</code> (or by older versions) is read.
  *
  * @return If successful, the number of RCT items is returned. Otherwise, zero
  *         is returned.
  */
 int RCT::build(const char* fileName, DistData** inputData, const int& numItems) {
+    data = inputData;
+    return loadFrom(fileName, inputData, NULL, numItems);
+}
+
+/*!
+ * Loads a previously-computed RCT from the specified file. The original data
+ * set must be provided as a matrix, see <code>build(DistMatrix*, ...)</code>.
+ *
+ * @return If successful, the number of RCT items is returned. Otherwise, zero
+ *         is returned.
+ */
+int RCT::build(const char* fileName, DistMatrix* inputData, const int& numItems) {
+    data = NULL;
+    return loadFrom(fileName, NULL, inputData, numItems);
+}
+
+/*!
+ * Loads a previously-computed RCT for either a list or a matrix of data items.
+ */
+int RCT::loadFrom(const char* fileName, DistData** inputData, DistMatrix* inputMatrix, const int& numItems) {
+    int loaded = 0;
+
+    // If the data set is empty, then abort.
+    if ((fileName == NULL) || (numItems <= 0)
+            || ((inputData == NULL) && (inputMatrix == NULL))) {
+        if (verbosity > 0) {
+            if (numItems == 1) {
+                cerr << "ERROR (from build): data set has only 1 item." << endl;
+            } else {
+                cerr << "ERROR (from build): empty data set or filename.";
+                cerr << endl;
+            }
+
+        }
+        return 0;
+    }
+
+    // Prefer the binary file, and fall back to the text file.
+    ostringstream binFileName;
+    binFileName << fileName << ".rctb";
+    if (access(binFileName.str().c_str(), R_OK) == 0) {
+        if (verbosity >= 2) {
+            cout << "Loading RCT from file '" << binFileName.str() << "' ..." << endl;
+        }
+        loaded = loadBinary(binFileName.str().c_str(), numItems);
+    } else {
+        if (verbosity >= 2) {
+            cout << "Loading RCT from file '" << fileName << ".rctf' ..." << endl;
+        }
+        loaded = loadText(fileName, numItems);
+    }
+    if (loaded <= 0) {
+        return 0;
+    }
+    setupItems(inputData, inputMatrix);
+    return size;
+}
+
+/*!
+ * Reads an RCT from the text file "<fileName>.rctf". The data items are
+ * set up by the caller.
+ *
+ * @return If successful, the number of RCT items is returned. Otherwise, zero
+ *         is returned.
+ */
+int RCT::loadText(const char* fileName, const int& numItems) {
     int i = 0;
     int j = 0;
     int lvl = 0;
     int loc = 0;
     int inLevel = 0;
-    int temp = 0;
     int inSize = 0;
     int inLevels = 0;
     int inNumNodes = 0;
@@ -275,25 +386,6 @@ int RCT::build(const char* fileName, DistData** inputData, const int& numItems)
     ifstream inFile;
     int levelSetSize = 0;
 
-    // If the data set is empty, then abort.
-    if ((fileName == NULL) || (numItems <= 0) || (inputData == NULL)) {
-        if (verbosity > 0) {
-            if (numItems == 1) {
-                cerr << "ERROR (from build): data set has only 1 item." << endl;
-            } else {
-                cerr << "ERROR (from build): empty data set or filename.";
-                cerr << endl;
-            }
-
-        }
-        return 0;
-    }
-
-    if (verbosity >= 2) {
-        cout << "Loading RCT from file '" << fileName << ".rctf' ..." << endl;
-    }
-    data = inputData;
-
     // Open the file containing the RCT. If we fail to open the file, abort.
     ostringstream fullFileName;
     fullFileName << fileName << ".rctf";
@@ -345,10 +437,8 @@ int RCT::build(const char* fileName, DistData** inputData, const int& numItems)
 
     // Fetch the level set sizes.
     levelSetSizeList = new int [levels + 1];
-    levelQuotaList = new int [levels + 1];
     for (lvl = 0; lvl <= levels; lvl++) {
         inFile >> levelSetSizeList[lvl];
-        levelQuotaList[lvl] = 0;
     }
     getline(inFile, buffer);
 
@@ -392,6 +482,135 @@ int RCT::build(const char* fileName, DistData** inputData, const int& numItems)
     return size;
 }
 
+/*!
+ * Maps an RCT from the binary file <em>fileName</em> written by
+ * <code>saveToFile</code>. The child lists are not copied; they point into
+ * the mapped file until the RCT is destroyed. The data items are set up by
+ * the caller.
+ *
+ * @return If successful, the number of RCT items is returned. Otherwise, zero
+ *         is returned.
+ */
+int RCT::loadBinary(const char* fileName, const int& numItems) {
+    int i;
+    int lvl;
+    int fd;
+    int inNumNodes = 0;
+    long long node = 0LL;
+    long long pos = 0LL;
+    long long expectedLength = 0LL;
+    struct stat st;
+    void* addr = NULL;
+    const char* base = NULL;
+    const int* inLevelSetSizes = NULL;
+    const int* inMapping = NULL;
+    const long long* childOffsets = NULL;
+    int* childIndices = NULL;
+    RCTBinaryHeader header;
+
+    fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        if (verbosity > 0) {
+            cerr << "ERROR (from build): file '" << fileName;
+            cerr << "' could not be opened." << endl;
+        }
+        return 0;
+    }
+    if ((fstat(fd, &st) != 0) || ((long long)st.st_size < (long long)sizeof(header))) {
+        if (verbosity > 0) {
+            cerr << "ERROR (from build): file '" << fileName;
+            cerr << "' is too short." << endl;
+        }
+        close(fd);
+        return 0;
+    }
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        if (verbosity > 0) {
+            cerr << "ERROR (from build): file '" << fileName;
+            cerr << "' could not be mapped." << endl;
+        }
+        return 0;
+    }
+    base = (const char*)addr;
+
+    // Check the header. Are these parameter values what we expected?
+    // If not, then abort!
+    memcpy(&header, base, sizeof(header));
+    if ((memcmp(header.magic, RCT_BINARY_MAGIC_, sizeof(header.magic)) != 0)
+            || (header.version != RCT_BINARY_VERSION_)
+            || (header.size != numItems)
+            || (header.levels < 0)) {
+        if (verbosity > 0) {
+            cerr << "ERROR (from build): unexpected RCT parameters in file";
+            cerr << " '" << fileName << "'." << endl;
+        }
+        munmap(addr, st.st_size);
+        return 0;
+    }
+
+    // Locate the arrays, and make sure that the file holds all of them.
+    pos = sizeof(header);
+    inLevelSetSizes = (const int*)(base + pos);
+    pos += sizeof(int) * ((long long)header.levels + 1);
+    pos += rctPadding(pos);
+    inMapping = (const int*)(base + pos);
+    pos += sizeof(int) * (long long)header.size;
+    pos += rctPadding(pos);
+    childOffsets = (const long long*)(base + pos);
+    pos += sizeof(long long) * ((long long)header.numNodes + 1);
+    childIndices = (int*)(base + pos);
+    expectedLength = pos + sizeof(int) * header.numEdges;
+    if (expectedLength == (long long)st.st_size) {
+        for (lvl = 0; lvl <= header.levels; lvl++) {
+            inNumNodes += inLevelSetSizes[lvl];
+        }
+    }
+    if ((expectedLength != (long long)st.st_size) || (inNumNodes != header.numNodes)) {
+        if (verbosity > 0) {
+            cerr << "ERROR (from build): invalid entry in file '";
+            cerr << fileName << "'." << endl;
+        }
+        munmap(addr, st.st_size);
+        return 0;
+    }
+
+    // Assign properties.
+    size = header.size;
+    levels = header.levels;
+    numNodes = header.numNodes;
+    maxParents = header.maxParents;
+    maxDegree = header.maxDegree;
+    avgDegree = header.avgDegree;
+    coverageParameter = header.coverageParameter;
+    buildScaleFactor = header.buildScaleFactor;
+    seed = (unsigned long)header.seed;
+
+    levelSetSizeList = new int [levels + 1];
+    memcpy(levelSetSizeList, inLevelSetSizes, sizeof(int) * (levels + 1));
+
+    // Reserve RCT storage. After this operation, the expected RCT size,
+    // number of levels, etc, are set.
+    reserveStorage();
+    memcpy(internToExternMapping, inMapping, sizeof(int) * size);
+
+    // Attach the child lists.
+    for (lvl = 0; lvl <= levels; lvl++) {
+        for (i = 0; i < levelSetSizeList[lvl]; i++) {
+            childLSizeLList[lvl][i] = (int)(childOffsets[node + 1] - childOffsets[node]);
+            if (childLSizeLList[lvl][i] > 0) {
+                childIndexLLList[lvl][i] = childIndices + childOffsets[node];
+            }
+            node++;
+        }
+    }
+
+    mapAddr = addr;
+    mapLength = st.st_size;
+    return size;
+}
+
 /*!
  * Perform an exact range query for the specified item. The upper limit on the
  * query-to-item distance must be supplied. The search is relative to the
@@ -412,9 +631,16 @@ int RCT::build(const char* fileName, DistData** inputData, const int& numItems)
  *       increasing order of their distances to the query.
  */
 int RCT::findAllInRange(DistData* query, const float& limit, const int& sampleLevel) {
-    queryResultSize = 0;
-    queryResultSampleSize = 0;
-    numDistComps = 0UL;
+    return findAllInRange((query == NULL) ? (const float*) NULL : query->value, limit, sampleLevel);
+}
+
+/*!
+ * Same as above, for a query given by its coordinates.
+ */
+int RCT::findAllInRange(const float* query, const float& limit, const int& sampleLevel) {
+    context->queryResultSize = 0;
+    context->queryResultSampleSize = 0;
+    context->numDistComps = 0UL;
     if ((size <= 0)
             || (query == NULL)
             || (limit < 0.0F)
@@ -425,8 +651,8 @@ int RCT::findAllInRange(DistData* query, const float& limit, const int& sampleLe
         }
         return 0;
     }
-    setNewQuery(query);
-    return doFindAllInRange(limit, sampleLevel);
+    setNewQuery(context, query);
+    return doFindAllInRange(context, limit, sampleLevel);
 }
 
 /*!
@@ -451,9 +677,16 @@ int RCT::findAllInRange(DistData* query, const float& limit, const int& sampleLe
  *       increasing order of their distances to the query.
  */
 int RCT::findMostInRange(DistData* query, const float& limit, const float& scaleFactor, const int& sampleLevel) {
-    queryResultSize = 0;
-    queryResultSampleSize = 0;
-    numDistComps = 0UL;
+    return findMostInRange((query == NULL) ? (const float*) NULL : query->value, limit, scaleFactor, sampleLevel);
+}
+
+/*!
+ * Same as above, for a query given by its coordinates.
+ */
+int RCT::findMostInRange(const float* query, const float& limit, const float& scaleFactor, const int& sampleLevel) {
+    context->queryResultSize = 0;
+    context->queryResultSampleSize = 0;
+    context->numDistComps = 0UL;
     if ((size <= 0)
             || (query == NULL)
             || (limit < 0.0F)
@@ -465,8 +698,8 @@ int RCT::findMostInRange(DistData* query, const float& limit, const float& scale
         }
         return 0;
     }
-    setNewQuery(query);
-    return doFindMostInRange(limit, sampleLevel, scaleFactor);
+    setNewQuery(context, query);
+    return doFindMostInRange(context, limit, sampleLevel, scaleFactor);
 }
 
 /*!
@@ -492,9 +725,16 @@ int RCT::findMostInRange(DistData* query, const float& limit, const float& scale
  *       increasing order of their distances to the query.
  */
 int RCT::findNear(DistData* query, const int& howMany, const float& scaleFactor, const int& sampleLevel) {
-    queryResultSize = 0;
-    queryResultSampleSize = 0;
-    numDistComps = 0UL;
+    return findNear((query == NULL) ? (const float*) NULL : query->value, howMany, scaleFactor, sampleLevel);
+}
+
+/*!
+ * Same as above, for a query given by its coordinates.
+ */
+int RCT::findNear(const float* query, const int& howMany, const float& scaleFactor, const int& sampleLevel) {
+    context->queryResultSize = 0;
+    context->queryResultSampleSize = 0;
+    context->numDistComps = 0UL;
     if ((size <= 0)
             || (query == NULL)
             || (howMany <= 0)
@@ -506,8 +746,10 @@ int RCT::findNear(DistData* query, const int& howMany, const float& scaleFactor,
         }
         return 0;
     }
-    setNewQuery(query);
-    return doFindNear(howMany, sampleLevel, scaleFactor);
+    setNewQuery(context, query);
+    doFindNear(context, howMany, sampleLevel, scaleFactor);
+    checks = context->checks;
+    return context->queryResultSize;
 }
 
 /*!
@@ -531,9 +773,16 @@ int RCT::findNear(DistData* query, const int& howMany, const float& scaleFactor,
  *       increasing order of their distances to the query.
  */
 int RCT::findNearest(DistData* query, const int& howMany, const int& sampleLevel) {
-    queryResultSize = 0;
-    queryResultSampleSize = 0;
-    numDistComps = 0UL;
+    return findNearest((query == NULL) ? (const float*) NULL : query->value, howMany, sampleLevel);
+}
+
+/*!
+ * Same as above, for a query given by its coordinates.
+ */
+int RCT::findNearest(const float* query, const int& howMany, const int& sampleLevel) {
+    context->queryResultSize = 0;
+    context->queryResultSampleSize = 0;
+    context->numDistComps = 0UL;
     if ((size <= 0)
             || (query == NULL)
             || (howMany <= 0)
@@ -544,8 +793,89 @@ int RCT::findNearest(DistData* query, const int& howMany, const int& sampleLevel
         }
         return 0;
     }
-    setNewQuery(query);
-    return doFindNearest(howMany, sampleLevel);
+    setNewQuery(context, query);
+    return doFindNearest(context, howMany, sampleLevel);
+}
+
+/*!
+ * Creates a query context for this RCT. Queries issued through a context
+ * leave the RCT unchanged, so each thread can search the same RCT with its
+ * own context.
+ *
+ * @param seed Seed of the context's generator used for breaking ties.
+ * @return A new query context, which must be deleted by the caller, or
+ *         <em>NULL</em> if the RCT has not been built.
+ */
+RCTQueryContext* RCT::createQueryContext(const unsigned long& seed) const {
+    if (size <= 0) {
+        return NULL;
+    }
+    return new RCTQueryContext(size, levels, internToExternMapping, seed);
+}
+
+/*!
+ * Same as <code>findNear</code>, except that the query state and the query
+ * result are kept in the supplied context instead of the RCT.
+ *
+ * @param ctx A query context created by this RCT.
+ *
+ * @note The query result can be obtained via calls to the methods of the
+ *       context: <code>getResultDists</code>, <code>getResultDistComps</code>,
+ *       <code>getResultIndices</code> and <code>getResultNumFound</code>.
+ */
+int RCT::findNear(RCTQueryContext* ctx, const float* query, const int& howMany, const float& scaleFactor, const int& sampleLevel) const {
+    if (ctx == NULL) {
+        if (verbosity > 0) {
+            cerr << "ERROR (from findNear): query context is NULL." << endl;
+        }
+        return 0;
+    }
+    ctx->queryResultSize = 0;
+    ctx->queryResultSampleSize = 0;
+    ctx->numDistComps = 0UL;
+    if ((size <= 0)
+            || (query == NULL)
+            || (howMany <= 0)
+            || (sampleLevel < 0)
+            || ((sampleLevel >= levels) && (size > 1))
+            || (scaleFactor <= 0.0F)) {
+        if (verbosity > 0) {
+            cerr << "ERROR (from findNear): invalid argument(s)." << endl;
+        }
+        return 0;
+    }
+    setNewQuery(ctx, query);
+    return doFindNear(ctx, howMany, sampleLevel, scaleFactor);
+}
+
+/*!
+ * Same as <code>findNearest</code>, except that the query state and the
+ * query result are kept in the supplied context instead of the RCT.
+ *
+ * @param ctx A query context created by this RCT.
+ */
+int RCT::findNearest(RCTQueryContext* ctx, const float* query, const int& howMany, const int& sampleLevel) const {
+    if (ctx == NULL) {
+        if (verbosity > 0) {
+            cerr << "ERROR (from findNearest): query context is NULL." << endl;
+        }
+        return 0;
+    }
+    ctx->queryResultSize = 0;
+    ctx->queryResultSampleSize = 0;
+    ctx->numDistComps = 0UL;
+    if ((size <= 0)
+            || (query == NULL)
+            || (howMany <= 0)
+            || (sampleLevel < 0)
+            || ((sampleLevel >= levels) && (size > 1))) {
+        if (verbosity > 0) {
+            cerr << "ERROR (from findNearest): invalid argument(s)." << endl;
+        }
+        return 0;
+    }
+    setNewQuery(ctx, query);
+    return doFindNearest(ctx, howMany, sampleLevel);
 }
 
 /*!
@@ -593,6 +923,16 @@ DistData** RCT::getData() {
     return data;
 }
 
+/*!
+ * Retrieve the copy of the data items in internal order. Row <em>i</em>
+ * holds the item with internal index <em>i</em>.
+ *
+ * @return The data items in internal order.
+ */
+DistMatrix* RCT::getItems() {
+    return items;
+}
+
 /*!
  * Fills the supplied list with the mapping from external item indices to
  * internal RCT indices.
@@ -767,7 +1107,10 @@ int RCT::getNumNodes() const {
 float RCT::getResultAcc(float* exactDistList, int howMany) const {
     int i;
     int loc = 0;
-    if ((exactDistList == NULL) || (howMany < queryResultSize)) {
+    if (context == NULL) {
+        return RCT_UNKNOWN_;
+    }
+    if ((exactDistList == NULL) || (howMany < context->queryResultSize)) {
         if (verbosity > 0) {
             cerr << "ERROR (from getResultAcc): exact distance list is too ";
             cerr << "small." << endl;
@@ -775,8 +1118,8 @@ float RCT::getResultAcc(float* exactDistList, int howMany) const {
         return RCT_UNKNOWN_;
     }
     for (i = 0; i < howMany; i++) {
-        if ((loc < queryResultSize)
-                && (queryResultDistList[loc] <= exactDistList[i])) {
+        if ((loc < context->queryResultSize)
+                && (context->queryResultDistList[loc] <= exactDistList[i])) {
             loc++;
         }
     }
@@ -794,18 +1137,17 @@ float RCT::getResultAcc(float* exactDistList, int howMany) const {
  *         zero is returned.
  */
 int RCT::getResultDists(float* result, int capacity) const {
-    int i;
-    if ((result == NULL) || (capacity < queryResultSize)) {
+    if (context == NULL) {
+        return 0;
+    }
+    if ((result == NULL) || (capacity < context->queryResultSize)) {
         if (verbosity > 0) {
             cerr << "ERROR (from getResultDists): result list capacity is too ";
             cerr << "small." << endl;
         }
         return 0;
     }
-    for (i = 0; i < queryResultSize; i++) {
-        result[i] = queryResultDistList[i];
-    }
-    return queryResultSize;
+    return context->getResultDists(result, capacity);
 }
 
 /*!
@@ -815,7 +1157,10 @@ int RCT::getResultDists(float* result, int capacity) const {
  * @return The number of distance comparisons.
  */
 unsigned long RCT::getResultDistComps() const {
-    return numDistComps;
+    if (context == NULL) {
+        return 0UL;
+    }
+    return context->getResultDistComps();
 }
 
 /*!
@@ -829,18 +1174,17 @@ unsigned long RCT::getResultDistComps() const {
  *         zero is returned.
  */
 int RCT::getResultIndices(int* result, int capacity) const {
-    int i;
-    if ((result == NULL) || (capacity < queryResultSize)) {
+    if (context == NULL) {
+        return 0;
+    }
+    if ((result == NULL) || (capacity < context->queryResultSize)) {
         if (verbosity > 0) {
             cerr << "ERROR (from getResultIndices): result list capacity is ";
             cerr << "too small." << endl;
         }
         return 0;
     }
-    for (i = 0; i < queryResultSize; i++) {
-        result[i] = internToExternMapping[queryResultIndexList[i]];
-    }
-    return queryResultSize;
+    return context->getResultIndices(result, capacity);
 }
 
 /*!
@@ -849,7 +1193,10 @@ int RCT::getResultIndices(int* result, int capacity) const {
  * @return Number of results found in the most recent query.
  */
 int RCT::getResultNumFound() const {
-    return queryResultSize;
+    if (context == NULL) {
+        return 0;
+    }
+    return context->getResultNumFound();
 }
 
 /*!
@@ -858,7 +1205,10 @@ int RCT::getResultNumFound() const {
  * @return Sample size used in the most recent query.
  */
 int RCT::getResultSampleSize() const {
-    return queryResultSampleSize;
+    if (context == NULL) {
+        return 0;
+    }
+    return context->getResultSampleSize();
 }
 
 /*!
@@ -875,18 +1225,122 @@ unsigned long RCT::getRNGSeed() const {
  * all needed distances from scratch.
  */
 void RCT::resetQuery() {
-    setNewQuery(NULL);
+    if (context != NULL) {
+        setNewQuery(context, NULL);
+    }
 }
 
 /*!
- * Save the RCT to the specified file. The extension ".rctf" is automatically 
- * appended to the file name.
+ * Save the RCT to the specified file in binary form. The extension ".rctb"
+ * is automatically appended to the file name. The file consists of a header
+ * and flat arrays (see <code>RCTBinaryHeader</code>), which are mapped into
+ * memory by <code>build(fileName, ...)</code> without parsing.
  *
  * @param fileName The file name to save the RCT under.
  * @return If successful, the number of RCT items is returned. Otherwise,
  *         zero is returned.
  */
 int RCT::saveToFile(const char* fileName) const {
+    int i;
+    int lvl;
+    long long numEdges = 0LL;
+    long long offset = 0LL;
+    const char padding[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    RCTBinaryHeader header;
+    ofstream outFile;
+
+    // If the RCT has not yet been built, abort.
+    if (size <= 0) {
+        return 0;
+    }
+
+    if (fileName == NULL) {
+        if (verbosity > 0) {
+            cerr << "ERROR (from saveToFile): output file name is NULL." << endl;
+        }
+        return 0;
+    }
+
+    // Attach extension '.rctb'.
+    ostringstream fullFileName;
+    fullFileName << fileName << ".rctb";
+
+    outFile.open(fullFileName.str().c_str(), ios::out | ios::binary);
+    if (!outFile.is_open()) {
+        if (verbosity > 0) {
+            cerr << "ERROR (from saveToFile): file '" << fullFileName.str();
+            cerr << "' could not be opened." << endl;
+        }
+        return 0;
+    }
+
+    for (lvl = 0; lvl <= levels; lvl++) {
+        for (i = 0; i < levelSetSizeList[lvl]; i++) {
+            numEdges += childLSizeLList[lvl][i];
+        }
+    }
+
+    // Write the header.
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RCT_BINARY_MAGIC_, sizeof(header.magic));
+    header.version = RCT_BINARY_VERSION_;
+    header.size = size;
+    header.levels = levels;
+    header.numNodes = numNodes;
+    header.maxParents = maxParents;
+    header.maxDegree = maxDegree;
+    header.avgDegree = avgDegree;
+    header.coverageParameter = coverageParameter;
+    header.buildScaleFactor = buildScaleFactor;
+    header.seed = seed;
+    header.numEdges = numEdges;
+    outFile.write((const char*)&header, sizeof(header));
+
+    // Write the level set sizes and the mapping to external indices.
+    outFile.write((const char*)levelSetSizeList, sizeof(int) * (levels + 1));
+    outFile.write(padding, rctPadding(sizeof(int) * (levels + 1)));
+    outFile.write((const char*)internToExternMapping, sizeof(int) * size);
+    outFile.write(padding, rctPadding(sizeof(int) * (long long)size));
+
+    // Write the child offsets, followed by the child lists.
+    for (lvl = 0; lvl <= levels; lvl++) {
+        for (i = 0; i < levelSetSizeList[lvl]; i++) {
+            outFile.write((const char*)&offset, sizeof(offset));
+            offset += childLSizeLList[lvl][i];
+        }
+    }
+    outFile.write((const char*)&offset, sizeof(offset));
+
+    for (lvl = 0; lvl <= levels; lvl++) {
+        for (i = 0; i < levelSetSizeList[lvl]; i++) {
+            if (childLSizeLList[lvl][i] > 0) {
+                outFile.write((const char*)childIndexLLList[lvl][i],
+                        sizeof(int) * childLSizeLList[lvl][i]);
+            }
+        }
+    }
+
+    if (!outFile.good()) {
+        if (verbosity > 0) {
+            cerr << "ERROR (from saveToFile): file '" << fullFileName.str();
+            cerr << "' could not be written." << endl;
+        }
+        outFile.close();
+        return 0;
+    }
+    outFile.close();
+    return size;
+}
+
+/*!
+ * Save the RCT to the specified file in the text format of version 1.0. The
+ * extension ".rctf" is automatically appended to the file name.
+ *
+ * @param fileName The file name to save the RCT under.
+ * @return If successful, the number of RCT items is returned. Otherwise,
+ *         zero is returned.
+ */
+int RCT::saveToTextFile(const char* fileName) const {
     int i;
     int j;
     int lvl;
@@ -904,7 +1358,7 @@ int RCT::saveToFile(const char* fileName) const {
     // If this fails, then abort.
     if (fileName == NULL) {
         if (verbosity > 0) {
-            cerr << "ERROR (from saveToFile): output file name is NULL." << endl;
+            cerr << "ERROR (from saveToTextFile): output file name is NULL." << endl;
         }
         return 0;
     }
@@ -917,7 +1371,7 @@ int RCT::saveToFile(const char* fileName) const {
     outFile.open(fullFileName.str().c_str(), ios::out);
     if (!outFile.is_open()) {
         if (verbosity > 0) {
-            cerr << "ERROR (from saveToFile): file '" << fullFileName.str();
+            cerr << "ERROR (from saveToTextFile): file '" << fullFileName.str();
             cerr << "' could not be opened." << endl;
         }
         return 0;
@@ -1006,15 +1460,15 @@ void RCT::setVerbosity(const int& verbosity) {
  * @param itemIndex The internal index of a data item.
  * @return The distance from the current query to that item.
  */
-float RCT::computeDistFromQuery(int itemIndex) {
-    if (distFromQueryList[itemIndex] == RCT_UNKNOWN_) {
-        distFromQueryList[itemIndex]
-                = query->distanceTo(data[internToExternMapping[itemIndex]]);
-        storedDistIndexList[numStoredDists] = itemIndex;
-        numStoredDists++;
-        numDistComps++;
-    }
-    return distFromQueryList[itemIndex];
+float RCT::computeDistFromQuery(RCTQueryContext* ctx, int itemIndex) const {
+    if (ctx->distFromQueryList[itemIndex] == RCT_UNKNOWN_) {
+        ctx->distFromQueryList[itemIndex]
+                = distMatrixL2(ctx->query, items->getRow(itemIndex), items->getDim());
+        ctx->storedDistIndexList[ctx->numStoredDists] = itemIndex;
+        ctx->numStoredDists++;
+        ctx->numDistComps++;
+    }
+    return ctx->distFromQueryList[itemIndex];
 }
 
 /*!
@@ -1029,7 +1483,9 @@ void RCT::doBuild() {
     int parent = 0;
     int child = 0;
     int childLSize = 0;
-    int offset = 0;
+    int t = 0;
+    atomic<int> nextChild(0);
+    RCTQueryContext** threadContexts = NULL;
     long int totalDegree = 0L;
 
     // Build the top level of the RCT as a special case.
@@ -1056,6 +1512,14 @@ void RCT::doBuild() {
         fflush(NULL);
     }
 
+    // The default context serves the first build thread.
+    if (numThreads > 1) {
+        threadContexts = new RCTQueryContext* [numThreads - 1];
+        for (t = 0; t < numThreads - 1; t++) {
+            threadContexts[t] = createQueryContext(seed);
+        }
+    }
+
     for (lvl = levels - 2; lvl >= 0; lvl--) {
         numUpperItems = levelSetSizeList[lvl + 1];
         numLowerItems = levelSetSizeList[lvl];
@@ -1066,72 +1530,28 @@ void RCT::doBuild() {
 
         // For each item at this level, generate a set of
         //   parents from the bottom level of the current RCT.
-        // Also, temporarily store (in "childLSizeLList") the number of times
-        //   each node is requested as a parent.
-        for (child = 0; child < numLowerItems; child++) {
-            if ((child % 5000 == 4999) && (verbosity >= 2)) {
-                printf("Inserting item %d (out of %d) at level %d...\n",
-                        child + 1, size, lvl);
-                fflush(NULL);
-            }
-
-            // Find some parents for the current child.
-            // If only one parent is requested and the child has a copy
-            //   at the level above, then just choose it directly.
-            // Otherwise, do a search.
-
-            if ((child < numUpperItems) && (maxParents == 1)) {
-                queryResultSize = 1;
-                queryResultIndexList[0] = child;
-            } else {
-                setNewQuery(data[internToExternMapping[child]]);
-
-                if (buildScaleFactor <= 0.0F) {
-                    doFindNearest(maxParents, lvl + 1);
-                } else {
-                    doFindNear(maxParents, lvl + 1, buildScaleFactor);
-                }
+        // The searches only read the levels above, so they are spread
+        //   over the build threads, each with its own query context.
+        nextChild = 0;
+        if (numThreads <= 1) {
+            insertChildren(context, lvl, &nextChild);
+        } else {
+            vector<thread> threads;
+            for (t = 1; t < numThreads; t++) {
+                threads.push_back(thread(&RCT::insertChildren, this,
+                        threadContexts[t - 1], lvl, &nextChild));
             }
-
-            // Connect links from child to parents.
-            // If a copy of the child also exists at the upper level,
-            //   then make sure that it is listed as the first parent.
-
-            parentLSizeLList[lvl][child] = queryResultSize;
-            parentIndexLLList[lvl][child] = new int [maxParents];
-
-            if ((child < numUpperItems) && (queryResultIndexList[0] != child)) {
-                // The first query result should have been a copy of the
-                //   child, but wasn't.
-                // Repair this situation by explicitly placing a copy of the child
-                //   at the head of the list, and shifting the remaining query
-                //   result elements to accommodate the child copy.
-
-                offset = 1;
-                parentIndexLLList[lvl][child][0] = child;
-                childLSizeLList[lvl + 1][child]++;
-            } else {
-                // Either the query result contains a copy of the child at its
-                //   head, or the child isn't supposed to appear in the
-                //   query result anyway.
-
-                offset = 0;
-                parentIndexLLList[lvl][child][0] = queryResultIndexList[0];
-                childLSizeLList[lvl + 1][queryResultIndexList[0]]++;
+            insertChildren(context, lvl, &nextChild);
+            for (t = 0; t < (int)threads.size(); t++) {
+                threads[t].join();
             }
+        }
 
-            for (i = 1; i < queryResultSize; i++) {
-                // Apply an offset shift only until a copy of the child is found
-                //   (one may not necessarily be found).
-                // This is to avoid picking up this copy more than once.
-
-                if (queryResultIndexList[i] == child) {
-                    offset = 0;
-                } else {
-                    parentIndexLLList[lvl][child][i]
-                            = queryResultIndexList[i - offset];
-                    childLSizeLList[lvl + 1][queryResultIndexList[i - offset]]++;
-                }
+        // Temporarily store (in "childLSizeLList") the number of times
+        //   each node is requested as a parent.
+        for (child = 0; child < numLowerItems; child++) {
+            for (i = 0; i < parentLSizeLList[lvl][child]; i++) {
+                childLSizeLList[lvl + 1][parentIndexLLList[lvl][child][i]]++;
             }
         }
 
@@ -1179,9 +1599,115 @@ void RCT::doBuild() {
         }
     }
 
+    if (threadContexts != NULL) {
+        for (t = 0; t < numThreads - 1; t++) {
+            context->numDistComps += threadContexts[t]->numDistComps;
+            delete threadContexts[t];
+        }
+        delete [] threadContexts;
+        threadContexts = NULL;
+    }
+
     avgDegree = (float)(((double)totalDegree) / (numNodes - size));
 }
 
+/*!
+ * Finds the parents of items at level <em>lvl</em> among the items at level
+ * <em>lvl + 1</em>, which must already be connected to the RCT. Items are
+ * taken in chunks from the shared counter <em>nextChild</em> until all
+ * items of the level are done, so several threads can run this method at
+ * once. The parents of each item are stored in its parent list.
+ *
+ * @note The tie-breaking generator of the context is reseeded for every
+ *       item, which makes the result independent of the number of threads.
+ *
+ * @param ctx The query context used by the calling thread.
+ * @param lvl The level whose items are inserted.
+ * @param nextChild The next item of the level that is not yet taken.
+ */
+void RCT::insertChildren(RCTQueryContext* ctx, int lvl, atomic<int>* nextChild) {
+    int i;
+    int child = 0;
+    int first = 0;
+    int last = 0;
+    int offset = 0;
+    int numUpperItems = levelSetSizeList[lvl + 1];
+    int numLowerItems = levelSetSizeList[lvl];
+    int* parentList = NULL;
+
+    while ((first = nextChild->fetch_add(RCT_BUILD_CHUNK_)) < numLowerItems) {
+        last = first + RCT_BUILD_CHUNK_;
+        if (last > numLowerItems) {
+            last = numLowerItems;
+        }
+
+        for (child = first; child < last; child++) {
+            if ((child % 5000 == 4999) && (verbosity >= 2)) {
+                printf("Inserting item %d (out of %d) at level %d...\n",
+                        child + 1, size, lvl);
+                fflush(NULL);
+            }
+
+            // Find some parents for the current child.
+            // If only one parent is requested and the child has a copy
+            //   at the level above, then just choose it directly.
+            // Otherwise, do a search.
+
+            if ((child < numUpperItems) && (maxParents == 1)) {
+                ctx->queryResultSize = 1;
+                ctx->queryResultIndexList[0] = child;
+            } else {
+                ctx->reseed(seed + (unsigned long)lvl * size + child);
+                setNewQuery(ctx, items->getRow(child));
+
+                if (buildScaleFactor <= 0.0F) {
+                    doFindNearest(ctx, maxParents, lvl + 1);
+                } else {
+                    doFindNear(ctx, maxParents, lvl + 1, buildScaleFactor);
+                }
+            }
+
+            // Connect links from child to parents.
+            // If a copy of the child also exists at the upper level,
+            //   then make sure that it is listed as the first parent.
+
+            parentList = new int [maxParents]();
+            parentLSizeLList[lvl][child] = ctx->queryResultSize;
+            parentIndexLLList[lvl][child] = parentList;
+
+            if ((child < numUpperItems) && (ctx->queryResultIndexList[0] != child)) {
+                // The first query result should have been a copy of the
+                //   child, but wasn't.
+                // Repair this situation by explicitly placing a copy of the child
+                //   at the head of the list, and shifting the remaining query
+                //   result elements to accommodate the child copy.
+
+                offset = 1;
+                parentList[0] = child;
+            } else {
+                // Either the query result contains a copy of the child at its
+                //   head, or the child isn't supposed to appear in the
+                //   query result anyway.
+
+                offset = 0;
+                parentList[0] = ctx->queryResultIndexList[0];
+            }
+
+            for (i = 1; i < ctx->queryResultSize; i++) {
+                // Apply an offset shift only until a copy of the child is found
+                //   (one may not necessarily be found).
+                // This is to avoid picking up this copy more than once.
+
+                if (ctx->queryResultIndexList[i] == child) {
+                    offset = 0;
+                } else {
+                    parentList[i] = ctx->queryResultIndexList[i - offset];
+                }
+            }
+        }
+    }
+}
+
 /*!
  * Performs an exact range query from the current query object, with respect to
  * a subset of the items. The subset consists of all items at the indicated
@@ -1193,53 +1719,54 @@ void RCT::doBuild() {
  *
  * @return The number of neighbors found.
  */
-int RCT::doFindAllInRange(float limit, int sampleLevel) {
+int RCT::doFindAllInRange(RCTQueryContext* ctx, float limit, int sampleLevel) const {
     int i;
 
     // Handle the singleton case separately.
     if (size == 1) {
-        queryResultDistList[0] = computeDistFromQuery(0);
-        queryResultIndexList[0] = 0;
-        queryResultSampleSize = 1;
+        ctx->queryResultDistList[0] = computeDistFromQuery(ctx, 0);
+        ctx->queryResultIndexList[0] = 0;
+        ctx->queryResultSampleSize = 1;
 
-        if (queryResultDistList[0] <= limit) {
-            queryResultSize = 1;
+        if (ctx->queryResultDistList[0] <= limit) {
+            ctx->queryResultSize = 1;
         } else {
-            queryResultSize = 0;
+            ctx->queryResultSize = 0;
         }
 
-        return queryResultSize;
+        return ctx->queryResultSize;
     }
 
-    queryResultSampleSize = levelSetSizeList[sampleLevel];
+    ctx->queryResultSampleSize = levelSetSizeList[sampleLevel];
 
     // Compute distances from the current query to all items.
 
-    for (i = 0; i < queryResultSampleSize; i++) {
-        queryResultDistList[i] = computeDistFromQuery(i);
-        queryResultIndexList[i] = i;
+    for (i = 0; i < ctx->queryResultSampleSize; i++) {
+        ctx->queryResultDistList[i] = computeDistFromQuery(ctx, i);
+        ctx->queryResultIndexList[i] = i;
     }
 
     // Sort the items by distances, returning the number of 
     //   elements actually found.
 
     quickSort
-            (queryResultDistList,
-            queryResultIndexList,
+            (ctx,
+            ctx->queryResultDistList,
+            ctx->queryResultIndexList,
             0,
-            queryResultSampleSize - 1);
+            ctx->queryResultSampleSize - 1);
 
     // Report only those items whose distances fall within the limit.
 
     i = 0;
 
-    while ((i < queryResultSize) && (queryResultDistList[i] <= limit)) {
+    while ((i < ctx->queryResultSize) && (ctx->queryResultDistList[i] <= limit)) {
         i++;
     }
 
-    queryResultSize = i;
+    ctx->queryResultSize = i;
 
-    return queryResultSize;
+    return ctx->queryResultSize;
 }
 
 /*!
@@ -1257,7 +1784,7 @@ int RCT::doFindAllInRange(float limit, int sampleLevel) {
  *
  * @return Number of neighbors found.
  */
-int RCT::doFindMostInRange(float limit, int sampleLevel, float scaleFactor) {
+int RCT::doFindMostInRange(RCTQueryContext* ctx, float limit, int sampleLevel, float scaleFactor) const {
     int i;
     int j;
     int lvl;
@@ -1272,22 +1799,22 @@ int RCT::doFindMostInRange(float limit, int sampleLevel, float scaleFactor) {
     // Handle the singleton case separately.
 
     if (size == 1) {
-        queryResultDistList[0] = computeDistFromQuery(0);
-        queryResultIndexList[0] = 0;
-        queryResultSampleSize = 1;
+        ctx->queryResultDistList[0] = computeDistFromQuery(ctx, 0);
+        ctx->queryResultIndexList[0] = 0;
+        ctx->queryResultSampleSize = 1;
 
-        if (queryResultDistList[0] <= limit) {
-            queryResultSize = 1;
+        if (ctx->queryResultDistList[0] <= limit) {
+            ctx->queryResultSize = 1;
         } else {
-            queryResultSize = 0;
+            ctx->queryResultSize = 0;
         }
 
-        return queryResultSize;
+        return ctx->queryResultSize;
     }
 
     // Compute the sample size for the operation.
 
-    queryResultSampleSize = levelSetSizeList[sampleLevel];
+    ctx->queryResultSampleSize = levelSetSizeList[sampleLevel];
 
     // Compute the minimum number of neighbours for each sample level.
 
@@ -1295,10 +1822,10 @@ int RCT::doFindMostInRange(float limit, int sampleLevel, float scaleFactor) {
 
     // Load the root as the tentative sole member of the query result list.
 
-    queryResultSize = 0;
+    ctx->queryResultSize = 0;
 
-    queryResultDistList[0] = computeDistFromQuery(0);
-    queryResultIndexList[0] = 0;
+    ctx->queryResultDistList[0] = computeDistFromQuery(ctx, 0);
+    ctx->queryResultIndexList[0] = 0;
     numRetained = 1;
 
     // From the root, search out other nodes to place in the query result.
@@ -1310,43 +1837,43 @@ int RCT::doFindMostInRange(float limit, int sampleLevel, float scaleFactor) {
         numFound = 0;
 
         for (i = 0; i < numRetained; i++) {
-            nodeIndex = queryResultIndexList[i];
+            nodeIndex = ctx->queryResultIndexList[i];
             numChildren = childLSizeLList[lvl][nodeIndex];
             childList = childIndexLLList[lvl][nodeIndex];
 
             for (j = 0; j < numChildren; j++) {
                 child = childList[j];
 
-                if (visitedNodeIndexList[child] != TRUE) {
-                    visitedNodeIndexList[child] = TRUE;
-                    tempResultIndexList[numFound] = child;
-                    tempResultDistList[numFound] = computeDistFromQuery(child);
+                if (ctx->visitedNodeIndexList[child] != TRUE) {
+                    ctx->visitedNodeIndexList[child] = TRUE;
+                    ctx->tempResultIndexList[numFound] = child;
+                    ctx->tempResultDistList[numFound] = computeDistFromQuery(ctx, child);
                     numFound++;
                 }
             }
         }
 
         for (i = 0; i < numFound; i++) {
-            visitedNodeIndexList[tempResultIndexList[i]] = FALSE;
+            ctx->visitedNodeIndexList[ctx->tempResultIndexList[i]] = FALSE;
         }
 
         // Extract the closest nodes from the list of accumulated children,
         //   and keep them as the tentative parents of the query.
 
-        quickSort(tempResultDistList, tempResultIndexList, 0, numFound - 1);
+        quickSort(ctx, ctx->tempResultDistList, ctx->tempResultIndexList, 0, numFound - 1);
 
         // Determine the elements in the query result that
         //   lie within the range.
 
-        queryResultSize = 0;
+        ctx->queryResultSize = 0;
 
-        while ((queryResultSize < numFound)
-                && (tempResultDistList[queryResultSize] <= limit)) {
-            queryResultIndexList[queryResultSize]
-                    = tempResultIndexList[queryResultSize];
-            queryResultDistList[queryResultSize]
-                    = tempResultDistList[queryResultSize];
-            queryResultSize++;
+        while ((ctx->queryResultSize < numFound)
+                && (ctx->tempResultDistList[ctx->queryResultSize] <= limit)) {
+            ctx->queryResultIndexList[ctx->queryResultSize]
+                    = ctx->tempResultIndexList[ctx->queryResultSize];
+            ctx->queryResultDistList[ctx->queryResultSize]
+                    = ctx->tempResultDistList[ctx->queryResultSize];
+            ctx->queryResultSize++;
         }
 
         // Determine the number of elements to be retained at this level.
@@ -1364,7 +1891,7 @@ int RCT::doFindMostInRange(float limit, int sampleLevel, float scaleFactor) {
 
     childList = NULL;
 
-    return queryResultSize;
+    return ctx->queryResultSize;
 }
 
 /*!
@@ -1379,7 +1906,7 @@ int RCT::doFindMostInRange(float limit, int sampleLevel, float scaleFactor) {
  *
  * @return The number of elements actually found.
  */
-int RCT::doFindNear(int howMany, int sampleLevel, float scaleFactor) {
+int RCT::doFindNear(RCTQueryContext* ctx, int howMany, int sampleLevel, float scaleFactor) const {
     int i;
     int j;
     int lvl;
@@ -1396,22 +1923,22 @@ int RCT::doFindNear(int howMany, int sampleLevel, float scaleFactor) {
     // Rank cover tree rules.levelQuotaList
     varQuota = (double)howMany;
     for (lvl = sampleLevel; lvl < levels; lvl++) {
-        levelQuotaList[lvl] = (int)((scaleFactor * varQuota * coverageParameter) + 0.999999F);
-        if (levelQuotaList[lvl] < scaleFactor * coverageParameter) {
-            levelQuotaList[lvl] = (int)((scaleFactor * coverageParameter) + 0.999999F);
+        ctx->levelQuotaList[lvl] = (int)((scaleFactor * varQuota * coverageParameter) + 0.999999F);
+        if (ctx->levelQuotaList[lvl] < scaleFactor * coverageParameter) {
+            ctx->levelQuotaList[lvl] = (int)((scaleFactor * coverageParameter) + 0.999999F);
         }
         varQuota /= sampleRate;
     }
-    if (howMany > levelQuotaList[sampleLevel]) {
-        levelQuotaList[sampleLevel] = howMany;
+    if (howMany > ctx->levelQuotaList[sampleLevel]) {
+        ctx->levelQuotaList[sampleLevel] = howMany;
     }
 
     // Load the root as the tentative sole member of the query result list.
-    queryResultSize = 0;
-    queryResultDistList[0] = computeDistFromQuery(0);
-    queryResultIndexList[0] = 0;
+    ctx->queryResultSize = 0;
+    ctx->queryResultDistList[0] = computeDistFromQuery(ctx, 0);
+    ctx->queryResultIndexList[0] = 0;
     numRetained = 1;
-    checks = 0;
+    ctx->checks = 0;
     // From the root, search out other nodes to place in the query result.
     for (lvl = levels - 1; lvl >= sampleLevel; lvl--) {
         // For every node at the active level, load its children
@@ -1419,57 +1946,58 @@ int RCT::doFindNear(int howMany, int sampleLevel, float scaleFactor) {
         numFound = 0;
 
         for (i = 0; i < numRetained; i++) {
-            nodeIndex = queryResultIndexList[i];
+            nodeIndex = ctx->queryResultIndexList[i];
             numChildren = childLSizeLList[lvl + 1][nodeIndex];
             childList = childIndexLLList[lvl + 1][nodeIndex];
 
             for (j = 0; j < numChildren; j++) {
                 child = childList[j];
 
-                if (visitedNodeIndexList[child] != TRUE) {
-                    visitedNodeIndexList[child] = TRUE;
-                    tempResultIndexList[numFound] = child;
-                    tempResultDistList[numFound] = computeDistFromQuery(child);
+                if (ctx->visitedNodeIndexList[child] != TRUE) {
+                    ctx->visitedNodeIndexList[child] = TRUE;
+                    ctx->tempResultIndexList[numFound] = child;
+                    ctx->tempResultDistList[numFound] = computeDistFromQuery(ctx, child);
                     numFound++;
-					checks++;
+					ctx->checks++;
                 }
             }
         }
 
         for (i = 0; i < numFound; i++) {
-            visitedNodeIndexList[tempResultIndexList[i]] = FALSE;
+            ctx->visitedNodeIndexList[ctx->tempResultIndexList[i]] = FALSE;
         }
 
         // Extract the closest nodes from the list of accumulated children,
         //   and keep them as the tentative parents of the query.
 
-        if (numFound > levelQuotaList[lvl]) {
-            numRetained = levelQuotaList[lvl];
+        if (numFound > ctx->levelQuotaList[lvl]) {
+            numRetained = ctx->levelQuotaList[lvl];
         } else {
             numRetained = numFound;
         }
 
         numRetained = partialQuickSort
-                (numRetained,
-                tempResultDistList,
-                tempResultIndexList,
+                (ctx,
+                numRetained,
+                ctx->tempResultDistList,
+                ctx->tempResultIndexList,
                 0,
                 numFound - 1);
 
         for (i = 0; i < numRetained; i++) {
-            queryResultIndexList[i] = tempResultIndexList[i];
-            queryResultDistList[i] = tempResultDistList[i];
+            ctx->queryResultIndexList[i] = ctx->tempResultIndexList[i];
+            ctx->queryResultDistList[i] = ctx->tempResultDistList[i];
         }
     }
 
     // Select the final number of neighbors needed.
     if (numRetained > howMany) {
-        queryResultSize = howMany;
+        ctx->queryResultSize = howMany;
     } else {
-        queryResultSize = numRetained;
+        ctx->queryResultSize = numRetained;
     }
     childList = NULL;
-    return queryResultSize;
+    return ctx->queryResultSize;
 
 }
 
@@ -1484,30 +2012,30 @@ int RCT::doFindNear(int howMany, int sampleLevel, float scaleFactor) {
  *
  * @return The number of elements actually found.
  */
-int RCT::doFindNearest(int howMany, int sampleLevel) {
+int RCT::doFindNearest(RCTQueryContext* ctx, int howMany, int sampleLevel) const {
     int i;
 
     // Handle the singleton case separately.
     if (size == 1) {
-        queryResultSize = 1;
-        queryResultDistList[0] = computeDistFromQuery(0);
-        queryResultIndexList[0] = 0;
+        ctx->queryResultSize = 1;
+        ctx->queryResultDistList[0] = computeDistFromQuery(ctx, 0);
+        ctx->queryResultIndexList[0] = 0;
 
         return 1;
     }
 
-    queryResultSize = levelSetSizeList[sampleLevel];
+    ctx->queryResultSize = levelSetSizeList[sampleLevel];
 
     // Compute distances from the current query to all items.
-    for (i = 0; i < queryResultSize; i++) {
-        queryResultDistList[i] = computeDistFromQuery(i);
-        queryResultIndexList[i] = i;
+    for (i = 0; i < ctx->queryResultSize; i++) {
+        ctx->queryResultDistList[i] = computeDistFromQuery(ctx, i);
+        ctx->queryResultIndexList[i] = i;
     }
 
-		queryResultSize = partialQuickSort(howMany, queryResultDistList, 
-																			 queryResultIndexList, 0, queryResultSize - 1);
+		ctx->queryResultSize = partialQuickSort(ctx, howMany, ctx->queryResultDistList, 
+																			 ctx->queryResultIndexList, 0, ctx->queryResultSize - 1);
 
-    return queryResultSize;
+    return ctx->queryResultSize;
 }
 
 /*!
@@ -1526,7 +2054,7 @@ int RCT::doFindNearest(int howMany, int sampleLevel) {
  *
  * @return Number of items sorted.
  */
-int RCT::partialQuickSort(int howMany, float* distList, int* indexList, int rangeFirst, int rangeLast) {
+int RCT::partialQuickSort(RCTQueryContext* ctx, int howMany, float* distList, int* indexList, int rangeFirst, int rangeLast) const {
     int i;
     int pivotLoc = 0;
     int pivotIndex = 0;
@@ -1557,7 +2085,7 @@ int RCT::partialQuickSort(int howMany, float* distList, int* indexList, int rang
 
     if (rangeLast - rangeFirst < 7) {
         high = rangeFirst + 1;
-        tieBreakIndex = indexList[rand.integer() % (rangeLast - rangeFirst + 1)];
+        tieBreakIndex = indexList[ctx->random() % (rangeLast - rangeFirst + 1)];
 
         // The outer while loop considers each item in turn (starting
         //   with the second item in the range), for insertion into
@@ -1696,8 +2224,8 @@ int RCT::partialQuickSort(int howMany, float* distList, int* indexList, int rang
     // Select a pivot item, and swap it with the item at the beginning
     //   of the range.
 
-    pivotLoc = rangeFirst + (rand.integer() % (rangeLast - rangeFirst + 1));
-    tieBreakIndex = indexList[rand.integer() % (rangeLast - rangeFirst + 1)];
+    pivotLoc = rangeFirst + (ctx->random() % (rangeLast - rangeFirst + 1));
+    tieBreakIndex = indexList[ctx->random() % (rangeLast - rangeFirst + 1)];
 
     pivotDist = distList[pivotLoc];
     distList[pivotLoc] = distList[rangeFirst];
@@ -1848,7 +2376,7 @@ int RCT::partialQuickSort(int howMany, float* distList, int* indexList, int rang
     // Recursively sort the items with smaller distance.
 
     numFound = partialQuickSort
-            (howMany, distList, indexList, rangeFirst, pivotLoc - 1);
+            (ctx, howMany, distList, indexList, rangeFirst, pivotLoc - 1);
 
     // If we found enough items (including the pivot), then we are done.
     // Make sure the pivot is in its correct position, if it is used.
@@ -1904,7 +2432,7 @@ int RCT::partialQuickSort(int howMany, float* distList, int* indexList, int rang
     // Note that the number of sorted items needed has dropped.
 
     return numFound + 1 + partialQuickSort
-            (howMany - numFound - 1,
+            (ctx, howMany - numFound - 1,
             distList, indexList,
             rangeFirst + numFound + 1, rangeLast);
 }
@@ -1922,7 +2450,7 @@ void RCT::printStats() const {
     cout << "  max parents per node   == " << maxParents << endl;
     cout << "  max node degree        == " << maxDegree << endl;
     cout << "  avg node degree        == " << avgDegree << endl;
-    cout << "  distance comparisons   == " << numDistComps << endl;
+    cout << "  distance comparisons   == " << context->numDistComps << endl;
     cout << "  RNG seed               == " << seed << endl;
     cout << endl;
 }
@@ -1936,7 +2464,7 @@ void RCT::printStats() const {
  * @param rangeFirst First element of range.
  * @param rangeLast Last element of range.
  */
-void RCT::quickSort(float* distList, int* indexList, int rangeFirst, int rangeLast) {
+void RCT::quickSort(RCTQueryContext* ctx, float* distList, int* indexList, int rangeFirst, int rangeLast) const {
     int pivotLoc = 0;
     float pivotDist;
     int pivotIndex;
@@ -1957,7 +2485,7 @@ void RCT::quickSort(float* distList, int* indexList, int rangeFirst, int rangeLa
 
     if (rangeLast - rangeFirst < 7) {
         high = rangeFirst + 1;
-        tieBreakDist = distList[rand.integer() % (rangeLast - rangeFirst + 1)];
+        tieBreakDist = distList[ctx->random() % (rangeLast - rangeFirst + 1)];
 
         // The outer while loop considers each item in turn (starting
         //   with the second item in the range), for insertion into
@@ -2049,8 +2577,8 @@ void RCT::quickSort(float* distList, int* indexList, int rangeFirst, int rangeLa
     // Select a pivot item, and swap it with the item at the beginning
     //   of the range.
 
-    pivotLoc = rangeFirst + (rand.integer() % (rangeLast - rangeFirst + 1));
-    tieBreakDist = distList[rand.integer() % (rangeLast - rangeFirst + 1)];
+    pivotLoc = rangeFirst + (ctx->random() % (rangeLast - rangeFirst + 1));
+    tieBreakDist = distList[ctx->random() % (rangeLast - rangeFirst + 1)];
 
     pivotDist = distList[pivotLoc];
     distList[pivotLoc] = distList[rangeFirst];
@@ -2176,8 +2704,8 @@ void RCT::quickSort(float* distList, int* indexList, int rangeFirst, int rangeLa
     // The partition is complete.
     // Recursively sort the remaining items.
 
-    quickSort(distList, indexList, rangeFirst, high - 1);
-    quickSort(distList, indexList, high + 1, rangeLast);
+    quickSort(ctx, distList, indexList, rangeFirst, high - 1);
+    quickSort(ctx, distList, indexList, high + 1, rangeLast);
 }
 
 /*!
@@ -2223,31 +2751,10 @@ void RCT::reserveStorage() {
     // Set up storage for managing distance computations and
     //   query results.
 
-    distFromQueryList = new float [size];
-    storedDistIndexList = new int [size];
-    numStoredDists = 0;
-
-    queryResultDistList = new float [size];
-    queryResultIndexList = new int [size];
-    queryResultSize = 0;
-    queryResultSampleSize = 0;
-
-    visitedNodeIndexList = new int [size];
-    tempResultIndexList = new int [size];
-    tempResultDistList = new float [size];
-
-    for (i = 0; i < size; i++) {
-        distFromQueryList[i] = RCT_UNKNOWN_;
-        storedDistIndexList[i] = RCT_NONE_;
-
-        queryResultDistList[i] = RCT_UNKNOWN_;
-        queryResultIndexList[i] = RCT_NONE_;
-
-        visitedNodeIndexList[i] = FALSE;
-
-        tempResultIndexList[i] = RCT_NONE_;
-        tempResultDistList[i] = RCT_UNKNOWN_;
+    if (context != NULL) {
+        delete context;
     }
+    context = new RCTQueryContext(size, levels, internToExternMapping, seed);
 }
 
 /*!
@@ -2258,14 +2765,39 @@ void RCT::reserveStorage() {
  *
  * @param query The new query item.
  */
-void RCT::setNewQuery(DistData* query) {
+void RCT::setNewQuery(RCTQueryContext* ctx, const float* query) const {
     int i;
-    if (query != this->query) {
-        for (i = 0; i < numStoredDists; i++) {
-            distFromQueryList[storedDistIndexList[i]] = RCT_UNKNOWN_;
+    if (query != ctx->query) {
+        for (i = 0; i < ctx->numStoredDists; i++) {
+            ctx->distFromQueryList[ctx->storedDistIndexList[i]] = RCT_UNKNOWN_;
         }
-        this->query = query;
-        numStoredDists = 0;
+        ctx->query = query;
+        ctx->numStoredDists = 0;
+    }
+}
+
+/*!
+ * Copies the data items (given as a list or as a matrix) into
+ * <code>items</code>, ordered by their internal indices.
+ */
+void RCT::setupItems(DistData** inputData, DistMatrix* inputMatrix) {
+    int i;
+    int dim;
+    float* source = NULL;
+
+    dim = (inputMatrix != NULL) ? inputMatrix->getDim() : inputData[0]->length;
+    if (items != NULL) {
+        delete items;
+    }
+    items = new DistMatrix(size, dim);
+
+    for (i = 0; i < size; i++) {
+        if (inputMatrix != NULL) {
+            source = inputMatrix->getRow(internToExternMapping[i]);
+        } else {
+            source = inputData[internToExternMapping[i]]->value;
+        }
+        memcpy(items->getRow(i), source, sizeof(float) * dim);
     }
 }
 
@@ -2312,15 +2844,12 @@ void RCT::setupLevels(int numItems, int numParents) {
 
     // Determine the level sample sizes.
 
-    levelQuotaList = new int [levels + 1];
     levelSetSizeList = new int [levels + 1];
 
     for (lvl = 0; lvl < levels; lvl++) {
-        levelQuotaList[lvl] = 0;
         levelSetSizeList[lvl] = 0;
     }
 
-    levelQuotaList[levels] = 0;
     levelSetSizeList[levels] = 1;
 
     for (i = 0; i < size; i++) {
@@ -2368,14 +2897,14 @@ double RCT::getFractionOfWellformedEdges() {
         // Check all nodes on level L.
         for (int i = 0; i < levelSetSizeList[L]; ++i) {
             // Select an item on level L as the parent.
-            DistData* parent = data[internToExternMapping[i]];
+            float* parent = items->getRow(i);
 
             // Investigate each child of that parent.
             int numChildren = childLSizeLList[L][i];
             int* children = childIndexLLList[L][i];
             for (int j = 0; j < numChildren; ++j) {
                 // Retrieve the child item.
-                DistData* child = data[internToExternMapping[children[j]]];
+                float* child = items->getRow(children[j]);
 
                 // Is this a copy of the parent?
                 if (parent == child) {
@@ -2385,11 +2914,11 @@ double RCT::getFractionOfWellformedEdges() {
                 }
 
                 // Determine the actual parent-child distance.
-                float actualParentChildDistance = parent->distanceTo(child);
+                float actualParentChildDistance = distMatrixL2(parent, child, items->getDim());
 
                 // Find the nearest-neighbor's distance of the child at the parent level L.
-                setNewQuery(child);
-                doFindNearest(1, L);
+                setNewQuery(context, child);
+                doFindNearest(context, 1, L);
                 float correctParentChildDistance;
                 getResultDists(&correctParentChildDistance, 1);
 
@@ -2406,3 +2935,146 @@ double RCT::getFractionOfWellformedEdges() {
     cout << wellFormedEdges << "/" << edgesChecked << endl;
     return static_cast<double>(wellFormedEdges) / static_cast<double>(edgesChecked);
 }
+
+/*!
+ * Creates a query context for an RCT with <em>size</em> items and
+ * <em>levels</em> sample levels. The mapping from internal to external
+ * indices is not copied.
+ */
+RCTQueryContext::RCTQueryContext(int size, int levels, const int* internToExternMapping, const unsigned long& seed) {
+    int i;
+    (*this).size = size;
+    (*this).internToExternMapping = internToExternMapping;
+    query = NULL;
+    numStoredDists = 0;
+    numDistComps = 0UL;
+    queryResultSize = 0;
+    queryResultSampleSize = 0;
+    checks = 0;
+
+    reseed(seed);
+
+    levelQuotaList = new int [levels + 1];
+    for (i = 0; i <= levels; i++) {
+        levelQuotaList[i] = 0;
+    }
+
+    distFromQueryList = new float [size];
+    storedDistIndexList = new int [size];
+    queryResultDistList = new float [size];
+    queryResultIndexList = new int [size];
+    visitedNodeIndexList = new int [size];
+    tempResultIndexList = new int [size];
+    tempResultDistList = new float [size];
+
+    for (i = 0; i < size; i++) {
+        distFromQueryList[i] = RCT_UNKNOWN_;
+        storedDistIndexList[i] = RCT_NONE_;
+
+        queryResultDistList[i] = RCT_UNKNOWN_;
+        queryResultIndexList[i] = RCT_NONE_;
+
+        visitedNodeIndexList[i] = 0;
+
+        tempResultIndexList[i] = RCT_NONE_;
+        tempResultDistList[i] = RCT_UNKNOWN_;
+    }
+}
+
+/*!
+ * The destructor releases the buffers of the context.
+ */
+RCTQueryContext::~RCTQueryContext() {
+    query = NULL;
+    internToExternMapping = NULL;
+    delete [] levelQuotaList;
+    delete [] distFromQueryList;
+    delete [] storedDistIndexList;
+    delete [] queryResultDistList;
+    delete [] queryResultIndexList;
+    delete [] visitedNodeIndexList;
+    delete [] tempResultIndexList;
+    delete [] tempResultDistList;
+}
+
+/*!
+ * Seeds the generator. The seed is scrambled first (splitmix64), so that
+ * consecutive seeds give unrelated sequences.
+ */
+void RCTQueryContext::reseed(const unsigned long& seed) {
+    unsigned long long z = (unsigned long long)seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+
+    // The generator state must not be zero.
+    rngState = (z != 0ULL) ? z : 0x9E3779B97F4A7C15ULL;
+}
+
+/*!
+ * Generates a pseudo-random integer (xorshift64).
+ */
+unsigned long RCTQueryContext::random() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return (unsigned long)(rngState >> 1);
+}
+
+/*!
+ * Fills the supplied list with the query-to-neighbour distances found in the
+ * most recent query issued through this context.
+ *
+ * @return If successful, the number of items found is returned. Otherwise,
+ *         zero is returned.
+ */
+int RCTQueryContext::getResultDists(float* result, int capacity) const {
+    int i;
+    if ((result == NULL) || (capacity < queryResultSize)) {
+        return 0;
+    }
+    for (i = 0; i < queryResultSize; i++) {
+        result[i] = queryResultDistList[i];
+    }
+    return queryResultSize;
+}
+
+/*!
+ * Retrieve the number of distance comparisons performed during the most
+ * recent query issued through this context.
+ */
+unsigned long RCTQueryContext::getResultDistComps() const {
+    return numDistComps;
+}
+
+/*!
+ * Fills the supplied list with the (external) indices of the items found in
+ * the most recent query issued through this context.
+ *
+ * @return If successful, the number of items found is returned. Otherwise,
+ *         zero is returned.
+ */
+int RCTQueryContext::getResultIndices(int* result, int capacity) const {
+    int i;
+    if ((result == NULL) || (capacity < queryResultSize)) {
+        return 0;
+    }
+    for (i = 0; i < queryResultSize; i++) {
+        result[i] = internToExternMapping[queryResultIndexList[i]];
+    }
+    return queryResultSize;
+}
+
+/*!
+ * Returns the number of items found in the most recent query.
+ */
+int RCTQueryContext::getResultNumFound() const {
+    return queryResultSize;
+}
+
+/*!
+ * Returns the sample size used in the most recent query.
+ */
+int RCTQueryContext::getResultSampleSize() const {
+    return queryResultSampleSize;
+}
@@ -149,6 +149,17 @@
  * float* distances = new float [num];
  * rct->getResultDists(distances, num);
  * \endcode
+ *
+ * These queries keep their state in the RCT. To search the same RCT from
+ * several threads, each thread creates its own query context and passes it
+ * to the query; the results are then read from the context:
+ *
+ * \code
+ * RCTQueryContext* ctx = rct->createQueryContext();
+ * int num = rct->findNear(ctx, query->value, k);
+ * ctx->getResultIndices(indices, num);
+ * delete ctx;
+ * \endcode
  */
 
 #ifndef __RCT_H
@@ -159,8 +170,18 @@
 #include <fstream>
 
 #include <cassert>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "DistData.h"
+#include "DistMatrix.h"
 
 using namespace std;
 
@@ -180,12 +201,193 @@ using namespace std;
 #define RCT_BUFSIZE_ (1024)
 #endif
 
+#ifndef RCT_BUILD_CHUNK_
+#define RCT_BUILD_CHUNK_ (64)
+#endif
+
 #ifndef RCT_VERSION_
 #define RCT_VERSION_ ("1.0")
 #endif
 
+#ifndef RCT_BINARY_MAGIC_
+#define RCT_BINARY_MAGIC_ ("RCTBIN\0\0")
+#endif
+
+#ifndef RCT_BINARY_VERSION_
+#define RCT_BINARY_VERSION_ (1)
+#endif
+
 #include "random.h"
 
+class RCT;
+
+/*!
+ * @class   RCTQueryContext
+ *
+ * The per-query state of an RCT search: the query object, the distance cache,
+ * the scratch lists and the query result. An RCT itself is read-only during
+ * a search, so several threads can search the same RCT at once as long as
+ * each of them uses its own context.
+ *
+ * Contexts are created by <code>RCT::createQueryContext</code> and must be
+ * deleted by the caller. A context is only valid for the RCT that created it,
+ * and only until that RCT is rebuilt or destroyed.
+ */
+//! Query state for searching an RCT.
+
+class RCTQueryContext {
+
+    friend class RCT;
+
+private:
+    //! The current query object.
+    /*!
+     * The coordinates of the currently processed (most recently processed)
+     * query. This marker is also used to identify repeated queries where
+     * computation time can be saved.
+     */
+    const float* query;
+
+    //! Distance cache.
+    /*!
+     * Stores distances from the current query item to some data items in the
+     * RCT that have been performed during the most recent query.
+     */
+    float* distFromQueryList;
+
+    //! Item cache.
+    /*!
+     * Stores indices of items whose distance to the current query object has
+     * been determined during the current query.
+     */
+    int* storedDistIndexList;
+
+    //! Cache length.
+    /*!
+     * Stores the number of items in the current query cache.
+     */
+    int numStoredDists;
+
+    //! Number of distance comparisons performed.
+    /*!
+     * Stores the number of distance comparisons that have been
+     * performed during the most recent RCT operation.
+     */
+    unsigned long numDistComps;
+
+    //! Level quota list.
+    /*!
+     * Stores the maximum number of nodes that are retained in the
+     * cover set during a search. The quotas are calculated for each
+     * search based on the number of neighbours sought.
+     *
+     * @todo If we safe the value of 'howMany' used in the queries,
+     *       we don't have to recompute that every time (minor
+     *       savings).
+     */
+    int* levelQuotaList;
+
+    //! Query result items.
+    /*!
+     * Stores the indices of the items found during the most
+     * recent search operation.
+     */
+    int* queryResultIndexList;
+
+    //! Query result distances.
+    /*!
+     * Stores the query-to-result distances of the items found during
+     * the most recent search operation.
+     */
+    float* queryResultDistList;
+
+    //! Query result size.
+    /*!
+     * Stores the number of results found in the most recent search
+     * operation.
+     */
+    int queryResultSize;
+
+    //! Query result sample size.
+    /*!
+     * The number of sample items within which the most recent similarity
+     * search was performed.
+     */
+    int queryResultSampleSize;
+
+    //! Temporary index list.
+    /*!
+     * This list stores nodes visited during the search operation.
+     */
+    int* visitedNodeIndexList;
+
+    //! Temporary distance list.
+    /*!
+     * This list stores the distance to the query item of nodes already
+     * visited during the current search.
+     */
+    float* tempResultDistList;
+
+    //! Temporary result list.
+    /*!
+     * This list stores result candidates during the search operation.
+     */
+    int* tempResultIndexList;
+
+    //! Number of RCT items.
+    /*!
+     * The size of the RCT the context was created for, i.e. the length of
+     * the distance cache and the scratch lists.
+     */
+    int size;
+
+    //! Mapping between internal and external indices.
+    /*!
+     * Points to the mapping owned by the RCT, which is used to report the
+     * result items by their external indices.
+     */
+    const int* internToExternMapping;
+
+    //! Random number generator state.
+    /*!
+     * The sorting routines break ties pseudo-randomly. Each context keeps
+     * its own generator, so that concurrent searches do not share state.
+     */
+    unsigned long long rngState;
+
+    //! Create a context for an RCT with the given shape.
+    RCTQueryContext(int size, int levels, const int* internToExternMapping, const unsigned long& seed);
+
+    //! Seed the random number generator.
+    void reseed(const unsigned long& seed);
+
+    //! Generate a pseudo-random integer.
+    unsigned long random();
+
+public:
+    //! Number of nodes visited by the most recent approximate search.
+    int checks;
+
+    //! Destroy the context.
+    virtual ~RCTQueryContext();
+
+    //! Retrieve the query-to-neighbor distances.
+    int getResultDists(float* result, int capacity) const;
+
+    //! Retrieve the number of distance comparisons performed.
+    unsigned long getResultDistComps() const;
+
+    //! Retrieve the indices of the query result items.
+    int getResultIndices(int* result, int capacity) const;
+
+    //! Retrieve the number of results found.
+    int getResultNumFound() const;
+
+    //! Retrieve the sample size used in the query.
+    int getResultSampleSize() const;
+
+};
+
 /*!
  * @class   RCT
  * @author  Michael E. Houle, Michael Nett
@@ -248,6 +450,16 @@ private:
      */
     DistData** data;
 
+    //! Data items in internal order.
+    /*!
+     * A contiguous, aligned copy of the data items where row <em>i</em>
+     * holds the item with internal index <em>i</em>. Since the items of
+     * level set L_j are the first <code>levelSetSizeList[j]</code> internal
+     * indices, the items at the upper levels, which are visited by every
+     * search, share a small block of memory.
+     */
+    DistMatrix* items;
+
     //! Pseudo random number generator.
     /*!
      * The pseudo random number generator is seeded with the current the
@@ -370,52 +582,13 @@ private:
      */
     int** childLSizeLList;
 
-    //! The current query object.
-    /*!
-     * The data item that is subject of the currently processed (most recently
-     * processed) query. This marker is also used to identify repeated queries
-     * where computation time can be saved.
-     */
-    DistData* query;
-
-    //! Distance cache.
-    /*!
-     * Stores distances from the current query item to some data items in the
-     * RCT that have been performed during the most recent query.
-     */
-    float* distFromQueryList;
-
-    //! Item cache.
-    /*!
-     * Stores indices of items whose distance to the current query object has
-     * been determined during the current query.
-     */
-    int* storedDistIndexList;
-
-    //! Cache length.
+    //! Default query context.
     /*!
-     * Stores the number of items in the current query cache.
+     * The query state used by the construction and by the query methods that
+     * do not take a context. The results of these queries are obtained via
+     * <code>getResultIndices</code> and friends.
      */
-    int numStoredDists;
-
-    //! Number of distance comparisons performed.
-    /*!
-     * Stores the number of distance comparisons that have been
-     * performed during the most recent RCT operation.
-     */
-    unsigned long numDistComps;
-
-    //! Level quota list.
-    /*!
-     * Stores the maximum number of nodes that are retained in the
-     * cover set during a search. The quotas are calculated for each
-     * search based on the number of neighbours sought.
-     *
-     * @todo If we safe the value of 'howMany' used in the queries,
-     *       we don't have to recompute that every time (minor
-     *       savings).
-     */
-    int* levelQuotaList;
+    RCTQueryContext* context;
 
     //! Coverage parameter.
     /*!
@@ -427,53 +600,6 @@ private:
      */
     float coverageParameter;
 
-    //! Query result items.
-    /*!
-     * Stores the indices of the items found during the most
-     * recent search operation.
-     */
-    int* queryResultIndexList;
-
-    //! Query result distances.
-    /*!
-     * Stores the query-to-result distances of the items found during
-     * the most recent search operation.
-     */
-    float* queryResultDistList;
-
-    //! Query result size.
-    /*!
-     * Stores the number of results found in the most recent search
-     * operation.
-     */
-    int queryResultSize;
-
-    //! Query result sample size.
-    /*!
-     * The number of sample items within which the most recent similarity
-     * search was performed.
-     */
-    int queryResultSampleSize;
-
-    //! Temporary index list.
-    /*!
-     * This list stores nodes visited during the search operation.
-     */
-    int* visitedNodeIndexList;
-
-    //! Temporary distance list.
-    /*!
-     * This list stores the distance to the query item of nodes already
-     * visited during the current search.
-     */
-    float* tempResultDistList;
-
-    //! Temporary result list.
-    /*!
-     * This list stores result candidates during the search operation.
-     */
-    int* tempResultIndexList;
-
     //! Verbosity levle.
     /*!
      * The verbosity level of the RCT determines the amount of feedback
@@ -498,6 +624,24 @@ private:
      */
     unsigned long seed;
 
+    //! Mapped RCT file.
+    /*!
+     * The address of the binary RCT file mapped by <code>loadBinary</code>,
+     * or <em>NULL</em>. If set, the child lists point into the mapping.
+     */
+    void* mapAddr;
+
+    //! Length of the mapped RCT file.
+    size_t mapLength;
+
+    //! Number of build threads.
+    /*!
+     * The number of threads searching for parents during construction.
+     * The items of one level are inserted in parallel, one level after the
+     * other.
+     */
+    int numThreads;
+
 public:
 	int checks;
     //! Retrieve the fraction of edges in the RCT which are well-formed.
@@ -512,24 +656,54 @@ public:
     //! Set the sample rate.
     void setSampleRate(const float& sampleRate);
 
+    //! Set the number of threads used for construction.
+    void setNumThreads(const int& numThreads);
+
     //! Constructs an RCT from an array of data items.
     int build(DistData** inputData, const int& numItems, const float& scaleFactor = 1.0f, const int& numParents = 1);
 
+    //! Constructs an RCT from a matrix of data items.
+    int build(DistMatrix* inputData, const int& numItems, const float& scaleFactor = 1.0f, const int& numParents = 1);
+
     //! Loads a previously-saved RCT from a file.
     int build(const char* fileName, DistData** inputData, const int& numItems);
 
+    //! Loads a previously-saved RCT from a file.
+    int build(const char* fileName, DistMatrix* inputData, const int& numItems);
+
     //! Perform an exact range query.
     int findAllInRange(DistData* query, const float& limit, const int& sampleLevel = 0);
 
+    //! Perform an exact range query.
+    int findAllInRange(const float* query, const float& limit, const int& sampleLevel = 0);
+
     //! Perform an approximate range query.
     int findMostInRange(DistData* query, const float& limit, const float& scaleFactor = 1.0f, const int& sampleLevel = 0);
 
+    //! Perform an approximate range query.
+    int findMostInRange(const float* query, const float& limit, const float& scaleFactor = 1.0f, const int& sampleLevel = 0);
+
     //! Perform an approximate nearest-neighbor query.
     int findNear(DistData* query, const int& howMany = 1, const float& scaleFactor = 1.0f, const int& sampleLevel = 0);
 
+    //! Perform an approximate nearest-neighbor query.
+    int findNear(const float* query, const int& howMany = 1, const float& scaleFactor = 1.0f, const int& sampleLevel = 0);
+
     //! Perform an exact nearest-neighbor query.
     int findNearest(DistData* query, const int& howMany = 1, const int& sampleLevel = 0);
 
+    //! Perform an exact nearest-neighbor query.
+    int findNearest(const float* query, const int& howMany = 1, const int& sampleLevel = 0);
+
+    //! Create a query context for concurrent searches.
+    RCTQueryContext* createQueryContext(const unsigned long& seed = 3141569UL) const;
+
+    //! Perform an approximate nearest-neighbor query using a query context.
+    int findNear(RCTQueryContext* ctx, const float* query, const int& howMany = 1, const float& scaleFactor = 1.0f, const int& sampleLevel = 0) const;
+
+    //! Perform an exact nearest-neighbor query using a query context.
+    int findNearest(RCTQueryContext* ctx, const float* query, const int& howMany = 1, const int& sampleLevel = 0) const;
+
     //! Retrieve the average node degree.
     float getAvgDegree() const;
     
@@ -542,6 +716,9 @@ public:
     //! Retrieve the data items.
     DistData** getData();
 
+    //! Retrieve the data items in internal order.
+    DistMatrix* getItems();
+
     //! Retrieve a mapping from external to internal item indices.
     int getExternToInternMapping(int* result, int capacity) const;
 
@@ -590,9 +767,12 @@ public:
     //! Retrieve the random number generator seed.
     unsigned long getRNGSeed() const;
 
-    //! Save the RCT to a file.
+    //! Save the RCT to a binary file.
     int saveToFile(const char* fileName) const;
 
+    //! Save the RCT to a text file.
+    int saveToTextFile(const char* fileName) const;
+
     //! Set the coverage parameter.
     bool setCoverageParameter(const float& coverageParameter);
 
@@ -604,37 +784,55 @@ protected:
     void resetQuery();
 
     //! Returns the distance of an item from the query.
-    float computeDistFromQuery(int itemIndex);
+    float computeDistFromQuery(RCTQueryContext* ctx, int itemIndex) const;
 
     //! Build an RCT on data items.
     void doBuild();
 
+    //! Find the parents of the items at a level.
+    void insertChildren(RCTQueryContext* ctx, int lvl, atomic<int>* nextChild);
+
+    //! Constructs an RCT from a list or a matrix of data items.
+    int buildFrom(DistData** inputData, DistMatrix* inputMatrix, const int& numItems, const float& scaleFactor, const int& numParents);
+
+    //! Loads a previously-saved RCT for a list or a matrix of data items.
+    int loadFrom(const char* fileName, DistData** inputData, DistMatrix* inputMatrix, const int& numItems);
+
+    //! Reads an RCT from a text file.
+    int loadText(const char* fileName, const int& numItems);
+
+    //! Maps an RCT from a binary file.
+    int loadBinary(const char* fileName, const int& numItems);
+
     //! Performs an exact range query.
-    int doFindAllInRange(float limit, int sampleLevel);
+    int doFindAllInRange(RCTQueryContext* ctx, float limit, int sampleLevel) const;
 
     //! Performs an approximate range query.
-    int doFindMostInRange(float limit, int sampleLevel, float scaleFactor);
+    int doFindMostInRange(RCTQueryContext* ctx, float limit, int sampleLevel, float scaleFactor) const;
 
     //! Performs an approximate nearest-neighbor query.
-    int doFindNear(int howMany, int sampleLevel, float scaleFactor);
+    int doFindNear(RCTQueryContext* ctx, int howMany, int sampleLevel, float scaleFactor) const;
 
     //! Performs an exact nearest-neighbor query.
-    int doFindNearest(int howMany, int sampleLevel);
+    int doFindNearest(RCTQueryContext* ctx, int howMany, int sampleLevel) const;
     
     //! Partial quicksort.
-    int partialQuickSort(int howMany, float* distList, int* indexList, int rangeFirst, int rangeLast);
+    int partialQuickSort(RCTQueryContext* ctx, int howMany, float* distList, int* indexList, int rangeFirst, int rangeLast) const;
 
     //! Print statistics related to the RCT construction.
     void printStats() const;
 
     //! Quicksort.
-    void quickSort(float* distList, int* indexList, int rangeFirst, int rangeLast);
+    void quickSort(RCTQueryContext* ctx, float* distList, int* indexList, int rangeFirst, int rangeLast) const;
 
     //! Reserve storage for the RCT and its data.
     void reserveStorage();
 
     //! Accept a new query item.
-    void setNewQuery(DistData* query);
+    void setNewQuery(RCTQueryContext* ctx, const float* query) const;
+
+    //! Copy the data items into internal order.
+    void setupItems(DistData** inputData, DistMatrix* inputMatrix);
 
     //! Setup random leveling.
     void setupLevels(int numItems, int numParents);
@@ -20,6 +20,7 @@
 #include <time.h>
 #include <sys/time.h>
 #include <stdexcept>
+#include <thread>
 
 using namespace std;
 using std::string;
@@ -35,6 +36,25 @@ float diff_timeval(timeval t1, timeval t2) {
   return (float) (t1.tv_sec - t2.tv_sec) + (t1.tv_usec - t2.tv_usec) * 1e-6;
 }
 
+// Answers queries [first, last) with its own query context, so that several
+// threads can search the same RCT at once.
+void search_range(const RCT* rct, DistMatrix* query, int first, int last,
+		int nn, float scale, int** indices, float** distances, int* nums, long* checks) {
+	RCTQueryContext* ctx = rct->createQueryContext();
+	*checks = 0;
+	for(int i=first;i<last;i++)
+	{
+		indices[i]=new int[nn];
+		distances[i] = new float[nn];
+		int num = rct->findNear(ctx, query->getRow(i), nn,scale);
+		nums[i]=num;
+		ctx->getResultIndices(indices[i], nn);
+		ctx->getResultDists(distances[i], nn);
+		*checks+=ctx->checks;
+	}
+	delete ctx;
+}
+
 int main(int argc, char * argv[]) {
 	const struct option longopts[] ={
 	    {"help",                        no_argument,       0, 'h'},
@@ -47,6 +67,7 @@ int main(int argc, char * argv[]) {
 	    {"m",                           required_argument, 0, 'm'},
 		{"k",                           required_argument, 0, 'k'},
 		{"c",                           required_argument, 0, 'c'},
+		{"num_threads",                 required_argument, 0, 't'},
 	  };
 	  int index;
 	  int iarg = 0;
@@ -56,6 +77,7 @@ int main(int argc, char * argv[]) {
       int dim;
       int nn;
       float scale;
+      int num_threads = 1;
 
 	  char groundtruth_filepath[100] = "";
 	  char query_filepath[100] = "";
@@ -64,7 +86,7 @@ int main(int argc, char * argv[]) {
       char indices_filepath[100] = "";
 
 	  while (iarg != -1) {
-	    iarg = getopt_long(argc, argv, "s:q:g:i:o:n:m:k:c:h",
+	    iarg = getopt_long(argc, argv, "s:q:g:i:o:n:m:k:c:t:h",
 	                       longopts, &index);
 
 	    switch (iarg) {
@@ -113,15 +135,18 @@ int main(int argc, char * argv[]) {
  				scale = atof(optarg);
 	    	  }
 	    	  break;
+		  case 't':
+	    	  if (optarg) {
+	    	  num_threads = atoi(optarg);
+	    	  }
+	    	  break;
 	      }
 	  }
 	  //read data points
-	  DistData** points = new DistData*[n];
-	  ReadPoints(dataset_filepath,points, n, &dim);
+	  DistMatrix* points = MapPoints(dataset_filepath, n, &dim);
 
 	  //read query
-	  DistData** query=new DistData*[nq];
-	  ReadPoints(query_filepath,query, nq, &dim);
+	  DistMatrix* query = MapPoints(query_filepath, nq, &dim);
 
       //read groundtruth
       int** gnd=new int*[nq];
@@ -140,17 +165,24 @@ int main(int argc, char * argv[]) {
       int** indices = new int* [nq];
 	  float** distances = new float* [nq];
 	  int* nums=new int[nq];
-	  int checks = 0;
-	  for(int i=0;i<nq;i++)
+	  long checks = 0;
+	  if (num_threads < 1) num_threads = 1;
+	  if (num_threads > nq) num_threads = nq;
+	  long* thread_checks = new long[num_threads];
+	  vector<thread> threads;
+	  for(int t=0;t<num_threads;t++)
 	  {
-		indices[i]=new int[nn];
-		distances[i] = new float[nn];			
-	    int num = rct->findNear(query[i], nn,scale);
-		nums[i]=num;
- 	    rct->getResultIndices(indices[i], nn);
-		rct->getResultDists(distances[i], nn);
-		checks+=rct->checks;
+		int first = (int) ((long) nq * t / num_threads);
+		int last = (int) ((long) nq * (t + 1) / num_threads);
+		threads.push_back(thread(search_range, rct, query, first, last,
+			nn, scale, indices, distances, nums, &thread_checks[t]));
+	  }
+	  for(int t=0;t<num_threads;t++)
+	  {
+		threads[t].join();
+		checks+=thread_checks[t];
 	  }
+	  delete[] thread_checks;
 	  timeval end;
       gettimeofday(&end, NULL);
       float search_time = diff_timeval(end, start)/nq;
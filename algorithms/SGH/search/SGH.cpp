@@ -30,8 +30,8 @@ using std::ifstream;
 using std::ios;
 using std::endl;
 
-vector<vector <float> > points;
-vector<vector <float > > query;
+FloatMatrix points;
+FloatMatrix queries;
 vector<vector <int> > gnds;
 vector<int> maxChecks;
 
@@ -40,6 +40,8 @@ int nq;
 int dim;
 int k;
 int radis;
+int num_threads = 1;
+int mih_tables;
 int sample_size;
 
 float diff_timeval(timeval t1, timeval t2) {
@@ -58,6 +60,8 @@ int main(int argc, char * argv[]) {
 		{"c",                           required_argument, 0, 'c'},
 		{"t",                           required_argument, 0, 't'},
 		{"r",                           required_argument, 0, 'r'},
+		{"mih",                         required_argument, 0, 'i'},
+		{"num-of-threads",              required_argument, 0, 'T'},
 	    {"dataset_binary_path",         required_argument, 0, 'b'},
 	    {"params_path",                 required_argument, 0, 'p'},
 	  };
@@ -73,7 +77,7 @@ int main(int argc, char * argv[]) {
 	  char checks_path[20] ="";
 
 	  while (iarg != -1) {
-	    iarg = getopt_long(argc, argv, "s:q:g:n:m:k:r:t:c:b:p:h",
+	    iarg = getopt_long(argc, argv, "s:q:g:n:m:k:r:i:T:t:c:b:p:h",
 	                       longopts, &index);
 
 	    switch (iarg) {
@@ -117,6 +121,16 @@ int main(int argc, char * argv[]) {
 	    	  radis = atoi(optarg);
 	    	  }
 	    	  break;
+		  case 'i':
+	    	  if (optarg) {
+	    	  mih_tables = atoi(optarg);
+	    	  }
+	    	  break;
+		  case 'T':
+	    	  if (optarg) {
+	    	  num_threads = atoi(optarg);
+	    	  }
+	    	  break;
 	      case 'b':
 	        if (optarg) {
 	        	strcpy(dataset_binary_path, optarg);
@@ -138,7 +152,7 @@ int main(int argc, char * argv[]) {
 	  ///*
 	  ReadPoints(dataset_filepath, &points, n, &dim);
 
-	  ReadPoints(query_filepath, &query,nq, &dim);
+	  ReadPoints(query_filepath, &queries,nq, &dim);
 
 	  ReadGroundtruth(groundtruth_filepath, &gnds, nq, k);
 
@@ -149,7 +163,7 @@ int main(int argc, char * argv[]) {
 	  SGH_.ReadSGHParams(params_path,sample_size, dim);
 	  int nbits = SGH_.nbits;
 
-	  vector<vector<unsigned> > B1;
+	  BinaryCodes B1;
 	  ReadB1(dataset_binary_path,&B1,n);
 	  //SH_.compressSH(&points,&B1);
 
@@ -158,12 +172,17 @@ int main(int argc, char * argv[]) {
 	  if(radis==-2)
 	  	HCI_.buildIndex();
 
+	  // multi-index hashing for range search; -i -1 scans all codes instead
+	  MultiIndexHashing MIH_;
+	  if(radis>=0 && mih_tables>=0)
+	  	MIH_.buildIndex(B1,mih_tables);
+
 	  timeval start;
       gettimeofday(&start, NULL);
 
 	  // compress query
-	  vector<vector<unsigned> > B2;
-	  SGH_.compressSGH(&query,&B2);
+	  BinaryCodes B2;
+	  SGH_.compressSGH(queries,&B2);
 
 	  timeval end;
 	  gettimeofday(&end, NULL);
@@ -181,18 +200,20 @@ int main(int argc, char * argv[]) {
 		    hammingDist(&B2,&B1,&indices,maxChecks[i]);
 		  else if(radis==-2)
 			HCI_.knnSearch(B2,indices,dists,maxChecks[i],maxChecks[i]);
+		  else if(mih_tables>=0)
+			MIH_.rangeSearch(B2,radis,&indices);
 		  else
 			hammingDist_ByRange(&B2,&B1,&indices,radis);
 
       		// get results after re-ranking
 	  	  vector<vector<int> > results;
-	  	  results = Search(&points, &query, &indices, k);
+	  	  results = Search(points, queries, indices, k, num_threads);
 
       	  gettimeofday(&end, NULL);
       	  double search_time = diff_timeval(end, start)+ transform_time ;
 
 	      float recall = compute_recall(&gnds, &results);
-          float rde =  compute_relative_distance_error(&points, &query, &gnds, &results);
+          float rde =  compute_relative_distance_error(points, queries, &gnds, &results);
 	      //float mrr = compute_mean_reciprocal_rank(&gnds, &results);
 	      //float nc = compute_number_closer(&gnds, &results);
 	      //float map = compute_mean_average_precision(&gnds, &results);
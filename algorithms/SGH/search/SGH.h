@@ -12,6 +12,9 @@
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include "binary_codes.h"
+#include "float_matrix.h"
+#include "batch_encoder.h"
 
 using namespace std;
 using std::string;
@@ -33,6 +36,11 @@ class SGH
 	vector<vector<float> > center;
 	vector<float> bias;
 	vector<vector<float> > Wx;
+
+	// centers and Wx for the batch encoder
+	FloatMatrix centerT;
+	vector<double> centerNorm;
+	FloatMatrix Wxm;
     
 	void ReadSGHParams(string filename, int m_, int dim)
 	{
@@ -73,71 +81,31 @@ class SGH
 			}
 			Wx.push_back(tmp);
 		}
+
+		FloatMatrix C;
+		C.assign(center);
+		matrix_transpose(C, &centerT);
+		squared_norms(C, &centerNorm);
+		Wxm.assign(Wx);
 	}
 	
-	void compactBits(vector<vector<float> > U,vector<vector<unsigned> >* B)
+	void compressSGH(const FloatMatrix& X, BinaryCodes* B)
 	{
-		//U n*nbits
-		int n = U.size();
-		int nbits = U.at(0).size();
-		for(int i=0;i<n;i++)
-		{
-			vector<unsigned> B_;
-			unsigned tmp=0;
-			for(int j=0;j<=nbits;j++)
-			{
-				if(j==nbits)
-				{
-					B_.push_back(tmp);
-					break;
-				}
-				if(j%8==0 && j!=0)
-				{
-					B_.push_back(tmp);
-					tmp=0;
-				}
-				if(U.at(i)[j]>0)
-				{
-					unsigned pos=1<<(j%8);
-					tmp |= pos;
-				}
-			}
-			B->push_back(B_);
-		}
-	}
+		int nq = X.size();
 
-	void compressSGH(vector<vector<float> >* X, vector<vector<unsigned> >* B)
-	{
-		int nq = X->size();
-		int dim = X->at(0).size();
-
-		vector<vector<float> > KX;
-		KX.resize(nq);
-		vector<vector<float> > Y;
+		// KX = exp(-||x-c||^2/(2 delta)) - bias, from one matrix product
+		FloatMatrix KX;
+		squared_distances(X, centerT, centerNorm, &KX);
 		for(int i=0; i<nq; i++)
 		{
-			KX.at(i).resize(m);
+			float* kx = KX.row(i);
 			for(int j=0; j<m; j++)
-			{
-				float tmp = 0.0;
-				for (int t=0;t<dim;t++)
-					tmp += pow(X->at(i)[t] - center[j][t],2);
-				KX[i][j] = exp((-1)*tmp/(2*delta))-bias[j];
-			}
-
-			vector<float> Y_;
-			for(int t=0; t<nbits; t++)
-			{
-				float tmp = 0.0;
-				for(int j=0; j<m; j++)
-				{
-					tmp+= KX[i][j]*Wx[j][t];
-				}
-				Y_.push_back(tmp);
-			}
-			Y.push_back(Y_);
+				kx[j] = exp((-1)*kx[j]/(2*delta))-bias[j];
 		}
-		compactBits(Y,B);
+
+		FloatMatrix Y;
+		matrix_multiply(KX, Wxm, &Y);
+		pack_signs(Y, B);
 	}
 };
 
@@ -0,0 +1,229 @@
+/*
+ * mih_index.h
+ *
+ *  Multi-index hashing over substrings of binary codes, for exact
+ *  Hamming range search (Norouzi et al., Fast Search in Hamming Space
+ *  with Multi-Index Hashing).
+ */
+
+#ifndef MIH_INDEX_H_
+#define MIH_INDEX_H_
+
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "binary_codes.h"
+
+using std::vector;
+
+/**
+ * The codes are cut into m disjoint substrings and each substring is the key
+ * of one hash table. If two codes are within Hamming distance r, one of the
+ * substrings is within r/m by pigeonhole, so a range query only probes the
+ * keys near the query substrings and checks the full distance of the codes
+ * found there. Keys of up to DIRECT_BITS bits index an offset array directly;
+ * longer keys are looked up in a sorted key array. When a radius needs more
+ * probes than there are codes, the codes are scanned instead.
+ */
+class MultiIndexHashing
+{
+	static const int DIRECT_BITS = 20;
+
+	struct Table
+	{
+		int begin;               // first bit of the substring
+		int len;                 // bits of the substring
+		vector<uint64_t> keys;   // sorted distinct keys, when len > DIRECT_BITS
+		vector<int> offsets;     // bucket b holds ids[offsets[b]..offsets[b+1]-1]
+		vector<int> ids;
+	};
+
+	public:
+	MultiIndexHashing() : points_(NULL), m_(0), stamp_(0) {}
+
+	/**
+	 * Builds m tables over the codes, which must outlive the index. With
+	 * m <= 0 the substrings are about log2(n) bits long.
+	 */
+	void buildIndex(const BinaryCodes& codes, int m)
+	{
+		int nbits = codes.nbits();
+		int n = codes.size();
+		points_ = &codes;
+		if (m <= 0)
+		{
+			int s = n > 1 ? (int)(log((double)n) / log(2.0) + 0.5) : 1;
+			m = (nbits + s / 2) / (s > 0 ? s : 1);
+		}
+		m = std::max(m, (nbits + 63) / 64);
+		m = std::min(m, nbits);
+		m_ = std::max(m, 1);
+
+		tables_.assign(m_, Table());
+		vector<uint64_t> key(n);
+		for (int t = 0, begin = 0; t < m_; t++)
+		{
+			Table& table = tables_[t];
+			table.begin = begin;
+			table.len = nbits / m_ + (t < nbits % m_ ? 1 : 0);
+			begin += table.len;
+
+			for (int i = 0; i < n; i++)
+			{
+				key[i] = substring(codes.row(i), table.begin, table.len);
+			}
+			if (table.len <= DIRECT_BITS)
+			{
+				table.offsets.assign(((size_t)1 << table.len) + 1, 0);
+				for (int i = 0; i < n; i++) table.offsets[key[i] + 1]++;
+			}
+			else
+			{
+				table.keys = key;
+				std::sort(table.keys.begin(), table.keys.end());
+				table.keys.erase(std::unique(table.keys.begin(), table.keys.end()), table.keys.end());
+				table.offsets.assign(table.keys.size() + 1, 0);
+				for (int i = 0; i < n; i++) table.offsets[bucket(table, key[i]) + 1]++;
+			}
+			for (size_t b = 1; b < table.offsets.size(); b++)
+			{
+				table.offsets[b] += table.offsets[b - 1];
+			}
+
+			// counting sort, so every bucket lists its ids in ascending order
+			vector<int> fill(table.offsets.begin(), table.offsets.end() - 1);
+			table.ids.resize(n);
+			for (int i = 0; i < n; i++)
+			{
+				size_t b = table.len <= DIRECT_BITS ? (size_t)key[i] : bucket(table, key[i]);
+				table.ids[fill[b]++] = i;
+			}
+		}
+		marks_.assign(n, 0);
+		stamp_ = 0;
+	}
+
+	int tables() const { return m_; }
+
+	/**
+	 * For each query, the ids of all codes within Hamming distance radius,
+	 * in ascending order as hammingDist_ByRange returns them.
+	 */
+	void rangeSearch(const BinaryCodes& queries, int radius, vector<vector<int> >* IDs)
+	{
+		for (int i = 0; i < queries.size(); i++)
+		{
+			vector<int> result;
+			rangeSearch(queries.row(i), radius, &result);
+			IDs->push_back(result);
+		}
+	}
+
+	void rangeSearch(const uint64_t* q, int radius, vector<int>* result)
+	{
+		if (probes(radius) > points_->size())
+		{
+			vector<int> dist(points_->size());
+			hamming_scan(q, *points_, 0, points_->size(), &dist[0]);
+			for (int j = 0; j < points_->size(); j++)
+			{
+				if (dist[j] <= radius) result->push_back(j);
+			}
+			return;
+		}
+		if (++stamp_ == 0)
+		{
+			std::fill(marks_.begin(), marks_.end(), 0);
+			stamp_ = 1;
+		}
+		// the first radius%m+1 tables are probed to radius/m and the others
+		// to radius/m-1, which still finds every code within radius
+		for (int t = 0; t < m_; t++)
+		{
+			int r = tableRadius(t, radius);
+			if (r < 0) continue;
+			const Table& table = tables_[t];
+			probe(table, q, radius, substring(q, table.begin, table.len),
+				0, std::min(r, table.len), result);
+		}
+		std::sort(result->begin(), result->end());
+	}
+
+	private:
+	int tableRadius(int t, int radius) const
+	{
+		return radius / m_ - (t <= radius % m_ ? 0 : 1);
+	}
+
+	/**
+	 * Number of keys probed by a query of the given radius.
+	 */
+	double probes(int radius) const
+	{
+		double total = 0;
+		for (int t = 0; t < m_; t++)
+		{
+			int len = tables_[t].len;
+			double c = 1;
+			for (int k = 0; k <= std::min(tableRadius(t, radius), len); k++)
+			{
+				total += c;
+				c = c * (len - k) / (k + 1);
+			}
+		}
+		return total;
+	}
+
+	static uint64_t substring(const uint64_t* code, int begin, int len)
+	{
+		int w = begin >> 6;
+		int shift = begin & 63;
+		uint64_t key = code[w] >> shift;
+		if (shift + len > 64) key |= code[w + 1] << (64 - shift);
+		return len == 64 ? key : key & ((uint64_t(1) << len) - 1);
+	}
+
+	static size_t bucket(const Table& table, uint64_t key)
+	{
+		return std::lower_bound(table.keys.begin(), table.keys.end(), key) - table.keys.begin();
+	}
+
+	/**
+	 * Visits every key that differs from key in at most left of the bits
+	 * first..len-1, each key once.
+	 */
+	void probe(const Table& table, const uint64_t* q, int radius, uint64_t key,
+		int first, int left, vector<int>* result)
+	{
+		int begin = 0, end = 0;
+		size_t b = table.len <= DIRECT_BITS ? (size_t)key : bucket(table, key);
+		if (table.len <= DIRECT_BITS || (b < table.keys.size() && table.keys[b] == key))
+		{
+			begin = table.offsets[b];
+			end = table.offsets[b + 1];
+		}
+		int words = points_->words();
+		for (int j = begin; j < end; j++)
+		{
+			int id = table.ids[j];
+			if (marks_[id] == stamp_) continue;
+			marks_[id] = stamp_;
+			if (hamming_distance(q, points_->row(id), words) <= radius)
+				result->push_back(id);
+		}
+		if (left == 0) return;
+		for (int bit = first; bit < table.len; bit++)
+		{
+			probe(table, q, radius, key ^ (uint64_t(1) << bit), bit + 1, left - 1, result);
+		}
+	}
+
+	const BinaryCodes* points_;
+	int m_;
+	vector<Table> tables_;
+	vector<unsigned> marks_;     // marks_[id] == stamp_: id seen by this query
+	unsigned stamp_;
+};
+
+#endif /* MIH_INDEX_H_ */
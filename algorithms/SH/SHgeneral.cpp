@@ -9,23 +9,45 @@ using namespace std;
 SHGeneral::SHGeneral()
 {
     cout<<"SHGeneral::SHGeneral"<<endl;
-    memset(dataproduct, 0, sizeof(dataproduct));
-    memset(familyvector, 0, sizeof(familyvector));
+    dataproduct = NULL;
+    familyvector = NULL;
+    datahashresult = NULL;
+    datahashtable = NULL;
+    decision = NULL;
     memset(hashtableindex, 0, sizeof(hashtableindex));
-    memset(datahashtable, 0, sizeof(datahashtable));
-    memset(datahashresult, 0, sizeof(datahashresult));
-    memset(decision, 0, sizeof(decision));
     R[0] = BaseR;
     for(int i = 1; i < Alter; i++)R[i] = c * R[i-1];
     isinit = false;
     decisionavailable = false;
 }
 
+SHGeneral::~SHGeneral()
+{
+    delete[] dataproduct;
+    delete[] familyvector;
+    delete[] datahashresult;
+    delete[] datahashtable;
+    delete[] decision;
+}
+
+//the sizes are only known once the data is read, so the arrays are
+//allocated on the first call to init() or SHIndex::index_load()
+void SHGeneral::allocate()
+{
+    if(dataproduct != NULL)return;
+    dataproduct = new float[(long)datasize*familysize]();
+    familyvector = new float[(long)familysize*(D+1)]();
+    datahashresult = new unsigned int[(long)datasize*L]();
+    datahashtable = new int[(long)L*datasize]();
+    decision = new int[datasize]();
+}
+
 void SHGeneral::init()
 {
 	if(isinit)return;
     isinit = true;
 	cout<<"SHGeneral::init"<<endl;
+	allocate();
 	family_generator();
 	generate_hashtableindex();
 	productcomputer();
@@ -37,8 +59,9 @@ void SHGeneral::family_generator()
     cout<<"SHGeneral::family_generator"<<endl;
     for(int i = 0; i < familysize; i++)
     {
-        MyRandom::rand_multi_gaussian(familyvector[i], D+1);
-        for (int j = 0; j < D; j++) familyvector[i][j] =  familyvector[i][j]/sqrt(D);
+        float* row = familyvector + (long)i*(D+1);
+        MyRandom::rand_multi_gaussian(row, D+1);
+        for (int j = 0; j < D; j++) row[j] =  row[j]/sqrt(D);
         //for test
         //float sum = 0;
         //for (int j = 0; j < D; j++)sum+= familyvector[i][j]*familyvector[i][j];
@@ -80,12 +103,13 @@ void SHGeneral::productcomputer()
     cout<<"SHGeneral::productcomputer"<<endl;
     for(int i = 0; i < datasize; i++)
     {
+        float* product = dataproduct + (long)i*familysize;
         for(int j = 0; j < familysize; j++)
         {
-            dataproduct[i][j] = MyVector::dotproduct(D,data[i],familyvector[j]);
+            product[j] = MyVector::dotproduct(D,data + (long)i*D,familyvector + (long)j*(D+1));
         }
         if(i%20000 == 0) {cout<<"SHGeneral::productcomputer"<<endl<<"current hashing data "<<i<<endl;
-        cout<<dataproduct[i][5]<<endl;}
+        cout<<product[5]<<endl;}
 
     }
     cout<<"SHGeneral::productcomputer--END"<<endl;
@@ -99,7 +123,7 @@ void SHGeneral::tableindex(float product[], int Rrank, unsigned int table[])
     {
         float temp = product[i];
         temp /=  ratio;
-        temp += familyvector[i][D];
+        temp += familyvector[(long)i*(D+1) + D];
         familyint[i] = (int)temp;
     }
     for(int l = 0; l < L; l++)
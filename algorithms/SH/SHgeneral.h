@@ -13,13 +13,13 @@ using namespace std;
 
 class SHGeneral{
     private:
-    
-    float dataproduct[datasize][familysize];
-    float familyvector[familysize][D+1];
+    //row-major heap arrays sized by allocate()
+    float* dataproduct;//[datasize][familysize]
+    float* familyvector;//[familysize][D+1]
     int hashtableindex[L][M];
-    unsigned int datahashresult[datasize][L];
-    int datahashtable[L][datasize];
-    int decision[datasize];
+    unsigned int* datahashresult;//[datasize][L]
+    int* datahashtable;//[L][datasize]
+    int* decision;//[datasize]
     bool decisionavailable;
     bool isinit;
 
@@ -30,10 +30,12 @@ class SHGeneral{
 
     public:
     SHGeneral();
+    ~SHGeneral();
     void init();
     void tableindex(float [], int, unsigned int []);
 
     private:
+    void allocate();
     void family_generator();
     void generate_hashtableindex();
     void familysample(int result[], int size, int needsize);
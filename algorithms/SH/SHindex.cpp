@@ -2,18 +2,39 @@
 #include <iostream>
 #include <cmath>
 #include<algorithm>
+#include<vector>
+#include<string.h>
+#include<thread>
 
 using namespace std;
-
-void SHIndex::linear_search()
-{
+
+SHIndex::SHIndex()
+{
+     bucketoffset = NULL;
+     query = NULL;
+     threadnum = 1;
+     queryresult = NULL;
+     knn = NULL;
+}
+
+SHIndex::~SHIndex()
+{
+     delete[] bucketoffset;
+     delete[] query;
+     delete[] queryresult;
+     delete[] knn;
+     for(size_t t = 0; t < contexts.size(); t++) delete[] contexts[t].queryid;
+}
+
+void SHIndex::linear_search()
+{
      for(int i = 0; i < querysize; i++)
-     {
-         knn[i].init();
-         knn[i].linear_scan(data,query[i]);
-         for(int j = 0; j < K; j++) queryresult[i][j] = knn[i].knnlist[j];
-     }
-}
+     {
+         knn[i].init();
+         knn[i].linear_scan(data,query + (long)i*D);
+         for(int j = 0; j < K; j++) queryresult[i*K + j] = knn[i].knnlist[j];
+     }
+}
 
 void SHIndex::GetDataQueryDistance()
 {
@@ -22,28 +43,18 @@ void SHIndex::GetDataQueryDistance()
 	fp = fopen("dq_distance.dat","wb");
     for(int sub=0;sub<2000/sub_count;sub_count++)
     {
-       float dqdistance[sub_count][querysize];
+       vector<float> dqdistance((long)sub_count*querysize);
        for (int i=0;i< sub_count;i++)
        {
             for(int j=0;j<querysize;j++)
             {
-                dqdistance[i][j]= MyVector::distancel2sq(D,data[i+sub*sub_count], query[j],0);
+                dqdistance[(long)i*querysize + j]= MyVector::distancel2sq(D,data + (long)(i+sub*sub_count)*D, query + (long)j*D,0);
             }
        }
-       fwrite(dqdistance[0], sizeof(double), sub_count*querysize, fp);
+       fwrite(&dqdistance[0], sizeof(double), sub_count*querysize, fp);
     }
 	fclose(fp);
 }
-bool datakeycompare(datakey a,datakey b)
-{
-      if(a.key < b.key) return true;
-      if(a.key == b.key)
-      {
-          if(a.dataid < b.dataid)return true;
-      }
-      return false;
-}
-
 void SHIndex::index_construct(string decision_file)
 {
      int start_=clock();
@@ -53,38 +64,36 @@ void SHIndex::index_construct(string decision_file)
      for(int k = 0; k < datasize; k++)
      {
             if(k%20000 == 0) cout<<"current hashing data "<<k<<endl;
-            shg.tableindex(shg.dataproduct[k],shg.decision[k],shg.datahashresult[k]);
+            shg.tableindex(shg.dataproduct + (long)k*familysize,shg.decision[k],shg.datahashresult + (long)k*L);
      }
+     long keynum = (long)Alter*bucketnum;
+     if(bucketoffset == NULL) bucketoffset = new int[L*(keynum+1)];
+     vector<int> bucketfill(keynum);
      for(int j = 0; j < L; j++)
      {
-             int hashkey;
+             //counting sort by key; the points are placed in id order, so
+             //each bucket is sorted by id
+             int* offset = bucketoffset + j*(keynum+1);
+             int* table = shg.datahashtable + (long)j*datasize;
+             memset(offset, 0, sizeof(int)*(keynum+1));
              for(int i = 0; i < datasize; i++)
              {
-                     temptable[i].dataid = i;
-                     hashkey = shg.datahashresult[i][j]%bucketnum;
-                     temptable[i].key = shg.decision[i]*bucketnum + hashkey;
+                     long key = (long)shg.decision[i]*bucketnum + shg.datahashresult[(long)i*L + j]%bucketnum;
+                     offset[key+1]++;
              }
-             sort(temptable,temptable+datasize,datakeycompare);
-             int q = 0;
-             hashkeyindex[j][0][0] = 0;
-             hashkeylength[j][0][0] = 0;
+             for(long q = 0; q < keynum; q++) offset[q+1] += offset[q];
+             for(long q = 0; q < keynum; q++) bucketfill[q] = offset[q];
              for(int i = 0; i < datasize; i++)
              {
-                     while(q != temptable[i].key)
-                     {
-                         q++;
-                         hashkeyindex[j][q/bucketnum][q%bucketnum] = i;
-                         hashkeylength[j][q/bucketnum][q%bucketnum] = 0;
-                     }
-                     hashkeylength[j][q/bucketnum][q%bucketnum]++;
-                     shg.datahashtable[j][i] = temptable[i].dataid;
+                     long key = (long)shg.decision[i]*bucketnum + shg.datahashresult[(long)i*L + j]%bucketnum;
+                     table[bucketfill[key]++] = i;
              }
              //for test
              int nullsum = 0;
              int normalsum = 0;
-             for(int i = 0; i < Alter * bucketnum; i++)
+             for(long q = 0; q < keynum; q++)
              {
-                 if(hashkeylength[j][i/bucketnum][i%bucketnum] == 0) nullsum++;
+                 if(offset[q+1] == offset[q]) nullsum++;
                  else normalsum++;
              }
              cout<<"table "<<j<<" construted"<<endl;
@@ -99,13 +108,12 @@ void SHIndex::index_construct(string decision_file)
 	 double avechecknum;
 	 for(int i = 0; i < L; i++)
 	 {
-		 for(int k = 0; k < Alter; k++)
+		 int* offset = bucketoffset + i*(keynum+1);
+		 for(long q = 0; q < keynum; q++)
 		 {
-            for(int j = 0; j < bucketnum; j++)
-            {
-                sumchecknum += hashkeylength[i][k][j] * hashkeylength[i][k][j] / (double) datasize;
-                optimized += hashkeylength[i][k][j] / (double) bucketnum;
-            }
+            double length = offset[q+1] - offset[q];
+            sumchecknum += length * length / (double) datasize;
+            optimized += length / (double) bucketnum;
 		 }
 	 }
 	 avechecknum = sumchecknum / L;
@@ -123,12 +131,13 @@ void SHIndex::index_write(string index_file)
 	    cout << "Cannot open file!" << endl;;
 		exit(1);
 	}
-	fwrite(shg.familyvector[0], sizeof(float), familysize*(D+1), fp);
+	int header[7] = {D, datasize, L, M, familysize, Alter, bucketnum};
+	fwrite(header, sizeof(int), 7, fp);
+	fwrite(shg.familyvector, sizeof(float), familysize*(D+1), fp);
 	fwrite(shg.hashtableindex[0], sizeof(int), L*M, fp);
-	fwrite(shg.datahashresult[0], sizeof(unsigned int), datasize*L, fp);
-	fwrite(shg.datahashtable[0], sizeof(int), L*datasize, fp);
-	fwrite(hashkeyindex[0][0], sizeof(int), L * Alter * bucketnum, fp);
-	fwrite(hashkeylength[0][0], sizeof(int), L * Alter * bucketnum, fp);
+	fwrite(shg.datahashresult, sizeof(unsigned int), (long)datasize*L, fp);
+	fwrite(shg.datahashtable, sizeof(int), (long)L*datasize, fp);
+	fwrite(bucketoffset, sizeof(int), L * ((long)Alter * bucketnum + 1), fp);
 	fclose(fp);
 }
 
@@ -141,22 +150,33 @@ void SHIndex::index_load(string index_file)
 	    cout << "Cannot open file!" << endl;;
 		exit(1);
 	}
-	fread(shg.familyvector[0], sizeof(float), familysize*(D+1), fp);
+	int header[7] = {};
+	fread(header, sizeof(int), 7, fp);
+	if(header[0] != D || header[1] != datasize || header[2] != L || header[3] != M
+	    || header[4] != familysize || header[5] != Alter || header[6] != bucketnum)
+	{
+	    cout << "Index does not match the data and parameters!" << endl;
+		exit(1);
+	}
+	shg.allocate();
+	if(bucketoffset == NULL) bucketoffset = new int[L * ((long)Alter * bucketnum + 1)];
+	fread(shg.familyvector, sizeof(float), familysize*(D+1), fp);
 	fread(shg.hashtableindex[0], sizeof(int), L*M, fp);
-	fread(shg.datahashresult[0], sizeof(unsigned int), datasize*L, fp);
-	fread(shg.datahashtable[0], sizeof(int), L*datasize, fp);
-	fread(hashkeyindex[0][0], sizeof(int), L * Alter * bucketnum, fp);
-	fread(hashkeylength[0][0], sizeof(int), L * Alter * bucketnum, fp);
+	fread(shg.datahashresult, sizeof(unsigned int), (long)datasize*L, fp);
+	fread(shg.datahashtable, sizeof(int), (long)L*datasize, fp);
+	fread(bucketoffset, sizeof(int), L * ((long)Alter * bucketnum + 1), fp);
 	fclose(fp);
 }
 
 void SHIndex::query_load(string query_file)
 {
-     io.diskread_float(query_file.c_str(), query[0], querysize*D);
-     for(int i = 0; i < datasize; i++)
-     {
-             queryid[i] = -1;
-     }
+     delete[] query;
+     delete[] queryresult;
+     delete[] knn;
+     query = new float[(long)querysize*D];
+     queryresult = new int[querysize*K];
+     knn = new Knn[querysize];
+     io.diskread_float(query_file.c_str(), query, (long)querysize*D);
      st.sumcheck = 0;
 }
 
@@ -175,29 +195,60 @@ void SHIndex::query_execute(int Lused)//,int MaxChecked
      }
 }
 */
+//the queries are shared out to threadnum threads, each with its own
+//SHQueryContext; the checks of all threads are summed into st.sumcheck
 void SHIndex::query_execute(int Lused,int MaxChecked)
-{
+{
+     int numthreads = threadnum < querysize ? threadnum : querysize;
+     if(numthreads < 1) numthreads = 1;
+     while((int)contexts.size() < numthreads)
+     {
+         SHQueryContext ctx;
+         ctx.queryid = new int[datasize];
+         for(int i = 0; i < datasize; i++) ctx.queryid[i] = -1;
+         ctx.stamp = 0;
+         contexts.push_back(ctx);
+     }
+     for(int t = 0; t < numthreads; t++) contexts[t].sumcheck = 0;
 
-     for(int i = 0; i < querysize; i++)//querysize
-     {
-         {
-             knn[i].init();
-             st.sumcheck=0;
-         }
-         pointquery(query[i],queryresult[i],i,Lused,MaxChecked);
+     atomic<int> nextquery(0);
+     vector<thread> workers;
+     for(int t = 1; t < numthreads; t++)
+         workers.push_back(thread(&SHIndex::query_range, this, &contexts[t], &nextquery, Lused, MaxChecked));
+     query_range(&contexts[0], &nextquery, Lused, MaxChecked);
+     for(size_t t = 0; t < workers.size(); t++) workers[t].join();
+
+     st.sumcheck = 0;
+     for(int t = 0; t < numthreads; t++) st.sumcheck += contexts[t].sumcheck;
+}
+
+//answer queries until none is left
+void SHIndex::query_range(SHQueryContext* ctx, atomic<int>* nextquery, int Lused,int MaxChecked)
+{
+     int i;
+     while((i = nextquery->fetch_add(1)) < querysize)
+     {
+         knn[i].init();
+         pointquery(ctx,query + (long)i*D,queryresult + i*K,i,Lused,MaxChecked);
      }
 }
 
 void SHIndex::result_write(string result_file)
 {
-     io.diskwrite_int(result_file.c_str(), queryresult[0], querysize*K);
+     io.diskwrite_int(result_file.c_str(), queryresult, querysize*K);
 }
 
-void SHIndex::pointquery(float querypoint[], int result[], int id,int Lused,int MaxChecked)
+//a point is checked at most once per query: it is marked with a stamp
+//that is new for each query of the context
+void SHIndex::pointquery(SHQueryContext* ctx, float querypoint[], int result[], int id,int Lused,int MaxChecked)
 {
-     float queryproduct[familysize];
-     for(int i = 0; i < familysize; i++)queryproduct[i] = MyVector::dotproduct(D,querypoint,shg.familyvector[i]);
+     float* queryproduct = ctx->queryproduct;
+     unsigned int (*querytableresult)[L] = ctx->querytableresult;
+     int* queryid = ctx->queryid;
+     int stamp = ++ctx->stamp;
+     for(int i = 0; i < familysize; i++)queryproduct[i] = MyVector::dotproduct(D,querypoint,shg.familyvector + (long)i*(D+1));
      for(int i = 0; i < Alter; i++)shg.tableindex(queryproduct,i,querytableresult[i]);
+	 long keynum = (long)Alter*bucketnum;
 	 int hashkey,bucketindex,bucketlength,tocheck;
 	 int check_count=0;
 	 for(int n = 0; n < Alter && check_count <= MaxChecked; n++)//&& check_count <= MaxChecked
@@ -206,16 +257,18 @@ void SHIndex::pointquery(float querypoint[], int result[], int id,int Lused,int
               for(int i = 0; i < Lused && check_count <= MaxChecked; i++)//&& check_count <= MaxChecked
               {
                     hashkey = querytableresult[n][i]%bucketnum;
-                    bucketindex = hashkeyindex[i][n][hashkey];
-                    bucketlength = hashkeylength[i][n][hashkey];
+                    int* offset = bucketoffset + i*(keynum+1) + (long)n*bucketnum + hashkey;
+                    bucketindex = offset[0];
+                    bucketlength = offset[1] - offset[0];
+                    int* table = shg.datahashtable + (long)i*datasize;
                     for(int j = 0; j < bucketlength && check_count <= MaxChecked; j++)//&& check_count <= MaxChecked
                     {
-                        tocheck = shg.datahashtable[i][bucketindex+j];
-                        if (shg.datahashresult[tocheck][i] != querytableresult[n][i])continue;
-                        if (queryid[tocheck] == id) continue;
-                        queryid[tocheck] = id;
+                        tocheck = table[bucketindex+j];
+                        if (shg.datahashresult[(long)tocheck*L + i] != querytableresult[n][i])continue;
+                        if (queryid[tocheck] == stamp) continue;
+                        queryid[tocheck] = stamp;
                         knn[id].addvertex(data, tocheck, querypoint);
-                        st.sumcheck++;
+                        ctx->sumcheck++;
                         check_count++;
                     }
               }
@@ -7,34 +7,39 @@ class SHIndex;
 #include "myvector.h"
 #include "myrandom.h"
 #include <string>
+#include <vector>
+#include <atomic>
 
 using namespace std;
 
-struct datakey
+//state of one query thread
+struct SHQueryContext
 {
-    int dataid;
-    int key;
+    float queryproduct[familysize];
+    unsigned int querytableresult[Alter][L];
+    int* queryid;//[datasize], stamp of the last query that checked each point
+    int stamp;
+    double sumcheck;
 };
 
 class SHIndex{
     protected:
-    //for index
-    int hashkeyindex[L][Alter][bucketnum];
-    int hashkeylength[L][Alter][bucketnum];
-    datakey temptable[datasize];
+    //for index, in CSR form: with key = Rrank*bucketnum + hashkey, the bucket
+    //of table j is datahashtable[j][bucketoffset[j][key] .. bucketoffset[j][key+1])
+    int* bucketoffset;//[L][Alter*bucketnum+1]
 
     //for query
-    float queryproduct[familysize];
-    unsigned int querytableresult[Alter][L];
-    int queryid[datasize];
-    float query[querysize][D];
+    vector<SHQueryContext> contexts;
+    float* query;//[querysize][D]
     //int queryresult[querysize][K];
     //float dqdistance[datasize][querysize];
-
-    public:
-
-    int queryresult[querysize][K];
-
+
+    public:
+
+    int* queryresult;//[querysize][K]
+
+    SHIndex();
+    ~SHIndex();
     void linear_search();
     void GetDataQueryDistance();
     void index_construct(string decision_file);
@@ -45,11 +50,13 @@ class SHIndex{
     void query_execute(int,int);
     void result_write(string result_file);
     float indextime;
-    Knn knn[querysize];
+    int threadnum;//threads of query_execute
+    Knn* knn;//[querysize]
 
     private:
     //void pointquery(float [], int [], int,int);//,int
-    void pointquery(float [], int [], int,int,int);
+    void pointquery(SHQueryContext*, float [], int [], int,int,int);
+    void query_range(SHQueryContext*, atomic<int>*, int,int);
 };
 
 #endif // SHINDEXING_H_INCLUDED
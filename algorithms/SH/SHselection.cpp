@@ -5,7 +5,8 @@ using namespace std;
 
 void SHSelection::radius_selection(string decision_file)
 {
-	memset(decisionsignal, 0, sizeof(decisionsignal));
+	decisionsignal = new int[datasize]();
+	hashkeylength = new int[(long)L*bucketnum];
 	//while(1)
 	{
 		//if(radius_test(0)==0)
@@ -24,7 +25,7 @@ void SHSelection::radius_selection(string decision_file)
 	{
 		for (int j=0;j<1;j++)
 		{
-		    float a=MyVector::dotproduct(D,data[sample_index[i]],shg.familyvector[j]);
+		    float a=MyVector::dotproduct(D,data + (long)sample_index[i]*D,shg.familyvector + (long)j*(D+1));
             sum += abs(a);
 		}
 
@@ -44,25 +45,30 @@ void SHSelection::radius_selection(string decision_file)
 	cout<<"finished"<<endl;
 	shg.decisionavailable = true;
 	io.diskwrite_int(decision_file, shg.decision, datasize);
+	delete[] decisionsignal;
+	delete[] hashkeylength;
 }
 
 int SHSelection::radius_test(int Rrank)
 {
      cout<<"SHSelection::radius_test "<<Rrank<<endl;
-     memset(hashkeylength, 0, sizeof(hashkeylength));
+     int thresholdpoint = (int)(3*(long)datasize/bucketnum);
+     memset(hashkeylength, 0, sizeof(int)*L*bucketnum);
      for(int k = 0; k < datasize; k++)
      {
             if(k%100000 == 0) cout<<"current hashing data "<<k<<endl;
-            shg.tableindex(shg.dataproduct[k],Rrank,shg.datahashresult[k]);
-            for(int i = 0; i < L; i++)hashkeylength[i][shg.datahashresult[k][i]%bucketnum]++;
+            unsigned int* hashresult = shg.datahashresult + (long)k*L;
+            shg.tableindex(shg.dataproduct + (long)k*familysize,Rrank,hashresult);
+            for(int i = 0; i < L; i++)hashkeylength[(long)i*bucketnum + hashresult[i]%bucketnum]++;
      }
      int sum = 0;
      for(int i = 0; i < datasize; i++)
      {
          int sumcount = 0;
+         unsigned int* hashresult = shg.datahashresult + (long)i*L;
          for(int j = 0; j < L; j++)
          {
-             if(hashkeylength[j][shg.datahashresult[i][j]%bucketnum] >= thresholdpoint)sumcount++;
+             if(hashkeylength[(long)j*bucketnum + hashresult[j]%bucketnum] >= thresholdpoint)sumcount++;
          }
          //cout<<"sumcount: "<<sumcount<<endl;
          //cout<<"thresholdtable: "<<thresholdtable<<endl;
@@ -13,8 +13,8 @@ class SHSelection{
     public:
 
     private:
-    int decisionsignal[datasize];
-    int hashkeylength[L][bucketnum];
+    int* decisionsignal;//[datasize]
+    int* hashkeylength;//[L][bucketnum]
 
     public:
     //SHSelection();
@@ -1,20 +1,21 @@
 #ifndef CONSTANTS_H_INCLUDED
 #define CONSTANTS_H_INCLUDED
 
-const int D = 1369;
-const int K = 20;
+//dataset shape, read from the data and parameter files at runtime
+extern int D;
+extern int datasize;
+extern int querysize;
+extern int bucketnum;
+
+const int K = 20;
 
 const int L = 80;
 const int M = 30;
-const int datasize = 94987;
-const int querysize = 200;
 const int familysize = 100;
 //selective hashing specific
 const int Alter = 20;
 const float BaseR = 100;
 const float c = 3;
-const int bucketnum = 9973;
-const int thresholdpoint = (int)(3*datasize/bucketnum);
 const float thresholdtable = (int)(0.4*L);
 const float ETRatio = 0.3;
 //for basic LSH test
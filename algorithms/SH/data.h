@@ -9,7 +9,7 @@
 #include "SHselection.h"
 #include "statisticsmodule.h"
 
-extern float data[datasize][D];
+extern float* data;//datasize rows of D floats
 extern IO io;
 extern Knn knn;
 extern SHGeneral shg;
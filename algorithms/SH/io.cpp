@@ -2,10 +2,11 @@
 #include <iostream>
 #include <fstream>
 #include <stdlib.h>
+#include <stdio.h>
 
 using namespace std;
 
-void IO::diskread_float(string filename, float array[], int size)
+void IO::diskread_float(string filename, float array[], long size)
 {
     FILE *fp;
 	fp = fopen(filename.c_str(),"rb");
@@ -14,11 +15,11 @@ void IO::diskread_float(string filename, float array[], int size)
 	    cout << "Cannot open file!" << endl;
 		exit(1);
 	}
-	fread(array, sizeof(double), size, fp);
+	fread(array, sizeof(float), size, fp);
 	fclose(fp);
 }
 
-void IO::diskwrite_float(string filename, float array[], int size)
+void IO::diskwrite_float(string filename, float array[], long size)
 {
     FILE *fp;
 	fp = fopen(filename.c_str(),"wb");
@@ -31,7 +32,7 @@ void IO::diskwrite_float(string filename, float array[], int size)
 	fclose(fp);
 }
 
-void IO::diskread_int(string filename, int array[], int size)
+void IO::diskread_int(string filename, int array[], long size)
 {
     FILE *fp;
 	fp = fopen(filename.c_str(),"rb");
@@ -44,7 +45,7 @@ void IO::diskread_int(string filename, int array[], int size)
 	fclose(fp);
 }
 
-void IO::diskwrite_int(string filename, int array[], int size)
+void IO::diskwrite_int(string filename, int array[], long size)
 {
 	FILE *fp;
 	fp = fopen(filename.c_str(),"wb");
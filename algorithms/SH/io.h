@@ -7,10 +7,10 @@ using namespace std;
 
 class IO{
     public:
-    void diskread_float(string filename, float array[], int size);
-    void diskwrite_float(string filename, float array[], int size);
-    void diskread_int(string filename, int array[], int size);
-    void diskwrite_int(string filename, int array[], int size);
+    void diskread_float(string filename, float array[], long size);
+    void diskwrite_float(string filename, float array[], long size);
+    void diskread_int(string filename, int array[], long size);
+    void diskwrite_int(string filename, int array[], long size);
 };
 
 #endif // IO_H_INCLUDED
@@ -19,7 +19,7 @@ void Knn::init(){
 }
 
 //linear scan the dataset and put the result in knnlist (order is not maintained)
-void Knn::linear_scan(float data[][D], float querypoint[])
+void Knn::linear_scan(float data[], float querypoint[])
 {
     init();
 	for (int i = 0; i < datasize; i++)
@@ -49,10 +49,11 @@ vector<int> GenRandom (int size,int N)
 }//*/
 
 // check if data forcheck is a knn of querypoint, if yes maintain a new knn list
-void Knn::addvertex(float data[][D], int forcheck, float querypoint[])
+// data is stored row by row, D floats per point
+void Knn::addvertex(float data[], int forcheck, float querypoint[])
 {
 	float dist;
-	dist = MyVector::distancel2sq(D,data[forcheck], querypoint,0);
+	dist = MyVector::distancel2sq(D,data + (long)forcheck*D, querypoint,0);
 	if (knnlist[K - 1] == -1)
 	{
 		for (int i = 0; i < K; i++)
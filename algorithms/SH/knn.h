@@ -24,8 +24,8 @@ class Knn{
 
     public:
     void init();
-    void linear_scan(float [][D], float []);
-    void addvertex(float [][D], int, float []);
+    void linear_scan(float [], float []);
+    void addvertex(float [], int, float []);
     void KNNsort();
 
     private:
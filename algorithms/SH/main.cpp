@@ -3,7 +3,9 @@
 #include "SHgeneral.h"
 #include "SHselection.h"
 #include "data.h"
+#include "../../tools/dataset/mmap_dataset.h"
 #include <iostream>
+#include <fstream>
 #include <cstring>
 
 #define no_argument 0
@@ -15,11 +17,49 @@ SHSelection shs;
 SHIndex shi;
 StatisticsModule st;
 
-float data[datasize][D];
-IO io;
-Knn knn;
-
-int main()
+//dataset shape, the defaults may be overridden by the parameter file
+int D = 1369;
+int datasize = 0;//0: all points of the data file
+int querysize = 0;//0: all points of the query file
+int bucketnum = 9973;
+
+float* data = NULL;
+IO io;
+Knn knn;
+
+//read "name value" lines of a parameter file, # starts a comment
+void read_parameters(const char* parameter_file, char* data_path, char* query_path,
+                     char* gnd_path, char* index_path, char* result_path)
+{
+    ifstream fin(parameter_file);
+    if(!fin)
+    {
+        cout << "Cannot open file!" << endl;
+        exit(1);
+    }
+    string name, value;
+    while(fin >> name)
+    {
+        if(name[0] == '#' || !(fin >> value))
+        {
+            getline(fin, value);
+            continue;
+        }
+        if(name == "dim") D = atoi(value.c_str());
+        else if(name == "datasize") datasize = atoi(value.c_str());
+        else if(name == "querysize") querysize = atoi(value.c_str());
+        else if(name == "bucketnum") bucketnum = atoi(value.c_str());
+        else if(name == "threads") shi.threadnum = atoi(value.c_str());
+        else if(name == "data") snprintf(data_path, 100, "%s", value.c_str());
+        else if(name == "query") snprintf(query_path, 100, "%s", value.c_str());
+        else if(name == "groundtruth") snprintf(gnd_path, 100, "%s", value.c_str());
+        else if(name == "index") snprintf(index_path, 100, "%s", value.c_str());
+        else if(name == "result") snprintf(result_path, 100, "%s", value.c_str());
+        else cout << "unknown parameter " << name << endl;
+    }
+}
+
+int main(int argc, char* argv[])
 {
     char file_path[20]="Enron";
     char data_name[20]="enron";
@@ -39,7 +79,37 @@ int main()
     char decision_path[50]="result/decision.dat";
     char query_result_path[50]="result/result.dat";
 
-    io.diskread_float(data_path, data[0], datasize*D);
+    //usage: SH [parameter_file]
+    if(argc > 1) read_parameters(argv[1],data_path,query_path,gnd_path,index_path,result_path);
+
+    //the data and query files are raw float rows of D elements, mapped by mmap;
+    //the number of points is taken from the file sizes unless given
+    nns::Dataset data_file, query_file;
+    if(D > 0)
+    {
+        try
+        {
+            data_file.open_raw(data_path, sizeof(float), D);
+            query_file.open_raw(query_path, sizeof(float), D);
+        }
+        catch(const std::runtime_error& e)
+        {
+            cout << e.what() << endl;
+            exit(1);
+        }
+    }
+    long datalength = (long)data_file.size();
+    long querylength = (long)query_file.size();
+    if(datasize == 0) datasize = (int)datalength;
+    if(querysize == 0) querysize = (int)querylength;
+    if(D <= 0 || bucketnum <= 0 || datasize <= 0 || datasize > datalength || querysize <= 0 || querysize > querylength)
+    {
+        cout << "Data and query files do not match the parameters!" << endl;
+        exit(1);
+    }
+    cout<<"D "<<D<<" datasize "<<datasize<<" querysize "<<querysize<<" bucketnum "<<bucketnum<<endl;
+
+    data = (float*)data_file.row<float>(0);
     cout<<"data read from disk"<<endl;
 
 
@@ -6,6 +6,28 @@
 #include <set>
 
 
+StatisticsModule::StatisticsModule()
+{
+    result = NULL;
+    groundtruth = NULL;
+    query = NULL;
+}
+
+StatisticsModule::~StatisticsModule()
+{
+    delete[] result;
+    delete[] groundtruth;
+    delete[] query;
+}
+
+//querysize is only known once the query file is found
+void StatisticsModule::allocate()
+{
+    if(result != NULL)return;
+    result = new int[querysize*K];
+    groundtruth = new int[querysize*K];
+    query = new float[(long)querysize*D];
+}
 
 void StatisticsModule::stat_output(string query_file,string groundtruth_file,string result_file,string output_file,int Lused)
 {
@@ -16,9 +38,10 @@ void StatisticsModule::stat_output(string query_file,string groundtruth_file,str
 	    cout << "Cannot open file!" << endl;;
 		exit(1);
 	}
-    io.diskread_float(query_file.c_str(), query[0], querysize*D);
-    io.diskread_int(groundtruth_file.c_str(), groundtruth[0], querysize*K);
-    io.diskread_int(result_file.c_str(), result[0], querysize*K);
+    allocate();
+    io.diskread_float(query_file.c_str(), query, (long)querysize*D);
+    io.diskread_int(groundtruth_file.c_str(), groundtruth, querysize*K);
+    io.diskread_int(result_file.c_str(), result, querysize*K);
     //cout<<groundtruth[0][1]<<endl;
     //cout<<"load performance";
 	float recall = compute_recall();
@@ -29,7 +52,7 @@ void StatisticsModule::stat_output(string query_file,string groundtruth_file,str
 	//float dcg = compute_discounted_culmulative_gain();
 
     fout.setf(ios::fixed);//" "<<mrr<<" "<<nc <<" "<<map<<" "<<dcg<<
-    fout<<recall << " "<<rde <<" "<<(double)(finish_ - start_)/CLOCKS_PER_SEC/querysize<<" #N_" <<Lused<<" "<<endl;
+    fout<<recall << " "<<rde <<" "<<(finish_ - start_)/querysize<<" #N_" <<Lused<<" "<<endl;
 	fout.close();
 }
 
@@ -43,7 +66,7 @@ float StatisticsModule::compute_recall()
 		int gs_n=0;
 		while(re_n<K && gs_n<K)
 		{
-			if(result[i][re_n] == groundtruth[i][gs_n])
+			if(result[i*K + re_n] == groundtruth[i*K + gs_n])
 			{
 				sum++;
 				re_n++;
@@ -66,7 +89,7 @@ float StatisticsModule::compute_mean_reciprocal_rank()
 		float rate=0.0;
 		for(int j=0;j<K;j++)
 		{
-			if(groundtruth[i][0] == result[i][j])
+			if(groundtruth[i*K] == result[i*K + j])
 			{
 				rate +=1.0/(j+1);
 				break;
@@ -87,7 +110,7 @@ float StatisticsModule::compute_number_closer()
 		{
 			for(int t=0;t<K;t++)
 			{
-				if(groundtruth[i][j] == result[i][t])
+				if(groundtruth[i*K + j] == result[i*K + t])
 				{
 					rate +=(float)(j+1)/(t+1);
 					break;
@@ -107,14 +130,14 @@ float StatisticsModule::compute_relative_distance_error()
 		float sum=0.0;
 		for (int j=0;j<K;j++)//K
 		{
-			float min_distance= MyVector::distancel2sq(D,data[groundtruth[i][j]],query[i],100);
+			float min_distance= MyVector::distancel2sq(D,data + (long)groundtruth[i*K + j]*D,query + (long)i*D,100);
 			//cout<<min_distance<<endl;
 			if(min_distance==0)
 				continue;
-			float test_distance = MyVector::distancel2sq(D,data[result[i][j]],query[i],100);
+			float test_distance = MyVector::distancel2sq(D,data + (long)result[i*K + j]*D,query + (long)i*D,100);
 
             if(test_distance<min_distance)
-                cout<<i<<" "<<j<<" "<<groundtruth[i][j]<<" "<<min_distance<<" "<<test_distance<<endl;
+                cout<<i<<" "<<j<<" "<<groundtruth[i*K + j]<<" "<<min_distance<<" "<<test_distance<<endl;
                // cout<<i<<" "<<j<<endl;
 			float d= (test_distance - min_distance )/min_distance;
 			if(d >4)
@@ -136,11 +159,11 @@ float StatisticsModule::compute_mean_average_precision ()
 		int found = 0;
 		std::set<int> gnd_row;
   		for(int j = 0; j <K; ++j) {
-      		gnd_row.insert(groundtruth[i][j]);
+      		gnd_row.insert(groundtruth[i*K + j]);
   		}
 		for(int j=0;j <K; j++)
 		{
-      		if(gnd_row.find(result[i][j]) != gnd_row.end())
+      		if(gnd_row.find(result[i*K + j]) != gnd_row.end())
 			{
 				found++;
 				rate += 1.0 * found/(j+1);
@@ -159,12 +182,12 @@ float StatisticsModule::compute_discounted_culmulative_gain ()
 		float rate = 0.0;
 		std::set<int> gnd_row;
   		for(size_t j = 0; j <K; ++j) {
-      		gnd_row.insert(groundtruth[i][j]);
+      		gnd_row.insert(groundtruth[i*K + j]);
   		}
 
 		for(size_t j=0;j <K; j++)
 		{
-      		if(gnd_row.find(result[i][j]) != gnd_row.end())
+      		if(gnd_row.find(result[i*K + j]) != gnd_row.end())
 			{
 				rate += 1.0 /log2(j+2);
       		}
@@ -176,13 +199,14 @@ float StatisticsModule::compute_discounted_culmulative_gain ()
 
 void StatisticsModule::gen_query_and_groundtruth(string query_file, string groundtruth_file)
 {
+    allocate();
     sample_query();
     cout<<"query sampled"<<endl;
-    io.diskwrite_float(query_file.c_str(), query[0], querysize*D);
+    io.diskwrite_float(query_file.c_str(), query, (long)querysize*D);
     cout<<"query write to disk"<<endl;
     batch_linear_scan();
     cout<<"linear scan finished"<<endl;
-    io.diskwrite_int(groundtruth_file.c_str(), groundtruth[0], querysize*K);
+    io.diskwrite_int(groundtruth_file.c_str(), groundtruth, querysize*K);
     cout<<"groundtruth write to disk"<<endl;
 }
 
@@ -192,7 +216,7 @@ void StatisticsModule::sample_query()
     for(int i = 0; i < querysize; i++)
     {
         int temp = MyRandom::int_random(datasize);
-        for(int j = 0; j < D; j++) query[i][j] = data[temp][j];
+        for(int j = 0; j < D; j++) query[(long)i*D + j] = data[(long)temp*D + j];
     }
     return;
 }
@@ -202,8 +226,8 @@ void StatisticsModule::batch_linear_scan()
 {
     for(int i = 0; i < querysize; i++)
     {
-        knn.linear_scan(data, query[i]);
-        for(int j = 0; j < K; j++) groundtruth[i][j] = knn.knnlist[j];
+        knn.linear_scan(data, query + (long)i*D);
+        for(int j = 0; j < K; j++) groundtruth[i*K + j] = knn.knnlist[j];
         cout<<i<<"   "<<knn.sqrtbound<<endl;
     }
     return;
@@ -7,11 +7,15 @@ class StatisticsModule;
 #include "data.h"
 #include <string>
 #include <fstream>
+#include <chrono>
 
 class StatisticsModule{
     public:
-    void begin(){start_ = clock();};
-    void finish(){finish_ = clock();};
+    StatisticsModule();
+    ~StatisticsModule();
+    //wall time in seconds, clock() would add up the cpu time of all query threads
+    void begin(){start_ = chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();};
+    void finish(){finish_ = chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();};
     void stat_output(string query_file,string groundtruth_file,string result_file,string output_file,int);
     //void stat_output(string query_file,string groundtruth_file,string output_file,int);
     void gen_query_and_groundtruth(string query_file, string groundtruth_file);
@@ -23,14 +27,16 @@ class StatisticsModule{
 	float compute_discounted_culmulative_gain();
 
     private:
+    void allocate();
     void sample_query();
     void batch_linear_scan();
 
     private:
     double start_,finish_;
-    int result[querysize][K];
-    int groundtruth[querysize][K];
-    float query[querysize][D];
+    //row-major heap arrays sized by allocate()
+    int* result;//[querysize][K]
+    int* groundtruth;//[querysize][K]
+    float* query;//[querysize][D]
 
     public:
     double sumcheck;
@@ -23,6 +23,9 @@
 
 #include <type_traits>
 #include <stdio.h>
+#include <stdlib.h>
+
+#include "../../tools/dataset/mmap_dataset.h"
 
 template<typename T>
 struct Accumulator {
@@ -44,22 +47,25 @@ class Raw_data {
   long long n;
   int d;
 
+  // The data file is mapped, its pages are read as they are needed
   Raw_data(long long n, int d, char * data_file_path) {
     this->n = n;
     this->d = d;
-    this->data = new T[n * d];
-    FILE *fp = fopen(data_file_path, "rb");
-    fread(data, sizeof(T), n * d, fp);
-    fclose(fp);
+    this->file.open_raw(data_file_path, sizeof(T), d);
+    if ((long long) this->file.size() < n) {
+      fprintf(stderr, "%s has only %lld points\n", data_file_path,
+              (long long) this->file.size());
+      exit(1);
+    }
+    this->data = this->file.template row<T>(0);
   }
 
   virtual ~Raw_data() {
-    delete[] this->data;
   }
 
   ResultType cal_squared_dist(long long id, T * q) {
     ResultType res = 0, diff0, diff1, diff2, diff3;
-    T * a = &data[d * id];
+    const T * a = &data[d * id];
     int iter = d / 4, last = d % 4;
     for (int i = 0; i < iter; ++i) {
       diff0 = a[0] - q[0];
@@ -80,7 +86,8 @@ class Raw_data {
   }
 
  private:
-  T * data;
+  nns::Dataset file;
+  const T * data;
 };
 
 #endif /* RAWDATA_H_ */
@@ -20,18 +20,6 @@
 
 #include "SRSCoverTree.h"
 
-struct search_node {
-  float min_dist;
-  CompressedTreeNode * node;
-  int id;
-
-  bool operator>(const search_node &) const;
-  bool operator>=(const search_node &) const;
-  bool operator==(const search_node &) const;
-  bool operator<=(const search_node &) const;
-  bool operator<(const search_node &) const;
-};
-
 bool search_node::operator>(const search_node &n) const {
   return min_dist < n.min_dist;
 }
@@ -81,8 +69,6 @@ SRS_Cover_Tree::SRS_Cover_Tree(long long n, int d, Proj_data * data) {
   this->data = data;
   this->d = d;
   this->root = NULL;
-  this->heap = NULL;
-  this->query = NULL;
   this->pool = NULL;
 
   this->construct();
@@ -260,7 +246,8 @@ void SRS_Cover_Tree::construct() {
   free(point_set.elements);
 }
 
-void SRS_Cover_Tree::init_search(float * query) {
+void SRS_Cover_Tree::init_search(SRS_Query_Context & ctx) {
+  float * query = ctx.query.data();
   search_node node;
   node.min_dist = max(
       0,
@@ -269,13 +256,17 @@ void SRS_Cover_Tree::init_search(float * query) {
   node.node = this->compressed_root;
   node.id = -1;
 
-  this->query = query;
-  this->heap = new std::vector<search_node>;
+  std::vector<search_node> * heap = &ctx.heap;
+  heap->clear();
+  if (heap->capacity() < n / 100) {
+    heap->reserve(n / 100);  // Avoid too many re-size of heap by reserving the heap size to be 1% of the total number of points.
+  }
   heap->push_back(node);
-  heap->reserve(n / 100);  // Avoid too many re-size of heap by reserving the heap size to be 1% of the total number of points.
 }
 
-res_pair SRS_Cover_Tree::increm_knn_search_compressed() {
+res_pair SRS_Cover_Tree::increm_knn_search_compressed(SRS_Query_Context & ctx) {
+  float * query = ctx.query.data();
+  std::vector<search_node> * heap = &ctx.heap;
   while (!heap->empty()) {
     search_node node = heap->front();
     std::pop_heap(heap->begin(), heap->end());
@@ -312,9 +303,8 @@ res_pair SRS_Cover_Tree::increm_knn_search_compressed() {
   return res;
 }
 
-void SRS_Cover_Tree::finish_search() {
-  delete this->heap;
-  delete[] this->query;
+void SRS_Cover_Tree::finish_search(SRS_Query_Context & ctx) {
+  ctx.heap.clear();  // keep the capacity for the next query
 }
 
 void SRS_Cover_Tree::compressed_vectorization(CompressedTreeNode * new_node,
@@ -66,7 +66,25 @@ struct ds_node {
   v_array<float> dist;
 };
 
-struct search_node;
+struct search_node {
+  float min_dist;
+  CompressedTreeNode * node;
+  int id;
+
+  bool operator>(const search_node &) const;
+  bool operator>=(const search_node &) const;
+  bool operator==(const search_node &) const;
+  bool operator<=(const search_node &) const;
+  bool operator<(const search_node &) const;
+};
+
+// State of one incremental knn search. It is owned by the caller and can be
+// reused by later queries (the buffers keep their capacity), so several
+// contexts can search the same tree concurrently.
+struct SRS_Query_Context {
+  std::vector<float> query;  // query in the projected space
+  std::vector<search_node> heap;  // search frontier
+};
 
 class SRS_Cover_Tree {
  private:
@@ -82,10 +100,6 @@ class SRS_Cover_Tree {
   int d;
   Proj_data * data;
 
-  /****query****/
-  float * query;
-  std::vector<search_node> * heap;
-
   TreeNode * batch_insert(int pivot, int max_scale, int top_scale,
                           v_array<ds_node> &point_set,
                           v_array<ds_node> &consumed_set,
@@ -106,9 +120,9 @@ class SRS_Cover_Tree {
   SRS_Cover_Tree(char * file_path);  // restore tree from disk
   virtual ~SRS_Cover_Tree();
   void search_knn(float * query, int k);  // knn search on cover tree
-  void init_search(float * query);
-  res_pair increm_knn_search_compressed();  // incremental knn search on compressed cover tree
-  void finish_search();
+  void init_search(SRS_Query_Context & ctx);  // ctx.query is set by the caller
+  res_pair increm_knn_search_compressed(SRS_Query_Context & ctx);  // incremental knn search on compressed cover tree
+  void finish_search(SRS_Query_Context & ctx);
 
   void write_to_disk_compressed(char * file_path);
   void tree_stat();  // for test only
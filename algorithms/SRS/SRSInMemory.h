@@ -24,11 +24,17 @@
 #include <stdio.h>
 #include <vector>
 #include <algorithm>
+#include <limits>
+#include <thread>
+#include <atomic>
+#include <sys/mman.h>
+#include <sys/time.h>
 
 #include "ParamFile.h"
 #include "RandGen.h"
 #include "SRSCoverTree.h"
 #include "Rawdata.h"
+#include "../../tools/dataset/mmap_dataset.h"
 
 template<typename T>
 struct res_pair_raw {
@@ -161,6 +167,8 @@ template<> struct type_format<long long> {
   }
 };
 
+#define SRS_BUILD_BLOCK 65536  // num of points read and projected at a time
+
 template<typename T>
 class SRS_In_Memory {
  private:
@@ -172,17 +180,28 @@ class SRS_In_Memory {
   char * index_path;
   char * data_type;
   SRS_Cover_Tree * index;
+  SRS_Query_Context ctx;  // used by knn_search without a context
 
   void get_proj(int n, int d, T * source, float * proj, float * dest);
+  void get_proj_block(long long cnt, T * source, float * dest);  // cnt points, d -> m
  public:
   SRS_In_Memory(char * index_path);
   virtual ~SRS_In_Memory();
 
-  void build_index(long long n, int d, int m, char * ds_path);
+  bool build_index(long long n, int d, int m, char * ds_path,
+                   int num_threads);  // false if the index wasn't built
   void restore_index();
   template<typename X>
   void knn_search(T * query, int k, int t, double thres,
                   std::vector<res_pair_raw<X> > & heap);
+  template<typename X>
+  void knn_search(T * query, int k, int t, double thres,
+                  std::vector<res_pair_raw<X> > & heap,
+                  SRS_Query_Context & ctx);  // thread safe with one ctx per thread
+  template<typename X>
+  void knn_search_batch(int nq, T * queries, int k, int t, double thres,
+                        std::vector<std::vector<res_pair_raw<X> > > & res,
+                        int num_threads);  // queries: nq * d, row by row
   int get_m() {
     return this->m;
   }
@@ -216,51 +235,144 @@ SRS_In_Memory<T>::~SRS_In_Memory() {
   delete this->index;
 }
 
+// The dataset is read in blocks of SRS_BUILD_BLOCK points. Binary files
+// (fvecs, ivecs and lshkit, see nns::guess_format) are mapped by mmap;
+// other files are parsed as text, d numbers per point. The projections of
+// a block are computed by num_threads threads. Errors are reported to
+// stderr and false is returned.
 template<typename T>
-void SRS_In_Memory<T>::build_index(long long n, int d, int m, char * ds_path) {
+bool SRS_In_Memory<T>::build_index(long long n, int d, int m, char * ds_path,
+                                   int num_threads) {
   this->n = n;
   this->d = d;
   this->m = m;
-  T * data = new T[d];
+  if (num_threads < 1)
+    num_threads = 1;
+
+  nns::DataFormat format = nns::guess_format(ds_path);
+  nns::Dataset ds;  // binary dataset
+  FILE * dfp = NULL;
+  if (format == nns::FORMAT_TEXT) {
+    dfp = fopen(ds_path, "r");
+    if (dfp == NULL) {
+      fprintf(stderr, "%s: cannot open the file\n", ds_path);
+      return false;
+    }
+  } else {
+    try {
+      ds.open(ds_path, format);
+    } catch (const std::runtime_error & e) {
+      fprintf(stderr, "%s\n", e.what());
+      return false;
+    }
+    if (format == nns::FORMAT_BVECS || ds.elem_size() != sizeof(float)) {
+      fprintf(stderr, "%s: only 4-byte elements are supported\n", ds_path);
+      return false;
+    }
+    // fvecs and lshkit files hold floats, which would be cut to T
+    if (format != nns::FORMAT_IVECS && std::numeric_limits<T>::is_integer) {
+      fprintf(stderr, "%s holds floating point numbers, use -y f\n", ds_path);
+      return false;
+    }
+    if ((int) ds.dim() != d) {
+      fprintf(stderr, "dimensionality of %s is %d, not %d\n", ds_path,
+              (int) ds.dim(), d);
+      return false;
+    }
+    if ((long long) ds.size() < n) {
+      fprintf(stderr, "%s has only %lld points\n", ds_path,
+              (long long) ds.size());
+      this->n = n = ds.size();
+    }
+    ds.advise(MADV_SEQUENTIAL);
+  }
+
   this->proj = new float[m * d];
   for (int i = 0; i < m * d; ++i) {
     proj[i] = gaussian(0, 1);
   }
   float * proj_data = new float[n * m];
-  FILE *dfp = fopen(ds_path, "r");
   char file_path[100];
   strcpy(file_path, index_path);
   strcat(file_path, "raw_data.dat");
   FILE * fp = fopen(file_path, "wb");
+  if (fp == NULL) {
+    fprintf(stderr, "%s: cannot create the file\n", file_path);
+    delete[] proj_data;
+    if (dfp != NULL) {
+      fclose(dfp);
+    }
+    return false;
+  }
 
-  int elem_cnt = 0, temp;
+  T * data = new T[SRS_BUILD_BLOCK * d];
   long long point_cnt = 0;
+  timeval start, now;
+  gettimeofday(&start, NULL);
 
   //read data
-  while (!feof(dfp) && point_cnt < n) {
-    fscanf(dfp, type_format<T>::format(), &data[elem_cnt]);
-    elem_cnt++;
-    if (elem_cnt == d) {  // generate projected points
-      for (int i = 0; i < m; ++i) {
-        float p = 0.0;
-        for (int j = 0; j < d; ++j) {
-          p += data[j] * proj[i * d + j];
-        }
-        proj_data[point_cnt * m + i] = p;
+  while (point_cnt < n) {
+    long long cnt = std::min((long long) SRS_BUILD_BLOCK, n - point_cnt);
+    if (format == nns::FORMAT_TEXT) {
+      long long elem_cnt = 0;
+      while (elem_cnt < cnt * d
+          && fscanf(dfp, type_format<T>::format(), &data[elem_cnt]) == 1) {
+        elem_cnt++;
+      }
+      cnt = elem_cnt / d;
+      if (cnt == 0) {
+        break;
       }
-      fwrite(data, sizeof(T), d, fp);
-      elem_cnt = 0;
-      point_cnt++;
-      if (point_cnt % 50000 == 0) {
-        fprintf(stderr, "\r%lld (%.3f\%)", point_cnt,
-                (double) point_cnt / n * 100);
+    } else {
+      for (long long i = 0; i < cnt; ++i) {
+        if (format == nns::FORMAT_IVECS) {
+          const int * src = ds.row<int>(point_cnt + i);
+          std::copy(src, src + d, &data[i * d]);
+        } else {
+          const float * src = ds.row<float>(point_cnt + i);
+          std::copy(src, src + d, &data[i * d]);
+        }
       }
     }
+
+    // generate projected points
+    long long step = (cnt + num_threads - 1) / num_threads;
+    std::vector<std::thread> workers;
+    for (long long first = 0; first < cnt; first += step) {
+      long long num = std::min(step, cnt - first);
+      workers.push_back(std::thread([=]() {
+        get_proj_block(num, &data[first * d],
+                       &proj_data[(point_cnt + first) * m]);
+      }));
+    }
+    for (size_t i = 0; i < workers.size(); ++i) {
+      workers[i].join();
+    }
+    fwrite(data, sizeof(T), cnt * d, fp);
+    point_cnt += cnt;
+
+    gettimeofday(&now, NULL);
+    double elapsed = (now.tv_sec - start.tv_sec)
+        + (now.tv_usec - start.tv_usec) * 1e-6;
+    fprintf(stderr, "\r%lld (%.3f%%) %.0f points/sec", point_cnt,
+            (double) point_cnt / n * 100, point_cnt / elapsed);
+  }
+  fprintf(stderr, "\n");
+  if (dfp != NULL) {
+    fclose(dfp);
   }
-  fprintf(stderr, "\r%lld (100.000\%)\n", point_cnt);
-  fclose(dfp);
   delete[] data;
   fclose(fp);
+  // a text file may hold fewer points than asked for
+  if (point_cnt == 0) {
+    fprintf(stderr, "%s has no points\n", ds_path);
+    delete[] proj_data;
+    return false;
+  }
+  if (point_cnt < n) {
+    fprintf(stderr, "%s has only %lld points\n", ds_path, point_cnt);
+    this->n = n = point_cnt;
+  }
   //build srs_cover_tree
   Proj_data * data_proj = new Proj_data(n, m, proj_data);
   this->index = new SRS_Cover_Tree(n, m, data_proj);
@@ -273,6 +385,7 @@ void SRS_In_Memory<T>::build_index(long long n, int d, int m, char * ds_path) {
   strcpy(file_path, index_path);
   strcat(file_path, "para.txt");
   writeParamFile(file_path, n, d, m, -1, proj, type_name<T>::name());  // no B in MEM model
+  return true;
 }
 
 template<typename T>
@@ -301,23 +414,63 @@ void SRS_In_Memory<T>::get_proj(int n, int d, T * source, float * proj,
   }
 }
 
+// Same as get_proj for cnt points, but four points are projected together so
+// that each row of proj is loaded once for all of them. The sums are added
+// in the same order as get_proj, so the results are the same.
+template<typename T>
+void SRS_In_Memory<T>::get_proj_block(long long cnt, T * source,
+                                      float * dest) {
+  long long i = 0;
+  for (; i + 4 <= cnt; i += 4) {
+    T * a0 = &source[i * d];
+    T * a1 = a0 + d;
+    T * a2 = a1 + d;
+    T * a3 = a2 + d;
+    for (int r = 0; r < m; ++r) {
+      float * p = &proj[r * d];
+      float s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+      for (int j = 0; j < d; ++j) {
+        s0 += a0[j] * p[j];
+        s1 += a1[j] * p[j];
+        s2 += a2[j] * p[j];
+        s3 += a3[j] * p[j];
+      }
+      dest[i * m + r] = s0;
+      dest[(i + 1) * m + r] = s1;
+      dest[(i + 2) * m + r] = s2;
+      dest[(i + 3) * m + r] = s3;
+    }
+  }
+  for (; i < cnt; ++i) {
+    get_proj(m, d, &source[i * d], proj, &dest[i * m]);
+  }
+}
+
 template<typename T>
 template<typename X>
 void SRS_In_Memory<T>::knn_search(T * query, int k, int t, double thres,
                                   std::vector<res_pair_raw<X> > & heap) {
-  float * q_proj = new float[m];
-  get_proj(m, d, query, this->proj, q_proj);
-  this->index->init_search(q_proj);
+  knn_search(query, k, t, thres, heap, this->ctx);
+}
+
+template<typename T>
+template<typename X>
+void SRS_In_Memory<T>::knn_search(T * query, int k, int t, double thres,
+                                  std::vector<res_pair_raw<X> > & heap,
+                                  SRS_Query_Context & ctx) {
+  ctx.query.resize(m);
+  get_proj(m, d, query, this->proj, ctx.query.data());
+  this->index->init_search(ctx);
   heap.clear();
   heap.reserve(k);
   int count = 0;
   while (count < t) {
-    res_pair cover_tree_res = this->index->increm_knn_search_compressed();
+    res_pair cover_tree_res = this->index->increm_knn_search_compressed(ctx);
     count++;
     if (thres > 0 && heap.size() == k
         && (cover_tree_res.dist * cover_tree_res.dist
             > heap.front().dist * thres)) {  // 1st time test early-stop condition
-      this->index->finish_search();
+      this->index->finish_search(ctx);
       return;
     }
     res_pair_raw<X> res = { cover_tree_res.id, raw_data->cal_squared_dist(
@@ -337,12 +490,42 @@ void SRS_In_Memory<T>::knn_search(T * query, int k, int t, double thres,
     if (thres > 0 && changed && heap.size() == k
         && (cover_tree_res.dist * cover_tree_res.dist
             > heap.front().dist * thres)) {  // 2nd time test early-stop condition
-      this->index->finish_search();
+      this->index->finish_search(ctx);
       return;
     }
   }
-  this->index->finish_search();
+  this->index->finish_search(ctx);
   return;
 }
 
+// The tree and the raw data are only read during search, so the queries are
+// shared among <num_threads> threads, each with its own query context.
+template<typename T>
+template<typename X>
+void SRS_In_Memory<T>::knn_search_batch(
+    int nq, T * queries, int k, int t, double thres,
+    std::vector<std::vector<res_pair_raw<X> > > & res, int num_threads) {
+  res.resize(nq);
+  if (num_threads < 1)
+    num_threads = 1;
+  if (num_threads > nq)
+    num_threads = nq;
+
+  std::atomic<int> next(0);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < num_threads; ++i) {
+    workers.push_back(std::thread([&]() {
+      SRS_Query_Context thread_ctx;
+      int q;
+      while ((q = next++) < nq) {
+        knn_search(queries + (long long) q * d, k, t, thres, res[q],
+                   thread_ctx);
+      }
+    }));
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    workers[i].join();
+  }
+}
+
 #endif /* SRSINMEMORY_H_ */
@@ -45,7 +45,7 @@ double cal_thres(double c, double p_thres, int m);
 template<class T>
 void query_workload(SRS_In_Memory<T> * searcher, int nq, int d, int k, int t, double thres,
                     char *query_file_path, char *ground_truth_file_path,
-                    char *output_file_path);
+                    char *output_file_path, int num_threads);
 
 float diff_timeval(timeval t1, timeval t2) {
   return (float) (t1.tv_sec - t2.tv_sec) + (t1.tv_usec - t2.tv_usec) * 1e-6;
@@ -71,6 +71,7 @@ int main(int argc, char * argv[]) {
     {"dataset-file-path",           required_argument, 0, 's'},
     {"max-number-of-points",        required_argument, 0, 't'},
     {"data-type",                   required_argument, 0, 'y'},
+    {"num-of-threads",              required_argument, 0, 'T'},
     {"query-size",                  required_argument, 0, 'p'},
     {0, 0, 0, 0},
   };
@@ -87,6 +88,7 @@ int main(int argc, char * argv[]) {
   int m = -1;
   int t = -1;
   int nq =-1;
+  int num_threads = 1;
 
   double c = -1.0;
   double p_thres = -1.0;
@@ -105,7 +107,7 @@ int main(int argc, char * argv[]) {
   bool is_integer = true;
 
   while (iarg != -1) {
-    iarg = getopt_long(argc, argv, "b:c:d:e:g:i:k:m:n:o:q:R:r:s:t:y:p:hIQ",
+    iarg = getopt_long(argc, argv, "b:c:d:e:g:i:k:m:n:o:q:R:r:s:t:T:y:p:hIQ",
                        longopts, &index);
 
     switch (iarg) {
@@ -197,6 +199,11 @@ int main(int argc, char * argv[]) {
             t = atoi(optarg);
           }
           break;
+          case 'T':
+          if (optarg) {
+            num_threads = atoi(optarg);
+          }
+          break;
           case 'y':
           if (optarg) {
             if (strcmp(optarg, "f") == 0) {
@@ -220,19 +227,25 @@ int main(int argc, char * argv[]) {
     } else if (b < 0) {
       if (is_integer) {
         SRS_In_Memory<int> * indexer = new SRS_In_Memory<int>(index_dir_path);
-        indexer->build_index(n, d, m, data_file_path);
+        bool built = indexer->build_index(n, d, m, data_file_path, num_threads);
         delete indexer;
+        if (!built) {
+          return 1;
+        }
       } else {
 		timeval start;
     	gettimeofday(&start, NULL);
         SRS_In_Memory<float> * indexer = new SRS_In_Memory<float>(
             index_dir_path);
-        indexer->build_index(n, d, m, data_file_path);
+        bool built = indexer->build_index(n, d, m, data_file_path, num_threads);
 		timeval end;
     	gettimeofday(&end, NULL);
+        delete indexer;
+        if (!built) {
+          return 1;
+        }
     	float index_time = diff_timeval(end, start);
 		cout<<index_time<<" #indextime"<<endl;
-        delete indexer;
       }
     } else {
       printf("use R-tree here\n");
@@ -254,7 +267,7 @@ int main(int argc, char * argv[]) {
           searcher->restore_index();
           query_workload(searcher, nq, d ,k, t, cal_thres(c, p_thres, m),
                          query_file_path, ground_truth_file_path,
-                         output_file_path);
+                         output_file_path, num_threads);
           delete searcher;
         } else if (strcmp(type, "float") == 0) {
           SRS_In_Memory<float> * searcher = new SRS_In_Memory<float>(
@@ -262,7 +275,7 @@ int main(int argc, char * argv[]) {
           searcher->restore_index();
           query_workload(searcher, nq, d, k, t, cal_thres(c, p_thres, m),
                          query_file_path, ground_truth_file_path,
-                         output_file_path);
+                         output_file_path, num_threads);
           delete searcher;
         }
         delete[] type;
@@ -296,8 +309,9 @@ void usage() {
   printf("-q {string}\tquery file\n");
   printf("-Q (function)\tprocess queries\n");
   printf("-r {value}\tthreshold of early termination condition\n");
-  printf("-s {string}\tdataset file\n");
+  printf("-s {string}\tdataset file (text, *.fvecs, *.ivecs or *.lshkit)\n");
   printf("-t {value}\tmaximum number of verify points\n");
+  printf("-T {value}\tnumber of threads, default value: 1\n");
   printf(
       "-y {string}\tdata type (i: integer; f: floating number), default value: integer\n");
   printf("\n");
@@ -307,10 +321,10 @@ void usage() {
   // printf("-I -b -d -i -m -n -s\n");
 
   printf("Index data (using cover-tree)\n");
-  printf("-I -d -i -m -n -s [-y]\n");
+  printf("-I -d -i -m -n -s [-y] [-T]\n");
 
   printf("Process queries\n");
-  printf("-Q -c -g -i -k -q -r -t\n");
+  printf("-Q -c -g -i -k -q -r -t [-T]\n");
 }
 
 bool file_exists(const char *filename) {
@@ -318,7 +332,7 @@ bool file_exists(const char *filename) {
   if (!ifile) {
     fprintf(stderr, "cannot open file %s\n", filename);
   }
-  return ifile;
+  return (bool) ifile;
 }
 
 bool dir_exists(const char *dirname) {
@@ -334,7 +348,7 @@ bool dir_exists(const char *dirname) {
 template<class T>
 void query_workload(SRS_In_Memory<T> * searcher,int qn, int d, int k, int t, double thres,
                     char *query_file_path, char *ground_truth_file_path,
-                    char *output_file_path) {
+                    char *output_file_path, int num_threads) {
   typedef typename Accumulator<T>::Type ResultType;
  
   FILE *qfp = fopen(query_file_path, "r");
@@ -345,23 +359,43 @@ void query_workload(SRS_In_Memory<T> * searcher,int qn, int d, int k, int t, dou
   double overall_time = 0.0;
   double overall_MAP = 0.0;
 
-  T * query = new T[d];
-  int * gt = new int[k];
-  std::vector<res_pair_raw<ResultType> > res;
+  T * queries = new T[(long long) qn * d];
+  int * gts = new int[(long long) qn * k];
   for (int i = 0; i < qn; ++i) {
     for (int j = 0; j < d; ++j) {
-      fscanf(qfp, type_format<T>::format(), &query[j]);
+      fscanf(qfp, type_format<T>::format(), &queries[(long long) i * d + j]);
     }
     for (int j = 0; j < k; ++j) {
-      fscanf(gfp, "%d ", &gt[j]);
+      fscanf(gfp, "%d ", &gts[(long long) i * k + j]);
     }
+  }
 
+  std::vector<std::vector<res_pair_raw<ResultType> > > batch_res;
+  if (num_threads > 1) {  // time of the batch is shared by the queries
     timeval start;
     gettimeofday(&start, NULL);
-    searcher->knn_search(query, k, t + k - 1, thres, res);
+    searcher->knn_search_batch(qn, queries, k, t + k - 1, thres, batch_res,
+                               num_threads);
     timeval end;
     gettimeofday(&end, NULL);
     overall_time += diff_timeval(end, start);
+  }
+
+  std::vector<res_pair_raw<ResultType> > res;
+  for (int i = 0; i < qn; ++i) {
+    T * query = &queries[(long long) i * d];
+    int * gt = &gts[(long long) i * k];
+
+    if (num_threads > 1) {
+      res.swap(batch_res[i]);
+    } else {
+      timeval start;
+      gettimeofday(&start, NULL);
+      searcher->knn_search(query, k, t + k - 1, thres, res);
+      timeval end;
+      gettimeofday(&end, NULL);
+      overall_time += diff_timeval(end, start);
+    }
 
     int ratio = 0;
     std::sort(res.begin(), res.end());
@@ -412,8 +446,8 @@ void query_workload(SRS_In_Memory<T> * searcher,int qn, int d, int k, int t, dou
 	fprintf(ofp,"%.6f %.6f %.6f #N_%d %.6f \n",recall,0.0,searchtime,t,map);
 
   
-  delete[] query;
-  delete[] gt;
+  delete[] queries;
+  delete[] gts;
   fclose(qfp);
   fclose(gfp);
   fclose(ofp);
@@ -0,0 +1,475 @@
+/*
+ *   Dataset files of the NNS benchmark, mapped into memory.
+ *
+ *   A binary file (*.fvecs, *.ivecs, *.bvecs, *.lshkit, or a raw array
+ *   of n * d elements) is mapped by mmap and its header is checked; the
+ *   rows are then read in place, so opening a file takes no time and the
+ *   pages are shared through the page cache by all the processes that use
+ *   the file. Row i starts at row_bytes(i), rows are stride() bytes apart.
+ *   In *vecs files each row is preceded by its dimensionality, so the rows
+ *   are not contiguous. An empty *vecs file has no rows and dimensionality 0.
+ *
+ *   Code that needs aligned, padded or writable rows calls align(), which
+ *   copies the rows to memory that is aligned as asked (optionally backed
+ *   by huge pages). Text files (d numbers per point, any white space) are
+ *   parsed into float rows, as they cannot be mapped.
+ *
+ *   Errors (missing files, bad headers, short files) throw
+ *   std::runtime_error.
+ */
+
+#ifndef NNS_MMAP_DATASET_H_
+#define NNS_MMAP_DATASET_H_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace nns {
+
+enum DataFormat {
+  FORMAT_TEXT,  // text, d numbers per point
+  FORMAT_FVECS,  // *.fvecs: per point, int d and then d floats
+  FORMAT_IVECS,  // *.ivecs: per point, int d and then d ints
+  FORMAT_BVECS,  // *.bvecs: per point, int d and then d bytes
+  FORMAT_LSHKIT,  // *.lshkit: int elem size, int n, int d and then n * d elems
+  FORMAT_RAW  // n * d elems, the shape is given by the caller
+};
+
+// The format of a file, from its extension
+inline DataFormat guess_format(const std::string & path) {
+  size_t dot = path.rfind('.');
+  std::string ext = dot == std::string::npos ? "" : path.substr(dot);
+  if (ext == ".fvecs") {
+    return FORMAT_FVECS;
+  } else if (ext == ".ivecs") {
+    return FORMAT_IVECS;
+  } else if (ext == ".bvecs") {
+    return FORMAT_BVECS;
+  } else if (ext == ".lshkit") {
+    return FORMAT_LSHKIT;
+  }
+  return FORMAT_TEXT;
+}
+
+class Dataset {
+ public:
+  Dataset()
+      : format_(FORMAT_TEXT),
+        map_(NULL),
+        map_length_(0),
+        buf_(NULL),
+        buf_length_(0),
+        buf_mapped_(false),
+        base_(NULL),
+        rows_(0),
+        dim_(0),
+        elem_size_(0),
+        stride_(0) {
+  }
+
+  // dim is needed for text files only
+  explicit Dataset(const std::string & path, int dim = 0)
+      : format_(FORMAT_TEXT),
+        map_(NULL),
+        map_length_(0),
+        buf_(NULL),
+        buf_length_(0),
+        buf_mapped_(false),
+        base_(NULL),
+        rows_(0),
+        dim_(0),
+        elem_size_(0),
+        stride_(0) {
+    open(path, dim);
+  }
+
+  ~Dataset() {
+    close();
+  }
+
+  // Opens a file of the format given by its extension, see guess_format
+  void open(const std::string & path, int dim = 0) {
+    open(path, guess_format(path), dim);
+  }
+
+  void open(const std::string & path, DataFormat format, int dim = 0) {
+    if (format == FORMAT_RAW) {
+      throw std::runtime_error(path + ": the shape of raw files is needed, use open_raw");
+    }
+    close();
+    format_ = format;
+    if (format == FORMAT_TEXT) {
+      parse_text(path, dim);
+      return;
+    }
+    map_file(path);
+
+    if (format == FORMAT_LSHKIT) {
+      uint32_t header[3];  // elem size, n, d
+      if (map_length_ < sizeof header) {
+        fail(path, "the lshkit header is missing");
+      }
+      memcpy(header, map_, sizeof header);
+      if (header[0] != 1 && header[0] != 2 && header[0] != 4 && header[0] != 8) {
+        fail(path, "bad element size in the lshkit header");
+      }
+      if (header[2] == 0) {
+        fail(path, "zero dimensionality in the lshkit header");
+      }
+      elem_size_ = header[0];
+      dim_ = header[2];
+      stride_ = elem_size_ * dim_;
+      if ((map_length_ - sizeof header) / stride_ < header[1]) {
+        fail(path, "the lshkit file is shorter than its header says");
+      }
+      rows_ = header[1];
+      base_ = map_ + sizeof header;
+    } else {
+      elem_size_ = format == FORMAT_BVECS ? 1 : 4;
+      if (map_length_ == 0) {  // an empty file has no rows
+        return;
+      }
+      int32_t d = 0;
+      if (map_length_ >= sizeof d) {
+        memcpy(&d, map_, sizeof d);
+      }
+      if (d <= 0) {
+        fail(path, "bad dimensionality of the first vector");
+      }
+      dim_ = d;
+      stride_ = sizeof d + elem_size_ * dim_;
+      if (map_length_ % stride_ != 0) {
+        fail(path, "the file size is not a multiple of the vector size");
+      }
+      rows_ = map_length_ / stride_;
+      base_ = map_ + sizeof d;
+      // the first and the last vectors are checked here, see check_rows
+      memcpy(&d, base_ + (rows_ - 1) * stride_ - sizeof d, sizeof d);
+      if ((size_t) d != dim_) {
+        fail(path, "the vectors have different dimensionalities");
+      }
+    }
+  }
+
+  /*
+   * Opens a file of rows of dim elems of elem_size bytes. The rows start
+   * after skip bytes and there are gap bytes after each row.
+   */
+  void open_raw(const std::string & path, size_t elem_size, size_t dim,
+                size_t skip = 0, size_t gap = 0) {
+    close();
+    format_ = FORMAT_RAW;
+    if (elem_size == 0 || dim == 0) {
+      fail(path, "the element size and the dimensionality must be positive");
+    }
+    map_file(path);
+    if (map_length_ < skip) {
+      fail(path, "the file is shorter than its header");
+    }
+    elem_size_ = elem_size;
+    dim_ = dim;
+    stride_ = elem_size * dim + gap;
+    // the gap after the last row may be missing
+    rows_ = (map_length_ - skip + gap) / stride_;
+    base_ = map_ + skip;
+  }
+
+  /*
+   * Checks the dimensionality stored before every row of a *vecs file.
+   * This reads the whole file, so it is not done by open.
+   */
+  bool check_rows() const {
+    if (format_ != FORMAT_FVECS && format_ != FORMAT_IVECS
+        && format_ != FORMAT_BVECS) {
+      return true;
+    }
+    for (size_t i = 0; i < rows_; ++i) {
+      int32_t d;
+      memcpy(&d, row_bytes(i) - sizeof d, sizeof d);
+      if ((size_t) d != dim_) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Keeps only the first rows rows
+  void truncate(size_t rows) {
+    if (rows < rows_) {
+      rows_ = rows;
+    }
+  }
+
+  // Passes a hint (e.g. MADV_SEQUENTIAL or MADV_WILLNEED) on the mapped rows
+  void advise(int advice) const {
+    if (map_ != NULL) {
+      madvise(map_, map_length_, advice);
+    }
+  }
+
+  /*
+   * Makes every row start at a multiple of alignment bytes (a power of
+   * two), with the rows padded by zeros to a multiple of alignment bytes.
+   * If the rows aren't laid out so or are mapped from the file, they are
+   * copied, to huge pages if huge_pages is set and the system has them
+   * (to transparent huge pages otherwise). The copy is writable, see
+   * mutable_row. The file is unmapped after the copy.
+   */
+  void align(size_t alignment, bool huge_pages = false) {
+    size_t row_size = elem_size_ * dim_;
+    size_t stride = (row_size + alignment - 1) / alignment * alignment;
+    if (buf_ != NULL && stride == stride_
+        && (uintptr_t) base_ % alignment == 0) {
+      return;
+    }
+    size_t length = stride * (rows_ > 0 ? rows_ : 1);
+    char * buf = NULL;
+    bool buf_mapped = false;
+    if (huge_pages) {
+      buf = alloc_huge(length, &length);
+      buf_mapped = buf != NULL;
+    }
+    if (buf == NULL) {
+      void * addr = NULL;
+      if (posix_memalign(&addr, alignment < sizeof(void *) ? sizeof(void *) : alignment, length) != 0) {
+        throw std::runtime_error("cannot allocate memory for the dataset");
+      }
+      buf = (char *) addr;
+      memset(buf, 0, length);
+    }
+    for (size_t i = 0; i < rows_; ++i) {
+      memcpy(buf + i * stride, row_bytes(i), row_size);
+    }
+
+    release();
+    buf_ = buf;
+    buf_length_ = length;
+    buf_mapped_ = buf_mapped;
+    base_ = buf;
+    stride_ = stride;
+  }
+
+  void close() {
+    release();
+    format_ = FORMAT_TEXT;
+    base_ = NULL;
+    rows_ = 0;
+    dim_ = 0;
+    elem_size_ = 0;
+    stride_ = 0;
+  }
+
+  void swap(Dataset & other) {
+    std::swap(format_, other.format_);
+    std::swap(map_, other.map_);
+    std::swap(map_length_, other.map_length_);
+    std::swap(buf_, other.buf_);
+    std::swap(buf_length_, other.buf_length_);
+    std::swap(buf_mapped_, other.buf_mapped_);
+    std::swap(base_, other.base_);
+    std::swap(rows_, other.rows_);
+    std::swap(dim_, other.dim_);
+    std::swap(elem_size_, other.elem_size_);
+    std::swap(stride_, other.stride_);
+  }
+
+  DataFormat format() const {
+    return format_;
+  }
+
+  size_t size() const {
+    return rows_;
+  }
+
+  size_t dim() const {
+    return dim_;
+  }
+
+  // The size of an element in bytes (4 for text files)
+  size_t elem_size() const {
+    return elem_size_;
+  }
+
+  // The distance between the starts of two rows in bytes
+  size_t stride() const {
+    return stride_;
+  }
+
+  // Whether the rows are read from the mapped file rather than a copy
+  bool mapped() const {
+    return buf_ == NULL && base_ != NULL;
+  }
+
+  const char * row_bytes(size_t i) const {
+    return base_ + i * stride_;
+  }
+
+  template<typename T>
+  const T * row(size_t i) const {
+    return (const T *) row_bytes(i);
+  }
+
+  // Rows of a copy (see align) may be changed
+  template<typename T>
+  T * mutable_row(size_t i) {
+    if (buf_ == NULL) {
+      throw std::runtime_error("the rows of a mapped dataset are read-only");
+    }
+    return (T *) (base_ + i * stride_);
+  }
+
+ private:
+  Dataset(const Dataset &);
+  Dataset & operator=(const Dataset &);
+
+  // Closes the dataset, so that a failed open leaves nothing behind
+  void fail(const std::string & path, const char * what) {
+    close();
+    throw std::runtime_error(path + ": " + what);
+  }
+
+  void map_file(const std::string & path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      fail(path, strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      ::close(fd);
+      fail(path, strerror(errno));
+    }
+    map_length_ = st.st_size;
+    if (map_length_ == 0) {  // nothing to map, see open
+      ::close(fd);
+      return;
+    }
+    void * addr = mmap(NULL, map_length_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+      map_length_ = 0;
+      fail(path, strerror(errno));
+    }
+    map_ = (char *) addr;
+  }
+
+  // Returns NULL if no memory could be mapped
+  static char * alloc_huge(size_t length, size_t * mapped_length) {
+    const size_t huge_page = 2 << 20;
+    length = (length + huge_page - 1) / huge_page * huge_page;
+    void * addr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    addr = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (addr == MAP_FAILED) {
+      addr = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (addr == MAP_FAILED) {
+        return NULL;
+      }
+#ifdef MADV_HUGEPAGE
+      madvise(addr, length, MADV_HUGEPAGE);
+#endif
+    }
+    *mapped_length = length;
+    return (char *) addr;
+  }
+
+  void parse_text(const std::string & path, int dim) {
+    FILE * fp = fopen(path.c_str(), "r");
+    if (fp == NULL) {
+      fail(path, strerror(errno));
+    }
+    std::vector<char> text;
+    char chunk[1 << 16];
+    size_t cnt;
+    while ((cnt = fread(chunk, 1, sizeof chunk, fp)) > 0) {
+      text.insert(text.end(), chunk, chunk + cnt);
+    }
+    fclose(fp);
+    text.push_back('\0');
+
+    std::vector<float> elems;
+    const char * p = &text[0];
+    const char * first_eol = strchr(p, '\n');
+    size_t first_line = 0;  // num of numbers on the first line
+    for (;;) {
+      char * end;
+      float x = strtof(p, &end);
+      if (end == p) {
+        break;
+      }
+      if (first_eol == NULL || end <= first_eol) {
+        ++first_line;
+      }
+      elems.push_back(x);
+      p = end;
+    }
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+      ++p;
+    }
+    if (*p != '\0') {
+      fail(path, "the text file has a token that is not a number");
+    }
+
+    dim_ = dim > 0 ? dim : first_line;
+    if (dim_ == 0 || elems.size() % dim_ != 0) {
+      fail(path, "the number of values is not a multiple of the dimensionality");
+    }
+    elem_size_ = sizeof(float);
+    rows_ = elems.size() / dim_;
+    stride_ = elem_size_ * dim_;
+    buf_length_ = elems.size() * sizeof(float);
+    buf_ = (char *) malloc(buf_length_);
+    if (buf_ == NULL) {
+      throw std::runtime_error("cannot allocate memory for the dataset");
+    }
+    memcpy(buf_, &elems[0], buf_length_);
+    base_ = buf_;
+  }
+
+  void release() {
+    if (map_ != NULL) {
+      munmap(map_, map_length_);
+    }
+    if (buf_ != NULL) {
+      if (buf_mapped_) {
+        munmap(buf_, buf_length_);
+      } else {
+        free(buf_);
+      }
+    }
+    map_ = NULL;
+    map_length_ = 0;
+    buf_ = NULL;
+    buf_length_ = 0;
+    buf_mapped_ = false;
+  }
+
+  DataFormat format_;
+  char * map_;  // the mapped file
+  size_t map_length_;
+  char * buf_;  // a copy of the rows, see align and parse_text
+  size_t buf_length_;
+  bool buf_mapped_;  // buf_ is mapped memory (huge pages) or malloc'ed
+  const char * base_;  // the first row
+  size_t rows_;
+  size_t dim_;
+  size_t elem_size_;
+  size_t stride_;  // in bytes
+};
+
+}  // namespace nns
+
+#endif /* NNS_MMAP_DATASET_H_ */
@@ -0,0 +1,332 @@
+/*
+ *   Exact k-NN ground truth for the NNS benchmark.
+ *
+ *   The base set is read in blocks of GT_BLOCK points. For a block, the
+ *   squared Euclidean distances to all queries are computed as
+ *   ||q||^2 + ||x||^2 - 2 q.x, where the dot products are done for tiles
+ *   of GT_QUERY_TILE queries and GT_POINT_TILE points at a time (in double
+ *   precision). The queries are split among the threads, each thread keeps
+ *   the k nearest points of its queries. Points at the same distance are
+ *   ordered by id.
+ *
+ *   Input files: *.fvecs, *.lshkit, or text (d numbers per point), read
+ *   by nns::Dataset; binary files are mapped, not copied.
+ *   Output files: *.lshkit (int 4, int nq, int k, then nq * k ids),
+ *   *.ivecs (per query int k, then k ids), or text (a line of k ids per
+ *   query). Ids start from 0.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "mmap_dataset.h"
+
+#define no_argument 0
+#define required_argument 1
+#define optional_argument 2
+
+#define GT_BLOCK 4096      // num of base points read at a time
+#define GT_QUERY_TILE 4    // num of queries in a tile of dot products
+#define GT_POINT_TILE 8    // num of points in a tile of dot products
+
+typedef std::pair<double, int> neighbor_t;  // squared distance, id
+
+void usage();
+bool open_vectors(const char * path, int d, nns::Dataset & ds);
+void gen_gt(const char * data_file_name, const char * query_file,
+            const std::vector<std::string> & gt_files, int d, long long n,
+            int k, int num_threads);
+
+int main(int argc, char * argv[]) {
+  const struct option longopts[] ={
+    {"dimension",                   required_argument, 0, 'd'},
+    {"dataset-file-path",           required_argument, 0, 's'},
+    {"cardinality",                 required_argument, 0, 'n'},
+    {"k",                           required_argument, 0, 'k'},
+    {"ground-truth-file-path",      required_argument, 0, 'g'},
+    {"query-file-path",             required_argument, 0, 'q'},
+    {"threads",                     required_argument, 0, 'T'},
+    {0, 0, 0, 0},
+  };
+
+  int index;
+  int iarg = 0;
+  opterr = 1;    //getopt error message (off: 0)
+
+  int d = -1;
+  long long n = -1;
+  int k = -1;
+  int num_threads = std::thread::hardware_concurrency();
+
+  std::vector<std::string> gt_files;
+  const char * query_file_path = NULL;
+  const char * data_file_path = NULL;
+
+  while (iarg != -1) {
+    iarg = getopt_long(argc, argv, "d:g:k:n:q:s:T:h", longopts, &index);
+
+    switch (iarg) {
+      case 'd':
+        d = atoi(optarg);
+        break;
+      case 'g':
+        gt_files.push_back(optarg);
+        break;
+      case 'h':
+        usage();
+        return 0;
+      case 'k':
+        k = atoi(optarg);
+        break;
+      case 'n':
+        n = atoll(optarg);
+        break;
+      case 'q':
+        query_file_path = optarg;
+        break;
+      case 's':
+        data_file_path = optarg;
+        break;
+      case 'T':
+        num_threads = atoi(optarg);
+        break;
+    }
+  }
+
+  if (k <= 0 || data_file_path == NULL || query_file_path == NULL
+      || gt_files.empty()) {
+    usage();
+    return 1;
+  }
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
+  gen_gt(data_file_path, query_file_path, gt_files, d, n, k, num_threads);
+
+  return 0;
+}
+
+void usage() {
+  printf("gen_groundtruth\n");
+  printf("Options\n");
+  printf("-d {value}\tdimensionality of data (required for text files)\n");
+  printf("-g {string}\tground truth file (*.lshkit, *.ivecs or text), can be repeated\n");
+  printf("-k {value}\tnumber of neighbors wanted\n");
+  printf("-n {value}\tuse only the first n points of the dataset\n");
+  printf("-q {string}\tquery file (*.fvecs, *.lshkit or text)\n");
+  printf("-s {string}\tdataset file (*.fvecs, *.lshkit or text)\n");
+  printf("-T {value}\tnumber of threads, default: number of cores\n");
+  printf("\n");
+
+  printf("Usage:\n");
+
+  printf("Generate ground truth files\n");
+  printf("-g -k -q -s [-d -n -T]\n");
+}
+
+/*
+ * dots[i * GT_POINT_TILE + j] = q_i . x_j for GT_QUERY_TILE queries (rows of
+ * q, d numbers each) and GT_POINT_TILE points (columns of xt, which holds
+ * a block transposed: coordinate t of point j is xt[t * stride + j]).
+ */
+void dot_tile(const double * q, const double * xt, long long stride, int d,
+              double * dots) {
+  double acc[GT_QUERY_TILE][GT_POINT_TILE] = {};
+  for (int t = 0; t < d; ++t) {
+    const double * x = &xt[t * stride];
+    for (int i = 0; i < GT_QUERY_TILE; ++i) {
+      const double qt = q[i * d + t];
+      for (int j = 0; j < GT_POINT_TILE; ++j) {
+        acc[i][j] += qt * x[j];
+      }
+    }
+  }
+  for (int i = 0; i < GT_QUERY_TILE; ++i) {
+    for (int j = 0; j < GT_POINT_TILE; ++j) {
+      dots[i * GT_POINT_TILE + j] = acc[i][j];
+    }
+  }
+}
+
+// Updates the k-NN heaps of queries [q_begin, q_end) with a block of points
+void search_block(const double * queries, const double * q_norms,
+                  const double * xt, const double * x_norms, long long stride,
+                  long long cnt, long long first_id, int d, int k,
+                  int q_begin, int q_end, std::vector<neighbor_t> * heaps) {
+  double dots[GT_QUERY_TILE * GT_POINT_TILE];
+  for (long long j0 = 0; j0 < cnt; j0 += GT_POINT_TILE) {
+    for (int i0 = q_begin; i0 < q_end; i0 += GT_QUERY_TILE) {
+      dot_tile(&queries[(long long) i0 * d], &xt[j0], stride, d, dots);
+      for (int i = i0; i < std::min(i0 + GT_QUERY_TILE, q_end); ++i) {
+        std::vector<neighbor_t> & heap = heaps[i];
+        for (long long j = j0; j < std::min(j0 + GT_POINT_TILE, cnt); ++j) {
+          double dist = q_norms[i] + x_norms[j]
+              - 2 * dots[(i - i0) * GT_POINT_TILE + (j - j0)];
+          neighbor_t nb(std::max(dist, 0.0), (int) (first_id + j));
+          if ((int) heap.size() < k) {
+            heap.push_back(nb);
+            std::push_heap(heap.begin(), heap.end());
+          } else if (nb < heap.front()) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = nb;
+            std::push_heap(heap.begin(), heap.end());
+          }
+        }
+      }
+    }
+  }
+}
+
+bool write_gt(const char * path, const std::vector<std::vector<int> > & gt,
+              int k) {
+  nns::DataFormat format = nns::guess_format(path);
+  FILE * fp = fopen(path, format == nns::FORMAT_TEXT ? "w" : "wb");
+  if (fp == NULL) {
+    fprintf(stderr, "cannot create file %s\n", path);
+    return false;
+  }
+  int nq = gt.size();
+  if (format == nns::FORMAT_LSHKIT) {
+    int header[3] = { sizeof(int), nq, k };
+    fwrite(header, sizeof(int), 3, fp);
+  }
+  for (int i = 0; i < nq; ++i) {
+    if (format == nns::FORMAT_TEXT) {
+      for (int j = 0; j < k; ++j) {
+        fprintf(fp, j ? " %d" : "%d", gt[i][j]);
+      }
+      fprintf(fp, "\n");
+    } else {
+      if (format != nns::FORMAT_LSHKIT) {  // ivecs
+        fwrite(&k, sizeof(int), 1, fp);
+      }
+      fwrite(&gt[i][0], sizeof(int), k, fp);
+    }
+  }
+  bool ok = !ferror(fp);
+  fclose(fp);
+  return ok;
+}
+
+// Opens a file of float vectors, d is used for text files
+bool open_vectors(const char * path, int d, nns::Dataset & ds) {
+  try {
+    ds.open(path, d > 0 ? d : 0);
+  } catch (const std::runtime_error & e) {
+    fprintf(stderr, "%s\n", e.what());
+    return false;
+  }
+  if (ds.format() == nns::FORMAT_IVECS || ds.format() == nns::FORMAT_BVECS
+      || ds.elem_size() != sizeof(float)) {
+    fprintf(stderr, "%s: only float vectors are supported\n", path);
+    return false;
+  }
+  return true;
+}
+
+void gen_gt(const char * data_file_name, const char * query_file,
+            const std::vector<std::string> & gt_files, int d, long long n,
+            int k, int num_threads) {
+  nns::Dataset queries_file, data_file;
+  if (!open_vectors(query_file, d, queries_file)
+      || !open_vectors(data_file_name, d, data_file)) {
+    exit(1);
+  }
+  d = data_file.dim();
+  if ((int) queries_file.dim() != d) {
+    fprintf(stderr, "dimensionality of queries is %d, not %d\n",
+            (int) queries_file.dim(), d);
+    exit(1);
+  }
+  if (n < 0 || (long long) data_file.size() < n) {
+    n = data_file.size();
+  }
+  data_file.advise(MADV_SEQUENTIAL);
+
+  // queries, padded to a multiple of GT_QUERY_TILE
+  int nq = queries_file.size();
+  if (nq == 0) {
+    fprintf(stderr, "no queries in %s\n", query_file);
+    exit(1);
+  }
+  std::vector<double> queries((long long) (nq + GT_QUERY_TILE - 1) / GT_QUERY_TILE * GT_QUERY_TILE * d, 0);
+  std::vector<double> q_norms(nq);
+  for (int i = 0; i < nq; ++i) {
+    const float * q = queries_file.row<float>(i);
+    double norm = 0;
+    for (int t = 0; t < d; ++t) {
+      queries[(long long) i * d + t] = q[t];
+      norm += (double) q[t] * q[t];
+    }
+    q_norms[i] = norm;
+  }
+
+  // queries of thread i: [q_split[i], q_split[i + 1])
+  int tiles = (nq + GT_QUERY_TILE - 1) / GT_QUERY_TILE;
+  num_threads = std::min(num_threads, tiles);
+  std::vector<int> q_split(num_threads + 1);
+  for (int i = 0; i <= num_threads; ++i) {
+    q_split[i] = std::min(nq, (int) ((long long) tiles * i / num_threads) * GT_QUERY_TILE);
+  }
+
+  std::vector<std::vector<neighbor_t> > heaps(nq);
+  const long long stride = GT_BLOCK;  // block is padded to GT_POINT_TILE
+  std::vector<double> xt(stride * d + GT_POINT_TILE, 0), x_norms(GT_BLOCK);
+  long long point_cnt = 0;
+  while (point_cnt < n) {
+    long long cnt = std::min((long long) GT_BLOCK, n - point_cnt);
+    for (long long j = 0; j < cnt; ++j) {
+      const float * row = data_file.row<float>(point_cnt + j);
+      double norm = 0;
+      for (int t = 0; t < d; ++t) {
+        double x = row[t];
+        xt[t * stride + j] = x;
+        norm += x * x;
+      }
+      x_norms[j] = norm;
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; ++i) {
+      threads.push_back(std::thread(search_block, &queries[0], &q_norms[0],
+                                    &xt[0], &x_norms[0], stride, cnt,
+                                    point_cnt, d, k, q_split[i],
+                                    q_split[i + 1], &heaps[0]));
+    }
+    search_block(&queries[0], &q_norms[0], &xt[0], &x_norms[0], stride, cnt,
+                 point_cnt, d, k, q_split[0], q_split[1], &heaps[0]);
+    for (size_t i = 0; i < threads.size(); ++i) {
+      threads[i].join();
+    }
+
+    point_cnt += cnt;
+    fprintf(stderr, "\r%lld points", point_cnt);
+  }
+  fprintf(stderr, "\n");
+
+  if (point_cnt < k) {
+    fprintf(stderr, "the dataset has only %lld points\n", point_cnt);
+    exit(1);
+  }
+
+  std::vector<std::vector<int> > gt(nq, std::vector<int>(k));
+  for (int i = 0; i < nq; ++i) {
+    std::sort_heap(heaps[i].begin(), heaps[i].end());
+    for (int j = 0; j < k; ++j) {
+      gt[i][j] = heaps[i][j].second;
+    }
+  }
+  for (size_t i = 0; i < gt_files.size(); ++i) {
+    if (!write_gt(gt_files[i].c_str(), gt, k)) {
+      exit(1);
+    }
+  }
+}